@@ -0,0 +1,8 @@
+#version 410 core
+out vec4 color;
+
+void main()
+{
+    // Color writes are masked off; only the samples passed by the depth test matter
+    color = vec4(1.0);
+}
@@ -0,0 +1,10 @@
+#version 410 core
+layout (location = 0) in vec3 aPos;
+
+// Transforms the unit cube onto an object's world-space bounding box
+uniform mat4 mvp;
+
+void main()
+{
+    gl_Position = mvp * vec4(aPos, 1.0);
+}
@@ -0,0 +1,177 @@
+#include "analytic_particles.h"
+#include "weighted_oit.h"
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+AnalyticParticles::AnalyticParticles(const ParticleEmitter::Settings &settings, GLuint shader, GLuint texture,
+                                     uint32_t seed)
+    : settings(settings), seed(seed), shader_id(shader), texture_id(texture) {
+    // Enough slots for every particle that can be alive at once; a slot is reused exactly when its particle dies
+    const int capacity = std::max(1, static_cast<int>(std::ceil(settings.rate * settings.lifetime)) + 1);
+    // Spawned long ago: every slot starts out dead
+    ring.assign(static_cast<size_t>(capacity), Spawn{-1.0e9f, 0u});
+
+    static constexpr GLfloat quad[] = {
+        -0.5f, -0.5f, 0.0f,
+        0.5f, -0.5f, 0.0f,
+        -0.5f, 0.5f, 0.0f,
+        0.5f, 0.5f, 0.0f,
+    };
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    glGenBuffers(1, &vbo_quad);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_quad);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, static_cast<void *>(nullptr));
+
+    glGenBuffers(1, &vbo_ring);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_ring);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(ring.size() * sizeof(Spawn)), ring.data(),
+                 GL_DYNAMIC_DRAW);
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(2);
+    bindRing(0, 1);
+    glBindVertexArray(0);
+
+    setShader(shader_id);
+}
+
+AnalyticParticles::~AnalyticParticles() {
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &vbo_quad);
+    glDeleteBuffers(1, &vbo_ring);
+}
+
+void AnalyticParticles::setShader(GLuint shader) {
+    shader_id = shader;
+    view_loc = glGetUniformLocation(shader_id, "view");
+    projection_loc = glGetUniformLocation(shader_id, "projection");
+    texture_sampler_loc = glGetUniformLocation(shader_id, "particleTexture");
+    stereo_half_separation_loc = glGetUniformLocation(shader_id, "stereoHalfSeparation");
+    time_loc = glGetUniformLocation(shader_id, "time");
+    emitter_position_loc = glGetUniformLocation(shader_id, "emitterPosition");
+    base_velocity_loc = glGetUniformLocation(shader_id, "baseVelocity");
+    velocity_jitter_loc = glGetUniformLocation(shader_id, "velocityJitter");
+    size_range_loc = glGetUniformLocation(shader_id, "sizeRange");
+    lifetime_loc = glGetUniformLocation(shader_id, "lifetime");
+    seed_loc = glGetUniformLocation(shader_id, "emitterSeed");
+    tint_loc = glGetUniformLocation(shader_id, "tint");
+    flipbook_loc = glGetUniformLocation(shader_id, "flipbook");
+}
+
+void AnalyticParticles::bindRing(int first, int views) const {
+    // Expects vao and vbo_ring bound
+    const size_t offset = static_cast<size_t>(first) * sizeof(Spawn);
+    glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, sizeof(Spawn),
+                          reinterpret_cast<void *>(offset + offsetof(Spawn, time)));
+    glVertexAttribIPointer(2, 1, GL_UNSIGNED_INT, sizeof(Spawn),
+                           reinterpret_cast<void *>(offset + offsetof(Spawn, seed)));
+    // Consecutive instances (one per eye) share a particle
+    glVertexAttribDivisor(1, static_cast<GLuint>(views));
+    glVertexAttribDivisor(2, static_cast<GLuint>(views));
+}
+
+void AnalyticParticles::update(float deltaTime) {
+    const int capacity = static_cast<int>(ring.size());
+    stats.uploadedBytes = 0;
+    if (time >= REBASE_PERIOD) {
+        // Ages are differences, so shifting every time by the same amount changes nothing on screen
+        time -= REBASE_PERIOD;
+        for (Spawn &spawn: ring) spawn.time -= REBASE_PERIOD;
+        glBindBuffer(GL_ARRAY_BUFFER, vbo_ring);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, static_cast<GLsizeiptr>(ring.size() * sizeof(Spawn)), ring.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        stats.uploadedBytes += static_cast<int>(ring.size() * sizeof(Spawn));
+    }
+    const float start = time;
+    time += deltaTime;
+
+    int count = 0;
+    if (settings.enabled && settings.rate > 0.0f) {
+        // As ParticleEmitter: particle k of this frame is due when the owed amount reaches k
+        const float owed = rate_accumulator + settings.rate * deltaTime;
+        count = static_cast<int>(owed);
+        const int first = head;
+        for (int k = 1; k <= count; k++) {
+            Spawn &spawn = ring[static_cast<size_t>(head)];
+            spawn.time = start + (static_cast<float>(k) - rate_accumulator) / settings.rate;
+            spawn.seed = seed ^ spawned++ * 0x9E3779B9u;
+            head = (head + 1) % capacity;
+        }
+        rate_accumulator = owed - static_cast<float>(count);
+
+        // The new slots, in at most two ranges when they wrap around the end
+        if (count > 0) {
+            glBindBuffer(GL_ARRAY_BUFFER, vbo_ring);
+            if (count >= capacity) {
+                glBufferSubData(GL_ARRAY_BUFFER, 0, static_cast<GLsizeiptr>(ring.size() * sizeof(Spawn)),
+                                ring.data());
+                count = capacity;
+            } else {
+                const int tail = std::min(count, capacity - first);
+                glBufferSubData(GL_ARRAY_BUFFER, static_cast<GLintptr>(first * sizeof(Spawn)),
+                                static_cast<GLsizeiptr>(tail * sizeof(Spawn)), &ring[static_cast<size_t>(first)]);
+                if (count > tail) {
+                    glBufferSubData(GL_ARRAY_BUFFER, 0, static_cast<GLsizeiptr>((count - tail) * sizeof(Spawn)),
+                                    ring.data());
+                }
+            }
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            stats.uploadedBytes += count * static_cast<int>(sizeof(Spawn));
+        }
+    }
+
+    stats.alive = 0;
+    for (const Spawn &spawn: ring) {
+        if (time - spawn.time < settings.lifetime) stats.alive++;
+    }
+}
+
+void AnalyticParticles::render(const glm::mat4 &viewMatrix, const glm::mat4 &projectionMatrix, int views,
+                               float eyeHalfSeparation) const {
+    if (order_independent) {
+        WeightedOit::setBlendState();
+    } else {
+        glEnable(GL_BLEND);
+        glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    }
+    glDepthMask(GL_FALSE);
+
+    glUseProgram(shader_id);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, texture_id);
+    glUniform1i(texture_sampler_loc, 0);
+    glUniformMatrix4fv(view_loc, 1, GL_FALSE, glm::value_ptr(viewMatrix));
+    glUniformMatrix4fv(projection_loc, 1, GL_FALSE, glm::value_ptr(projectionMatrix));
+    glUniform1f(stereo_half_separation_loc, eyeHalfSeparation);
+    glUniform1f(time_loc, time);
+    glUniform3fv(emitter_position_loc, 1, glm::value_ptr(settings.position));
+    glUniform3fv(base_velocity_loc, 1, glm::value_ptr(settings.velocity));
+    glUniform3fv(velocity_jitter_loc, 1, glm::value_ptr(settings.velocityJitter));
+    glUniform2f(size_range_loc, settings.minSize, settings.maxSize);
+    glUniform1f(lifetime_loc, settings.lifetime);
+    glUniform1ui(seed_loc, seed);
+    glUniform4fv(tint_loc, 1, glm::value_ptr(settings.tint));
+    glUniform2f(flipbook_loc, static_cast<float>(settings.atlasFrame),
+                static_cast<float>(std::max(settings.frameCount, 1)));
+
+    // Oldest first: from the head to the end of the ring, then from its start up to the head. GL 4.1 has no base
+    // instance, so the second range moves the attribute offsets instead
+    const int capacity = static_cast<int>(ring.size());
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_ring);
+    bindRing(head, views);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (capacity - head) * views);
+    if (head > 0) {
+        bindRing(0, views);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, head * views);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glBindVertexArray(0);
+    glDepthMask(GL_TRUE);
+    glDisable(GL_BLEND);
+}
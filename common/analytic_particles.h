@@ -0,0 +1,90 @@
+#ifndef ANALYTIC_PARTICLES_H
+#define ANALYTIC_PARTICLES_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "glad.h"
+
+#include "particle_emitter.h"
+
+/*
+ * AnalyticParticles Class
+ * One emitter whose particles are never simulated: with constant velocity and a linear fade, a particle's state is
+ * a pure function of its age and its random seed. The CPU only keeps a ring of (spawn time, seed) pairs, one slot
+ * per particle that can be alive at once (rate x lifetime), and the ANALYTIC permutation of particle.vert computes
+ * position, size and fade from "time - spawnTime" with the same integer hash as particle_sim.vert.
+ * Per frame the CPU writes just the slots of the particles born that frame (8 bytes each) and sets the clock.
+ * Slots are drawn oldest first, unsorted; dead slots collapse to zero-sized quads.
+ * Moving the emitter moves the whole plume, since its position is a uniform.
+ */
+class AnalyticParticles {
+public:
+    struct Stats {
+        int alive = 0;
+        int uploadedBytes = 0; // Written to the ring by the last update()
+    };
+
+    // Uses the settings' position, velocity, jitter, sizes, lifetime and rate; bursts, capacity and the overflow
+    // policy do not apply. "shader" must be an ANALYTIC permutation of the particle shader
+    AnalyticParticles(const ParticleEmitter::Settings &settings, GLuint shader, GLuint texture, uint32_t seed = 1u);
+
+    ~AnalyticParticles();
+
+    AnalyticParticles(const AnalyticParticles &) = delete;
+
+    AnalyticParticles &operator=(const AnalyticParticles &) = delete;
+
+    // Advances the clock and records the particles born during deltaTime
+    void update(float deltaTime);
+
+    // With views = 2 every particle is drawn twice, once per eye; needs the STEREO permutation as well
+    void render(const glm::mat4 &viewMatrix, const glm::mat4 &projectionMatrix, int views = 1,
+                float eyeHalfSeparation = 0.0f) const;
+
+    // Switches to another ANALYTIC permutation of the particle shader and looks up its uniforms
+    void setShader(GLuint shader);
+
+    // For an OIT permutation drawing into WeightedOit's targets
+    void setOrderIndependent(bool enabled) { order_independent = enabled; }
+
+    int getCapacity() const { return static_cast<int>(ring.size()); }
+
+    const Stats &getStats() const { return stats; }
+
+private:
+    // One ring slot, as particle.vert reads it
+    struct Spawn {
+        float time;
+        uint32_t seed;
+    };
+
+    // The clock is a float; it is moved back by this much (with every spawn time) before it loses precision
+    static constexpr float REBASE_PERIOD = 1024.0f;
+
+    // Points the instance attributes at the ring from slot "first"
+    void bindRing(int first, int views) const;
+
+    ParticleEmitter::Settings settings;
+    uint32_t seed;
+    std::vector<Spawn> ring;
+    int head = 0;            // Next slot to write, also the oldest particle
+    uint32_t spawned = 0;    // Particles ever spawned, numbers their seeds
+    float time = 0.0f;
+    float rate_accumulator = 0.0f;
+    Stats stats;
+
+    GLuint vao = 0;
+    GLuint vbo_quad = 0;
+    GLuint vbo_ring = 0;
+
+    // Shader uniform locations
+    GLint view_loc, projection_loc, texture_sampler_loc, stereo_half_separation_loc;
+    GLint time_loc, emitter_position_loc, base_velocity_loc, velocity_jitter_loc, size_range_loc, lifetime_loc;
+    GLint seed_loc, tint_loc, flipbook_loc;
+    GLuint shader_id;
+    GLuint texture_id;
+    bool order_independent = false;
+};
+
+#endif // ANALYTIC_PARTICLES_H
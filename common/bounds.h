@@ -0,0 +1,84 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include <glm/glm.hpp>
+
+#include <cfloat>
+#include <vector>
+
+/*
+ * AABB struct
+ * Axis-aligned bounding box used for culling.
+ * A default constructed box is "empty" (min > max) so it can be grown with expand().
+ */
+struct AABB {
+    glm::vec3 min = glm::vec3(FLT_MAX);
+    glm::vec3 max = glm::vec3(-FLT_MAX);
+
+    AABB() = default;
+
+    AABB(const glm::vec3 &min, const glm::vec3 &max) : min(min), max(max) {
+    }
+
+    // Box around the positions of interleaved vertex data ("stride" floats per vertex, position first)
+    static AABB fromInterleaved(const std::vector<float> &data, int stride) {
+        AABB box;
+        for (size_t i = 0; i + 2 < data.size(); i += stride) {
+            box.expand(glm::vec3(data[i], data[i + 1], data[i + 2]));
+        }
+        return box;
+    }
+
+    bool isEmpty() const {
+        return min.x > max.x || min.y > max.y || min.z > max.z;
+    }
+
+    void expand(const glm::vec3 &point) {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+
+    void expand(const AABB &other) {
+        if (other.isEmpty()) return;
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+
+    glm::vec3 center() const {
+        return (min + max) * 0.5f;
+    }
+
+    glm::vec3 extents() const {
+        return (max - min) * 0.5f;
+    }
+
+    // Returns the 8 corners of the box
+    void corners(glm::vec3 out[8]) const {
+        for (int i = 0; i < 8; i++) {
+            out[i] = glm::vec3(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z);
+        }
+    }
+
+    // Returns the world-space box enclosing this box after transformation by "model"
+    AABB transformed(const glm::mat4 &model) const {
+        if (isEmpty()) return *this;
+        // Arvo's method: transform center, then accumulate absolute extents per axis
+        glm::vec3 c = glm::vec3(model * glm::vec4(center(), 1.0f));
+        glm::vec3 e = extents();
+        glm::mat3 absRot;
+        for (int col = 0; col < 3; col++) {
+            absRot[col] = glm::abs(glm::vec3(model[col]));
+        }
+        glm::vec3 newExtents = absRot * e;
+        return {c - newExtents, c + newExtents};
+    }
+
+    // Returns a box with the same center, scaled per axis
+    AABB scaled(const glm::vec3 &factor) const {
+        glm::vec3 c = center();
+        glm::vec3 e = extents() * factor;
+        return {c - e, c + e};
+    }
+};
+
+#endif // BOUNDS_H
@@ -0,0 +1,77 @@
+#include "dynamic_resolution.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    constexpr int HISTORY_LENGTH = 240;
+
+    // Changes smaller than this are ignored, so timer noise does not make the image shimmer
+    constexpr float SCALE_DEADBAND = 0.02f;
+
+    // Fraction of the way to the ideal scale moved per frame; the timers lag a few frames behind,
+    // and jumping the whole way would oscillate
+    constexpr float SCALE_RATE = 0.1f;
+}
+
+DynamicResolution::DynamicResolution(GLuint upscaleProgram, float minScale)
+    : upscale_program(upscaleProgram), min_scale(minScale) {
+    sharpness_location = glGetUniformLocation(upscale_program, "sharpness");
+    render_scale_location = glGetUniformLocation(upscale_program, "renderScale");
+    texel_size_location = glGetUniformLocation(upscale_program, "texelSize");
+    glUseProgram(upscale_program);
+    glUniform1i(glGetUniformLocation(upscale_program, "sceneColor"), 0);
+
+    glGenVertexArrays(1, &empty_vao);
+    history.assign(HISTORY_LENGTH, 1.0f);
+}
+
+DynamicResolution::~DynamicResolution() {
+    glDeleteVertexArrays(1, &empty_vao);
+}
+
+void DynamicResolution::update(double gpuMs, double budgetMs) {
+    if (gpuMs <= 0.0 || budgetMs <= 0.0) return;
+    const float ideal = std::clamp(scale * static_cast<float>(std::sqrt(budgetMs / gpuMs)), min_scale, 1.0f);
+    if (std::abs(ideal - scale) < SCALE_DEADBAND * scale) return;
+    scale += (ideal - scale) * SCALE_RATE;
+}
+
+void DynamicResolution::setScale(float newScale) {
+    scale = std::clamp(newScale, min_scale, 1.0f);
+}
+
+void DynamicResolution::beginFrame(int nativeWidth, int nativeHeight) {
+    native_size = glm::ivec2(nativeWidth, nativeHeight);
+    render_size = glm::max(glm::ivec2(glm::vec2(native_size) * scale + 0.5f), glm::ivec2(1));
+
+    history[history_offset] = scale;
+    history_offset = (history_offset + 1) % HISTORY_LENGTH;
+}
+
+void DynamicResolution::beginScene() const {
+    glViewport(0, 0, render_size.x, render_size.y);
+    // Only the used corner needs clearing
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(0, 0, render_size.x, render_size.y);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glDisable(GL_SCISSOR_TEST);
+}
+
+void DynamicResolution::present(GLuint texture, float sharpness) const {
+    glViewport(0, 0, native_size.x, native_size.y);
+    glDisable(GL_DEPTH_TEST);
+
+    glUseProgram(upscale_program);
+    glUniform1f(sharpness_location, sharpness);
+    glUniform2f(render_scale_location, static_cast<float>(render_size.x) / static_cast<float>(native_size.x),
+                static_cast<float>(render_size.y) / static_cast<float>(native_size.y));
+    glUniform2f(texel_size_location, 1.0f / static_cast<float>(native_size.x),
+                1.0f / static_cast<float>(native_size.y));
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glBindVertexArray(empty_vao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+
+    glEnable(GL_DEPTH_TEST);
+}
@@ -0,0 +1,69 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "glad.h"
+
+/*
+ * DynamicResolution Class
+ * Renders the 3D scene at a fraction of the window size and scales it back up with a contrast-adaptive
+ * sharpening filter. The scene targets (from the render graph) stay at native size, and a smaller scale only
+ * uses their lower-left corner, so changing the scale every frame never reallocates anything.
+ * The scale is steered by update() from the measured GPU time of the passes it affects.
+ */
+class DynamicResolution {
+public:
+    // "upscaleProgram" is fullscreen.vert + upscale.frag
+    explicit DynamicResolution(GLuint upscaleProgram, float minScale = 0.5f);
+
+    ~DynamicResolution();
+
+    DynamicResolution(const DynamicResolution &) = delete;
+
+    DynamicResolution &operator=(const DynamicResolution &) = delete;
+
+    // Moves the scale towards the one that would make "gpuMs" meet "budgetMs". GPU cost is roughly
+    // proportional to the pixel count, so the step assumes time ~ scale^2
+    void update(double gpuMs, double budgetMs);
+
+    // Fixed scale, clamped to [minScale, 1]
+    void setScale(float scale);
+
+    // Picks this frame's render size for a window of the given size
+    void beginFrame(int nativeWidth, int nativeHeight);
+
+    // Sets the viewport to the render size and clears that corner of the bound framebuffer
+    void beginScene() const;
+
+    // Draws "texture" (native size, scene in the rendered corner) over the bound native-size framebuffer
+    // with sharpening
+    void present(GLuint texture, float sharpness) const;
+
+    float getScale() const { return scale; }
+
+    // Size the scene is rendered at this frame
+    glm::ivec2 getRenderSize() const { return render_size; }
+
+    glm::ivec2 getNativeSize() const { return native_size; }
+
+    // Scale of the last frames, oldest first starting at getHistoryOffset() (for ImGui::PlotLines)
+    const std::vector<float> &getHistory() const { return history; }
+
+    int getHistoryOffset() const { return history_offset; }
+
+private:
+    GLuint upscale_program;
+    GLint sharpness_location, render_scale_location, texel_size_location;
+    float min_scale;
+    float scale = 1.0f;
+
+    glm::ivec2 native_size = glm::ivec2(0);
+    glm::ivec2 render_size = glm::ivec2(0);
+    GLuint empty_vao = 0; // The full-screen triangle has no vertex data
+
+    std::vector<float> history;
+    int history_offset = 0;
+};
+
+#endif // DYNAMIC_RESOLUTION_H
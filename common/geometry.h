@@ -3,7 +3,11 @@
 
 #pragma once
 
+#include <cmath>
 #include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 #include "glad/glad.h" // For GLuint
 
 namespace Geometry {
@@ -112,6 +116,154 @@ namespace Geometry {
         0, 1, 2, 0, 2, 3
     };
 
+    // === Hub (Cylinder, in the center of 4 blades) ===
+    // Position (x, y, z) + Normal (nx, ny, nz); flat caps with their own vertices, then the side
+    inline void buildHub(std::vector<float> &hubVertexData, std::vector<GLuint> &hubIndices) {
+        constexpr int segments = 16;
+        constexpr float radius = 0.3f;
+        constexpr float length = 0.5f;
+
+        // Centers: X = 0.0, Y = 0.0
+        // Front Center (Z = length/2)
+        hubVertexData.insert(hubVertexData.end(), {0.0f, 0.0f, length / 2.0f, 0.0f, 0.0f, 1.0f}); // Index 0
+        // Back Center (Z = -length/2)
+        hubVertexData.insert(hubVertexData.end(), {0.0f, 0.0f, -length / 2.0f, 0.0f, 0.0f, -1.0f}); // Index 1
+
+        // Perimeter vertices
+        for (int i = 0; i < segments; ++i) {
+            float angle = glm::two_pi<float>() * static_cast<float>(i) / static_cast<float>(segments);
+            float x = radius * std::cos(angle);
+            float y = radius * std::sin(angle);
+
+            // Front perimeter vertex (Z = length/2)
+            hubVertexData.insert(hubVertexData.end(), {x, y, length / 2.0f, 0.0f, 0.0f, 1.0f});
+            // Back perimeter vertex (Z = -length/2)
+            hubVertexData.insert(hubVertexData.end(), {x, y, -length / 2.0f, 0.0f, 0.0f, -1.0f});
+        }
+
+        // Indices for caps
+        for (int i = 0; i < segments; ++i) {
+            GLuint next_i = (i + 1) % segments;
+            GLuint front_curr = 2 + i * 2;
+            GLuint front_next = 2 + next_i * 2;
+            GLuint back_curr = 3 + i * 2;
+            GLuint back_next = 3 + next_i * 2;
+
+            // Front cap triangle fan (using index 0 as center)
+            hubIndices.insert(hubIndices.end(), {0, front_curr, front_next});
+
+            // Back cap triangle fan (using index 1 as center)
+            hubIndices.insert(hubIndices.end(), {1, back_next, back_curr});
+        }
+
+        // Duplicating perimeter vertices for correct side normals
+        GLuint sideStartIndex = hubVertexData.size() / 6;
+        for (int i = 0; i < segments; ++i) {
+            float angle = glm::two_pi<float>() * static_cast<float>(i) / static_cast<float>(segments);
+            float x = radius * std::cos(angle);
+            float y = radius * std::sin(angle);
+
+            // Side normal (perpendicular to Z-axis)
+            float nx = std::cos(angle);
+            float ny = std::sin(angle);
+
+            GLuint next_i = (i + 1) % segments;
+
+            // Side Quad vertices
+            hubVertexData.insert(hubVertexData.end(), {x, y, length / 2.0f, nx, ny, 0.0f}); // front_curr_side
+            hubVertexData.insert(hubVertexData.end(), {x, y, -length / 2.0f, nx, ny, 0.0f}); // back_curr_side
+
+            // Quad indices
+            GLuint curr_f = sideStartIndex + i * 2;
+            GLuint curr_b = sideStartIndex + i * 2 + 1;
+            GLuint next_f = sideStartIndex + next_i * 2;
+            GLuint next_b = sideStartIndex + next_i * 2 + 1;
+
+            // Triangle 1 - front_curr, front_next, back_curr
+            hubIndices.insert(hubIndices.end(), {curr_f, next_f, curr_b});
+            // Triangle 2 - back_curr, front_next, back_next
+            hubIndices.insert(hubIndices.end(), {curr_b, next_f, next_b});
+        }
+    }
+
+    // === Chimney (Cylinder) ===
+    // Unit height and radius around the origin; 3 for position, 3 for normal, 2 for UV
+    constexpr int chimneyVertexStride = 8;
+
+    inline void buildChimney(std::vector<float> &chimneyVertexData, std::vector<GLuint> &chimneyIndices) {
+        constexpr int chimneySegments = 32;
+        constexpr float chimneyRadius = 1.0f;
+        constexpr float chimneyHeight = 1.0f;
+
+        // Generate vertices for the side of the cylinder
+        for (int i = 0; i <= chimneySegments; ++i) {
+            float angle = glm::two_pi<float>() * static_cast<float>(i) / static_cast<float>(chimneySegments);
+            float x = chimneyRadius * std::cos(angle);
+            float z = chimneyRadius * std::sin(angle);
+            float u = static_cast<float>(i) / static_cast<float>(chimneySegments);
+
+            glm::vec3 normal = glm::normalize(glm::vec3(x, 0.0f, z));
+
+            // Top vertex
+            chimneyVertexData.insert(chimneyVertexData.end(), {
+                                         x, chimneyHeight / 2.0f, z, normal.x, normal.y, normal.z, u, 1.0f
+                                     });
+            // Bottom vertex
+            chimneyVertexData.insert(chimneyVertexData.end(), {
+                                         x, -chimneyHeight / 2.0f, z, normal.x, normal.y, normal.z, u, 0.0f
+                                     });
+        }
+
+        // Indices for the side of the cylinder
+        for (int i = 0; i < chimneySegments; ++i) {
+            GLuint topLeft = i * 2;
+            GLuint bottomLeft = i * 2 + 1;
+            GLuint topRight = (i + 1) * 2;
+            GLuint bottomRight = (i + 1) * 2 + 1;
+
+            chimneyIndices.insert(chimneyIndices.end(), {bottomLeft, topRight, topLeft});
+            chimneyIndices.insert(chimneyIndices.end(), {bottomLeft, bottomRight, topRight});
+        }
+
+        // --- Vertices and indices for caps ---
+        // Top cap
+        GLuint topCenterIndex = chimneyVertexData.size() / chimneyVertexStride;
+        chimneyVertexData.insert(chimneyVertexData.end(),
+                                 {0.0f, chimneyHeight / 2.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.5f, 0.5f});
+        for (int i = 0; i <= chimneySegments; ++i) {
+            float angle = glm::two_pi<float>() * static_cast<float>(i) / static_cast<float>(chimneySegments);
+            float x = chimneyRadius * std::cos(angle);
+            float z = chimneyRadius * std::sin(angle);
+            chimneyVertexData.insert(chimneyVertexData.end(), {
+                                         x, chimneyHeight / 2.0f, z, 0.0f, 1.0f, 0.0f, 0.5f + 0.5f * x,
+                                         0.5f + 0.5f * z
+                                     });
+        }
+        for (int i = 0; i < chimneySegments; ++i) {
+            chimneyIndices.insert(chimneyIndices.end(),
+                                  {topCenterIndex, topCenterIndex + i + 1, topCenterIndex + i + 2});
+        }
+
+        // Bottom cap
+        GLuint bottomCenterIndex = chimneyVertexData.size() / chimneyVertexStride;
+        chimneyVertexData.insert(chimneyVertexData.end(),
+                                 {0.0f, -chimneyHeight / 2.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.5f, 0.5f});
+        for (int i = 0; i <= chimneySegments; ++i) {
+            float angle = glm::two_pi<float>() * static_cast<float>(i) / static_cast<float>(chimneySegments);
+            float x = chimneyRadius * std::cos(angle);
+            float z = chimneyRadius * std::sin(angle);
+            chimneyVertexData.insert(chimneyVertexData.end(), {
+                                         x, -chimneyHeight / 2.0f, z, 0.0f, -1.0f, 0.0f, 0.5f + 0.5f * x,
+                                         0.5f + 0.5f * z
+                                     });
+        }
+        for (int i = 0; i < chimneySegments; ++i) {
+            chimneyIndices.insert(chimneyIndices.end(), {
+                                      bottomCenterIndex, bottomCenterIndex + i + 2, bottomCenterIndex + i + 1
+                                  });
+        }
+    }
+
     // === Ground (Large Quad Plane) ===
     // Position (x, y, z) + Normal (nx, ny, nz)
     static const std::vector groundVertices = {
@@ -169,6 +321,77 @@ namespace Geometry {
         {25.0f, 0.0f, -5.0f},
         {30.0f, 0.0f, -45.0f}
     };
+
+    // === Scene Layout ===
+    // Model matrices shared by the windowed renderer and the headless software renderer
+    constexpr float treeA_scale = 2.0f;
+    constexpr float treeB_scale = 1.5f;
+
+    inline glm::mat4 treeTransform(const glm::vec3 &position, float scale) {
+        return glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(scale));
+    }
+
+    // Cabin: positioning, rotation (clockwise, around the Y-axis), scaling
+    inline glm::mat4 cabinTransform() {
+        glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3(10.0f, 0.0f, -30.0f));
+        transform = glm::rotate(transform, glm::radians(-180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        return glm::scale(transform, glm::vec3(0.4f));
+    }
+
+    // Bench 1: positioning, scaling
+    inline glm::mat4 bench1Transform() {
+        glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3(6.0f, 0.0f, -12.0f));
+        return glm::scale(transform, glm::vec3(0.02f));
+    }
+
+    // Bench 2: positioning, rotation (clockwise, around the Y-axis), scaling
+    inline glm::mat4 bench2Transform() {
+        glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3(10.0f, 0.0f, -8.0f));
+        transform = glm::rotate(transform, glm::radians(-90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        return glm::scale(transform, glm::vec3(0.02f));
+    }
+
+    // Chimney: move it back-left of the windmill and move it up so its base is on the ground plane, then scale
+    inline glm::mat4 chimneyTransform() {
+        glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3(-10.0f, 7.5f, -30.0f));
+        return glm::scale(transform, glm::vec3(0.8f, 15.0f, 0.8f));
+    }
+
+    // Ground: move the ground plane up slightly to meet the base of the objects
+    inline glm::mat4 groundTransform() {
+        return glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.5f, 0.0f));
+    }
+
+    // Windmill main body: the tower (quadrangular frustum) and cap (cube) rotate together around the Y-axis
+    inline glm::mat4 towerTransform(float bodyAngle) {
+        return glm::rotate(glm::mat4(1.0f), glm::radians(bodyAngle), glm::vec3(0.0f, 1.0f, 0.0f));
+    }
+
+    // T_center * R_body: the cap's center, which the blades and the hub hang off
+    inline glm::mat4 bodyTransform(float bodyAngle) {
+        glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 10.0f, 0.0f));
+        return glm::rotate(transform, glm::radians(bodyAngle), glm::vec3(0.0f, 1.0f, 0.0f));
+    }
+
+    // T_center * R_body * S_cap
+    inline glm::mat4 capTransform(float bodyAngle) {
+        return glm::scale(bodyTransform(bodyAngle), glm::vec3(1.5f, 1.0f, 1.5f));
+    }
+
+    // Blade "i" of 4
+    inline glm::mat4 bladeTransform(float bodyAngle, float bladeAngle, int i) {
+        glm::mat4 transform = capTransform(bodyAngle);
+        // Translate to the center of the block's side, leaving a slight gap
+        transform = glm::translate(transform, glm::vec3(0.0f, 0.0f, 1.05f));
+        // Rotate the blade around the Z-axis
+        return glm::rotate(transform, glm::radians(bladeAngle + static_cast<float>(i) * 90.0f),
+                           glm::vec3(0.0f, 0.0f, 1.0f));
+    }
+
+    // Hub cylinder, in the center of the 4 blades
+    inline glm::mat4 hubTransform(float bodyAngle) {
+        return glm::translate(bodyTransform(bodyAngle), glm::vec3(0.0f, 0.0f, 1.5f));
+    }
 }
 
 #endif //GEOMETRY_H
@@ -0,0 +1,457 @@
+#include "gl_device.h"
+#include "shader_variants.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace {
+    // Space reserved per push, the largest block the abstraction allows
+    constexpr size_t MAX_PUSH_CONSTANTS = 128;
+    constexpr GLuint PUSH_CONSTANT_BINDING = 0;
+
+    struct GLCommand {
+        enum Type {
+            BeginPass, EndPass, Viewport, BindPipeline, BindVertexBuffer, BindIndexBuffer, BindTexture,
+            PushConstants, Draw, DrawIndexed
+        };
+
+        Type type;
+        uint32_t handle = 0;
+        size_t offset = 0;     // Into the vertex buffer or the list's push constants
+        GLint args[4] = {0, 0, 0, 0};
+    };
+
+    struct TextureFormatGL {
+        GLenum internalFormat, format, type;
+        size_t texelBytes;
+    };
+
+    TextureFormatGL formatOf(TextureFormat format) {
+        switch (format) {
+            case TextureFormat::RGBA16F: return {GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT, 8};
+            case TextureFormat::Depth32F: return {GL_DEPTH_COMPONENT32F, GL_DEPTH_COMPONENT, GL_FLOAT, 4};
+            default: return {GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, 4};
+        }
+    }
+
+    GLenum compareOf(CompareOp op) {
+        switch (op) {
+            case CompareOp::LessEqual: return GL_LEQUAL;
+            case CompareOp::Always: return GL_ALWAYS;
+            default: return GL_LESS;
+        }
+    }
+}
+
+/*
+ * GLCommandList Class
+ * Commands as plain data; push constants are packed at the uniform buffer offset alignment so submit()
+ * uploads each list's with one call and binds ranges of it.
+ */
+class GLCommandList : public CommandList {
+public:
+    explicit GLCommandList(size_t constantAlignment) : constant_alignment(constantAlignment) {
+    }
+
+    void begin() override {
+        commands.clear();
+        passes.clear();
+        constants.clear();
+    }
+
+    void end() override {
+    }
+
+    void beginRenderPass(const RenderPassDesc &pass) override {
+        GLCommand command{GLCommand::BeginPass};
+        command.args[0] = static_cast<GLint>(passes.size());
+        passes.push_back(pass);
+        commands.push_back(command);
+    }
+
+    void endRenderPass() override {
+        commands.push_back(GLCommand{GLCommand::EndPass});
+    }
+
+    void setViewport(int x, int y, int width, int height) override {
+        GLCommand command{GLCommand::Viewport};
+        command.args[0] = x;
+        command.args[1] = y;
+        command.args[2] = width;
+        command.args[3] = height;
+        commands.push_back(command);
+    }
+
+    void bindPipeline(PipelineHandle pipeline) override {
+        GLCommand command{GLCommand::BindPipeline};
+        command.handle = pipeline.id;
+        commands.push_back(command);
+    }
+
+    void bindVertexBuffer(BufferHandle buffer, size_t offset) override {
+        GLCommand command{GLCommand::BindVertexBuffer};
+        command.handle = buffer.id;
+        command.offset = offset;
+        commands.push_back(command);
+    }
+
+    void bindIndexBuffer(BufferHandle buffer) override {
+        GLCommand command{GLCommand::BindIndexBuffer};
+        command.handle = buffer.id;
+        commands.push_back(command);
+    }
+
+    void bindTexture(int slot, TextureHandle texture) override {
+        GLCommand command{GLCommand::BindTexture};
+        command.handle = texture.id;
+        command.args[0] = slot;
+        commands.push_back(command);
+    }
+
+    void pushConstants(const void *data, uint32_t size) override {
+        size = std::min(size, static_cast<uint32_t>(MAX_PUSH_CONSTANTS));
+        GLCommand command{GLCommand::PushConstants};
+        command.offset = (constants.size() + constant_alignment - 1) / constant_alignment * constant_alignment;
+        constants.resize(command.offset + MAX_PUSH_CONSTANTS, 0);
+        std::memcpy(constants.data() + command.offset, data, size);
+        commands.push_back(command);
+    }
+
+    void draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex) override {
+        GLCommand command{GLCommand::Draw};
+        command.args[0] = static_cast<GLint>(vertexCount);
+        command.args[1] = static_cast<GLint>(instanceCount);
+        command.args[2] = static_cast<GLint>(firstVertex);
+        commands.push_back(command);
+    }
+
+    void drawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex) override {
+        GLCommand command{GLCommand::DrawIndexed};
+        command.args[0] = static_cast<GLint>(indexCount);
+        command.args[1] = static_cast<GLint>(instanceCount);
+        command.args[2] = static_cast<GLint>(firstIndex);
+        commands.push_back(command);
+    }
+
+    std::vector<GLCommand> commands;
+    std::vector<RenderPassDesc> passes;
+    std::vector<unsigned char> constants;
+
+private:
+    size_t constant_alignment;
+};
+
+GLRenderDevice::GLRenderDevice(ProgramCache *cache) : program_cache(cache) {
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniform_alignment);
+    glGenBuffers(1, &push_constant_buffer);
+}
+
+GLRenderDevice::~GLRenderDevice() {
+    for (const Buffer &buffer: buffers) {
+        if (buffer.name) glDeleteBuffers(1, &buffer.name);
+    }
+    for (const Texture &texture: textures) {
+        if (texture.name && texture.owned) glDeleteTextures(1, &texture.name);
+    }
+    for (const Pipeline &pipeline: pipelines) {
+        if (pipeline.vao) glDeleteVertexArrays(1, &pipeline.vao);
+    }
+    for (const auto &entry: framebuffers) {
+        glDeleteFramebuffers(1, &entry.second);
+    }
+    glDeleteBuffers(1, &push_constant_buffer);
+}
+
+std::string GLRenderDevice::name() const {
+    return std::string("OpenGL ") + reinterpret_cast<const char *>(glGetString(GL_VERSION)) + " " +
+           reinterpret_cast<const char *>(glGetString(GL_RENDERER));
+}
+
+BufferHandle GLRenderDevice::createBuffer(const BufferDesc &desc) {
+    Buffer buffer;
+    buffer.target = desc.usage == BufferUsage::Index ? GL_ELEMENT_ARRAY_BUFFER : GL_ARRAY_BUFFER;
+    glGenBuffers(1, &buffer.name);
+    // Filled through the copy target: binding an element buffer would change the bound vertex array
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer.name);
+    glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(desc.size), desc.data,
+                 desc.data ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW);
+    buffers.push_back(buffer);
+    return BufferHandle{static_cast<uint32_t>(buffers.size())};
+}
+
+void GLRenderDevice::updateBuffer(BufferHandle buffer, const void *data, size_t size, size_t offset) {
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffers[buffer.id - 1].name);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(size), data);
+}
+
+TextureHandle GLRenderDevice::createTexture(const TextureDesc &desc) {
+    const TextureFormatGL format = formatOf(desc.format);
+    Texture texture;
+    texture.target = desc.type == TextureType::Cube ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+    texture.desc = desc;
+    texture.desc.data = nullptr;
+    glGenTextures(1, &texture.name);
+    glBindTexture(texture.target, texture.name);
+    const auto *texels = static_cast<const unsigned char *>(desc.data);
+    if (desc.type == TextureType::Cube) {
+        const size_t faceBytes = static_cast<size_t>(desc.width) * desc.height * format.texelBytes;
+        for (int face = 0; face < 6; face++) {
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, format.internalFormat, desc.width, desc.height, 0,
+                         format.format, format.type, texels ? texels + face * faceBytes : nullptr);
+        }
+    } else {
+        glTexImage2D(GL_TEXTURE_2D, 0, format.internalFormat, desc.width, desc.height, 0, format.format, format.type,
+                     texels);
+    }
+    glTexParameteri(texture.target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(texture.target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(texture.target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(texture.target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(texture.target, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    textures.push_back(texture);
+    return TextureHandle{static_cast<uint32_t>(textures.size())};
+}
+
+TextureHandle GLRenderDevice::importTexture(GLuint name, TextureType type, int width, int height) {
+    Texture texture;
+    texture.name = name;
+    texture.target = type == TextureType::Cube ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+    texture.desc.type = type;
+    texture.desc.width = width;
+    texture.desc.height = height;
+    texture.owned = false;
+    textures.push_back(texture);
+    return TextureHandle{static_cast<uint32_t>(textures.size())};
+}
+
+PipelineHandle GLRenderDevice::createPipeline(const PipelineDesc &desc) {
+    std::unique_ptr<ShaderVariants> &variants = shaders[std::make_pair(desc.vertexShader, desc.fragmentShader)];
+    if (!variants) {
+        variants = std::make_unique<ShaderVariants>(desc.vertexShader.c_str(), desc.fragmentShader.c_str(),
+                                                    program_cache);
+    }
+
+    Pipeline pipeline;
+    pipeline.desc = desc;
+    pipeline.program = variants->get(desc.features).id;
+    glUseProgram(pipeline.program);
+    for (size_t slot = 0; slot < desc.textures.size(); slot++) {
+        glUniform1i(glGetUniformLocation(pipeline.program, desc.textures[slot].c_str()), static_cast<GLint>(slot));
+    }
+    const GLuint block = glGetUniformBlockIndex(pipeline.program, "PushConstants");
+    if (block != GL_INVALID_INDEX) {
+        glUniformBlockBinding(pipeline.program, block, PUSH_CONSTANT_BINDING);
+    } else if (desc.pushConstantSize > 0) {
+        std::cout << "ERROR::GL_DEVICE::NO_PUSH_CONSTANT_BLOCK " << desc.vertexShader << std::endl;
+    }
+    glGenVertexArrays(1, &pipeline.vao);
+    pipelines.push_back(pipeline);
+    return PipelineHandle{static_cast<uint32_t>(pipelines.size())};
+}
+
+void GLRenderDevice::destroyBuffer(BufferHandle buffer) {
+    Buffer &entry = buffers[buffer.id - 1];
+    glDeleteBuffers(1, &entry.name);
+    entry.name = 0;
+}
+
+void GLRenderDevice::destroyTexture(TextureHandle texture) {
+    Texture &entry = textures[texture.id - 1];
+    for (auto it = framebuffers.begin(); it != framebuffers.end();) {
+        if (it->first.first == texture.id || it->first.second == texture.id) {
+            glDeleteFramebuffers(1, &it->second);
+            it = framebuffers.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    if (entry.owned) glDeleteTextures(1, &entry.name);
+    entry.name = 0;
+}
+
+void GLRenderDevice::destroyPipeline(PipelineHandle pipeline) {
+    // The program stays with its ShaderVariants, other pipelines may use it
+    Pipeline &entry = pipelines[pipeline.id - 1];
+    glDeleteVertexArrays(1, &entry.vao);
+    entry.vao = 0;
+}
+
+std::unique_ptr<CommandList> GLRenderDevice::createCommandList() {
+    return std::make_unique<GLCommandList>(static_cast<size_t>(uniform_alignment));
+}
+
+GLuint GLRenderDevice::framebufferFor(TextureHandle color, TextureHandle depth) {
+    const auto key = std::make_pair(color.id, depth.id);
+    auto found = framebuffers.find(key);
+    if (found != framebuffers.end()) return found->second;
+
+    GLuint framebuffer;
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    if (color.valid()) {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textures[color.id - 1].name, 0);
+    } else {
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+    }
+    if (depth.valid()) {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, textures[depth.id - 1].name, 0);
+    }
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cout << "ERROR::GL_DEVICE::FRAMEBUFFER_INCOMPLETE" << std::endl;
+    }
+    framebuffers[key] = framebuffer;
+    return framebuffer;
+}
+
+void GLRenderDevice::submit(const std::vector<CommandList *> &lists) {
+    const Pipeline *pipeline = nullptr;
+    const Buffer *vertexBuffer = nullptr;
+    size_t vertexOffset = 0;
+    GLuint indexBuffer = 0;
+    // Passes with attachments put back the framebuffer and viewport they replaced
+    GLint previousFramebuffer = 0;
+    GLint previousViewport[4] = {0, 0, 0, 0};
+    bool restoreFramebuffer = false;
+
+    // Vertex formats live in the pipeline's vertex array, so the buffers are attached whenever either changes
+    auto applyVertexInput = [&]() {
+        if (!pipeline) return;
+        glBindVertexArray(pipeline->vao);
+        if (vertexBuffer) {
+            glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer->name);
+            for (const VertexAttribute &attribute: pipeline->desc.attributes) {
+                glEnableVertexAttribArray(attribute.location);
+                glVertexAttribPointer(attribute.location, attribute.components, GL_FLOAT, GL_FALSE,
+                                      static_cast<GLsizei>(pipeline->desc.vertexStride),
+                                      reinterpret_cast<void *>(vertexOffset + attribute.offset));
+            }
+        }
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    };
+
+    for (CommandList *base: lists) {
+        const auto *list = static_cast<const GLCommandList *>(base);
+        if (!list->constants.empty()) {
+            glBindBuffer(GL_UNIFORM_BUFFER, push_constant_buffer);
+            // Orphaned, so draws still reading the previous contents keep them
+            glBufferData(GL_UNIFORM_BUFFER, static_cast<GLsizeiptr>(list->constants.size()), list->constants.data(),
+                         GL_STREAM_DRAW);
+        }
+
+        for (const GLCommand &command: list->commands) {
+            switch (command.type) {
+                case GLCommand::BeginPass: {
+                    const RenderPassDesc &pass = list->passes[command.args[0]];
+                    if (pass.color.valid() || pass.depth.valid()) {
+                        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+                        glGetIntegerv(GL_VIEWPORT, previousViewport);
+                        restoreFramebuffer = true;
+                        glBindFramebuffer(GL_FRAMEBUFFER, framebufferFor(pass.color, pass.depth));
+                        const TextureDesc &size = textures[(pass.color.valid() ? pass.color : pass.depth).id - 1].desc;
+                        glViewport(0, 0, size.width, size.height);
+                    }
+                    if (pass.clear) {
+                        glDepthMask(GL_TRUE);
+                        glClearColor(pass.clearColor.r, pass.clearColor.g, pass.clearColor.b, pass.clearColor.a);
+                        glClearDepth(pass.clearDepth);
+                        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                    }
+                    break;
+                }
+                case GLCommand::EndPass:
+                    if (restoreFramebuffer) {
+                        glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(previousFramebuffer));
+                        glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+                        restoreFramebuffer = false;
+                    }
+                    break;
+                case GLCommand::Viewport:
+                    glViewport(command.args[0], command.args[1], command.args[2], command.args[3]);
+                    break;
+                case GLCommand::BindPipeline: {
+                    pipeline = &pipelines[command.handle - 1];
+                    const PipelineDesc &desc = pipeline->desc;
+                    glUseProgram(pipeline->program);
+                    if (desc.depthTest) glEnable(GL_DEPTH_TEST);
+                    else glDisable(GL_DEPTH_TEST);
+                    glDepthFunc(compareOf(desc.depthCompare));
+                    glDepthMask(desc.depthWrite ? GL_TRUE : GL_FALSE);
+                    if (desc.alphaBlend) {
+                        glEnable(GL_BLEND);
+                        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+                    } else {
+                        glDisable(GL_BLEND);
+                    }
+                    if (desc.cullBackFaces) glEnable(GL_CULL_FACE);
+                    else glDisable(GL_CULL_FACE);
+                    applyVertexInput();
+                    break;
+                }
+                case GLCommand::BindVertexBuffer:
+                    vertexBuffer = &buffers[command.handle - 1];
+                    vertexOffset = command.offset;
+                    applyVertexInput();
+                    break;
+                case GLCommand::BindIndexBuffer:
+                    indexBuffer = buffers[command.handle - 1].name;
+                    applyVertexInput();
+                    break;
+                case GLCommand::BindTexture: {
+                    const Texture &texture = textures[command.handle - 1];
+                    glActiveTexture(GL_TEXTURE0 + command.args[0]);
+                    glBindTexture(texture.target, texture.name);
+                    break;
+                }
+                case GLCommand::PushConstants:
+                    glBindBufferRange(GL_UNIFORM_BUFFER, PUSH_CONSTANT_BINDING, push_constant_buffer,
+                                      static_cast<GLintptr>(command.offset), MAX_PUSH_CONSTANTS);
+                    break;
+                case GLCommand::Draw:
+                    glDrawArraysInstanced(GL_TRIANGLES, command.args[2], command.args[0], command.args[1]);
+                    break;
+                case GLCommand::DrawIndexed:
+                    glDrawElementsInstanced(GL_TRIANGLES, command.args[0], GL_UNSIGNED_INT,
+                                            reinterpret_cast<void *>(command.args[2] * sizeof(GLuint)),
+                                            command.args[1]);
+                    break;
+            }
+        }
+    }
+
+    glBindVertexArray(0);
+    glActiveTexture(GL_TEXTURE0);
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LESS);
+    glDepthMask(GL_TRUE);
+    glDisable(GL_BLEND);
+    glDisable(GL_CULL_FACE);
+}
+
+std::vector<unsigned char> GLRenderDevice::readTexture(TextureHandle texture) {
+    const Texture &entry = textures[texture.id - 1];
+    const size_t rowBytes = static_cast<size_t>(entry.desc.width) * 4;
+    std::vector<unsigned char> texels(rowBytes * entry.desc.height);
+    if (entry.desc.format != TextureFormat::RGBA8 || entry.target != GL_TEXTURE_2D) {
+        std::cout << "ERROR::GL_DEVICE::READ_TEXTURE_FORMAT" << std::endl;
+        return texels;
+    }
+    glBindTexture(GL_TEXTURE_2D, entry.name);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, texels.data());
+    // GL rows start at the bottom
+    std::vector<unsigned char> row(rowBytes);
+    for (int y = 0; y < entry.desc.height / 2; y++) {
+        unsigned char *top = texels.data() + y * rowBytes;
+        unsigned char *bottom = texels.data() + (entry.desc.height - 1 - y) * rowBytes;
+        std::memcpy(row.data(), top, rowBytes);
+        std::memcpy(top, bottom, rowBytes);
+        std::memcpy(bottom, row.data(), rowBytes);
+    }
+    return texels;
+}
+
+void GLRenderDevice::report() const {
+    for (const auto &entry: shaders) {
+        entry.second->report();
+    }
+}
@@ -0,0 +1,95 @@
+#ifndef GL_DEVICE_H
+#define GL_DEVICE_H
+
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "glad.h"
+
+#include "render_device.h"
+
+class ProgramCache;
+class ShaderVariants;
+
+/*
+ * GLRenderDevice Class
+ * RenderDevice on the current GL context. Pipelines are ShaderVariants permutations plus the fixed-function
+ * state they set; push constants become a std140 uniform block named PushConstants. Command lists record into
+ * plain command arrays, so they can be recorded on any thread, and are replayed by submit() on the GL thread.
+ * submit() leaves depth testing on with GL_LESS and depth writes, no blending and no culling, as the rest of
+ * the renderer expects.
+ */
+class GLRenderDevice : public RenderDevice {
+public:
+    explicit GLRenderDevice(ProgramCache *cache = nullptr);
+
+    ~GLRenderDevice() override;
+
+    GLRenderDevice(const GLRenderDevice &) = delete;
+
+    GLRenderDevice &operator=(const GLRenderDevice &) = delete;
+
+    std::string name() const override;
+
+    BufferHandle createBuffer(const BufferDesc &desc) override;
+
+    void updateBuffer(BufferHandle buffer, const void *data, size_t size, size_t offset) override;
+
+    TextureHandle createTexture(const TextureDesc &desc) override;
+
+    // Wraps a texture made elsewhere (e.g. loaded with stb_image); destroyTexture() leaves it alive
+    TextureHandle importTexture(GLuint texture, TextureType type, int width = 0, int height = 0);
+
+    PipelineHandle createPipeline(const PipelineDesc &desc) override;
+
+    void destroyBuffer(BufferHandle buffer) override;
+
+    void destroyTexture(TextureHandle texture) override;
+
+    void destroyPipeline(PipelineHandle pipeline) override;
+
+    std::unique_ptr<CommandList> createCommandList() override;
+
+    void submit(const std::vector<CommandList *> &lists) override;
+
+    std::vector<unsigned char> readTexture(TextureHandle texture) override;
+
+    // Prints the shader permutations compiled for pipelines
+    void report() const;
+
+private:
+    struct Buffer {
+        GLuint name = 0;
+        GLenum target = GL_ARRAY_BUFFER;
+    };
+
+    struct Texture {
+        GLuint name = 0;
+        GLenum target = GL_TEXTURE_2D;
+        TextureDesc desc;
+        bool owned = true;
+    };
+
+    struct Pipeline {
+        GLuint program = 0;
+        GLuint vao = 0;
+        PipelineDesc desc;
+    };
+
+    GLuint framebufferFor(TextureHandle color, TextureHandle depth);
+
+    std::vector<Buffer> buffers;   // Handle id - 1; destroyed entries keep name 0
+    std::vector<Texture> textures;
+    std::vector<Pipeline> pipelines;
+
+    ProgramCache *program_cache;
+    std::map<std::pair<std::string, std::string>, std::unique_ptr<ShaderVariants> > shaders;
+    std::map<std::pair<uint32_t, uint32_t>, GLuint> framebuffers; // Keyed by colour and depth handle
+
+    GLuint push_constant_buffer = 0;
+    GLint uniform_alignment = 256;
+};
+
+#endif // GL_DEVICE_H
@@ -0,0 +1,38 @@
+#include "gpu_counter.h"
+
+GpuCounter::GpuCounter(GLenum target, int latency) : target(target) {
+    queries.resize(latency);
+    glGenQueries(latency, queries.data());
+    pending.assign(latency, false);
+}
+
+GpuCounter::~GpuCounter() {
+    glDeleteQueries(static_cast<GLsizei>(queries.size()), queries.data());
+}
+
+void GpuCounter::collect() {
+    while (pending[oldest]) {
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(queries[oldest], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) break;
+        glGetQueryObjectui64v(queries[oldest], GL_QUERY_RESULT, &last_value);
+        pending[oldest] = false;
+        oldest = (oldest + 1) % static_cast<int>(queries.size());
+    }
+}
+
+void GpuCounter::begin() {
+    collect();
+    // Ring is full of unfinished queries: drop the oldest rather than wait for it
+    if (pending[next]) {
+        pending[next] = false;
+        oldest = (next + 1) % static_cast<int>(queries.size());
+    }
+    glBeginQuery(target, queries[next]);
+}
+
+void GpuCounter::end() {
+    glEndQuery(target);
+    pending[next] = true;
+    next = (next + 1) % static_cast<int>(queries.size());
+}
@@ -0,0 +1,45 @@
+#ifndef GPU_COUNTER_H
+#define GPU_COUNTER_H
+
+#include <vector>
+#include "glad.h"
+
+/*
+ * GpuCounter Class
+ * Wraps a small ring of query objects of one target (GL_TIME_ELAPSED, GL_SAMPLES_PASSED, ...).
+ * begin()/end() bracket the measured GL commands once per frame; results are picked up a few frames later,
+ * only once they are available, so reading a counter never stalls the pipeline.
+ */
+class GpuCounter {
+public:
+    explicit GpuCounter(GLenum target, int latency = 4);
+
+    ~GpuCounter();
+
+    GpuCounter(const GpuCounter &) = delete;
+
+    GpuCounter &operator=(const GpuCounter &) = delete;
+
+    void begin();
+
+    void end();
+
+    // Latest available result (0 until the first one arrives)
+    GLuint64 value() const { return last_value; }
+
+    // For GL_TIME_ELAPSED counters: latest result in milliseconds
+    double milliseconds() const { return static_cast<double>(last_value) / 1.0e6; }
+
+private:
+    // Reads every finished query, oldest first
+    void collect();
+
+    GLenum target;
+    std::vector<GLuint> queries;
+    std::vector<bool> pending;
+    int next = 0; // Ring slot used by the next begin()
+    int oldest = 0; // Oldest slot that may still be pending
+    GLuint64 last_value = 0;
+};
+
+#endif // GPU_COUNTER_H
@@ -0,0 +1,229 @@
+#include "gpu_particles.h"
+#include "program_cache.h"
+#include "weighted_oit.h"
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+namespace {
+    std::string readSource(const std::string &path) {
+        std::ifstream file(path);
+        if (!file) {
+            std::cout << "ERROR::SHADER::FILE_NOT_READ " << path << std::endl;
+            return "";
+        }
+        std::stringstream stream;
+        stream << file.rdbuf();
+        return stream.str();
+    }
+
+    // The varyings must be declared before linking, which rules out ShaderVariants
+    GLuint buildSimulationProgram(ProgramCache *cache) {
+        const std::string source = readSource("particle_sim.vert");
+        auto attachShaders = [&](GLuint program) {
+            GLuint shader = glCreateShader(GL_VERTEX_SHADER);
+            const char *code = source.c_str();
+            glShaderSource(shader, 1, &code, nullptr);
+            glCompileShader(shader);
+            int success;
+            char infoLog[512];
+            glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+            if (!success) {
+                glGetShaderInfoLog(shader, 512, nullptr, infoLog);
+                std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED (particle_sim.vert)\n" << infoLog << std::endl;
+            }
+            glAttachShader(program, shader);
+            glDeleteShader(shader);
+            static const char *const varyings[] = {"outPosAndSize", "outVelocityAndAge", "outAlphaAndFrame"};
+            glTransformFeedbackVaryings(program, 3, varyings, GL_INTERLEAVED_ATTRIBS);
+        };
+
+        GLuint program;
+        if (cache) {
+            // No fragment stage: the varyings are part of the source, so they are covered by the key
+            program = cache->getProgram(source, "", "particle_sim.vert (transform feedback)", attachShaders);
+        } else {
+            program = glCreateProgram();
+            attachShaders(program);
+            glLinkProgram(program);
+        }
+        int linked;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            char infoLog[512];
+            glGetProgramInfoLog(program, 512, nullptr, infoLog);
+            std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED (particle_sim.vert)\n" << infoLog << std::endl;
+        }
+        return program;
+    }
+}
+
+GpuParticles::GpuParticles(const ParticleEmitter::Settings &settings, GLuint renderShader, GLuint texture,
+                           ProgramCache *cache)
+    : settings(settings), shader_id(renderShader), texture_id(texture) {
+    sim_program = buildSimulationProgram(cache);
+    sim_emitter_position_loc = glGetUniformLocation(sim_program, "emitterPosition");
+    sim_base_velocity_loc = glGetUniformLocation(sim_program, "baseVelocity");
+    sim_velocity_jitter_loc = glGetUniformLocation(sim_program, "velocityJitter");
+    sim_size_range_loc = glGetUniformLocation(sim_program, "sizeRange");
+    sim_lifetime_loc = glGetUniformLocation(sim_program, "lifetime");
+    sim_delta_time_loc = glGetUniformLocation(sim_program, "deltaTime");
+    sim_frame_seed_loc = glGetUniformLocation(sim_program, "frameSeed");
+    sim_flipbook_loc = glGetUniformLocation(sim_program, "flipbook");
+
+    static constexpr GLfloat quad[] = {
+        -0.5f, -0.5f, 0.0f,
+        0.5f, -0.5f, 0.0f,
+        -0.5f, 0.5f, 0.0f,
+        0.5f, 0.5f, 0.0f,
+    };
+    glGenBuffers(1, &vbo_quad);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_quad);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+
+    glGenBuffers(2, buffers);
+    glGenTransformFeedbacks(2, feedback);
+    glGenVertexArrays(2, sim_vao);
+    glGenVertexArrays(2, render_vao);
+    for (int i = 0; i < 2; i++) {
+        glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, feedback[i]);
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, buffers[i]);
+
+        glBindVertexArray(sim_vao[i]);
+        glBindBuffer(GL_ARRAY_BUFFER, buffers[i]);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, PARTICLE_STRIDE, static_cast<void *>(nullptr));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, PARTICLE_STRIDE, reinterpret_cast<void *>(4 * sizeof(float)));
+
+        // The attributes particle.vert gets from ParticleSystem: quad corners, posAndSize, then the fade and atlas
+        // frame. The tint is the same for every particle, so it is a constant attribute set in render()
+        glBindVertexArray(render_vao[i]);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo_quad);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, static_cast<void *>(nullptr));
+        glBindBuffer(GL_ARRAY_BUFFER, buffers[i]);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, PARTICLE_STRIDE, static_cast<void *>(nullptr));
+        glVertexAttribDivisor(1, 1);
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, PARTICLE_STRIDE, reinterpret_cast<void *>(8 * sizeof(float)));
+        glVertexAttribDivisor(3, 1);
+    }
+    glBindVertexArray(0);
+    glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, 0);
+
+    allocateBuffers();
+    setShader(shader_id);
+}
+
+GpuParticles::~GpuParticles() {
+    glDeleteProgram(sim_program);
+    glDeleteVertexArrays(2, sim_vao);
+    glDeleteVertexArrays(2, render_vao);
+    glDeleteTransformFeedbacks(2, feedback);
+    glDeleteBuffers(2, buffers);
+    glDeleteBuffers(1, &vbo_quad);
+}
+
+void GpuParticles::setShader(GLuint shader) {
+    shader_id = shader;
+    view_loc = glGetUniformLocation(shader_id, "view");
+    projection_loc = glGetUniformLocation(shader_id, "projection");
+    texture_sampler_loc = glGetUniformLocation(shader_id, "particleTexture");
+    stereo_half_separation_loc = glGetUniformLocation(shader_id, "stereoHalfSeparation");
+}
+
+void GpuParticles::setCapacity(int capacity) {
+    settings.capacity = std::max(capacity, 1);
+    allocateBuffers();
+}
+
+void GpuParticles::allocateBuffers() {
+    // The one upload: every slot waits to be born, births spread evenly over the first lifetime
+    const int capacity = std::max(settings.capacity, 1);
+    std::vector<float> initial(static_cast<size_t>(capacity) * PARTICLE_FLOATS, 0.0f);
+    for (int i = 0; i < capacity; i++) {
+        float *particle = &initial[static_cast<size_t>(i) * PARTICLE_FLOATS];
+        particle[0] = settings.position.x;
+        particle[1] = settings.position.y;
+        particle[2] = settings.position.z;
+        particle[7] = -settings.lifetime * static_cast<float>(i + 1) / static_cast<float>(capacity);
+    }
+    for (int i = 0; i < 2; i++) {
+        glBindBuffer(GL_ARRAY_BUFFER, buffers[i]);
+        glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(initial.size() * sizeof(float)),
+                     i == 0 ? initial.data() : nullptr, GL_DYNAMIC_COPY);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    current = 0;
+    captured = false;
+}
+
+void GpuParticles::simulate(float deltaTime) {
+    const int target = 1 - current;
+    glUseProgram(sim_program);
+    glUniform3fv(sim_emitter_position_loc, 1, glm::value_ptr(settings.position));
+    glUniform3fv(sim_base_velocity_loc, 1, glm::value_ptr(settings.velocity));
+    glUniform3fv(sim_velocity_jitter_loc, 1, glm::value_ptr(settings.velocityJitter));
+    glUniform2f(sim_size_range_loc, settings.minSize, settings.maxSize);
+    glUniform1f(sim_lifetime_loc, settings.lifetime);
+    glUniform1f(sim_delta_time_loc, deltaTime);
+    glUniform1ui(sim_frame_seed_loc, frame++);
+    glUniform2f(sim_flipbook_loc, static_cast<float>(settings.atlasFrame),
+                static_cast<float>(std::max(settings.frameCount, 1)));
+
+    glEnable(GL_RASTERIZER_DISCARD);
+    glBindVertexArray(sim_vao[current]);
+    glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, feedback[target]);
+    glBeginTransformFeedback(GL_POINTS);
+    if (captured) {
+        // As many vertices as the last step captured, counted on the GPU
+        glDrawTransformFeedback(GL_POINTS, feedback[current]);
+    } else {
+        glDrawArrays(GL_POINTS, 0, settings.capacity);
+    }
+    glEndTransformFeedback();
+    glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, 0);
+    glBindVertexArray(0);
+    glDisable(GL_RASTERIZER_DISCARD);
+
+    current = target;
+    captured = true;
+}
+
+void GpuParticles::render(const glm::mat4 &viewMatrix, const glm::mat4 &projectionMatrix, int views,
+                          float eyeHalfSeparation) const {
+    if (order_independent) {
+        WeightedOit::setBlendState();
+    } else {
+        glEnable(GL_BLEND);
+        glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    }
+    glDepthMask(GL_FALSE);
+
+    glUseProgram(shader_id);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, texture_id);
+    glUniform1i(texture_sampler_loc, 0);
+    glUniformMatrix4fv(view_loc, 1, GL_FALSE, glm::value_ptr(viewMatrix));
+    glUniformMatrix4fv(projection_loc, 1, GL_FALSE, glm::value_ptr(projectionMatrix));
+    glUniform1f(stereo_half_separation_loc, eyeHalfSeparation);
+
+    glBindVertexArray(render_vao[current]);
+    glVertexAttrib4fv(2, glm::value_ptr(settings.tint));
+    // Consecutive instances (one per eye) share a particle
+    glVertexAttribDivisor(1, views);
+    glVertexAttribDivisor(3, views);
+    // GL 4.1 has no instanced glDrawTransformFeedback; every slot is captured each step, so the count is the
+    // capacity without asking the GPU
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, settings.capacity * views);
+
+    glBindVertexArray(0);
+    glDepthMask(GL_TRUE);
+    glDisable(GL_BLEND);
+}
@@ -0,0 +1,90 @@
+#ifndef GPU_PARTICLES_H
+#define GPU_PARTICLES_H
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "glad.h"
+
+#include "particle_emitter.h"
+
+class ProgramCache;
+
+/*
+ * GpuParticles Class
+ * One emitter simulated entirely on the GPU, for particle counts where uploading a CPU-built instance array every
+ * frame would dominate. particle_sim.vert advances every particle slot once per step with GL_RASTERIZER_DISCARD,
+ * and transform feedback writes the results into the other buffer of a ping-pong pair. Respawned slots draw
+ * their velocity and size from an integer hash of the slot and the step, so no random numbers come from the CPU.
+ * The captured buffer feeds particle.vert's instance attributes directly: after the first step the CPU uploads
+ * nothing and never reads anything back.
+ * Every slot is reused as soon as its particle dies, so the emission rate is capacity / lifetime; births start
+ * staggered over the first lifetime. Particles are drawn unsorted.
+ */
+class GpuParticles {
+public:
+    // Uses the settings' position, velocity, jitter, sizes, lifetime, tint, flipbook and capacity; the rate,
+    // bursts and overflow policy do not apply.
+    // "renderShader" is a permutation of the particle shader; with a cache the simulation program is kept on disk
+    GpuParticles(const ParticleEmitter::Settings &settings, GLuint renderShader, GLuint texture,
+                 ProgramCache *cache = nullptr);
+
+    ~GpuParticles();
+
+    GpuParticles(const GpuParticles &) = delete;
+
+    GpuParticles &operator=(const GpuParticles &) = delete;
+
+    // Reallocates both buffers and restarts the emitter
+    void setCapacity(int capacity);
+
+    int getCapacity() const { return settings.capacity; }
+
+    void setEmitterPosition(const glm::vec3 &position) { settings.position = position; }
+
+    // Advances every particle by deltaTime with transform feedback
+    void simulate(float deltaTime);
+
+    // With views = 2 every particle is drawn twice, once per eye; needs the STEREO permutation of the shader
+    void render(const glm::mat4 &viewMatrix, const glm::mat4 &projectionMatrix, int views = 1,
+                float eyeHalfSeparation = 0.0f) const;
+
+    // Switches to another permutation of the particle shader and looks up its uniforms
+    void setShader(GLuint shader);
+
+    // For an OIT permutation drawing into WeightedOit's targets, which also makes the unsorted draw correct
+    void setOrderIndependent(bool enabled) { order_independent = enabled; }
+
+private:
+    // Per particle in each buffer: posAndSize, velocityAndAge, then the fade and atlas frame the render shader reads
+    static constexpr int PARTICLE_FLOATS = 10;
+    static constexpr GLsizei PARTICLE_STRIDE = PARTICLE_FLOATS * sizeof(float);
+
+    void allocateBuffers();
+
+    ParticleEmitter::Settings settings;
+
+    GLuint sim_program = 0;
+    GLint sim_emitter_position_loc, sim_base_velocity_loc, sim_velocity_jitter_loc, sim_size_range_loc;
+    GLint sim_lifetime_loc, sim_delta_time_loc, sim_frame_seed_loc, sim_flipbook_loc;
+
+    // Ping-pong pair: step n reads buffers[current] and writes buffers[1 - current]
+    GLuint buffers[2] = {0, 0};
+    GLuint feedback[2] = {0, 0};  // Transform feedback objects, feedback[i] captures into buffers[i]
+    GLuint sim_vao[2] = {0, 0};   // Reading buffers[i] as simulation input
+    GLuint render_vao[2] = {0, 0}; // Reading buffers[i] as instance data
+    GLuint vbo_quad = 0;
+    int current = 0;
+    bool captured = false; // buffers[current] was written by transform feedback
+    uint32_t frame = 0;
+
+    // Shader uniform locations
+    GLint view_loc;
+    GLint projection_loc;
+    GLint texture_sampler_loc;
+    GLint stereo_half_separation_loc;
+    GLuint shader_id;
+    GLuint texture_id;
+    bool order_independent = false;
+};
+
+#endif // GPU_PARTICLES_H
@@ -0,0 +1,50 @@
+#include "headless_gl.h"
+#include <EGL/eglext.h>
+#include <iostream>
+#include "glad.h"
+
+HeadlessGL::HeadlessGL(int majorVersion, int minorVersion) {
+    auto getPlatformDisplay =
+            reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (getPlatformDisplay) {
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    }
+    EGLint eglMajor, eglMinor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &eglMajor, &eglMinor)) {
+        std::cout << "ERROR::HEADLESS_GL::NO_SURFACELESS_DISPLAY" << std::endl;
+        display = EGL_NO_DISPLAY;
+        return;
+    }
+    eglBindAPI(EGL_OPENGL_API);
+
+    const EGLint attributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, majorVersion,
+        EGL_CONTEXT_MINOR_VERSION, minorVersion,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    // No config and no surface: everything is drawn into framebuffer objects
+    context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attributes);
+    if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+        std::cout << "ERROR::HEADLESS_GL::CONTEXT_NOT_CREATED " << majorVersion << "." << minorVersion << std::endl;
+        if (context != EGL_NO_CONTEXT) eglDestroyContext(display, context);
+        context = EGL_NO_CONTEXT;
+        return;
+    }
+    if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(eglGetProcAddress))) {
+        std::cout << "ERROR::HEADLESS_GL::GLAD_NOT_LOADED" << std::endl;
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(display, context);
+        context = EGL_NO_CONTEXT;
+        return;
+    }
+    std::cout << "GL: " << glGetString(GL_RENDERER) << " | " << glGetString(GL_VERSION) << std::endl;
+}
+
+HeadlessGL::~HeadlessGL() {
+    if (context != EGL_NO_CONTEXT) {
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(display, context);
+    }
+    if (display != EGL_NO_DISPLAY) eglTerminate(display);
+}
@@ -0,0 +1,31 @@
+#ifndef HEADLESS_GL_H
+#define HEADLESS_GL_H
+
+#include <EGL/egl.h>
+
+/*
+ * HeadlessGL Class
+ * An OpenGL core context without a window or display server, for the GL headless tests. It is created on EGL's
+ * surfaceless platform (EGL_MESA_platform_surfaceless), which Mesa provides on every driver including llvmpipe,
+ * so the tests also run on machines without a GPU. There is no default framebuffer: tests render into their
+ * own framebuffer objects. glad is loaded through eglGetProcAddress once the context is current.
+ */
+class HeadlessGL {
+public:
+    explicit HeadlessGL(int majorVersion = 4, int minorVersion = 1);
+
+    ~HeadlessGL();
+
+    HeadlessGL(const HeadlessGL &) = delete;
+
+    HeadlessGL &operator=(const HeadlessGL &) = delete;
+
+    // False if no context could be created or made current; the error has been printed
+    bool valid() const { return context != EGL_NO_CONTEXT; }
+
+private:
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLContext context = EGL_NO_CONTEXT;
+};
+
+#endif // HEADLESS_GL_H
@@ -0,0 +1,42 @@
+#include "indirect_draw.h"
+
+IndirectDrawBuffer::IndirectDrawBuffer() {
+    glGenBuffers(1, &buffer);
+}
+
+IndirectDrawBuffer::~IndirectDrawBuffer() {
+    glDeleteBuffers(1, &buffer);
+}
+
+void IndirectDrawBuffer::upload(const IndirectDrawList &list) {
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, buffer);
+    if (list.commands.size() > capacity) {
+        capacity = list.commands.size() * 2;
+    }
+    // Orphan the previous frame's commands so the driver doesn't wait for draws still reading them
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, capacity * sizeof(DrawElementsIndirectCommand), nullptr, GL_STREAM_DRAW);
+    if (!list.commands.empty()) {
+        glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, list.commands.size() * sizeof(DrawElementsIndirectCommand),
+                        list.commands.data());
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+int IndirectDrawBuffer::draw(const IndirectDrawList::Range &range) const {
+    if (range.commandCount == 0) return 0;
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, buffer);
+    const size_t offset = range.firstCommand * sizeof(DrawElementsIndirectCommand);
+    if (GLAD_GL_VERSION_4_3) {
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, reinterpret_cast<void *>(offset),
+                                    range.commandCount, sizeof(DrawElementsIndirectCommand));
+    } else {
+        // GL 4.1 (macOS): one indirect draw per command, all from the same buffer
+        for (GLsizei i = 0; i < range.commandCount; i++) {
+            glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                                   reinterpret_cast<void *>(offset + i * sizeof(DrawElementsIndirectCommand)));
+        }
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    return GLAD_GL_VERSION_4_3 ? 1 : range.commandCount;
+}
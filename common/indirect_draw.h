@@ -0,0 +1,75 @@
+#ifndef INDIRECT_DRAW_H
+#define INDIRECT_DRAW_H
+
+#include <cstddef>
+#include <vector>
+#include "glad.h"
+
+// Layout mandated by glDrawElementsIndirect (GL 4.0)
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance; // Must be 0 before GL 4.2
+};
+
+/*
+ * IndirectDrawList struct
+ * CPU-side output of a culling pass: indirect commands grouped into ranges that share GL state
+ * (one range per VAO/material). Filling it makes no GL calls, so it can be built on a worker thread.
+ */
+struct IndirectDrawList {
+    struct Range {
+        int group; // Caller-defined state group (e.g. batch index)
+        GLuint firstCommand;
+        GLsizei commandCount;
+    };
+
+    std::vector<DrawElementsIndirectCommand> commands;
+    std::vector<Range> ranges;
+    int culled = 0;
+    GLuint instanceCount = 1; // Of every command added; 2 for single-pass stereo. Kept by clear()
+
+    void clear() {
+        commands.clear();
+        ranges.clear();
+        culled = 0;
+    }
+
+    // Starts a new state group; following commands belong to it
+    void beginGroup(int group) {
+        ranges.push_back({group, static_cast<GLuint>(commands.size()), 0});
+    }
+
+    void add(GLuint count, GLuint firstIndex, GLint baseVertex = 0) {
+        commands.push_back({count, instanceCount, firstIndex, baseVertex, 0});
+        ranges.back().commandCount++;
+    }
+};
+
+/*
+ * IndirectDrawBuffer Class
+ * Owns the GL_DRAW_INDIRECT_BUFFER that an IndirectDrawList is uploaded into once per frame.
+ * Submission is then a loop of glDrawElementsIndirect calls reading from that single buffer,
+ * or one glMultiDrawElementsIndirect per range where GL 4.3 is available.
+ */
+class IndirectDrawBuffer {
+public:
+    IndirectDrawBuffer();
+
+    ~IndirectDrawBuffer();
+
+    // Replaces the buffer content with the list's commands (orphaning the old storage)
+    void upload(const IndirectDrawList &list);
+
+    // Draws one range of the last uploaded list. The range's VAO and state must already be bound.
+    // Returns the number of draw calls made: 1 with glMultiDrawElementsIndirect, one per command without
+    int draw(const IndirectDrawList::Range &range) const;
+
+private:
+    GLuint buffer;
+    size_t capacity = 0; // In commands
+};
+
+#endif // INDIRECT_DRAW_H
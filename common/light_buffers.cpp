@@ -0,0 +1,57 @@
+#include "light_buffers.h"
+
+namespace {
+    // Buffer textures must not be empty; upload one dummy element instead
+    template<typename T>
+    void uploadBuffer(GLuint buffer, const std::vector<T> &data) {
+        static const T zero[4] = {};
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        if (data.empty()) {
+            glBufferData(GL_TEXTURE_BUFFER, sizeof(zero), zero, GL_STREAM_DRAW);
+        } else {
+            glBufferData(GL_TEXTURE_BUFFER, data.size() * sizeof(T), data.data(), GL_STREAM_DRAW);
+        }
+    }
+}
+
+LightBuffers::LightBuffers() {
+    glGenBuffers(BUFFER_COUNT, buffers);
+    glGenTextures(BUFFER_COUNT, textures);
+
+    const GLenum formats[BUFFER_COUNT] = {GL_RGBA32F, GL_RG32UI, GL_R32UI};
+    for (int i = 0; i < BUFFER_COUNT; i++) {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+        glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+        glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+        glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i]);
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+LightBuffers::~LightBuffers() {
+    glDeleteTextures(BUFFER_COUNT, textures);
+    glDeleteBuffers(BUFFER_COUNT, buffers);
+}
+
+void LightBuffers::upload(const std::vector<PointLight> &lights, const LightClusters &clusters) {
+    light_data.clear();
+    for (const auto &light: lights) {
+        light_data.insert(light_data.end(), {
+                              light.position.x, light.position.y, light.position.z, light.radius,
+                              light.color.r, light.color.g, light.color.b, 0.0f
+                          });
+    }
+    uploadBuffer(buffers[LIGHT_DATA], light_data);
+    uploadBuffer(buffers[CLUSTER_RANGES], clusters.getClusterRanges());
+    uploadBuffer(buffers[LIGHT_INDICES], clusters.getLightIndices());
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void LightBuffers::bind(GLuint firstUnit) const {
+    for (int i = 0; i < BUFFER_COUNT; i++) {
+        glActiveTexture(GL_TEXTURE0 + firstUnit + i);
+        glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+    }
+    glActiveTexture(GL_TEXTURE0);
+}
@@ -0,0 +1,40 @@
+#ifndef LIGHT_BUFFERS_H
+#define LIGHT_BUFFERS_H
+
+#include <vector>
+#include "glad.h"
+
+#include "light_clusters.h"
+
+/*
+ * LightBuffers Class
+ * GPU side of clustered lighting: three buffer textures the fragment shader reads with texelFetch.
+ *   lightData     RGBA32F, two texels per light (position + radius, color)
+ *   clusterRanges RG32UI, one texel per cluster (offset, count into lightIndices)
+ *   lightIndices  R32UI, the flat per-cluster light lists
+ * Buffers are re-specified every frame (orphaning), so the GPU never waits on last frame's data.
+ */
+class LightBuffers {
+public:
+    LightBuffers();
+
+    ~LightBuffers();
+
+    LightBuffers(const LightBuffers &) = delete;
+
+    LightBuffers &operator=(const LightBuffers &) = delete;
+
+    void upload(const std::vector<PointLight> &lights, const LightClusters &clusters);
+
+    // Binds the three buffer textures to units firstUnit .. firstUnit + 2
+    void bind(GLuint firstUnit) const;
+
+private:
+    enum { LIGHT_DATA, CLUSTER_RANGES, LIGHT_INDICES, BUFFER_COUNT };
+
+    GLuint buffers[BUFFER_COUNT];
+    GLuint textures[BUFFER_COUNT];
+    std::vector<float> light_data; // Staging for the interleaved light texels
+};
+
+#endif // LIGHT_BUFFERS_H
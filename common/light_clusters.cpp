@@ -0,0 +1,159 @@
+#include "light_clusters.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CLUSTERS_USE_SSE 1
+#endif
+
+namespace {
+    // Padding lanes: far away with zero radius, never touch a cluster
+    constexpr float PAD_POSITION = 1.0e18f;
+}
+
+LightClusters::LightClusters(int tilesX, int tilesY, int slices, ThreadPool *pool)
+    : tiles_x(tilesX), tiles_y(tilesY), slices(slices), thread_pool(pool) {
+    boxes.resize(clusterCount());
+    slice_indices.resize(slices);
+    cluster_ranges.assign(clusterCount() * 2, 0);
+}
+
+void LightClusters::setProjection(float fovY, float aspect, float zNear, float zFar) {
+    z_near = zNear;
+    z_far = zFar;
+    const float logRatio = std::log(zFar / zNear);
+    slice_scale_bias = glm::vec2(static_cast<float>(slices) / logRatio,
+                                 -static_cast<float>(slices) * std::log(zNear) / logRatio);
+
+    const float tanY = std::tan(fovY * 0.5f);
+    const float tanX = tanY * aspect;
+    for (int slice = 0; slice < slices; slice++) {
+        // Exponential slices keep clusters roughly cube-shaped in view space
+        const float d0 = zNear * std::pow(zFar / zNear, static_cast<float>(slice) / static_cast<float>(slices));
+        const float d1 = zNear * std::pow(zFar / zNear, static_cast<float>(slice + 1) / static_cast<float>(slices));
+        for (int y = 0; y < tiles_y; y++) {
+            const float ny0 = -1.0f + 2.0f * static_cast<float>(y) / static_cast<float>(tiles_y);
+            const float ny1 = -1.0f + 2.0f * static_cast<float>(y + 1) / static_cast<float>(tiles_y);
+            for (int x = 0; x < tiles_x; x++) {
+                const float nx0 = -1.0f + 2.0f * static_cast<float>(x) / static_cast<float>(tiles_x);
+                const float nx1 = -1.0f + 2.0f * static_cast<float>(x + 1) / static_cast<float>(tiles_x);
+                // The tile's side planes pass through the eye, so its extremes lie on the near or far face
+                ClusterBox &box = boxes[(slice * tiles_y + y) * tiles_x + x];
+                box.min.x = std::min(nx0 * tanX * d0, nx0 * tanX * d1);
+                box.max.x = std::max(nx1 * tanX * d0, nx1 * tanX * d1);
+                box.min.y = std::min(ny0 * tanY * d0, ny0 * tanY * d1);
+                box.max.y = std::max(ny1 * tanY * d0, ny1 * tanY * d1);
+                box.min.z = -d1;
+                box.max.z = -d0;
+            }
+        }
+    }
+}
+
+void LightClusters::assign(const std::vector<PointLight> &lights, const glm::mat4 &view) {
+    auto start = std::chrono::high_resolution_clock::now();
+    stats = Stats();
+
+    // Lights to view space, dropping the ones entirely behind the near plane or beyond the far plane
+    light_x.clear();
+    light_y.clear();
+    light_z.clear();
+    light_radius.clear();
+    light_id.clear();
+    for (size_t i = 0; i < lights.size(); i++) {
+        const glm::vec3 p = glm::vec3(view * glm::vec4(lights[i].position, 1.0f));
+        const float r = lights[i].radius;
+        if (p.z - r > -z_near || p.z + r < -z_far) continue;
+        light_x.push_back(p.x);
+        light_y.push_back(p.y);
+        light_z.push_back(p.z);
+        light_radius.push_back(r);
+        light_id.push_back(static_cast<std::uint32_t>(i));
+    }
+    stats.lights = static_cast<int>(light_id.size());
+
+    if (thread_pool) {
+        thread_pool->parallelFor(slices, [this](int slice) { assignSlice(slice); });
+    } else {
+        for (int slice = 0; slice < slices; slice++) assignSlice(slice);
+    }
+
+    // Slices were filled independently; concatenate them and turn slice-relative offsets into global ones
+    light_indices.clear();
+    const int clustersPerSlice = tiles_x * tiles_y;
+    for (int slice = 0; slice < slices; slice++) {
+        const auto base = static_cast<std::uint32_t>(light_indices.size());
+        for (int c = slice * clustersPerSlice; c < (slice + 1) * clustersPerSlice; c++) {
+            cluster_ranges[c * 2] += base;
+            stats.maxPerCluster = std::max(stats.maxPerCluster, static_cast<int>(cluster_ranges[c * 2 + 1]));
+        }
+        light_indices.insert(light_indices.end(), slice_indices[slice].begin(), slice_indices[slice].end());
+    }
+    stats.indices = static_cast<int>(light_indices.size());
+
+    stats.assignMs = std::chrono::duration<double, std::milli>(
+        std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void LightClusters::assignSlice(int slice) {
+    std::vector<std::uint32_t> &out = slice_indices[slice];
+    out.clear();
+
+    // Lights overlapping the slice's depth range, padded to a multiple of 4
+    const ClusterBox &sliceBox = boxes[slice * tiles_x * tiles_y];
+    std::vector<float> cx, cy, cz, cr2;
+    std::vector<std::uint32_t> cid;
+    for (size_t i = 0; i < light_id.size(); i++) {
+        if (light_z[i] - light_radius[i] > sliceBox.max.z || light_z[i] + light_radius[i] < sliceBox.min.z) continue;
+        cx.push_back(light_x[i]);
+        cy.push_back(light_y[i]);
+        cz.push_back(light_z[i]);
+        cr2.push_back(light_radius[i] * light_radius[i]);
+        cid.push_back(light_id[i]);
+    }
+    while (cx.size() % 4 != 0) {
+        cx.push_back(PAD_POSITION);
+        cy.push_back(PAD_POSITION);
+        cz.push_back(PAD_POSITION);
+        cr2.push_back(0.0f);
+    }
+
+    for (int c = slice * tiles_x * tiles_y; c < (slice + 1) * tiles_x * tiles_y; c++) {
+        const ClusterBox &box = boxes[c];
+        const auto offset = static_cast<std::uint32_t>(out.size());
+
+        // Sphere/box test: squared distance from the light to the closest point of the box
+#ifdef CLUSTERS_USE_SSE
+        const __m128 minX = _mm_set1_ps(box.min.x), maxX = _mm_set1_ps(box.max.x);
+        const __m128 minY = _mm_set1_ps(box.min.y), maxY = _mm_set1_ps(box.max.y);
+        const __m128 minZ = _mm_set1_ps(box.min.z), maxZ = _mm_set1_ps(box.max.z);
+        const __m128 zero = _mm_setzero_ps();
+        for (size_t i = 0; i < cx.size(); i += 4) {
+            const __m128 x = _mm_loadu_ps(&cx[i]), y = _mm_loadu_ps(&cy[i]), z = _mm_loadu_ps(&cz[i]);
+            const __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minX, x), _mm_sub_ps(x, maxX)), zero);
+            const __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minY, y), _mm_sub_ps(y, maxY)), zero);
+            const __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minZ, z), _mm_sub_ps(z, maxZ)), zero);
+            const __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+            const int mask = _mm_movemask_ps(_mm_cmple_ps(d2, _mm_loadu_ps(&cr2[i])));
+            if (mask == 0) continue;
+            for (int lane = 0; lane < 4; lane++) {
+                if (mask & (1 << lane)) out.push_back(cid[i + lane]);
+            }
+        }
+#else
+        for (size_t i = 0; i < cid.size(); i++) {
+            const float dx = std::max(std::max(box.min.x - cx[i], cx[i] - box.max.x), 0.0f);
+            const float dy = std::max(std::max(box.min.y - cy[i], cy[i] - box.max.y), 0.0f);
+            const float dz = std::max(std::max(box.min.z - cz[i], cz[i] - box.max.z), 0.0f);
+            if (dx * dx + dy * dy + dz * dz <= cr2[i]) out.push_back(cid[i]);
+        }
+#endif
+
+        cluster_ranges[c * 2] = offset;
+        cluster_ranges[c * 2 + 1] = static_cast<std::uint32_t>(out.size()) - offset;
+    }
+}
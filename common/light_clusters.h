@@ -0,0 +1,79 @@
+#ifndef LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+class ThreadPool;
+
+struct PointLight {
+    glm::vec3 position; // World space
+    float radius;       // Light has no effect beyond this distance
+    glm::vec3 color;
+};
+
+/*
+ * LightClusters Class
+ * Clustered light assignment for forward shading. The view frustum is split into a grid of screen tiles
+ * and exponentially spaced depth slices; each cluster gets the list of point lights whose sphere touches it.
+ * Assignment runs on the CPU (one depth slice per task, 4 lights per sphere/box test with SSE) and makes no
+ * GL calls, so it can be tested and timed without a context. Output is laid out for buffer textures:
+ * per cluster an (offset, count) pair into one flat index list.
+ */
+class LightClusters {
+public:
+    struct Stats {
+        int lights = 0;       // Lights in front of the camera
+        int indices = 0;      // Total light references over all clusters
+        int maxPerCluster = 0;
+        double assignMs = 0.0;
+    };
+
+    LightClusters(int tilesX, int tilesY, int slices, ThreadPool *pool = nullptr);
+
+    // Rebuilds the cluster boxes; only needed when the projection changes
+    void setProjection(float fovY, float aspect, float zNear, float zFar);
+
+    // Assigns the lights to clusters for the given camera
+    void assign(const std::vector<PointLight> &lights, const glm::mat4 &view);
+
+    int clusterCount() const { return tiles_x * tiles_y * slices; }
+
+    glm::ivec3 gridSize() const { return {tiles_x, tiles_y, slices}; }
+
+    // slice = log(viewDepth) * scale + bias
+    glm::vec2 sliceScaleBias() const { return slice_scale_bias; }
+
+    // Cluster index = (slice * tilesY + tileY) * tilesX + tileX. Two entries per cluster: offset, count
+    const std::vector<std::uint32_t> &getClusterRanges() const { return cluster_ranges; }
+
+    const std::vector<std::uint32_t> &getLightIndices() const { return light_indices; }
+
+    const Stats &getStats() const { return stats; }
+
+private:
+    // View-space bounds of one cluster
+    struct ClusterBox {
+        glm::vec3 min, max;
+    };
+
+    void assignSlice(int slice);
+
+    int tiles_x, tiles_y, slices;
+    ThreadPool *thread_pool;
+    float z_near = 0.1f, z_far = 100.0f;
+    glm::vec2 slice_scale_bias = glm::vec2(0.0f);
+    std::vector<ClusterBox> boxes;
+
+    // View-space light spheres for the current assign(), structure of arrays padded to a multiple of 4
+    std::vector<float> light_x, light_y, light_z, light_radius;
+    std::vector<std::uint32_t> light_id;
+
+    std::vector<std::vector<std::uint32_t>> slice_indices; // Per slice, written by one task each
+    std::vector<std::uint32_t> cluster_ranges;
+    std::vector<std::uint32_t> light_indices;
+    Stats stats;
+};
+
+#endif // LIGHT_CLUSTERS_H
@@ -4,6 +4,8 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include "bounds.h"
+
 #include <string>
 #include <utility>
 #include <vector>
@@ -44,16 +46,24 @@ public:
     std::vector<Vertex>       vertices;
     std::vector<unsigned int> indices;
     std::vector<Texture>      textures;
-    unsigned int VAO;
+    unsigned int VAO = 0;
+    // Object-space bounding box of all vertices
+    AABB bounds;
 
-    // Constructor: takes vertices, indices, and textures to create a mesh
-    Mesh(const std::vector<Vertex> &vertices, std::vector<unsigned int> indices, std::vector<Texture> textures) {
+    // Constructor: takes vertices, indices, and textures to create a mesh.
+    // Without "upload" the mesh only keeps its data on the CPU and no GL context is needed (VAO stays 0)
+    Mesh(const std::vector<Vertex> &vertices, std::vector<unsigned int> indices, std::vector<Texture> textures,
+         bool upload = true) {
         this->vertices = vertices;
         this->indices = std::move(indices);
         this->textures = std::move(textures);
 
+        for (const auto &vertex : this->vertices)
+            bounds.expand(vertex.Position);
+
         // Set the vertex buffers and its attribute pointers
-        setupMesh();
+        if (upload)
+            setupMesh();
     }
 
     // Render the mesh
@@ -66,9 +76,31 @@ public:
         glBindVertexArray(0);
     }
 
+    // Sources attribute locations 3-6 (one mat4 per instance) from "buffer", for the INSTANCED shader variant.
+    // The matrix advances every "divisor" instances (2 when each instance is drawn once per eye)
+    void setInstanceBuffer(GLuint buffer, GLuint divisor = 1) const {
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        for (int column = 0; column < 4; column++) {
+            glEnableVertexAttribArray(3 + column);
+            glVertexAttribPointer(3 + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+                                  reinterpret_cast<void *>(column * sizeof(glm::vec4)));
+            glVertexAttribDivisor(3 + column, divisor);
+        }
+        glBindVertexArray(0);
+    }
+
+    // Render "instanceCount" copies of the mesh, transformed by the instance buffer
+    void drawInstanced(GLsizei instanceCount) const {
+        glBindVertexArray(VAO);
+        glDrawElementsInstanced(GL_TRIANGLES, static_cast<GLsizei>(indices.size()), GL_UNSIGNED_INT, nullptr,
+                                instanceCount);
+        glBindVertexArray(0);
+    }
+
 private:
     // Render data
-    unsigned int VBO, EBO;
+    unsigned int VBO = 0, EBO = 0;
 
     // Initializes all the buffer objects/arrays
     void setupMesh() {
@@ -26,7 +26,8 @@ void Model::processNode(const aiNode *node, const aiScene *scene) {
     // Process all the node's meshes (if any)
     for(unsigned int i = 0; i < node->mNumMeshes; i++) {
         aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-        meshes.push_back(processMesh(mesh, scene));
+        meshes.push_back(processMesh(mesh, scene, upload));
+        bounds.expand(meshes.back().bounds);
     }
     // Then do the same for each of its children
     for(unsigned int i = 0; i < node->mNumChildren; i++) {
@@ -35,7 +36,7 @@ void Model::processNode(const aiNode *node, const aiScene *scene) {
 }
 
 // Translates an aiMesh object to our Mesh object
-Mesh Model::processMesh(const aiMesh *mesh, const aiScene *scene) {
+Mesh Model::processMesh(const aiMesh *mesh, const aiScene *scene, bool upload) {
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
     const std::vector<Texture> textures;
@@ -70,5 +71,5 @@ Mesh Model::processMesh(const aiMesh *mesh, const aiScene *scene) {
             indices.push_back(face.mIndices[j]);
     }
 
-    return Mesh(vertices, indices, textures);
+    return Mesh(vertices, indices, textures, upload);
 }
\ No newline at end of file
@@ -24,9 +24,12 @@ public:
     // Model data
     std::vector<Mesh> meshes;
     std::string directory;
+    // Object-space bounding box of all meshes
+    AABB bounds;
 
-    // Constructor, expects a filepath to a 3D model
-    explicit Model(std::string const &path) {
+    // Constructor, expects a filepath to a 3D model.
+    // Without "upload" the meshes stay on the CPU, for renderers that run without a GL context
+    explicit Model(std::string const &path, bool upload = true) : upload(upload) {
         loadModel(path);
     }
 
@@ -36,7 +39,21 @@ public:
             mesh.draw(shaderProgram);
     }
 
+    // Binds a buffer of per-instance model matrices to every mesh, see Mesh::setInstanceBuffer
+    void setInstanceBuffer(GLuint buffer, GLuint divisor = 1) const {
+        for (const auto & mesh : meshes)
+            mesh.setInstanceBuffer(buffer, divisor);
+    }
+
+    // Draws "instanceCount" instances of the model
+    void drawInstanced(GLsizei instanceCount) const {
+        for (const auto & mesh : meshes)
+            mesh.drawInstanced(instanceCount);
+    }
+
 private:
+    bool upload;
+
     // Loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector
     void loadModel(std::string const &path);
 
@@ -45,7 +62,7 @@ private:
     void processNode(const aiNode *node, const aiScene *scene);
 
     // Processes an aiMesh object and transforms it into our own Mesh object
-    static Mesh processMesh(const aiMesh *mesh, const aiScene *scene);
+    static Mesh processMesh(const aiMesh *mesh, const aiScene *scene, bool upload);
 };
 
 #endif
@@ -0,0 +1,252 @@
+#include "occlusion.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define OCCLUSION_USE_SSE 1
+#endif
+
+OcclusionCuller::OcclusionCuller(int width, int height, ThreadPool *pool)
+    : width((width + TILE_SIZE - 1) / TILE_SIZE * TILE_SIZE),
+      height((height + TILE_SIZE - 1) / TILE_SIZE * TILE_SIZE),
+      pool(pool) {
+    tiles_x = this->width / TILE_SIZE;
+    tiles_y = this->height / TILE_SIZE;
+    depth.assign(this->width * this->height, 1.0f);
+    tile_max_depth.assign(tiles_x * tiles_y, 1.0f);
+}
+
+void OcclusionCuller::beginFrame(const glm::mat4 &viewProjection) {
+    view_projection = viewProjection;
+    triangles.clear();
+    stats = Stats();
+    tested_objects = 0;
+    culled_objects = 0;
+}
+
+void OcclusionCuller::addOccluder(const std::vector<glm::vec3> &positions, const std::vector<unsigned int> &indices,
+                                  const glm::mat4 &model) {
+    const glm::mat4 mvp = view_projection * model;
+
+    std::vector<glm::vec4> clip(positions.size());
+    for (size_t i = 0; i < positions.size(); i++) {
+        clip[i] = mvp * glm::vec4(positions[i], 1.0f);
+    }
+
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        ScreenTriangle tri{};
+        bool clipped = false;
+        for (int k = 0; k < 3; k++) {
+            const glm::vec4 &c = clip[indices[i + k]];
+            // Triangles crossing the near plane are dropped: occluders may only ever under-occlude
+            if (c.w <= 1e-5f || c.z < -c.w) {
+                clipped = true;
+                break;
+            }
+            glm::vec3 ndc = glm::vec3(c) / c.w;
+            tri.v[k] = glm::vec3((ndc.x * 0.5f + 0.5f) * static_cast<float>(width),
+                                 (ndc.y * 0.5f + 0.5f) * static_cast<float>(height),
+                                 std::min(ndc.z * 0.5f + 0.5f, 1.0f));
+        }
+        if (clipped) continue;
+
+        // Pixel centers are at (x + 0.5, y + 0.5)
+        glm::vec2 lo = glm::min(glm::min(glm::vec2(tri.v[0]), glm::vec2(tri.v[1])), glm::vec2(tri.v[2]));
+        glm::vec2 hi = glm::max(glm::max(glm::vec2(tri.v[0]), glm::vec2(tri.v[1])), glm::vec2(tri.v[2]));
+        tri.minPixel = glm::ivec2(std::max(0, static_cast<int>(std::ceil(lo.x - 0.5f))),
+                                  std::max(0, static_cast<int>(std::ceil(lo.y - 0.5f))));
+        tri.maxPixel = glm::ivec2(std::min(width - 1, static_cast<int>(std::floor(hi.x - 0.5f))),
+                                  std::min(height - 1, static_cast<int>(std::floor(hi.y - 0.5f))));
+        if (tri.minPixel.x > tri.maxPixel.x || tri.minPixel.y > tri.maxPixel.y) continue;
+
+        triangles.push_back(tri);
+    }
+}
+
+void OcclusionCuller::addOccluder(const AABB &box, const glm::mat4 &model) {
+    static const std::vector<unsigned int> boxIndices = {
+        0, 1, 3, 0, 3, 2, // -Z
+        4, 6, 7, 4, 7, 5, // +Z
+        0, 4, 5, 0, 5, 1, // -Y
+        2, 3, 7, 2, 7, 6, // +Y
+        0, 2, 6, 0, 6, 4, // -X
+        1, 5, 7, 1, 7, 3 // +X
+    };
+    glm::vec3 corners[8];
+    box.corners(corners);
+    addOccluder(std::vector<glm::vec3>(corners, corners + 8), boxIndices, model);
+}
+
+void OcclusionCuller::rasterize() {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    std::fill(depth.begin(), depth.end(), 1.0f);
+
+    // Each band is one row of tiles, so bands never write to the same pixels
+    if (pool) {
+        pool->parallelFor(tiles_y, [this](int band) { rasterizeBand(band); });
+    } else {
+        for (int band = 0; band < tiles_y; band++) rasterizeBand(band);
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    stats.occluderTriangles = static_cast<int>(triangles.size());
+    stats.rasterMs = std::chrono::duration<float, std::milli>(end - start).count();
+}
+
+void OcclusionCuller::rasterizeBand(int band) {
+    const int rowBegin = band * TILE_SIZE;
+    const int rowEnd = rowBegin + TILE_SIZE;
+
+    for (const auto &tri: triangles) {
+        if (tri.maxPixel.y < rowBegin || tri.minPixel.y >= rowEnd) continue;
+        rasterizeTriangle(tri, rowBegin, rowEnd, width, depth.data());
+    }
+
+    // Reduce the band into its row of tiles (farthest depth per tile)
+    for (int tx = 0; tx < tiles_x; tx++) {
+        float farthest = 0.0f;
+        for (int y = rowBegin; y < rowEnd; y++) {
+            const float *row = &depth[y * width + tx * TILE_SIZE];
+            for (int x = 0; x < TILE_SIZE; x++) {
+                farthest = std::max(farthest, row[x]);
+            }
+        }
+        tile_max_depth[band * tiles_x + tx] = farthest;
+    }
+}
+
+void OcclusionCuller::rasterizeTriangle(const ScreenTriangle &tri, int rowBegin, int rowEnd, int width,
+                                        float *depth) {
+    glm::vec3 a = tri.v[0], b = tri.v[1], c = tri.v[2];
+
+    float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+    if (std::fabs(area) < 1e-8f) return;
+    // Occluders are rendered two-sided: flip clockwise triangles to counter-clockwise
+    if (area < 0.0f) {
+        std::swap(b, c);
+        area = -area;
+    }
+
+    // Edge functions E(x, y) = A * x + B * y + C, positive inside
+    const float A0 = b.y - c.y, B0 = c.x - b.x, C0 = b.x * c.y - b.y * c.x; // Opposite vertex a
+    const float A1 = c.y - a.y, B1 = a.x - c.x, C1 = c.x * a.y - c.y * a.x; // Opposite vertex b
+    const float A2 = a.y - b.y, B2 = b.x - a.x, C2 = a.x * b.y - a.y * b.x; // Opposite vertex c
+
+    // Screen-space depth plane z(x, y) = Az * x + Bz * y + Cz
+    const float invArea = 1.0f / area;
+    const float Az = (A0 * a.z + A1 * b.z + A2 * c.z) * invArea;
+    const float Bz = (B0 * a.z + B1 * b.z + B2 * c.z) * invArea;
+    const float Cz = (C0 * a.z + C1 * b.z + C2 * c.z) * invArea;
+
+    const int y0 = std::max(tri.minPixel.y, rowBegin);
+    const int y1 = std::min(tri.maxPixel.y, rowEnd - 1);
+    // Start on a 4-pixel boundary; lanes left of the bounding box are outside the triangle anyway
+    const int x0 = tri.minPixel.x & ~3;
+    const int x1 = tri.maxPixel.x;
+
+#ifdef OCCLUSION_USE_SSE
+    const __m128 laneOffsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+    const __m128 zero = _mm_setzero_ps();
+    for (int y = y0; y <= y1; y++) {
+        const float py = static_cast<float>(y) + 0.5f;
+        const __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x0)), laneOffsets);
+        __m128 e0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(A0), px), _mm_set1_ps(B0 * py + C0));
+        __m128 e1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(A1), px), _mm_set1_ps(B1 * py + C1));
+        __m128 e2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(A2), px), _mm_set1_ps(B2 * py + C2));
+        __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(Az), px), _mm_set1_ps(Bz * py + Cz));
+        const __m128 stepE0 = _mm_set1_ps(A0 * 4.0f), stepE1 = _mm_set1_ps(A1 * 4.0f);
+        const __m128 stepE2 = _mm_set1_ps(A2 * 4.0f), stepZ = _mm_set1_ps(Az * 4.0f);
+
+        float *row = depth + y * width;
+        for (int x = x0; x <= x1; x += 4) {
+            __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)),
+                                       _mm_cmpge_ps(e2, zero));
+            if (_mm_movemask_ps(inside)) {
+                __m128 old = _mm_loadu_ps(row + x);
+                __m128 nearest = _mm_min_ps(old, z);
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+            }
+            e0 = _mm_add_ps(e0, stepE0);
+            e1 = _mm_add_ps(e1, stepE1);
+            e2 = _mm_add_ps(e2, stepE2);
+            z = _mm_add_ps(z, stepZ);
+        }
+    }
+#else
+    for (int y = y0; y <= y1; y++) {
+        const float py = static_cast<float>(y) + 0.5f;
+        float *row = depth + y * width;
+        for (int x = x0; x <= x1; x += 4) {
+            for (int lane = 0; lane < 4; lane++) {
+                const float px = static_cast<float>(x + lane) + 0.5f;
+                if (A0 * px + B0 * py + C0 >= 0.0f && A1 * px + B1 * py + C1 >= 0.0f &&
+                    A2 * px + B2 * py + C2 >= 0.0f) {
+                    row[x + lane] = std::min(row[x + lane], Az * px + Bz * py + Cz);
+                }
+            }
+        }
+    }
+#endif
+}
+
+bool OcclusionCuller::isVisible(const AABB &worldBounds) {
+    tested_objects++;
+
+    glm::vec3 corners[8];
+    worldBounds.corners(corners);
+
+    glm::vec3 ndcMin(FLT_MAX), ndcMax(-FLT_MAX);
+    for (const auto &corner: corners) {
+        glm::vec4 clip = view_projection * glm::vec4(corner, 1.0f);
+        // Box crosses the near plane: assume visible
+        if (clip.w <= 1e-5f || clip.z < -clip.w) return true;
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        ndcMin = glm::min(ndcMin, ndc);
+        ndcMax = glm::max(ndcMax, ndc);
+    }
+
+    // Completely outside the view frustum
+    if (ndcMax.x < -1.0f || ndcMin.x > 1.0f || ndcMax.y < -1.0f || ndcMin.y > 1.0f || ndcMin.z > 1.0f) {
+        culled_objects++;
+        return false;
+    }
+
+    const float nearestDepth = ndcMin.z * 0.5f + 0.5f;
+    const int px0 = std::max(0, static_cast<int>(std::floor((ndcMin.x * 0.5f + 0.5f) * static_cast<float>(width))));
+    const int py0 = std::max(0, static_cast<int>(std::floor((ndcMin.y * 0.5f + 0.5f) * static_cast<float>(height))));
+    const int px1 = std::min(width - 1,
+                             static_cast<int>(std::floor((ndcMax.x * 0.5f + 0.5f) * static_cast<float>(width))));
+    const int py1 = std::min(height - 1,
+                             static_cast<int>(std::floor((ndcMax.y * 0.5f + 0.5f) * static_cast<float>(height))));
+
+    for (int ty = py0 / TILE_SIZE; ty <= py1 / TILE_SIZE; ty++) {
+        for (int tx = px0 / TILE_SIZE; tx <= px1 / TILE_SIZE; tx++) {
+            // Every pixel of the tile is nearer than the box: the whole tile hides it
+            if (tile_max_depth[ty * tiles_x + tx] < nearestDepth) continue;
+
+            // Inconclusive tile: check the covered pixels individually
+            const int xBegin = std::max(px0, tx * TILE_SIZE), xEnd = std::min(px1, tx * TILE_SIZE + TILE_SIZE - 1);
+            const int yBegin = std::max(py0, ty * TILE_SIZE), yEnd = std::min(py1, ty * TILE_SIZE + TILE_SIZE - 1);
+            for (int y = yBegin; y <= yEnd; y++) {
+                for (int x = xBegin; x <= xEnd; x++) {
+                    if (depth[y * width + x] >= nearestDepth) return true;
+                }
+            }
+        }
+    }
+
+    culled_objects++;
+    return false;
+}
+
+OcclusionCuller::Stats OcclusionCuller::getStats() const {
+    Stats result = stats;
+    result.tested = tested_objects.load();
+    result.culled = culled_objects.load();
+    return result;
+}
@@ -0,0 +1,84 @@
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include <atomic>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "bounds.h"
+
+class ThreadPool;
+
+/*
+ * OcclusionCuller Class
+ * CPU software occlusion culling.
+ * A handful of simplified occluder meshes are rasterized into a small depth buffer, which is then reduced
+ * into a coarser max-depth level (one value per 8x8 tile). Objects are tested by projecting their bounding box
+ * and comparing its nearest depth against the buffer, first per tile, then per pixel where a tile is inconclusive.
+ * Runs entirely on the CPU and never touches OpenGL, so it can be used without a GL context.
+ */
+class OcclusionCuller {
+public:
+    // Size of a hierarchical depth tile, in depth buffer pixels
+    static constexpr int TILE_SIZE = 8;
+
+    struct Stats {
+        int occluderTriangles = 0;
+        int tested = 0;
+        int culled = 0;
+        float rasterMs = 0.0f;
+    };
+
+    // width and height are rounded up to a multiple of TILE_SIZE. "pool" may be null (single threaded)
+    OcclusionCuller(int width, int height, ThreadPool *pool = nullptr);
+
+    // Clears the depth buffer and the occluder list
+    void beginFrame(const glm::mat4 &viewProjection);
+
+    // Adds an occluder mesh (triangle list) transformed by "model"
+    void addOccluder(const std::vector<glm::vec3> &positions, const std::vector<unsigned int> &indices,
+                     const glm::mat4 &model);
+
+    // Adds a solid box as occluder (a cheap stand-in for a complex model)
+    void addOccluder(const AABB &box, const glm::mat4 &model);
+
+    // Rasterizes all occluders added since beginFrame() and builds the tile level
+    void rasterize();
+
+    // Returns false only if the world-space box is fully hidden behind the occluders (or off-screen).
+    // Safe to call from several threads at once after rasterize()
+    bool isVisible(const AABB &worldBounds);
+
+    Stats getStats() const;
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+    // Depth values in [0, 1] (1 = far), row-major, row 0 at the bottom of the screen
+    const std::vector<float> &getDepthBuffer() const { return depth; }
+
+private:
+    // Screen-space triangle: x/y in depth buffer pixels, z in [0, 1]
+    struct ScreenTriangle {
+        glm::vec3 v[3];
+        glm::ivec2 minPixel, maxPixel;
+    };
+
+    void rasterizeBand(int band);
+
+    static void rasterizeTriangle(const ScreenTriangle &tri, int rowBegin, int rowEnd, int width, float *depth);
+
+    int width, height;
+    int tiles_x, tiles_y;
+    ThreadPool *pool;
+
+    glm::mat4 view_projection = glm::mat4(1.0f);
+    std::vector<ScreenTriangle> triangles;
+    std::vector<float> depth; // Full resolution depth
+    std::vector<float> tile_max_depth; // Farthest depth per tile
+    Stats stats;
+    std::atomic<int> tested_objects{0};
+    std::atomic<int> culled_objects{0};
+};
+
+#endif // OCCLUSION_H
@@ -0,0 +1,135 @@
+#include "occlusion_query.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+OcclusionQueries::OcclusionQueries(int objectCount, GLuint boxShader)
+    : shader_id(boxShader) {
+    queries.resize(objectCount * 2);
+    glGenQueries(static_cast<GLsizei>(queries.size()), queries.data());
+    issued.assign(queries.size(), false);
+    // Until a result comes back, everything is assumed visible
+    visible.assign(objectCount, true);
+
+    static constexpr GLfloat cubeVertices[] = {
+        0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f,
+        0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f,
+    };
+    static constexpr GLuint cubeIndices[] = {
+        0, 1, 3, 0, 3, 2, 4, 6, 7, 4, 7, 5, 0, 4, 5, 0, 5, 1,
+        2, 3, 7, 2, 7, 6, 0, 2, 6, 0, 6, 4, 1, 5, 7, 1, 7, 3,
+    };
+
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vbo);
+    glGenBuffers(1, &ebo);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(cubeVertices), cubeVertices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cubeIndices), cubeIndices, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), static_cast<void *>(nullptr));
+    glBindVertexArray(0);
+
+    mvp_loc = glGetUniformLocation(shader_id, "mvp");
+}
+
+OcclusionQueries::~OcclusionQueries() {
+    glDeleteQueries(static_cast<GLsizei>(queries.size()), queries.data());
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &vbo);
+    glDeleteBuffers(1, &ebo);
+}
+
+void OcclusionQueries::beginFrame() {
+    if (mode == Mode::Off) return;
+
+    // Last frame's queries were issued into the current set; read whatever has already finished
+    for (int i = 0; i < objectCount(); i++) {
+        const int index = current_set * objectCount() + i;
+        if (!issued[index]) continue;
+
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(queries[index], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) {
+            GLuint samplesPassed = GL_FALSE;
+            glGetQueryObjectuiv(queries[index], GL_QUERY_RESULT, &samplesPassed);
+            visible[i] = samplesPassed != GL_FALSE;
+            issued[index] = false;
+        }
+        // Not ready yet: keep the previous visibility rather than waiting for the GPU
+    }
+
+    current_set = 1 - current_set;
+}
+
+void OcclusionQueries::issueQueries(const std::vector<AABB> &worldBounds, const glm::mat4 &viewProjection,
+                                    const glm::vec3 &cameraPosition) {
+    if (mode == Mode::Off) return;
+
+    glUseProgram(shader_id);
+    glBindVertexArray(vao);
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthMask(GL_FALSE);
+
+    for (int i = 0; i < objectCount() && i < static_cast<int>(worldBounds.size()); i++) {
+        const int index = current_set * objectCount() + i;
+
+        // Camera (nearly) inside the box: the near plane would clip the proxy away, so skip the query
+        const AABB nearBounds = AABB(worldBounds[i].min - glm::vec3(0.5f), worldBounds[i].max + glm::vec3(0.5f));
+        if (glm::all(glm::greaterThanEqual(cameraPosition, nearBounds.min)) &&
+            glm::all(glm::lessThanEqual(cameraPosition, nearBounds.max))) {
+            visible[i] = true;
+            issued[index] = false;
+            continue;
+        }
+
+        glm::mat4 boxModel = glm::translate(glm::mat4(1.0f), worldBounds[i].min);
+        boxModel = glm::scale(boxModel, worldBounds[i].max - worldBounds[i].min);
+        glm::mat4 mvp = viewProjection * boxModel;
+        glUniformMatrix4fv(mvp_loc, 1, GL_FALSE, glm::value_ptr(mvp));
+
+        glBeginQuery(GL_ANY_SAMPLES_PASSED, queries[index]);
+        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, nullptr);
+        glEndQuery(GL_ANY_SAMPLES_PASSED);
+        issued[index] = true;
+    }
+
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glDepthMask(GL_TRUE);
+    glBindVertexArray(0);
+}
+
+bool OcclusionQueries::beginDraw(int object) {
+    switch (mode) {
+        case Mode::Latent:
+            return visible[object];
+        case Mode::Conditional: {
+            const int index = current_set * objectCount() + object;
+            // No query this frame (camera inside the box): draw unconditionally
+            if (issued[index]) {
+                // The GPU waits for the result, not the CPU. The queries go out before any heavy model, so it is
+                // normally ready; with NO_WAIT, renderers that finish queries only with the frame (tilers, llvmpipe)
+                // would never skip anything
+                glBeginConditionalRender(queries[index], GL_QUERY_WAIT);
+            }
+            return true;
+        }
+        default:
+            return true;
+    }
+}
+
+void OcclusionQueries::endDraw(int object) {
+    if (mode == Mode::Conditional && issued[current_set * objectCount() + object]) {
+        glEndConditionalRender();
+    }
+}
+
+int OcclusionQueries::occludedCount() const {
+    int count = 0;
+    for (bool v: visible) {
+        if (!v) count++;
+    }
+    return count;
+}
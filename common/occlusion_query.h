@@ -0,0 +1,63 @@
+#ifndef OCCLUSION_QUERY_H
+#define OCCLUSION_QUERY_H
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "glad.h"
+
+#include "bounds.h"
+
+/*
+ * OcclusionQueries Class
+ * GPU occlusion culling for expensive models using GL_ANY_SAMPLES_PASSED queries.
+ * The bounding box of each object is rendered (no color/depth writes) against the depth buffer, and the query
+ * result decides whether the full model is drawn:
+ * - Conditional: the draw is wrapped in glBeginConditionalRender with this frame's query, so the GPU skips it.
+ *   The queries have to be issued after the occluders and before any draw of the queried models.
+ * - Latent: last frame's result is read back without waiting (one frame of latency), and occluded objects
+ *   are not submitted at all.
+ * Query objects are double-buffered so a result is never read from a query that is being re-issued.
+ */
+class OcclusionQueries {
+public:
+    enum class Mode { Off, Conditional, Latent };
+
+    OcclusionQueries(int objectCount, GLuint boxShader);
+
+    ~OcclusionQueries();
+
+    void setMode(Mode newMode) { mode = newMode; }
+    Mode getMode() const { return mode; }
+
+    // Collects available results from last frame's queries (never stalls) and flips the query sets
+    void beginFrame();
+
+    // Renders the box of every object inside its query. Changes the bound program and VAO
+    void issueQueries(const std::vector<AABB> &worldBounds, const glm::mat4 &viewProjection,
+                      const glm::vec3 &cameraPosition);
+
+    // Returns false if the object must not be drawn; otherwise the draw must be followed by endDraw()
+    bool beginDraw(int object);
+
+    void endDraw(int object);
+
+    // Number of objects whose last known result was "occluded"
+    int occludedCount() const;
+
+    int objectCount() const { return static_cast<int>(visible.size()); }
+
+private:
+    Mode mode = Mode::Off;
+    int current_set = 0;
+
+    std::vector<GLuint> queries; // Two sets of one query per object
+    std::vector<bool> issued; // Whether queries[i] holds a pending or finished result
+    std::vector<bool> visible; // Last known visibility per object
+
+    // Unit cube proxy geometry
+    GLuint vao, vbo, ebo;
+    GLuint shader_id;
+    GLint mvp_loc;
+};
+
+#endif // OCCLUSION_QUERY_H
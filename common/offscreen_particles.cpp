@@ -0,0 +1,87 @@
+#include "offscreen_particles.h"
+#include <glm/gtc/type_ptr.hpp>
+
+OffscreenParticles::OffscreenParticles(GLuint downsampleProgram, GLuint compositeProgram)
+    : downsample_program(downsampleProgram), composite_program(compositeProgram) {
+    downsample_factor = glGetUniformLocation(downsample_program, "factor");
+    downsample_render_size = glGetUniformLocation(downsample_program, "renderSize");
+    downsample_near_far = glGetUniformLocation(downsample_program, "nearFar");
+    glUseProgram(downsample_program);
+    glUniform1i(glGetUniformLocation(downsample_program, "sceneDepth"), 0);
+
+    composite_factor = glGetUniformLocation(composite_program, "factor");
+    composite_low_render_size = glGetUniformLocation(composite_program, "lowRenderSize");
+    composite_near_far = glGetUniformLocation(composite_program, "nearFar");
+    glUseProgram(composite_program);
+    glUniform1i(glGetUniformLocation(composite_program, "particleColor"), 0);
+    glUniform1i(glGetUniformLocation(composite_program, "lowDepth"), 1);
+    glUniform1i(glGetUniformLocation(composite_program, "sceneDepth"), 2);
+
+    glGenVertexArrays(1, &empty_vao);
+}
+
+OffscreenParticles::~OffscreenParticles() {
+    glDeleteVertexArrays(1, &empty_vao);
+}
+
+void OffscreenParticles::downsampleDepth(GLuint sceneDepth, glm::ivec2 renderSize) {
+    const glm::ivec2 lowSize = reducedSize(renderSize);
+    glViewport(0, 0, lowSize.x, lowSize.y);
+    // Every fragment writes its depth, whatever was there before
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_ALWAYS);
+    glDepthMask(GL_TRUE);
+
+    glUseProgram(downsample_program);
+    glUniform1i(downsample_factor, factor);
+    glUniform2i(downsample_render_size, renderSize.x, renderSize.y);
+    glUniform2fv(downsample_near_far, 1, glm::value_ptr(near_far));
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, sceneDepth);
+    glBindVertexArray(empty_vao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+
+    glBindVertexArray(0);
+    glDepthFunc(GL_LESS);
+}
+
+void OffscreenParticles::prepareSoftParticles(GLuint particleProgram, GLuint lowDistance, glm::ivec2 lowTextureSize,
+                                              float softDistance) const {
+    glUseProgram(particleProgram);
+    glUniform1i(glGetUniformLocation(particleProgram, "sceneDistance"), 1);
+    glUniform2f(glGetUniformLocation(particleProgram, "depthTexelSize"),
+                1.0f / static_cast<float>(lowTextureSize.x), 1.0f / static_cast<float>(lowTextureSize.y));
+    glUniform2fv(glGetUniformLocation(particleProgram, "nearFar"), 1, glm::value_ptr(near_far));
+    glUniform1f(glGetUniformLocation(particleProgram, "softDistance"), softDistance);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, lowDistance);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void OffscreenParticles::composite(GLuint particleColor, GLuint lowDistance, GLuint sceneDepth,
+                                   glm::ivec2 renderSize) const {
+    const glm::ivec2 lowSize = reducedSize(renderSize);
+    glViewport(0, 0, renderSize.x, renderSize.y);
+    glDisable(GL_DEPTH_TEST);
+    // Premultiplied "over"
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+    glUseProgram(composite_program);
+    glUniform1i(composite_factor, factor);
+    glUniform2i(composite_low_render_size, lowSize.x, lowSize.y);
+    glUniform2fv(composite_near_far, 1, glm::value_ptr(near_far));
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, particleColor);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, lowDistance);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, sceneDepth);
+    glBindVertexArray(empty_vao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glActiveTexture(GL_TEXTURE0);
+
+    glBindVertexArray(0);
+    glDisable(GL_BLEND);
+    glEnable(GL_DEPTH_TEST);
+}
@@ -0,0 +1,68 @@
+#ifndef OFFSCREEN_PARTICLES_H
+#define OFFSCREEN_PARTICLES_H
+
+#include <glm/glm.hpp>
+#include "glad.h"
+
+/*
+ * OffscreenParticles Class
+ * Renders particles at half or quarter resolution to cut the fill rate of overlapping billboards, which with
+ * alpha blending and no depth writes shade every covered pixel (or MSAA sample) once per layer.
+ * A frame takes three passes around the particle draws, all over the rendered corner of native-size targets
+ * as produced by DynamicResolution:
+ * - downsampleDepth(): the scene depth reduced to the nearest depth of each factor x factor block, into a
+ *   low-resolution depth target the particles are depth tested against and an R32F copy as linear distance,
+ *   which can be sampled while the depth target is bound;
+ * - the particle draws themselves, into a cleared low-resolution colour target (premultiplied colour, alpha as
+ *   coverage), optionally with the SOFT permutation fading them against the low-resolution distance;
+ * - composite(): a depth-aware (bilateral) upsample blended over the full-resolution scene colour.
+ * The targets themselves come from the render graph; only the two full-screen programs are held here.
+ */
+class OffscreenParticles {
+public:
+    // Both programs are fullscreen.vert with particle_depth.frag / particle_upsample.frag
+    OffscreenParticles(GLuint downsampleProgram, GLuint compositeProgram);
+
+    ~OffscreenParticles();
+
+    OffscreenParticles(const OffscreenParticles &) = delete;
+
+    OffscreenParticles &operator=(const OffscreenParticles &) = delete;
+
+    // 1 draws particles straight into the scene (no offscreen passes), 2 at half and 4 at quarter resolution.
+    // The passes also work at 1, as full-resolution targets for draws that cannot blend into the scene directly
+    // (WeightedOit)
+    void setFactor(int newFactor) { factor = newFactor == 2 || newFactor == 4 ? newFactor : 1; }
+
+    int getFactor() const { return factor; }
+
+    bool isEnabled() const { return factor > 1; }
+
+    // Size of a low-resolution target for a full-resolution one, rounded up
+    glm::ivec2 reducedSize(glm::ivec2 size) const { return (size + factor - 1) / factor; }
+
+    void setDepthRange(float nearPlane, float farPlane) { near_far = glm::vec2(nearPlane, farPlane); }
+
+    // Writes the reduced scene depth into the bound framebuffer: its depth attachment and, as linear distance,
+    // its first colour attachment. "sceneDepth" must be single-sampled
+    void downsampleDepth(GLuint sceneDepth, glm::ivec2 renderSize);
+
+    // Binds the low-resolution distance to texture unit 1 and sets the soft-particle uniforms of a SOFT
+    // permutation of the particle shader; call before the particle draws
+    void prepareSoftParticles(GLuint particleProgram, GLuint lowDistance, glm::ivec2 lowTextureSize,
+                              float softDistance) const;
+
+    // Blends the low-resolution particles over the bound scene colour target
+    void composite(GLuint particleColor, GLuint lowDistance, GLuint sceneDepth, glm::ivec2 renderSize) const;
+
+private:
+    int factor = 1;
+    glm::vec2 near_far = glm::vec2(0.1f, 100.0f);
+
+    GLuint downsample_program, composite_program;
+    GLint downsample_factor, downsample_render_size, downsample_near_far;
+    GLint composite_factor, composite_low_render_size, composite_near_far;
+    GLuint empty_vao = 0;
+};
+
+#endif // OFFSCREEN_PARTICLES_H
@@ -1,30 +1,37 @@
 #include "particle.h"
+#include "thread_pool.h"
+#include "weighted_oit.h"
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <algorithm>
+#include <cfloat>
+#include <chrono>
 #include <cstddef>
-#include <ctime>
-
-// Data structure for instanced rendering, matches layout in the shader
-struct ParticleInstanceData {
-    glm::vec4 posAndSize; // .xyz = position, .w = size
-    glm::vec4 color;
-};
-
-// A more robust helper function to get a random float
-float rand_float(float min, float max) {
-    if (min > max) std::swap(min, max);
-    return min + (static_cast<float>(rand()) / static_cast<float>(RAND_MAX)) * (max - min);
+#include <functional>
+#include <iterator>
+#include <queue>
+
+namespace {
+    // Conservative: false only when all eight corners are outside the same clip plane
+    bool boxInFrustum(const AABB &box, const glm::mat4 &viewProjection) {
+        glm::vec3 corners[8];
+        box.corners(corners);
+        unsigned outside = ~0u;
+        for (const glm::vec3 &corner: corners) {
+            const glm::vec4 clip = viewProjection * glm::vec4(corner, 1.0f);
+            unsigned planes = 0;
+            for (int axis = 0; axis < 3; axis++) {
+                if (clip[axis] < -clip.w) planes |= 1u << (axis * 2);
+                if (clip[axis] > clip.w) planes |= 2u << (axis * 2);
+            }
+            outside &= planes;
+        }
+        return outside == 0;
+    }
 }
 
-ParticleSystem::ParticleSystem(unsigned int maxParticles, GLuint shader, GLuint texture)
-    : max_particles(maxParticles), shader_id(shader), texture_id(texture) {
-    srand(time(nullptr));
-    particles.resize(max_particles);
-
-    for (auto& p : particles) {
-        p.life = -1.0f;
-    }
+ParticleSystem::ParticleSystem(GLuint shader, GLuint texture, ThreadPool *pool, uint32_t seed)
+    : thread_pool(pool), seed(seed), shader_id(shader), texture_id(texture) {
 
     static constexpr GLfloat g_vertex_buffer_data[] = {
         -0.5f, -0.5f, 0.0f,
@@ -46,8 +53,7 @@ ParticleSystem::ParticleSystem(unsigned int maxParticles, GLuint shader, GLuint
 
     // --- 2. Interleaved instanced data (attributes 1 and 2) ---
     glGenBuffers(1, &vbo_instanced_data);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo_instanced_data);
-    glBufferData(GL_ARRAY_BUFFER, max_particles * sizeof(ParticleInstanceData), nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_instanced_data); // Storage is (re)allocated by every render()
 
     // Attribute 1: Position (vec3) and Size (float)
     glEnableVertexAttribArray(1);
@@ -55,19 +61,29 @@ ParticleSystem::ParticleSystem(unsigned int maxParticles, GLuint shader, GLuint
                           reinterpret_cast<void *>(offsetof(ParticleInstanceData, posAndSize)));
     glVertexAttribDivisor(1, 1); // Instanced
 
-    // Attribute 2: Color (vec4)
+    // Attribute 2: Tint (RGBA8, normalized to vec4)
     glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(ParticleInstanceData),
-                          reinterpret_cast<void *>(offsetof(ParticleInstanceData, color)));
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ParticleInstanceData),
+                          reinterpret_cast<void *>(offsetof(ParticleInstanceData, tint)));
     glVertexAttribDivisor(2, 1); // Instanced
 
+    // Attribute 3: Lifetime alpha and atlas frame (vec2)
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(ParticleInstanceData),
+                          reinterpret_cast<void *>(offsetof(ParticleInstanceData, alpha)));
+    glVertexAttribDivisor(3, 1); // Instanced
+
     glBindVertexArray(0);
 
-    // Get uniform locations
-    glUseProgram(shader_id);
+    setShader(shader_id);
+}
+
+void ParticleSystem::setShader(GLuint shader) {
+    shader_id = shader;
     view_loc = glGetUniformLocation(shader_id, "view");
     projection_loc = glGetUniformLocation(shader_id, "projection");
     texture_sampler_loc = glGetUniformLocation(shader_id, "particleTexture");
+    stereo_half_separation_loc = glGetUniformLocation(shader_id, "stereoHalfSeparation");
 }
 
 ParticleSystem::~ParticleSystem() {
@@ -76,89 +92,125 @@ ParticleSystem::~ParticleSystem() {
     glDeleteBuffers(1, &vbo_instanced_data);
 }
 
-int ParticleSystem::findUnusedParticle() {
-    for (int i = last_used_particle; i < max_particles; i++) {
-        if (particles[i].life < 0) {
-            last_used_particle = i;
-            return i;
+int ParticleSystem::addEmitter(const ParticleEmitter::Settings &settings) {
+    const uint32_t index = static_cast<uint32_t>(emitters.size());
+    // Each emitter's stream depends only on the seed and its index
+    emitters.emplace_back(settings, seed ^ (index + 1u) * 0x9E3779B9u);
+    return static_cast<int>(index);
+}
+
+void ParticleSystem::setCamera(const glm::mat4 &viewMatrix, const glm::mat4 &projectionMatrix, int viewportHeight) {
+    view_projection = projectionMatrix * viewMatrix;
+    projection_scale = projectionMatrix[1][1] * 0.5f * static_cast<float>(viewportHeight);
+}
+
+void ParticleSystem::chooseLods(const glm::vec3 &cameraPosition) {
+    for (ParticleEmitter &emitter: emitters) {
+        if (!lod_settings.enabled || projection_scale <= 0.0f) {
+            emitter.setLod(ParticleEmitter::Lod::Full);
+            continue;
         }
-    }
-    for (int i = 0; i < last_used_particle; i++) {
-        if (particles[i].life < 0) {
-            last_used_particle = i;
-            return i;
+        const AABB bounds = emitter.getBounds();
+        if (!boxInFrustum(bounds, view_projection)) {
+            emitter.setLod(lod_settings.dormantOffscreen ? ParticleEmitter::Lod::Dormant
+                                                         : ParticleEmitter::Lod::Hidden);
+            continue;
         }
+        // Height of the bounding sphere on screen; from inside it, the emitter fills the view
+        const float radius = glm::length(bounds.extents());
+        const float distance = glm::length(bounds.center() - cameraPosition);
+        const float pixels = distance > radius ? 2.0f * radius * projection_scale / distance : FLT_MAX;
+        const float detail = glm::clamp(pixels / lod_settings.fullDetailPixels, lod_settings.minDetail, 1.0f);
+        emitter.setLod(detail < 1.0f ? ParticleEmitter::Lod::Reduced : ParticleEmitter::Lod::Full, detail);
     }
-    return 0;
 }
 
-void ParticleSystem::spawnParticle(Particle &p) {
-    // Lifetime: 2 seconds
-    p.life = 2.0f;
-    p.pos = glm::vec3(-10.0f, 15.0f, -30.0f); // Correct chimney top
-
-    // A clear, consistent upward speed
-    // Y-speed of 4 means it will travel 8 units up over its 2s lifetime
-    glm::vec3 mainDir = glm::vec3(0.0f, 4.0f, 0.0f);
-    // Very slight randomness for variation
-    glm::vec3 randomDir = glm::vec3(
-        rand_float(-0.3f, 0.3f),
-        rand_float(-0.3f, 0.3f),
-        rand_float(-0.3f, 0.3f)
-    );
-    p.speed = mainDir + randomDir;
-
-    p.color = glm::vec4(1.0f); // Alpha will be controlled for fade-out
-    p.size = rand_float(1.4f, 2.0f); // Size of the smoke, slightly varied
+void ParticleSystem::update(float deltaTime, glm::vec3 cameraPosition) {
+    chooseLods(cameraPosition);
+    auto start = std::chrono::high_resolution_clock::now();
+    const std::function<void(int)> updateEmitter = [&](int i) {
+        emitters[i].update(deltaTime, cameraPosition, !order_independent);
+    };
+    if (thread_pool && emitters.size() > 1) {
+        thread_pool->parallelFor(static_cast<int>(emitters.size()), updateEmitter);
+    } else {
+        for (int i = 0; i < static_cast<int>(emitters.size()); i++) updateEmitter(i);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    stats.updateMs = std::chrono::duration<float, std::milli>(end - start).count();
+
+    start = end;
+    mergeInstances();
+    stats.mergeMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    stats.emitters = static_cast<int>(emitters.size());
+    stats.alive = static_cast<int>(instance_data.size());
+    stats.spawned = stats.dropped = stats.recycled = 0.0f;
+    stats.simulated = 0;
+    std::fill(std::begin(stats.lodCounts), std::end(stats.lodCounts), 0);
+    for (const ParticleEmitter &emitter : emitters) {
+        stats.spawned += emitter.getStats().spawned;
+        stats.dropped += emitter.getStats().dropped;
+        stats.recycled += emitter.getStats().recycled;
+        stats.simulated += emitter.getPool().size();
+        stats.lodCounts[static_cast<int>(emitter.getLod())]++;
+    }
 }
 
-void ParticleSystem::update(float deltaTime, int newParticles, glm::vec3 cameraPosition) {
-    for (int i = 0; i < newParticles; i++) {
-        int particleIndex = findUnusedParticle();
-        spawnParticle(particles[particleIndex]);
+void ParticleSystem::mergeInstances() {
+    size_t total = 0;
+    std::vector<int> nonEmpty;
+    for (int i = 0; i < static_cast<int>(emitters.size()); i++) {
+        if (emitters[i].getInstances().empty()) continue;
+        total += emitters[i].getInstances().size();
+        nonEmpty.push_back(i);
     }
-
-    for (auto &p: particles) {
-        if (p.life > 0.0f) {
-            p.life -= deltaTime;
-            if (p.life > 0.0f) {
-                // Simple, constant velocity motion
-                p.pos += p.speed * deltaTime;
-
-                glm::vec3 toCamera = p.pos - cameraPosition;
-                p.cameraDistance = glm::dot(toCamera, toCamera);
-
-                // Fade out based on its 2-second lifetime
-                p.color.a = p.life / 2.0f;
-            } else {
-                p.cameraDistance = -1.0f;
-            }
+    instance_data.resize(total);
+    if (nonEmpty.size() == 1 || order_independent) {
+        // Nothing to interleave: the runs one after the other, in emitter order
+        auto out = instance_data.begin();
+        for (const int i: nonEmpty) {
+            out = std::copy(emitters[i].getInstances().begin(), emitters[i].getInstances().end(), out);
         }
+        return;
     }
-    std::sort(particles.begin(), particles.end());
-}
-
-void ParticleSystem::render(const glm::mat4 &viewMatrix, const glm::mat4 &projectionMatrix) const {
-    std::vector<ParticleInstanceData> instance_data;
-    instance_data.reserve(max_particles);
 
-    for (const auto &p: particles) {
-        if (p.life > 0.0f) {
-            instance_data.push_back({glm::vec4(p.pos, p.size), p.color});
+    // K-way merge of the emitters' sorted runs: the heap holds each run's next key, with the emitter index in the
+    // low bits so equal keys always come out in emitter order
+    std::vector<size_t> cursors(emitters.size(), 0);
+    std::priority_queue<uint64_t, std::vector<uint64_t>, std::greater<uint64_t> > heads;
+    for (const int i: nonEmpty) {
+        heads.push(static_cast<uint64_t>(emitters[i].getSortKeys()[0]) << 32 | static_cast<uint32_t>(i));
+    }
+    for (size_t n = 0; n < total; n++) {
+        const int i = static_cast<int>(heads.top() & 0xFFFFFFFFu);
+        heads.pop();
+        const ParticleEmitter &emitter = emitters[i];
+        size_t &cursor = cursors[i];
+        instance_data[n] = emitter.getInstances()[cursor++];
+        if (cursor < emitter.getInstances().size()) {
+            heads.push(static_cast<uint64_t>(emitter.getSortKeys()[cursor]) << 32 | static_cast<uint32_t>(i));
         }
     }
+}
 
+void ParticleSystem::render(const glm::mat4 &viewMatrix, const glm::mat4 &projectionMatrix, int views,
+                            float eyeHalfSeparation) const {
     if (instance_data.empty()) return;
 
     // --- Simplified and Robust Data Upload ---
     glBindBuffer(GL_ARRAY_BUFFER, vbo_instanced_data);
     // Replace the entire buffer content with the new data for this frame.
-    glBufferData(GL_ARRAY_BUFFER, instance_data.size() * sizeof(ParticleInstanceData), &instance_data[0],
+    glBufferData(GL_ARRAY_BUFFER, instance_data.size() * sizeof(ParticleInstanceData), instance_data.data(),
                  GL_STREAM_DRAW);
 
     // --- Render ---
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    if (order_independent) {
+        WeightedOit::setBlendState();
+    } else {
+        glEnable(GL_BLEND);
+        // Alpha accumulates coverage, so the same draw also works into a transparent offscreen target
+        glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    }
     glDepthMask(GL_FALSE);
 
     glUseProgram(shader_id);
@@ -168,9 +220,14 @@ void ParticleSystem::render(const glm::mat4 &viewMatrix, const glm::mat4 &projec
     glUniform1i(texture_sampler_loc, 0);
     glUniformMatrix4fv(view_loc, 1, GL_FALSE, glm::value_ptr(viewMatrix));
     glUniformMatrix4fv(projection_loc, 1, GL_FALSE, glm::value_ptr(projectionMatrix));
+    glUniform1f(stereo_half_separation_loc, eyeHalfSeparation);
 
     glBindVertexArray(vao);
-    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, instance_data.size());
+    // Consecutive instances (one per eye) share a particle
+    glVertexAttribDivisor(1, views);
+    glVertexAttribDivisor(2, views);
+    glVertexAttribDivisor(3, views);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(instance_data.size()) * views);
 
     // --- Reset state ---
     glBindVertexArray(0);
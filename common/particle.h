@@ -1,52 +1,108 @@
 #ifndef PARTICLE_H
 #define PARTICLE_H
 
+#include <cstdint>
 #include <vector>
 #include <glm/glm.hpp>
 #include "glad.h"
+#include "particle_emitter.h"
 
-// Represents a single particle's state on the CPU
-struct Particle {
-    glm::vec3 pos, speed;
-    glm::vec4 color;
-    float size;
-    float life; // Remaining life of the particle; if < 0 particle is dead
-    float cameraDistance; // Squared distance to the camera. if dead: -1.0f
-
-    bool operator<(const Particle &that) const {
-        // Sort in reverse order : far particles drawn first.
-        return this->cameraDistance > that.cameraDistance;
-    }
-};
+class ThreadPool;
 
+/*
+ * ParticleSystem Class
+ * Draws the particles of any number of ParticleEmitters (chimney smoke, dust from the blades, falling leaves) in
+ * one instanced draw. update() runs the emitters as parallel tasks on the ThreadPool (each spawns, simulates, sorts
+ * and packs its own particles) and then merges their back-to-front runs into a single stream by sort key, ties
+ * going to the lower emitter index. Each emitter's random stream is seeded from the system's seed and the emitter's
+ * index, so the particles and the final order are the same for every thread count.
+ * Emitters differ only in their per-instance tint and atlas frame, so with a ParticleAtlas texture smoke, dust and
+ * leaves still share the one draw.
+ * With LOD enabled, each update() first picks every emitter's ParticleEmitter::Lod from its bounds and the camera
+ * given to setCamera(): emitters outside the frustum stop drawing (and, if asked, simulating), and emitters whose
+ * bounds cover few pixels emit fewer, larger particles.
+ */
 class ParticleSystem {
 public:
-    ParticleSystem(unsigned int maxParticles, GLuint shader, GLuint texture);
+    struct Stats {
+        int emitters = 0;
+        int alive = 0;     // Drawn this frame
+        float updateMs = 0.0f; // Emitters, wall time of the parallel part
+        float mergeMs = 0.0f;
+        float spawned = 0.0f, dropped = 0.0f, recycled = 0.0f; // Per second, summed over the emitters
+        int simulated = 0; // Live particles, drawn or not
+        int lodCounts[4] = {0, 0, 0, 0}; // Emitters per ParticleEmitter::Lod
+    };
+
+    struct LodSettings {
+        bool enabled = false;
+        bool dormantOffscreen = false; // Off-frustum emitters skip simulation (Dormant) instead of drawing (Hidden)
+        float fullDetailPixels = 150.0f; // Projected bounds height from which an emitter runs at full detail
+        float minDetail = 0.125f;        // Fraction of the rate kept however small the emitter gets
+    };
+
+    // "pool" may be null (single threaded). "seed" starts the emitters' random streams, so runs with the same
+    // seed spawn the same particles
+    ParticleSystem(GLuint shader, GLuint texture, ThreadPool *pool = nullptr, uint32_t seed = 1u);
 
     ~ParticleSystem();
 
-    void update(float deltaTime, int newParticles, glm::vec3 cameraPosition);
+    // Returns the emitter's index
+    int addEmitter(const ParticleEmitter::Settings &settings);
+
+    ParticleEmitter &getEmitter(int index) { return emitters[index]; }
+
+    int getEmitterCount() const { return static_cast<int>(emitters.size()); }
+
+    // Camera the LOD of the next update() is chosen for
+    void setCamera(const glm::mat4 &viewMatrix, const glm::mat4 &projectionMatrix, int viewportHeight);
+
+    void setLodSettings(const LodSettings &settings) { lod_settings = settings; }
+
+    const LodSettings &getLodSettings() const { return lod_settings; }
+
+    // Updates every emitter and merges their instances back to front (or, order independent, concatenates them)
+    void update(float deltaTime, glm::vec3 cameraPosition);
+
+    // With views = 2 every particle is drawn twice, once per eye; needs the STEREO permutation of the shader
+    void render(const glm::mat4 &viewMatrix, const glm::mat4 &projectionMatrix, int views = 1,
+                float eyeHalfSeparation = 0.0f) const;
+
+    // Switches to another permutation of the particle shader and looks up its uniforms
+    void setShader(GLuint shader);
+
+    // For an OIT permutation drawing into WeightedOit's targets: the draws use its blend state, and neither the
+    // emitters nor the merge sort anything
+    void setOrderIndependent(bool enabled) { order_independent = enabled; }
 
-    void render(const glm::mat4 &viewMatrix, const glm::mat4 &projectionMatrix) const;
+    const Stats &getStats() const { return stats; }
 
 private:
-    static void spawnParticle(Particle &particle);
+    void mergeInstances();
 
-    int findUnusedParticle();
+    // Sets every emitter's LOD for the camera at cameraPosition
+    void chooseLods(const glm::vec3 &cameraPosition);
 
-    std::vector<Particle> particles;
-    int max_particles;
-    int last_used_particle = 0;
+    ThreadPool *thread_pool;
+    uint32_t seed;
+    bool order_independent = false;
+    LodSettings lod_settings;
+    glm::mat4 view_projection = glm::mat4(1.0f);
+    float projection_scale = 0.0f; // Pixels per unit of height at distance 1
+    std::vector<ParticleEmitter> emitters;
+    std::vector<ParticleInstanceData> instance_data; // All emitters, sorted back to front, rebuilt by update()
+    Stats stats;
 
     // OpenGL handles
     GLuint vao;
     GLuint vbo_quad; // VBO for the quad's vertices
-    GLuint vbo_instanced_data; // VBO for the per-particle data (pos, size, color)
+    GLuint vbo_instanced_data; // VBO for the per-particle data (pos, size, tint, alpha, frame)
 
     // Shader uniform locations
     GLuint view_loc;
     GLuint projection_loc;
     GLuint texture_sampler_loc;
+    GLint stereo_half_separation_loc;
     GLuint shader_id;
     GLuint texture_id;
 };
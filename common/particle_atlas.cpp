@@ -0,0 +1,136 @@
+#include "particle_atlas.h"
+#include "stb_image.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <numeric>
+
+namespace {
+    // Texels of each frame's edge repeated around it
+    constexpr int BORDER = 4;
+
+    int nextPowerOfTwo(int value) {
+        int power = 1;
+        while (power < value) power *= 2;
+        return power;
+    }
+}
+
+ParticleAtlas::~ParticleAtlas() {
+    glDeleteTextures(1, &texture);
+}
+
+int ParticleAtlas::addSheet(const std::string &path, int columns, int rows) {
+    int width, height, channels;
+    unsigned char *data = stbi_load(path.c_str(), &width, &height, &channels, 4);
+    if (!data) {
+        std::cout << "ERROR::PARTICLE_ATLAS::SHEET_NOT_LOADED " << path << std::endl;
+        return -1;
+    }
+    const int sheet = addSheet(width, height, data, columns, rows);
+    stbi_image_free(data);
+    return sheet;
+}
+
+int ParticleAtlas::addSheet(int width, int height, const unsigned char *rgba, int columns, int rows) {
+    columns = std::max(columns, 1);
+    rows = std::max(rows, 1);
+    Sheet sheet;
+    sheet.firstFrame = static_cast<int>(frames.size());
+    sheet.frameCount = columns * rows;
+    const int frameWidth = width / columns, frameHeight = height / rows;
+    for (int row = 0; row < rows; row++) {
+        for (int column = 0; column < columns; column++) {
+            Frame frame;
+            frame.width = frameWidth;
+            frame.height = frameHeight;
+            frame.rgba.resize(static_cast<size_t>(frameWidth) * frameHeight * 4);
+            for (int y = 0; y < frameHeight; y++) {
+                const unsigned char *source =
+                        rgba + (static_cast<size_t>(row * frameHeight + y) * width + column * frameWidth) * 4;
+                std::copy(source, source + frameWidth * 4,
+                          frame.rgba.begin() + static_cast<size_t>(y) * frameWidth * 4);
+            }
+            frames.push_back(std::move(frame));
+        }
+    }
+    sheets.push_back(sheet);
+    return static_cast<int>(sheets.size()) - 1;
+}
+
+bool ParticleAtlas::build() {
+    if (frames.empty()) return false;
+    if (static_cast<int>(frames.size()) > MAX_FRAMES) {
+        std::cout << "ERROR::PARTICLE_ATLAS::TOO_MANY_FRAMES " << frames.size() << std::endl;
+        frames.resize(MAX_FRAMES);
+    }
+
+    // Shelf packing, tallest first, into a power-of-two width about the square root of the total area
+    std::vector<int> order(frames.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return frames[a].height > frames[b].height; });
+    long long area = 0;
+    int widest = 0;
+    for (const Frame &frame: frames) {
+        area += static_cast<long long>(frame.width + 2 * BORDER) * (frame.height + 2 * BORDER);
+        widest = std::max(widest, frame.width + 2 * BORDER);
+    }
+    const int width = nextPowerOfTwo(std::max(widest, static_cast<int>(std::sqrt(static_cast<double>(area)))));
+    int x = 0, shelfY = 0, shelfHeight = 0;
+    for (int index: order) {
+        Frame &frame = frames[index];
+        const int w = frame.width + 2 * BORDER, h = frame.height + 2 * BORDER;
+        if (x + w > width) {
+            shelfY += shelfHeight;
+            x = 0;
+            shelfHeight = 0;
+        }
+        frame.position = glm::ivec2(x + BORDER, shelfY + BORDER);
+        x += w;
+        shelfHeight = std::max(shelfHeight, h);
+    }
+    size = glm::ivec2(width, nextPowerOfTwo(shelfY + shelfHeight));
+
+    // Each frame and its border, clamped to its own edge texels
+    std::vector<unsigned char> pixels(static_cast<size_t>(size.x) * size.y * 4, 0);
+    rects.clear();
+    for (const Frame &frame: frames) {
+        for (int y = -BORDER; y < frame.height + BORDER; y++) {
+            const int sourceY = std::min(std::max(y, 0), frame.height - 1);
+            for (int x = -BORDER; x < frame.width + BORDER; x++) {
+                const int sourceX = std::min(std::max(x, 0), frame.width - 1);
+                const unsigned char *source = &frame.rgba[(static_cast<size_t>(sourceY) * frame.width + sourceX) * 4];
+                unsigned char *target = &pixels[(static_cast<size_t>(frame.position.y + y) * size.x +
+                                                 frame.position.x + x) * 4];
+                std::copy(source, source + 4, target);
+            }
+        }
+        rects.emplace_back(glm::vec2(frame.position) / glm::vec2(size),
+                           glm::vec2(frame.width, frame.height) / glm::vec2(size));
+    }
+
+    if (!texture) glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size.x, size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    // Past log2(BORDER) levels a texel would average across frames
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 2);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // The source pixels are in the texture now
+    for (Frame &frame: frames) std::vector<unsigned char>().swap(frame.rgba);
+    return true;
+}
+
+void ParticleAtlas::applyTo(GLuint program) const {
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "particleTexture"), 0);
+    if (!rects.empty()) {
+        glUniform4fv(glGetUniformLocation(program, "atlasFrames"), static_cast<GLsizei>(rects.size()),
+                     &rects[0].x);
+    }
+}
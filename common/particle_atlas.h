@@ -0,0 +1,73 @@
+#ifndef PARTICLE_ATLAS_H
+#define PARTICLE_ATLAS_H
+
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "glad.h"
+
+/*
+ * ParticleAtlas Class
+ * Packs the frames of several sprite sheets (smoke, dust, a leaf flipbook) into one texture, so particles of
+ * every emitter are drawn from a single texture bind, and ParticleSystem can keep all its emitters in one
+ * instanced draw. Each instance names its frame; particle.vert looks the frame's rectangle up in a uniform table
+ * and maps the quad's texture coordinates into it.
+ * Frames are placed on shelves, tallest first, each with a border of its own edge texels so bilinear filtering
+ * and the first mip levels do not pick up a neighbour.
+ */
+class ParticleAtlas {
+public:
+    // Size of particle.vert's atlasFrames array
+    static constexpr int MAX_FRAMES = 128;
+
+    // A sheet's frames are consecutive in the atlas
+    struct Sheet {
+        int firstFrame = 0;
+        int frameCount = 0;
+    };
+
+    ParticleAtlas() = default;
+
+    ~ParticleAtlas();
+
+    ParticleAtlas(const ParticleAtlas &) = delete;
+
+    ParticleAtlas &operator=(const ParticleAtlas &) = delete;
+
+    // A sprite sheet of columns x rows equal frames, numbered left to right from the first row of the image.
+    // Returns the sheet's index, or -1 when the image cannot be read
+    int addSheet(const std::string &path, int columns = 1, int rows = 1);
+
+    // The same from 8-bit RGBA pixels in memory
+    int addSheet(int width, int height, const unsigned char *rgba, int columns = 1, int rows = 1);
+
+    // Packs every frame added so far and uploads the atlas with mipmaps; frames past MAX_FRAMES are dropped
+    bool build();
+
+    const Sheet &getSheet(int index) const { return sheets[index]; }
+
+    GLuint getTexture() const { return texture; }
+
+    glm::ivec2 getSize() const { return size; }
+
+    int getFrameCount() const { return static_cast<int>(frames.size()); }
+
+    // Uploads the frame table to a particle shader program (uniform values stay with the program, so once per
+    // program and atlas) and points its particleTexture sampler at unit 0
+    void applyTo(GLuint program) const;
+
+private:
+    struct Frame {
+        int width = 0, height = 0;
+        std::vector<unsigned char> rgba;
+        glm::ivec2 position = glm::ivec2(0); // In the atlas, without the border
+    };
+
+    std::vector<Sheet> sheets;
+    std::vector<Frame> frames;
+    std::vector<glm::vec4> rects; // Per frame: .xy = texture coordinate offset, .zw = scale
+    glm::ivec2 size = glm::ivec2(0);
+    GLuint texture = 0;
+};
+
+#endif // PARTICLE_ATLAS_H
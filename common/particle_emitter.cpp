@@ -0,0 +1,154 @@
+#include "particle_emitter.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    uint32_t packTint(const glm::vec4 &tint) {
+        const glm::vec4 clamped = glm::clamp(tint, 0.0f, 1.0f) * 255.0f + 0.5f;
+        return static_cast<uint32_t>(clamped.r) | static_cast<uint32_t>(clamped.g) << 8 |
+               static_cast<uint32_t>(clamped.b) << 16 | static_cast<uint32_t>(clamped.a) << 24;
+    }
+}
+
+ParticleEmitter::ParticleEmitter(const Settings &settings, uint32_t seed)
+    : settings(settings), pool(settings.capacity), random(seed) {
+    stats.capacity = pool.capacity();
+}
+
+AABB ParticleEmitter::getBounds() const {
+    const glm::vec3 slowest = (settings.velocity - settings.velocityJitter) * settings.lifetime;
+    const glm::vec3 fastest = (settings.velocity + settings.velocityJitter) * settings.lifetime;
+    const glm::vec3 halfSize(std::max(settings.minSize, settings.maxSize) * 0.5f);
+    return {settings.position + glm::min(glm::min(slowest, fastest), glm::vec3(0.0f)) - halfSize,
+            settings.position + glm::max(glm::max(slowest, fastest), glm::vec3(0.0f)) + halfSize};
+}
+
+void ParticleEmitter::setLod(Lod newLod, float newDetail) {
+    lod = newLod;
+    detail = glm::clamp(newDetail, 0.01f, 1.0f);
+}
+
+int ParticleEmitter::reserve(int count) {
+    const int free = pool.capacity() - pool.size();
+    if (count <= free) return count;
+
+    int room = free;
+    switch (settings.overflow) {
+        case OverflowPolicy::Drop:
+            break;
+        case OverflowPolicy::StealOldest: {
+            // Never more than the pool holds: a burst bigger than the capacity still drops its excess
+            const int steal = std::min(count - free, pool.size());
+            pool.removeOldest(steal);
+            recycled_count += steal;
+            room += steal;
+            break;
+        }
+        case OverflowPolicy::Grow: {
+            const int limit = std::max(settings.maxCapacity > 0 ? settings.maxCapacity : settings.capacity * 16,
+                                       pool.capacity());
+            int capacity = pool.capacity();
+            while (capacity - pool.size() < count && capacity < limit) capacity = std::min(capacity * 2, limit);
+            if (capacity != pool.capacity()) pool.setCapacity(capacity);
+            room = capacity - pool.size();
+            break;
+        }
+    }
+    const int spawned = std::min(count, room);
+    dropped_count += count - spawned;
+    return spawned;
+}
+
+void ParticleEmitter::update(float deltaTime, const glm::vec3 &cameraPosition, bool sort) {
+    if (lod == Lod::Dormant) {
+        dormant_time += deltaTime;
+        instances.clear();
+        window_time += deltaTime;
+        return;
+    }
+    // Waking up: this step covers the skipped time too (already counted by the stats window)
+    const float frameTime = deltaTime;
+    deltaTime += dormant_time;
+    dormant_time = 0.0f;
+    // Anything emitted before this would be dead by the end of the step
+    const float firstAlive = deltaTime - settings.lifetime;
+
+    // Reduced detail: fewer particles, each covering the area of 1 / detail of them
+    const float rateScale = lod == Lod::Reduced ? detail : 1.0f;
+    const float sizeScale = 1.0f / std::sqrt(rateScale);
+    const float rate = settings.rate * rateScale;
+
+    // Emission times within this frame, in seconds after its start
+    emit_times.clear();
+    if (settings.enabled) {
+        const int burst = static_cast<int>(std::lround(static_cast<float>(pending_burst) * rateScale));
+        if (firstAlive <= 0.0f) emit_times.insert(emit_times.end(), static_cast<size_t>(burst), 0.0f);
+
+        if (settings.burstCount > 0 && settings.burstInterval > 0.0f) {
+            const int periodic = static_cast<int>(std::lround(static_cast<float>(settings.burstCount) * rateScale));
+            while (next_burst < deltaTime) {
+                if (next_burst >= firstAlive) {
+                    emit_times.insert(emit_times.end(), static_cast<size_t>(periodic), next_burst);
+                }
+                next_burst += settings.burstInterval;
+            }
+            next_burst -= deltaTime;
+        }
+
+        if (rate > 0.0f) {
+            // Particle k of this frame is due when the owed amount reaches k
+            const float owed = rate_accumulator + rate * deltaTime;
+            const int count = static_cast<int>(owed);
+            const int first = std::max(1, static_cast<int>(std::ceil(firstAlive * rate + rate_accumulator)));
+            for (int k = first; k <= count; k++) {
+                emit_times.push_back((static_cast<float>(k) - rate_accumulator) / rate);
+            }
+            rate_accumulator = owed - static_cast<float>(count);
+        }
+    }
+    pending_burst = 0;
+
+    // When the pool overflows, the latest emissions are the ones dropped
+    const int count = emit_times.empty() ? 0 : reserve(static_cast<int>(emit_times.size()));
+    if (count > 0) {
+        // The random values of every new particle in two bulk draws: the direction jitter, then the sizes
+        random_values.resize(static_cast<size_t>(count) * 4);
+        float *jitter = random_values.data();
+        float *sizes = jitter + static_cast<size_t>(count) * 3;
+        random.uniform(jitter, count * 3, -1.0f, 1.0f);
+        random.uniform(sizes, count, settings.minSize * sizeScale, settings.maxSize * sizeScale);
+        for (int i = 0; i < count; i++) {
+            const glm::vec3 offset(jitter[i * 3], jitter[i * 3 + 1], jitter[i * 3 + 2]);
+            const glm::vec3 velocity = settings.velocity + offset * settings.velocityJitter;
+            // Placed where the coming update() has it end the frame at its true age; born after the frame start,
+            // it starts "before" the emitter and with extra life
+            const float t = emit_times[i];
+            pool.spawn(settings.position - velocity * t, velocity, sizes[i], settings.lifetime,
+                       settings.lifetime + t);
+        }
+        spawned_count += count;
+    }
+
+    pool.update(deltaTime, cameraPosition);
+    if (lod == Lod::Hidden) {
+        instances.clear();
+    } else {
+        if (sort) pool.sortByDepth();
+        instances.resize(pool.size());
+        ParticleKernels::Appearance appearance;
+        appearance.tint = packTint(settings.tint);
+        appearance.firstFrame = static_cast<float>(settings.atlasFrame);
+        appearance.frameCount = static_cast<float>(std::max(settings.frameCount, 1));
+        pool.packInstances(instances.data(), appearance);
+    }
+
+    window_time += frameTime;
+    if (window_time >= 1.0f) {
+        stats.spawned = static_cast<float>(spawned_count) / window_time;
+        stats.dropped = static_cast<float>(dropped_count) / window_time;
+        stats.recycled = static_cast<float>(recycled_count) / window_time;
+        spawned_count = dropped_count = recycled_count = 0;
+        window_time = 0.0f;
+    }
+    stats.capacity = pool.capacity();
+}
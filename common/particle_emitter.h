@@ -0,0 +1,127 @@
+#ifndef PARTICLE_EMITTER_H
+#define PARTICLE_EMITTER_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "bounds.h"
+#include "particle_pool.h"
+#include "particle_simd.h"
+
+/*
+ * ParticleEmitter Class
+ * One source of particles (a chimney, the blades, a tree) with its own pool and its own random stream. An emitter
+ * only ever touches its own state, so different emitters can be updated on different threads at once; the
+ * random stream is seeded by the owner, so an emitter spawns the same particles whichever thread runs it.
+ * Never touches OpenGL.
+ */
+class ParticleEmitter {
+public:
+    // What happens to a new particle when the pool is full
+    enum class OverflowPolicy {
+        Drop,        // It is not spawned
+        StealOldest, // The live particles with the least life left make room for it
+        Grow         // The pool doubles, up to maxCapacity; beyond that the particle is dropped
+    };
+
+    struct Settings {
+        glm::vec3 position = glm::vec3(0.0f);
+        glm::vec3 velocity = glm::vec3(0.0f, 1.0f, 0.0f); // Shared by every particle
+        glm::vec3 velocityJitter = glm::vec3(0.0f);        // Per particle, uniform in [-jitter, jitter)
+        float minSize = 1.0f, maxSize = 1.0f;
+        glm::vec4 tint = glm::vec4(1.0f);                   // Multiplies the atlas frame's colour and alpha
+        int atlasFrame = 0;                                 // First flipbook frame, see ParticleAtlas
+        int frameCount = 1;                                 // Flipbook frames, played once over the lifetime
+        float lifetime = 1.0f;                              // Seconds
+        float rate = 60.0f;                                 // Particles per second, independent of the frame rate
+        int burstCount = 0;                                 // Particles per periodic burst
+        float burstInterval = 0.0f;                         // Seconds between bursts; 0: no periodic bursts
+        int capacity = 1000;
+        int maxCapacity = 0;                                // For OverflowPolicy::Grow; 0: 16 x capacity
+        OverflowPolicy overflow = OverflowPolicy::Drop;
+        bool enabled = true;                                // Disabled emitters spawn nothing; their particles live on
+    };
+
+    // Level of detail, chosen per frame by the owner (see ParticleSystem::LodSettings)
+    enum class Lod {
+        Full,
+        Reduced, // Fewer, larger particles: the rate times the detail, sizes over its square root
+        Hidden,  // Off-screen: simulated, but neither sorted nor packed
+        Dormant  // Off-screen: not even simulated; the skipped time is caught up when it wakes
+    };
+
+    // Particles per second, measured over the last full second
+    struct Stats {
+        float spawned = 0.0f;
+        float dropped = 0.0f;  // Not spawned: the pool was full
+        float recycled = 0.0f; // Live particles taken over by StealOldest
+        int capacity = 0;
+    };
+
+    ParticleEmitter(const Settings &settings, uint32_t seed);
+
+    void setPosition(const glm::vec3 &position) { settings.position = position; }
+
+    void setEnabled(bool enabled) { settings.enabled = enabled; }
+
+    void setOverflowPolicy(OverflowPolicy policy) { settings.overflow = policy; }
+
+    const Settings &getSettings() const { return settings; }
+
+    // Box every particle stays in, from the settings: the emitter swept by the extreme velocities over a lifetime,
+    // grown by the largest size. Particles emitted before the emitter last moved may lie outside it
+    AABB getBounds() const;
+
+    // "detail" in (0, 1] only matters for Lod::Reduced
+    void setLod(Lod newLod, float detail = 1.0f);
+
+    Lod getLod() const { return lod; }
+
+    float getDetail() const { return lod == Lod::Reduced ? detail : 1.0f; }
+
+    // Emits "count" particles at the start of the next update(), on top of the rate
+    void burst(int count) { pending_burst += count; }
+
+    // Spawns, simulates, depth-sorts and packs this frame's instances (back to front; with "sort" false they stay
+    // in pool order, for order-independent blending).
+    // Particles due within the frame are spawned at their exact emission time: one emitted halfway through the
+    // frame ends it half a frame old, so the spacing of a stream does not depend on the frame rate.
+    // A Dormant emitter only adds deltaTime to its debt. The first update after it wakes covers the whole debt in
+    // one step, which is exact since particles move at constant velocity: the existing ones are moved and aged by
+    // it, and only the emissions of its last lifetime, the ones still alive at its end, are spawned
+    void update(float deltaTime, const glm::vec3 &cameraPosition, bool sort = true);
+
+    const ParticlePool &getPool() const { return pool; }
+
+    const Stats &getStats() const { return stats; }
+
+    // This frame's instances and their sort keys, both in back-to-front order when sorted
+    const std::vector<ParticleInstanceData> &getInstances() const { return instances; }
+    const uint32_t *getSortKeys() const { return pool.sortKeys(); }
+
+private:
+    // Makes room for "count" new particles as the overflow policy says; returns how many can be spawned
+    int reserve(int count);
+
+    Settings settings;
+    ParticlePool pool;
+    ParticleRandom random;
+    float rate_accumulator = 0.0f; // Fraction of a particle owed by the rate, in [0, 1)
+    float next_burst = 0.0f;       // Seconds until the next periodic burst
+    int pending_burst = 0;
+    Lod lod = Lod::Full;
+    float detail = 1.0f;
+    float dormant_time = 0.0f; // Seconds skipped while Dormant
+    std::vector<float> emit_times; // This frame's emissions, seconds after its start
+    std::vector<float> random_values; // Scratch for spawning
+
+    // Counters of the current one-second window
+    int spawned_count = 0, dropped_count = 0, recycled_count = 0;
+    float window_time = 0.0f;
+    Stats stats;
+
+    std::vector<ParticleInstanceData> instances;
+};
+
+#endif // PARTICLE_EMITTER_H
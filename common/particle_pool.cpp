@@ -0,0 +1,317 @@
+#include "particle_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <random>
+
+namespace {
+    constexpr int RADIX_BITS = 11;
+    constexpr int RADIX_BUCKETS = 1 << RADIX_BITS;
+    constexpr int RADIX_PASSES = 3; // 33 bits cover the 32-bit keys
+
+    float elapsedMs(std::chrono::high_resolution_clock::time_point start) {
+        return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+}
+
+ParticlePool::ParticlePool(int capacity) {
+    setCapacity(capacity);
+}
+
+void ParticlePool::setCapacity(int capacity) {
+    max_particles = std::max(capacity, 0);
+    count = std::min(count, max_particles);
+    for (std::vector<float> *array: {&pos_x, &pos_y, &pos_z, &speed_x, &speed_y, &speed_z, &sizes, &life,
+                                     &inv_lifetime, &float_scratch}) {
+        array->resize(max_particles);
+    }
+    for (std::vector<uint32_t> *array: {&keys, &keys_scratch, &order, &order_scratch}) {
+        array->resize(max_particles);
+    }
+}
+
+bool ParticlePool::spawn(const glm::vec3 &position, const glm::vec3 &speed, float size, float lifetime,
+                         float lifeLeft) {
+    if (count == max_particles || lifetime <= 0.0f || lifeLeft <= 0.0f) return false;
+    const int i = count++;
+    pos_x[i] = position.x;
+    pos_y[i] = position.y;
+    pos_z[i] = position.z;
+    speed_x[i] = speed.x;
+    speed_y[i] = speed.y;
+    speed_z[i] = speed.z;
+    sizes[i] = size;
+    life[i] = lifeLeft;
+    inv_lifetime[i] = 1.0f / lifetime;
+    return true;
+}
+
+void ParticlePool::removeOldest(int n) {
+    n = std::min(n, count);
+    if (n <= 0) return;
+    if (n == count) {
+        count = 0;
+        return;
+    }
+    // (life, index) pairs; the first n after the selection are the oldest
+    std::vector<std::pair<float, int> > byLife(count);
+    for (int i = 0; i < count; i++) byLife[i] = {life[i], i};
+    std::nth_element(byLife.begin(), byLife.begin() + (n - 1), byLife.end());
+    std::vector<int> victims(n);
+    for (int i = 0; i < n; i++) victims[i] = byLife[i].second;
+    // Highest index first: the particle swapped into a freed slot is never one still to be removed
+    std::sort(victims.begin(), victims.end(), std::greater<int>());
+    for (const int index: victims) removeAt(index);
+}
+
+void ParticlePool::removeAt(int index) {
+    const int last = --count;
+    pos_x[index] = pos_x[last];
+    pos_y[index] = pos_y[last];
+    pos_z[index] = pos_z[last];
+    speed_x[index] = speed_x[last];
+    speed_y[index] = speed_y[last];
+    speed_z[index] = speed_z[last];
+    sizes[index] = sizes[last];
+    life[index] = life[last];
+    inv_lifetime[index] = inv_lifetime[last];
+    keys[index] = keys[last];
+}
+
+ParticleKernels::Streams ParticlePool::streams() {
+    return {pos_x.data(), pos_y.data(), pos_z.data(), speed_x.data(), speed_y.data(), speed_z.data(), sizes.data(),
+            life.data(), inv_lifetime.data(), keys.data()};
+}
+
+void ParticlePool::update(float deltaTime, const glm::vec3 &cameraPosition) {
+    const auto start = std::chrono::high_resolution_clock::now();
+    ParticleKernels::integrate(streams(), count, deltaTime, cameraPosition.x, cameraPosition.y, cameraPosition.z);
+    // Backwards, so the particle swapped into a freed slot has already been checked
+    for (int i = count - 1; i >= 0; i--) {
+        if (keys[i] == ParticleKernels::DEAD_KEY) removeAt(i);
+    }
+    stats.alive = count;
+    stats.updateMs = elapsedMs(start);
+}
+
+void ParticlePool::sortByDepth() {
+    const auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < count; i++) {
+        order[i] = static_cast<uint32_t>(i);
+    }
+
+    // One read of the keys builds the histograms of all three digits
+    histograms.assign(RADIX_PASSES * RADIX_BUCKETS, 0);
+    for (int i = 0; i < count; i++) {
+        for (int pass = 0; pass < RADIX_PASSES; pass++) {
+            histograms[pass * RADIX_BUCKETS + (keys[i] >> (pass * RADIX_BITS) & (RADIX_BUCKETS - 1))]++;
+        }
+    }
+
+    bool moved = false;
+    for (int pass = 0; pass < RADIX_PASSES; pass++) {
+        uint32_t *histogram = &histograms[pass * RADIX_BUCKETS];
+        const int shift = pass * RADIX_BITS;
+        // Every key has the same digit: the pass would not move anything (typical for the top bits, where
+        // the particles share an exponent)
+        if (count == 0 || histogram[keys[0] >> shift & (RADIX_BUCKETS - 1)] == static_cast<uint32_t>(count)) {
+            continue;
+        }
+        uint32_t offset = 0;
+        for (int bucket = 0; bucket < RADIX_BUCKETS; bucket++) {
+            const uint32_t bucketSize = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += bucketSize;
+        }
+        for (int i = 0; i < count; i++) {
+            const uint32_t destination = histogram[keys[i] >> shift & (RADIX_BUCKETS - 1)]++;
+            keys_scratch[destination] = keys[i];
+            order_scratch[destination] = order[i];
+        }
+        keys.swap(keys_scratch);
+        order.swap(order_scratch);
+        moved = true;
+    }
+
+    // The arrays are put into depth order, so packing reads them front to back. The order persists into the
+    // next frame (only swap-removes and new particles disturb it), so after the first frame this gather is close
+    // to a sequential copy
+    if (moved) {
+        for (std::vector<float> *array: {&pos_x, &pos_y, &pos_z, &speed_x, &speed_y, &speed_z, &sizes, &life,
+                                         &inv_lifetime}) {
+            std::vector<float> &values = *array;
+            for (int n = 0; n < count; n++) {
+                float_scratch[n] = values[order[n]];
+            }
+            values.swap(float_scratch);
+        }
+    }
+    stats.sortMs = elapsedMs(start);
+}
+
+int ParticlePool::packInstances(ParticleInstanceData *out, const ParticleKernels::Appearance &appearance) {
+    const auto start = std::chrono::high_resolution_clock::now();
+    ParticleKernels::pack(streams(), count, appearance, out);
+    stats.packMs = elapsedMs(start);
+    return count;
+}
+
+// === Benchmark ===
+namespace {
+    // The pool this class replaced: one struct per slot, a linear search for free slots, std::sort over every
+    // slot each frame and a rescan of every slot to pack
+    struct LegacyParticle {
+        glm::vec3 pos, speed;
+        glm::vec4 color;
+        float size;
+        float life;
+        float cameraDistance;
+
+        bool operator<(const LegacyParticle &that) const { return cameraDistance > that.cameraDistance; }
+    };
+
+    struct LegacyPool {
+        std::vector<LegacyParticle> particles;
+        int last_used = 0;
+
+        explicit LegacyPool(int capacity) : particles(capacity) {
+            for (auto &p: particles) p.life = -1.0f;
+        }
+
+        int findUnused() {
+            const int size = static_cast<int>(particles.size());
+            for (int i = last_used; i < size; i++) {
+                if (particles[i].life < 0) return last_used = i;
+            }
+            for (int i = 0; i < last_used; i++) {
+                if (particles[i].life < 0) return last_used = i;
+            }
+            return 0;
+        }
+
+        void update(float deltaTime, const glm::vec3 &cameraPosition) {
+            for (auto &p: particles) {
+                if (p.life > 0.0f) {
+                    p.life -= deltaTime;
+                    if (p.life > 0.0f) {
+                        p.pos += p.speed * deltaTime;
+                        const glm::vec3 toCamera = p.pos - cameraPosition;
+                        p.cameraDistance = glm::dot(toCamera, toCamera);
+                        p.color.a = p.life / 2.0f;
+                    } else {
+                        p.cameraDistance = -1.0f;
+                    }
+                }
+            }
+        }
+
+        int pack(ParticleInstanceData *out) const {
+            int n = 0;
+            for (const auto &p: particles) {
+                if (p.life > 0.0f) out[n++] = {glm::vec4(p.pos, p.size), 0xFFFFFFFFu, p.color.a, 0.0f, 0.0f};
+            }
+            return n;
+        }
+    };
+}
+
+void ParticlePool::runBenchmark() {
+    constexpr float LIFETIME = 2.0f;
+    constexpr float DELTA_TIME = 1.0f / 60.0f;
+    constexpr int WARMUP_FRAMES = 2;
+    constexpr int FRAMES = 10;
+    const glm::vec3 cameraPosition(0.0f, 6.5f, 20.0f);
+    using Clock = std::chrono::high_resolution_clock;
+
+    std::printf("Particle benchmark (%d frames at 60 Hz, lifetime %.0f s, ms per frame):\n", FRAMES, LIFETIME);
+    std::printf("%9s | %26s | %26s\n", "", "array of structs + std::sort", "SoA + radix sort");
+    std::printf("%9s | %8s %8s %8s | %8s %8s %8s\n", "particles", "update", "sort", "pack", "update", "sort", "pack");
+    for (const int particleCount: {5000, 100000, 1000000}) {
+        // Steady state: the pool is full and as many particles are born each frame as die
+        const int spawnsPerFrame = std::max(1, static_cast<int>(particleCount * DELTA_TIME / LIFETIME));
+        std::mt19937 random(1234u);
+        std::uniform_real_distribution<float> jitter(-0.3f, 0.3f), age(0.0f, LIFETIME);
+        auto randomSpeed = [&]() { return glm::vec3(jitter(random), 4.0f + jitter(random), jitter(random)); };
+        const glm::vec3 emitter(-10.0f, 15.0f, -30.0f);
+
+        std::vector<ParticleInstanceData> instances(particleCount);
+        LegacyPool legacy(particleCount);
+        ParticlePool pool(particleCount);
+        for (int i = 0; i < particleCount; i++) {
+            const glm::vec3 speed = randomSpeed();
+            const float lifeLeft = LIFETIME - age(random);
+            const glm::vec3 position = emitter + speed * (LIFETIME - lifeLeft);
+            legacy.particles[i] = {position, speed, glm::vec4(1.0f), 1.7f, lifeLeft, 0.0f};
+            pool.spawn(position, speed, 1.7f, lifeLeft);
+        }
+
+        double legacyMs[3] = {0.0, 0.0, 0.0}, poolMs[3] = {0.0, 0.0, 0.0};
+        for (int frame = 0; frame < WARMUP_FRAMES + FRAMES; frame++) {
+            const bool measured = frame >= WARMUP_FRAMES;
+
+            auto start = Clock::now();
+            for (int i = 0; i < spawnsPerFrame; i++) {
+                LegacyParticle &p = legacy.particles[legacy.findUnused()];
+                p = {emitter, randomSpeed(), glm::vec4(1.0f), 1.7f, LIFETIME, 0.0f};
+            }
+            legacy.update(DELTA_TIME, cameraPosition);
+            if (measured) legacyMs[0] += elapsedMs(start);
+            start = Clock::now();
+            std::sort(legacy.particles.begin(), legacy.particles.end());
+            if (measured) legacyMs[1] += elapsedMs(start);
+            start = Clock::now();
+            legacy.pack(instances.data());
+            if (measured) legacyMs[2] += elapsedMs(start);
+
+            start = Clock::now();
+            for (int i = 0; i < spawnsPerFrame; i++) pool.spawn(emitter, randomSpeed(), 1.7f, LIFETIME);
+            pool.update(DELTA_TIME, cameraPosition);
+            if (measured) poolMs[0] += elapsedMs(start);
+            pool.sortByDepth();
+            pool.packInstances(instances.data());
+            if (measured) {
+                poolMs[1] += pool.getStats().sortMs;
+                poolMs[2] += pool.getStats().packMs;
+            }
+        }
+        std::printf("%9d | %8.3f %8.3f %8.3f | %8.3f %8.3f %8.3f\n", particleCount, legacyMs[0] / FRAMES,
+                    legacyMs[1] / FRAMES, legacyMs[2] / FRAMES, poolMs[0] / FRAMES, poolMs[1] / FRAMES,
+                    poolMs[2] / FRAMES);
+    }
+
+    // Kernels alone over live particles (never dying within the run), at every level this CPU has: 16k fit in
+    // the cache, 1M measure the memory bandwidth
+    const ParticleKernels::Level activeLevel = ParticleKernels::getLevel();
+    std::printf("Particle kernels (particles per ns):\n");
+    for (const int particleCount: {16384, 1000000}) {
+        const int runs = std::max(20, 100000000 / particleCount);
+        ParticlePool pool(particleCount);
+        ParticleRandom random(1234u);
+        std::vector<float> jitter(particleCount * 3);
+        random.uniform(jitter.data(), static_cast<int>(jitter.size()), -0.3f, 0.3f);
+        for (int i = 0; i < particleCount; i++) {
+            pool.spawn(glm::vec3(-10.0f, 15.0f, -30.0f),
+                       glm::vec3(jitter[i * 3], 4.0f + jitter[i * 3 + 1], jitter[i * 3 + 2]), 1.7f, 1.0e6f);
+        }
+        std::vector<ParticleInstanceData> instances(particleCount);
+        for (int level = 0; level <= static_cast<int>(ParticleKernels::bestLevel()); level++) {
+            ParticleKernels::setLevel(static_cast<ParticleKernels::Level>(level));
+            double integrateMs = 0.0, packMs = 0.0;
+            for (int run = 0; run < runs; run++) {
+                auto start = Clock::now();
+                ParticleKernels::integrate(pool.streams(), pool.count, DELTA_TIME, cameraPosition.x,
+                                           cameraPosition.y, cameraPosition.z);
+                integrateMs += elapsedMs(start);
+                start = Clock::now();
+                ParticleKernels::pack(pool.streams(), pool.count, ParticleKernels::Appearance(), instances.data());
+                packMs += elapsedMs(start);
+            }
+            const double particles = static_cast<double>(particleCount) * runs;
+            std::printf("%9d %6s: integrate %.3f, pack %.3f\n", particleCount,
+                        ParticleKernels::levelName(static_cast<ParticleKernels::Level>(level)),
+                        particles / (integrateMs * 1.0e6), particles / (packMs * 1.0e6));
+        }
+    }
+    ParticleKernels::setLevel(activeLevel);
+}
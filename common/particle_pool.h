@@ -0,0 +1,111 @@
+#ifndef PARTICLE_POOL_H
+#define PARTICLE_POOL_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "particle_simd.h"
+
+// Data structure for instanced rendering, matches the attributes particle.vert reads (32 bytes per particle)
+struct ParticleInstanceData {
+    glm::vec4 posAndSize; // .xyz = position, .w = size
+    uint32_t tint;        // RGBA8, red in the lowest byte; multiplies the atlas frame's texels
+    float alpha;          // Fade over the lifetime
+    float frame;          // Atlas frame, see ParticleAtlas
+    float unused;
+};
+
+/*
+ * ParticlePool Class
+ * CPU particle state as a structure of arrays. The live particles always occupy the dense range [0, size()):
+ * spawning appends, and a particle whose life runs out is swap-removed (the last live particle moves into its
+ * slot), so no pass ever visits a dead particle and finding a free slot is O(1): the range past size() is the
+ * free list.
+ * The per-particle loops are ParticleKernels' SIMD kernels: update() ages, moves and computes the sort keys in one
+ * pass, and packInstances() fades and interleaves the instance stream four or eight particles at a time.
+ * Depth sorting only covers the live range: squared camera distances are turned into unsigned keys and sorted
+ * with a stable LSD radix sort (three 11-bit digits, passes whose digit is the same for every key are skipped).
+ * The arrays are then reordered to match, so the instance stream is packed with sequential reads; since that order
+ * carries over to the next frame, the radix scatters and the reordering stay close to sequential as well.
+ * Never touches OpenGL, so it can be used (and benchmarked) without a GL context.
+ */
+class ParticlePool {
+public:
+    struct Stats {
+        int alive = 0;
+        float updateMs = 0.0f;
+        float sortMs = 0.0f;
+        float packMs = 0.0f;
+    };
+
+    explicit ParticlePool(int capacity);
+
+    // Returns false when the pool is full and the particle was not spawned. "lifeLeft" may exceed "lifetime" for a
+    // particle that is born later within the coming update() (the fade always uses lifetime)
+    bool spawn(const glm::vec3 &position, const glm::vec3 &speed, float size, float lifetime, float lifeLeft);
+
+    bool spawn(const glm::vec3 &position, const glm::vec3 &speed, float size, float lifetime) {
+        return spawn(position, speed, size, lifetime, lifetime);
+    }
+
+    // Removes the "n" live particles with the least life left (one partial selection over the live range)
+    void removeOldest(int n);
+
+    // Grows (or shrinks, dropping particles past the new capacity) every array
+    void setCapacity(int capacity);
+
+    // Ages every live particle, moves it and computes its depth key for cameraPosition, then removes those that
+    // died
+    void update(float deltaTime, const glm::vec3 &cameraPosition);
+
+    // Orders the live particles back to front, by the keys of the last update()
+    void sortByDepth();
+
+    // Writes the live particles in their current order, back to front after sortByDepth(); alpha fades with the
+    // remaining life. Returns the count
+    int packInstances(ParticleInstanceData *out,
+                      const ParticleKernels::Appearance &appearance = ParticleKernels::Appearance());
+
+    void clear() { count = 0; }
+
+    // Depth keys of the live particles in their current order; after sortByDepth(), ascending (back to front)
+    const uint32_t *sortKeys() const { return keys.data(); }
+
+    int size() const { return count; }
+    int capacity() const { return max_particles; }
+
+    const Stats &getStats() const { return stats; }
+
+    // Times update, sort and pack at 5k, 100k and 1M particles against the previous array-of-structs pool
+    // (std::sort over every slot, dead ones included), then the kernels alone at every SIMD level in particles
+    // per nanosecond, and prints the results
+    static void runBenchmark();
+
+private:
+    void removeAt(int index);
+
+    ParticleKernels::Streams streams();
+
+    int max_particles;
+    int count = 0;
+
+    // Per particle, indexed [0, count)
+    std::vector<float> pos_x, pos_y, pos_z;
+    std::vector<float> speed_x, speed_y, speed_z;
+    std::vector<float> sizes;
+    std::vector<float> life;
+    std::vector<float> inv_lifetime; // 1 / starting life, for the fade
+
+    std::vector<uint32_t> keys; // Depth sort keys, ParticleKernels::DEAD_KEY for dead particles
+
+    // Sort state: keys and indices, ping-ponged between the radix passes
+    std::vector<uint32_t> keys_scratch;
+    std::vector<uint32_t> order, order_scratch;
+    std::vector<uint32_t> histograms; // Per pass
+    std::vector<float> float_scratch; // For reordering the particle arrays
+
+    Stats stats;
+};
+
+#endif // PARTICLE_POOL_H
@@ -0,0 +1,318 @@
+#include "particle_simd.h"
+#include "particle_pool.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define PARTICLE_USE_SSE 1
+#endif
+
+// AVX2 kernels are compiled with a per-function target, so the rest of the build keeps its baseline flags
+#if defined(PARTICLE_USE_SSE) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define PARTICLE_USE_AVX2 1
+#define PARTICLE_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+// === ParticleRandom ===
+namespace {
+    uint32_t xorshift(uint32_t x) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        return x;
+    }
+
+    // 24 random bits to [0, 1); exact in float, so the SSE conversion matches
+    float toUnit(uint32_t x) {
+        return static_cast<float>(static_cast<int>(x >> 8)) * (1.0f / 16777216.0f);
+    }
+}
+
+ParticleRandom::ParticleRandom(uint32_t seed) {
+    // splitmix32 spreads nearby seeds over the lanes' states; xorshift needs them non-zero
+    for (uint32_t &lane: lanes) {
+        seed += 0x9E3779B9u;
+        uint32_t z = seed;
+        z = (z ^ z >> 16) * 0x85EBCA6Bu;
+        z = (z ^ z >> 13) * 0xC2B2AE35u;
+        z ^= z >> 16;
+        lane = z != 0 ? z : 0x6D2B79F5u;
+    }
+}
+
+float ParticleRandom::uniform(float min, float max) {
+    uint32_t &lane = lanes[next_lane];
+    lane = xorshift(lane);
+    next_lane = (next_lane + 1) & 3;
+    return min + toUnit(lane) * (max - min);
+}
+
+void ParticleRandom::uniform(float *out, int count, float min, float max) {
+    int i = 0;
+    // Draw single values until lane 0 is next, then whole rounds of four
+    for (; i < count && next_lane != 0; i++) out[i] = uniform(min, max);
+#ifdef PARTICLE_USE_SSE
+    if (count - i >= 4) {
+        __m128i state = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lanes));
+        const __m128 scale = _mm_set1_ps(1.0f / 16777216.0f);
+        const __m128 minimum = _mm_set1_ps(min), range = _mm_set1_ps(max - min);
+        for (; i + 4 <= count; i += 4) {
+            state = _mm_xor_si128(state, _mm_slli_epi32(state, 13));
+            state = _mm_xor_si128(state, _mm_srli_epi32(state, 17));
+            state = _mm_xor_si128(state, _mm_slli_epi32(state, 5));
+            const __m128 unit = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(state, 8)), scale);
+            _mm_storeu_ps(out + i, _mm_add_ps(minimum, _mm_mul_ps(unit, range)));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), state);
+    }
+#endif
+    for (; i < count; i++) out[i] = uniform(min, max);
+}
+
+// === Kernels ===
+namespace {
+    using ParticleKernels::Streams;
+
+    uint32_t depthKey(float squaredDistance) {
+        uint32_t bits;
+        std::memcpy(&bits, &squaredDistance, sizeof(bits));
+        // Squared distances are never negative, so their bits order like unsigned integers; inverting them sorts
+        // far particles first. The low bit is dropped so that no live particle gets DEAD_KEY
+        return ~(bits | 1u);
+    }
+
+    void integrateScalar(const Streams &s, int begin, int end, float dt, float cx, float cy, float cz) {
+        for (int i = begin; i < end; i++) {
+            s.life[i] -= dt;
+            s.posX[i] += s.speedX[i] * dt;
+            s.posY[i] += s.speedY[i] * dt;
+            s.posZ[i] += s.speedZ[i] * dt;
+            const float dx = s.posX[i] - cx, dy = s.posY[i] - cy, dz = s.posZ[i] - cz;
+            s.keys[i] = s.life[i] > 0.0f ? depthKey(dx * dx + dy * dy + dz * dz) : ParticleKernels::DEAD_KEY;
+        }
+    }
+
+    void packScalar(const Streams &s, int begin, int end, const ParticleKernels::Appearance &look,
+                    ParticleInstanceData *out) {
+        const float lastStep = look.frameCount - 1.0f;
+        for (int i = begin; i < end; i++) {
+            const float alpha = s.life[i] * s.invLifetime[i];
+            const float step = std::min((1.0f - alpha) * look.frameCount, lastStep);
+            out[i].posAndSize = glm::vec4(s.posX[i], s.posY[i], s.posZ[i], s.size[i]);
+            out[i].tint = look.tint;
+            out[i].alpha = alpha;
+            out[i].frame = static_cast<float>(static_cast<int>(step)) + look.firstFrame;
+            out[i].unused = 0.0f;
+        }
+    }
+
+#ifdef PARTICLE_USE_SSE
+    int integrateSSE(const Streams &s, int count, float dt, float cx, float cy, float cz) {
+        const __m128 delta = _mm_set1_ps(dt), zero = _mm_setzero_ps();
+        const __m128 camX = _mm_set1_ps(cx), camY = _mm_set1_ps(cy), camZ = _mm_set1_ps(cz);
+        const __m128i lowBit = _mm_set1_epi32(1), allOnes = _mm_set1_epi32(-1);
+        int i = 0;
+        for (; i + 4 <= count; i += 4) {
+            const __m128 life = _mm_sub_ps(_mm_loadu_ps(s.life + i), delta);
+            const __m128 x = _mm_add_ps(_mm_loadu_ps(s.posX + i), _mm_mul_ps(_mm_loadu_ps(s.speedX + i), delta));
+            const __m128 y = _mm_add_ps(_mm_loadu_ps(s.posY + i), _mm_mul_ps(_mm_loadu_ps(s.speedY + i), delta));
+            const __m128 z = _mm_add_ps(_mm_loadu_ps(s.posZ + i), _mm_mul_ps(_mm_loadu_ps(s.speedZ + i), delta));
+            _mm_storeu_ps(s.life + i, life);
+            _mm_storeu_ps(s.posX + i, x);
+            _mm_storeu_ps(s.posY + i, y);
+            _mm_storeu_ps(s.posZ + i, z);
+
+            const __m128 dx = _mm_sub_ps(x, camX), dy = _mm_sub_ps(y, camY), dz = _mm_sub_ps(z, camZ);
+            const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)),
+                                               _mm_mul_ps(dz, dz));
+            // Dead lanes (life <= 0) become all ones, live ones ~(bits | 1)
+            const __m128i alive = _mm_castps_si128(_mm_cmpgt_ps(life, zero));
+            const __m128i key = _mm_xor_si128(_mm_or_si128(_mm_castps_si128(distance), lowBit), allOnes);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(s.keys + i),
+                             _mm_or_si128(_mm_and_si128(alive, key), _mm_andnot_si128(alive, allOnes)));
+        }
+        return i;
+    }
+
+    int packSSE(const Streams &s, int count, const ParticleKernels::Appearance &look, ParticleInstanceData *out) {
+        const __m128 one = _mm_set1_ps(1.0f), zero = _mm_setzero_ps();
+        const __m128 tint = _mm_castsi128_ps(_mm_set1_epi32(static_cast<int>(look.tint)));
+        const __m128 frameCount = _mm_set1_ps(look.frameCount), lastStep = _mm_set1_ps(look.frameCount - 1.0f);
+        const __m128 firstFrame = _mm_set1_ps(look.firstFrame);
+        float *destination = reinterpret_cast<float *>(out);
+        int i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m128 x = _mm_loadu_ps(s.posX + i), y = _mm_loadu_ps(s.posY + i);
+            __m128 z = _mm_loadu_ps(s.posZ + i), size = _mm_loadu_ps(s.size + i);
+            __m128 alpha = _mm_mul_ps(_mm_loadu_ps(s.life + i), _mm_loadu_ps(s.invLifetime + i));
+            // Truncation is rounding down: the step is never negative
+            const __m128 step = _mm_min_ps(_mm_mul_ps(_mm_sub_ps(one, alpha), frameCount), lastStep);
+            __m128 frame = _mm_add_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(step)), firstFrame);
+            __m128 red = tint, unused = zero;
+            // Rows become particles: (x, y, z, size) and (tint, alpha, frame, 0)
+            _MM_TRANSPOSE4_PS(x, y, z, size);
+            _MM_TRANSPOSE4_PS(red, alpha, frame, unused);
+            float *instance = destination + static_cast<size_t>(i) * 8;
+            _mm_storeu_ps(instance, x);
+            _mm_storeu_ps(instance + 4, red);
+            _mm_storeu_ps(instance + 8, y);
+            _mm_storeu_ps(instance + 12, alpha);
+            _mm_storeu_ps(instance + 16, z);
+            _mm_storeu_ps(instance + 20, frame);
+            _mm_storeu_ps(instance + 24, size);
+            _mm_storeu_ps(instance + 28, unused);
+        }
+        return i;
+    }
+#endif
+
+#ifdef PARTICLE_USE_AVX2
+    PARTICLE_AVX2_TARGET int integrateAVX2(const Streams &s, int count, float dt, float cx, float cy, float cz) {
+        const __m256 delta = _mm256_set1_ps(dt), zero = _mm256_setzero_ps();
+        const __m256 camX = _mm256_set1_ps(cx), camY = _mm256_set1_ps(cy), camZ = _mm256_set1_ps(cz);
+        const __m256i lowBit = _mm256_set1_epi32(1), allOnes = _mm256_set1_epi32(-1);
+        int i = 0;
+        for (; i + 8 <= count; i += 8) {
+            const __m256 life = _mm256_sub_ps(_mm256_loadu_ps(s.life + i), delta);
+            const __m256 x = _mm256_add_ps(_mm256_loadu_ps(s.posX + i),
+                                           _mm256_mul_ps(_mm256_loadu_ps(s.speedX + i), delta));
+            const __m256 y = _mm256_add_ps(_mm256_loadu_ps(s.posY + i),
+                                           _mm256_mul_ps(_mm256_loadu_ps(s.speedY + i), delta));
+            const __m256 z = _mm256_add_ps(_mm256_loadu_ps(s.posZ + i),
+                                           _mm256_mul_ps(_mm256_loadu_ps(s.speedZ + i), delta));
+            _mm256_storeu_ps(s.life + i, life);
+            _mm256_storeu_ps(s.posX + i, x);
+            _mm256_storeu_ps(s.posY + i, y);
+            _mm256_storeu_ps(s.posZ + i, z);
+
+            const __m256 dx = _mm256_sub_ps(x, camX), dy = _mm256_sub_ps(y, camY), dz = _mm256_sub_ps(z, camZ);
+            const __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)),
+                                                  _mm256_mul_ps(dz, dz));
+            const __m256i alive = _mm256_castps_si256(_mm256_cmp_ps(life, zero, _CMP_GT_OQ));
+            const __m256i key = _mm256_xor_si256(_mm256_or_si256(_mm256_castps_si256(distance), lowBit), allOnes);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(s.keys + i),
+                                _mm256_or_si256(_mm256_and_si256(alive, key), _mm256_andnot_si256(alive, allOnes)));
+        }
+        return i;
+    }
+
+    PARTICLE_AVX2_TARGET int packAVX2(const Streams &s, int count, const ParticleKernels::Appearance &look,
+                                      ParticleInstanceData *out) {
+        const __m256 one = _mm256_set1_ps(1.0f), zero = _mm256_setzero_ps();
+        const __m256 tint = _mm256_castsi256_ps(_mm256_set1_epi32(static_cast<int>(look.tint)));
+        const __m256 frameCount = _mm256_set1_ps(look.frameCount);
+        const __m256 lastStep = _mm256_set1_ps(look.frameCount - 1.0f), firstFrame = _mm256_set1_ps(look.firstFrame);
+        float *destination = reinterpret_cast<float *>(out);
+        int i = 0;
+        for (; i + 8 <= count; i += 8) {
+            const __m256 x = _mm256_loadu_ps(s.posX + i), y = _mm256_loadu_ps(s.posY + i);
+            const __m256 z = _mm256_loadu_ps(s.posZ + i), size = _mm256_loadu_ps(s.size + i);
+            const __m256 alpha = _mm256_mul_ps(_mm256_loadu_ps(s.life + i), _mm256_loadu_ps(s.invLifetime + i));
+            const __m256 step = _mm256_min_ps(_mm256_mul_ps(_mm256_sub_ps(one, alpha), frameCount), lastStep);
+            const __m256 frame = _mm256_add_ps(_mm256_cvtepi32_ps(_mm256_cvttps_epi32(step)), firstFrame);
+            // In-lane 4x4 transposes: p0 holds particles 0 and 4 as (x, y, z, size), p1 particles 1 and 5, ...
+            const __m256 xy0 = _mm256_unpacklo_ps(x, y), xy1 = _mm256_unpackhi_ps(x, y);
+            const __m256 zs0 = _mm256_unpacklo_ps(z, size), zs1 = _mm256_unpackhi_ps(z, size);
+            const __m256 p0 = _mm256_shuffle_ps(xy0, zs0, 0x44), p1 = _mm256_shuffle_ps(xy0, zs0, 0xEE);
+            const __m256 p2 = _mm256_shuffle_ps(xy1, zs1, 0x44), p3 = _mm256_shuffle_ps(xy1, zs1, 0xEE);
+            // The second halves the same way: (tint, alpha, frame, 0)
+            const __m256 ta0 = _mm256_unpacklo_ps(tint, alpha), ta1 = _mm256_unpackhi_ps(tint, alpha);
+            const __m256 fu0 = _mm256_unpacklo_ps(frame, zero), fu1 = _mm256_unpackhi_ps(frame, zero);
+            const __m256 c0 = _mm256_shuffle_ps(ta0, fu0, 0x44), c1 = _mm256_shuffle_ps(ta0, fu0, 0xEE);
+            const __m256 c2 = _mm256_shuffle_ps(ta1, fu1, 0x44), c3 = _mm256_shuffle_ps(ta1, fu1, 0xEE);
+            // Each instance is 32 bytes: the low halves make particles 0-3, the high halves 4-7
+            float *instance = destination + static_cast<size_t>(i) * 8;
+            _mm256_storeu_ps(instance, _mm256_permute2f128_ps(p0, c0, 0x20));
+            _mm256_storeu_ps(instance + 8, _mm256_permute2f128_ps(p1, c1, 0x20));
+            _mm256_storeu_ps(instance + 16, _mm256_permute2f128_ps(p2, c2, 0x20));
+            _mm256_storeu_ps(instance + 24, _mm256_permute2f128_ps(p3, c3, 0x20));
+            _mm256_storeu_ps(instance + 32, _mm256_permute2f128_ps(p0, c0, 0x31));
+            _mm256_storeu_ps(instance + 40, _mm256_permute2f128_ps(p1, c1, 0x31));
+            _mm256_storeu_ps(instance + 48, _mm256_permute2f128_ps(p2, c2, 0x31));
+            _mm256_storeu_ps(instance + 56, _mm256_permute2f128_ps(p3, c3, 0x31));
+        }
+        return i;
+    }
+#endif
+
+    ParticleKernels::Level detectLevel() {
+#ifdef PARTICLE_USE_AVX2
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return ParticleKernels::Level::AVX2;
+#endif
+#ifdef PARTICLE_USE_SSE
+        return ParticleKernels::Level::SSE2;
+#else
+        return ParticleKernels::Level::Scalar;
+#endif
+    }
+
+    ParticleKernels::Level &activeLevel() {
+        static ParticleKernels::Level level = ParticleKernels::bestLevel();
+        return level;
+    }
+}
+
+ParticleKernels::Level ParticleKernels::bestLevel() {
+    static const Level best = detectLevel();
+    return best;
+}
+
+ParticleKernels::Level ParticleKernels::getLevel() {
+    return activeLevel();
+}
+
+void ParticleKernels::setLevel(Level level) {
+    activeLevel() = static_cast<int>(level) < static_cast<int>(bestLevel()) ? level : bestLevel();
+}
+
+const char *ParticleKernels::levelName(Level level) {
+    switch (level) {
+        case Level::AVX2: return "AVX2";
+        case Level::SSE2: return "SSE2";
+        default: return "scalar";
+    }
+}
+
+void ParticleKernels::integrate(const Streams &streams, int count, float deltaTime, float cameraX, float cameraY,
+                                float cameraZ) {
+    int done = 0;
+    switch (activeLevel()) {
+#ifdef PARTICLE_USE_AVX2
+        case Level::AVX2:
+            done = integrateAVX2(streams, count, deltaTime, cameraX, cameraY, cameraZ);
+            break;
+#endif
+#ifdef PARTICLE_USE_SSE
+        case Level::SSE2:
+            done = integrateSSE(streams, count, deltaTime, cameraX, cameraY, cameraZ);
+            break;
+#endif
+        default:
+            break;
+    }
+    // The remainder that does not fill a register
+    integrateScalar(streams, done, count, deltaTime, cameraX, cameraY, cameraZ);
+}
+
+void ParticleKernels::pack(const Streams &streams, int count, const Appearance &appearance,
+                           ParticleInstanceData *out) {
+    int done = 0;
+    switch (activeLevel()) {
+#ifdef PARTICLE_USE_AVX2
+        case Level::AVX2:
+            done = packAVX2(streams, count, appearance, out);
+            break;
+#endif
+#ifdef PARTICLE_USE_SSE
+        case Level::SSE2:
+            done = packSSE(streams, count, appearance, out);
+            break;
+#endif
+        default:
+            break;
+    }
+    packScalar(streams, done, count, appearance, out);
+}
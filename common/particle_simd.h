@@ -0,0 +1,79 @@
+#ifndef PARTICLE_SIMD_H
+#define PARTICLE_SIMD_H
+
+#include <cstdint>
+
+struct ParticleInstanceData;
+
+/*
+ * ParticleRandom Class
+ * Per-system random numbers for spawning, replacing the process-global rand(): four xorshift32 generators
+ * stepped side by side, so bulk requests fill four values per SSE step. The stream is the lanes' outputs in
+ * turn (value k comes from lane k % 4), whichever of the scalar or bulk calls draws it, so a seed always
+ * produces the same sequence on every CPU.
+ */
+class ParticleRandom {
+public:
+    explicit ParticleRandom(uint32_t seed = 1u);
+
+    // Uniform in [min, max)
+    float uniform(float min, float max);
+
+    // "count" uniform values in [min, max), the same ones "count" uniform() calls would return
+    void uniform(float *out, int count, float min, float max);
+
+private:
+    uint32_t lanes[4];
+    int next_lane = 0;
+};
+
+/*
+ * ParticleKernels Namespace
+ * The per-particle loops of ParticlePool over its structure of arrays, in scalar, SSE2 and AVX2 versions. The
+ * fastest one the CPU supports is picked at runtime (AVX2 is compiled per function, so the build needs no
+ * extra flags); setLevel() can force a slower one for comparison. Every level does the same float operations
+ * in the same order (no FMA), so the results are bit-identical across levels.
+ */
+namespace ParticleKernels {
+    enum class Level { Scalar, SSE2, AVX2 };
+
+    // Pointers to ParticlePool's arrays
+    struct Streams {
+        float *posX, *posY, *posZ;
+        float *speedX, *speedY, *speedZ;
+        float *size;
+        float *life;
+        float *invLifetime;
+        uint32_t *keys;
+    };
+
+    // Best level this CPU and build support
+    Level bestLevel();
+
+    Level getLevel();
+
+    // Clamped to bestLevel()
+    void setLevel(Level level);
+
+    const char *levelName(Level level);
+
+    // One pass over [0, count): life -= dt, pos += speed * dt and the depth sort key from the squared distance to
+    // the camera (far particles get smaller keys; ~0u marks a particle whose life ran out)
+    void integrate(const Streams &streams, int count, float deltaTime, float cameraX, float cameraY,
+                   float cameraZ);
+
+    // Per-emitter inputs of pack(): the tint and the flipbook its particles play once over their lifetime
+    struct Appearance {
+        uint32_t tint = 0xFFFFFFFFu; // RGBA8, red in the lowest byte
+        float firstFrame = 0.0f;     // Atlas frames firstFrame .. firstFrame + frameCount - 1
+        float frameCount = 1.0f;
+    };
+
+    // Interleaves position, size, the tint, the fade (alpha = life / lifetime) and the flipbook frame
+    // (firstFrame + the elapsed share of the lifetime x frameCount, rounded down) into the instance stream
+    void pack(const Streams &streams, int count, const Appearance &appearance, ParticleInstanceData *out);
+
+    constexpr uint32_t DEAD_KEY = 0xFFFFFFFFu;
+}
+
+#endif // PARTICLE_SIMD_H
@@ -0,0 +1,100 @@
+#include "png_writer.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <vector>
+
+namespace {
+    // CRC-32 as used by PNG chunks (polynomial 0xEDB88320)
+    uint32_t crc32(const unsigned char *data, size_t size, uint32_t crc = 0) {
+        static const std::array<uint32_t, 256> table = []() {
+            std::array<uint32_t, 256> entries{};
+            for (uint32_t n = 0; n < 256; n++) {
+                uint32_t c = n;
+                for (int k = 0; k < 8; k++) {
+                    c = c & 1u ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                }
+                entries[n] = c;
+            }
+            return entries;
+        }();
+        crc = ~crc;
+        for (size_t i = 0; i < size; i++) {
+            crc = table[(crc ^ data[i]) & 0xFFu] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    void putBigEndian(std::vector<unsigned char> &out, uint32_t value) {
+        out.push_back(static_cast<unsigned char>(value >> 24));
+        out.push_back(static_cast<unsigned char>(value >> 16));
+        out.push_back(static_cast<unsigned char>(value >> 8));
+        out.push_back(static_cast<unsigned char>(value));
+    }
+
+    void writeChunk(std::ofstream &file, const char type[4], const std::vector<unsigned char> &data) {
+        std::vector<unsigned char> chunk;
+        chunk.reserve(data.size() + 12);
+        putBigEndian(chunk, static_cast<uint32_t>(data.size()));
+        chunk.insert(chunk.end(), type, type + 4);
+        chunk.insert(chunk.end(), data.begin(), data.end());
+        // The CRC covers the type and the data, not the length
+        putBigEndian(chunk, crc32(chunk.data() + 4, data.size() + 4));
+        file.write(reinterpret_cast<const char *>(chunk.data()), static_cast<std::streamsize>(chunk.size()));
+    }
+}
+
+bool writePNG(const std::string &path, const unsigned char *rgba, int width, int height) {
+    if (width <= 0 || height <= 0) return false;
+    std::ofstream file(path, std::ios::binary);
+    if (!file) return false;
+
+    static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    file.write(reinterpret_cast<const char *>(signature), sizeof(signature));
+
+    std::vector<unsigned char> header;
+    putBigEndian(header, static_cast<uint32_t>(width));
+    putBigEndian(header, static_cast<uint32_t>(height));
+    header.insert(header.end(), {8, 6, 0, 0, 0}); // 8 bits per channel, RGBA, deflate, adaptive filters, no interlace
+    writeChunk(file, "IHDR", header);
+
+    // Scanlines, each led by its filter type (0: none)
+    const size_t rowBytes = static_cast<size_t>(width) * 4;
+    std::vector<unsigned char> raw;
+    raw.reserve((rowBytes + 1) * height);
+    for (int y = 0; y < height; y++) {
+        raw.push_back(0);
+        raw.insert(raw.end(), rgba + y * rowBytes, rgba + (y + 1) * rowBytes);
+    }
+
+    // zlib stream of stored deflate blocks, at most 65535 bytes each, then the Adler-32 of the raw data
+    std::vector<unsigned char> compressed;
+    compressed.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+    compressed.insert(compressed.end(), {0x78, 0x01});
+    size_t offset = 0;
+    do {
+        const size_t blockSize = std::min<size_t>(raw.size() - offset, 65535);
+        const bool last = offset + blockSize == raw.size();
+        compressed.push_back(last ? 1 : 0);
+        compressed.push_back(static_cast<unsigned char>(blockSize));
+        compressed.push_back(static_cast<unsigned char>(blockSize >> 8));
+        compressed.push_back(static_cast<unsigned char>(~blockSize));
+        compressed.push_back(static_cast<unsigned char>(~blockSize >> 8));
+        compressed.insert(compressed.end(), raw.begin() + static_cast<std::ptrdiff_t>(offset),
+                          raw.begin() + static_cast<std::ptrdiff_t>(offset + blockSize));
+        offset += blockSize;
+    } while (offset < raw.size());
+
+    uint32_t a = 1, b = 0;
+    for (size_t i = 0; i < raw.size(); i++) {
+        a = (a + raw[i]) % 65521u;
+        b = (b + a) % 65521u;
+    }
+    putBigEndian(compressed, b << 16 | a);
+    writeChunk(file, "IDAT", compressed);
+    writeChunk(file, "IEND", {});
+
+    return static_cast<bool>(file);
+}
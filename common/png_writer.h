@@ -0,0 +1,15 @@
+#ifndef PNG_WRITER_H
+#define PNG_WRITER_H
+
+#include <string>
+
+/*
+ * writePNG
+ * Writes 8-bit RGBA pixels, top row first, to an RGBA PNG file. The image data is stored without compression
+ * (deflate "stored" blocks), so no zlib is needed; files are about as large as the raw pixels. Pixels are written
+ * exactly, which is what golden-image comparisons want.
+ * Returns false if the file could not be written.
+ */
+bool writePNG(const std::string &path, const unsigned char *rgba, int width, int height);
+
+#endif // PNG_WRITER_H
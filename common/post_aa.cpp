@@ -0,0 +1,142 @@
+#include "post_aa.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+namespace {
+    // Radical inverse in the given base: 1/2, 1/4, 3/4, ... for base 2
+    float halton(unsigned index, unsigned base) {
+        float result = 0.0f;
+        float fraction = 1.0f / static_cast<float>(base);
+        while (index > 0) {
+            result += fraction * static_cast<float>(index % base);
+            index /= base;
+            fraction /= static_cast<float>(base);
+        }
+        return result;
+    }
+
+    // Jitter positions repeat after this many frames
+    constexpr unsigned JITTER_PHASES = 8;
+
+    // Share of the history in each TAA output pixel
+    constexpr float HISTORY_WEIGHT = 0.9f;
+}
+
+PostAntiAliasing::PostAntiAliasing(GLuint fxaaProgram, GLuint taaProgram)
+    : fxaa_program(fxaaProgram), taa_program(taaProgram) {
+    fxaa_render_scale = glGetUniformLocation(fxaa_program, "renderScale");
+    fxaa_texel_size = glGetUniformLocation(fxaa_program, "texelSize");
+    glUseProgram(fxaa_program);
+    glUniform1i(glGetUniformLocation(fxaa_program, "sceneColor"), 0);
+
+    taa_render_scale = glGetUniformLocation(taa_program, "renderScale");
+    taa_history_scale = glGetUniformLocation(taa_program, "historyScale");
+    taa_texel_size = glGetUniformLocation(taa_program, "texelSize");
+    taa_reprojection = glGetUniformLocation(taa_program, "reprojection");
+    taa_jitter = glGetUniformLocation(taa_program, "jitter");
+    taa_history_weight = glGetUniformLocation(taa_program, "historyWeight");
+    glUseProgram(taa_program);
+    glUniform1i(glGetUniformLocation(taa_program, "currentColor"), 0);
+    glUniform1i(glGetUniformLocation(taa_program, "currentDepth"), 1);
+    glUniform1i(glGetUniformLocation(taa_program, "history"), 2);
+
+    glGenVertexArrays(1, &empty_vao);
+}
+
+PostAntiAliasing::~PostAntiAliasing() {
+    release();
+    glDeleteVertexArrays(1, &empty_vao);
+}
+
+glm::mat4 PostAntiAliasing::jitterProjection(const glm::mat4 &projection, glm::ivec2 renderSize) {
+    if (mode != Mode::TAA) {
+        jitter_ndc = glm::vec2(0.0f);
+        return projection;
+    }
+    // Halton (2, 3) offsets within the pixel, in [-0.5, 0.5)
+    frame_index = (frame_index + 1) % JITTER_PHASES;
+    const glm::vec2 pixels(halton(frame_index + 1, 2) - 0.5f, halton(frame_index + 1, 3) - 0.5f);
+    jitter_ndc = 2.0f * pixels / glm::vec2(renderSize);
+    // Applied after the projection, so the shift is the same number of pixels at every depth
+    return glm::translate(glm::mat4(1.0f), glm::vec3(jitter_ndc, 0.0f)) * projection;
+}
+
+void PostAntiAliasing::prepareHistory(glm::ivec2 nativeSize) {
+    if (nativeSize == native_size) return;
+    release();
+    native_size = nativeSize;
+    history_valid = false;
+
+    glGenTextures(2, targets);
+    for (GLuint target: targets) {
+        // Half floats so the history does not band while it accumulates
+        glBindTexture(GL_TEXTURE_2D, target);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, nativeSize.x, nativeSize.y, 0, GL_RGBA, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void PostAntiAliasing::apply(GLuint color, GLuint depth, glm::ivec2 renderSize, glm::ivec2 nativeSize,
+                             const glm::mat4 &viewProjection) {
+    if (mode == Mode::Off) return;
+
+    const glm::vec2 renderScale = glm::vec2(renderSize) / glm::vec2(nativeSize);
+    const glm::vec2 texelSize = 1.0f / glm::vec2(nativeSize);
+    glViewport(0, 0, renderSize.x, renderSize.y);
+    glDisable(GL_DEPTH_TEST);
+    glBindVertexArray(empty_vao);
+
+    if (mode == Mode::FXAA) {
+        glUseProgram(fxaa_program);
+        glUniform2fv(fxaa_render_scale, 1, glm::value_ptr(renderScale));
+        glUniform2fv(fxaa_texel_size, 1, glm::value_ptr(texelSize));
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, color);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    } else {
+        glUseProgram(taa_program);
+        const glm::mat4 reprojection = previous_view_projection * glm::inverse(viewProjection);
+        glUniform2fv(taa_render_scale, 1, glm::value_ptr(renderScale));
+        glUniform2fv(taa_history_scale, 1, glm::value_ptr(previous_render_scale));
+        glUniform2fv(taa_texel_size, 1, glm::value_ptr(texelSize));
+        glUniformMatrix4fv(taa_reprojection, 1, GL_FALSE, glm::value_ptr(reprojection));
+        glUniform2fv(taa_jitter, 1, glm::value_ptr(jitter_ndc));
+        glUniform1f(taa_history_weight, history_valid ? HISTORY_WEIGHT : 0.0f);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, color);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, depth);
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, getHistory());
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glActiveTexture(GL_TEXTURE0);
+
+        history_valid = true;
+        previous_view_projection = viewProjection;
+        previous_render_scale = renderScale;
+        current = 1 - current;
+    }
+
+    glBindVertexArray(0);
+    glEnable(GL_DEPTH_TEST);
+}
+
+void PostAntiAliasing::setMode(Mode newMode) {
+    if (newMode == mode) return;
+    mode = newMode;
+    history_valid = false;
+}
+
+size_t PostAntiAliasing::memoryBytes() const {
+    // Two RGBA16F textures, allocated on first use of TAA
+    return targets[0] ? 2 * static_cast<size_t>(native_size.x) * static_cast<size_t>(native_size.y) * 8 : 0;
+}
+
+void PostAntiAliasing::release() {
+    glDeleteTextures(2, targets);
+    targets[0] = targets[1] = 0;
+}
@@ -0,0 +1,80 @@
+#ifndef POST_AA_H
+#define POST_AA_H
+
+#include <cstddef>
+#include <glm/glm.hpp>
+#include "glad.h"
+
+/*
+ * PostAntiAliasing Class
+ * Anti-aliasing as full-screen passes over the single-sampled scene, as an alternative to MSAA:
+ * FXAA smooths edges found in the final colours; TAA jitters the projection by a sub-pixel offset every frame
+ * and blends each frame into a history reprojected with the camera motion, clamped to the current pixel's
+ * neighbourhood so moving objects (the windmill) do not leave trails.
+ * Inputs and outputs are native-size textures of which only the rendered corner (renderSize) is used,
+ * as produced by DynamicResolution, so the render scale may change between frames. The output framebuffer
+ * comes from the render graph; only the TAA history, which outlives the frame, is owned here.
+ */
+class PostAntiAliasing {
+public:
+    enum class Mode { Off, FXAA, TAA };
+
+    // Both programs are fullscreen.vert with fxaa.frag / taa.frag
+    PostAntiAliasing(GLuint fxaaProgram, GLuint taaProgram);
+
+    ~PostAntiAliasing();
+
+    PostAntiAliasing(const PostAntiAliasing &) = delete;
+
+    PostAntiAliasing &operator=(const PostAntiAliasing &) = delete;
+
+    // Advances the jitter sequence and returns "projection" offset by this frame's sub-pixel jitter.
+    // Returns it unchanged unless the mode is TAA
+    glm::mat4 jitterProjection(const glm::mat4 &projection, glm::ivec2 renderSize);
+
+    // (Re)allocates the TAA history for the given size; call before getHistory()/getHistoryTarget()
+    void prepareHistory(glm::ivec2 nativeSize);
+
+    // Last frame's TAA output, read by this frame's pass
+    GLuint getHistory() const { return targets[1 - current]; }
+
+    // Texture this frame's TAA pass must be drawing into; it becomes the history of the next frame
+    GLuint getHistoryTarget() const { return targets[current]; }
+
+    // Runs the pass for the current mode into the bound framebuffer. "viewProjection" is this frame's
+    // unjittered camera matrix; "depth" is needed by TAA
+    void apply(GLuint color, GLuint depth, glm::ivec2 renderSize, glm::ivec2 nativeSize,
+               const glm::mat4 &viewProjection);
+
+    void setMode(Mode newMode);
+
+    Mode getMode() const { return mode; }
+
+    // Drops the TAA history, e.g. after a camera cut
+    void resetHistory() { history_valid = false; }
+
+    // GPU memory of the TAA history
+    size_t memoryBytes() const;
+
+private:
+    void release();
+
+    Mode mode = Mode::Off;
+    GLuint fxaa_program, taa_program;
+    GLint fxaa_render_scale, fxaa_texel_size;
+    GLint taa_render_scale, taa_history_scale, taa_texel_size, taa_reprojection, taa_jitter, taa_history_weight;
+    GLuint empty_vao = 0;
+
+    // Ping-pong history: TAA writes targets[current] and reads the other
+    GLuint targets[2] = {0, 0};
+    int current = 0;
+    glm::ivec2 native_size = glm::ivec2(0);
+
+    unsigned frame_index = 0;
+    glm::vec2 jitter_ndc = glm::vec2(0.0f);
+    bool history_valid = false;
+    glm::mat4 previous_view_projection = glm::mat4(1.0f);
+    glm::vec2 previous_render_scale = glm::vec2(1.0f);
+};
+
+#endif // POST_AA_H
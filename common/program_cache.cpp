@@ -0,0 +1,171 @@
+#include "program_cache.h"
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <utility>
+
+namespace {
+    constexpr std::uint32_t BINARY_MAGIC = 0x42504c47; // "GLPB"
+
+    // File layout: header, then "length" bytes of program binary
+    struct BinaryHeader {
+        std::uint32_t magic;
+        std::uint32_t format;
+        std::uint32_t length;
+        std::uint32_t reserved;
+        std::uint64_t key;
+    };
+
+    // FNV-1a, 64 bit
+    void hashBytes(std::uint64_t &hash, const std::string &bytes) {
+        for (unsigned char c: bytes) {
+            hash ^= c;
+            hash *= 0x100000001b3ull;
+        }
+        // Separator, so ("ab", "c") and ("a", "bc") differ
+        hash ^= 0xff;
+        hash *= 0x100000001b3ull;
+    }
+
+    std::string glString(GLenum name) {
+        const GLubyte *value = glGetString(name);
+        return value ? reinterpret_cast<const char *>(value) : "";
+    }
+
+    double millisecondsSince(std::chrono::high_resolution_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+}
+
+ProgramCache::ProgramCache(std::string directory) : directory(std::move(directory)) {
+    driver = glString(GL_VENDOR) + "\n" + glString(GL_RENDERER) + "\n" + glString(GL_VERSION);
+
+    GLint formatCount = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+    enabled = formatCount > 0;
+    if (!enabled) {
+        std::cout << "Program binary cache disabled: driver reports no binary formats" << std::endl;
+        return;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(this->directory, error);
+    if (error) {
+        std::cout << "Program binary cache disabled: cannot create " << this->directory << std::endl;
+        enabled = false;
+    }
+}
+
+GLuint ProgramCache::getProgram(const std::string &vertexSource, const std::string &fragmentSource,
+                                const std::string &label, const std::function<void(GLuint)> &attachShaders,
+                                bool *fromCache) {
+    auto start = std::chrono::high_resolution_clock::now();
+    const std::uint64_t key = keyOf(vertexSource, fragmentSource);
+
+    if (enabled) {
+        if (GLuint program = loadBinary(key)) {
+            entries.push_back({label, true, millisecondsSince(start)});
+            if (fromCache) *fromCache = true;
+            return program;
+        }
+    }
+
+    GLuint program = glCreateProgram();
+    if (enabled) {
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    attachShaders(program);
+    glLinkProgram(program);
+
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (enabled && linked) {
+        saveBinary(key, program);
+    }
+
+    entries.push_back({label, false, millisecondsSince(start)});
+    if (fromCache) *fromCache = false;
+    return program;
+}
+
+void ProgramCache::report() const {
+    double compiledMs = 0.0, cachedMs = 0.0;
+    std::cout << "Program cache (" << (enabled ? directory : "disabled") << "):\n";
+    for (const auto &entry: entries) {
+        char line[256];
+        std::snprintf(line, sizeof(line), "  %-8s %8.2f ms  %s\n", entry.fromCache ? "binary" : "compiled",
+                      entry.milliseconds, entry.label.c_str());
+        std::cout << line;
+        (entry.fromCache ? cachedMs : compiledMs) += entry.milliseconds;
+    }
+    char total[128];
+    std::snprintf(total, sizeof(total), "  total: %.2f ms compiled, %.2f ms from binaries\n", compiledMs, cachedMs);
+    std::cout << total;
+}
+
+std::uint64_t ProgramCache::keyOf(const std::string &vertexSource, const std::string &fragmentSource) const {
+    std::uint64_t hash = 0xcbf29ce484222325ull;
+    hashBytes(hash, vertexSource);
+    hashBytes(hash, fragmentSource);
+    hashBytes(hash, driver);
+    return hash;
+}
+
+std::string ProgramCache::pathOf(std::uint64_t key) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+    return (std::filesystem::path(directory) / name).string();
+}
+
+GLuint ProgramCache::loadBinary(std::uint64_t key) const {
+    const std::string path = pathOf(key);
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return 0;
+
+    BinaryHeader header{};
+    file.read(reinterpret_cast<char *>(&header), sizeof(header));
+    std::vector<char> binary;
+    if (file && header.magic == BINARY_MAGIC && header.key == key) {
+        binary.resize(header.length);
+        file.read(binary.data(), header.length);
+    }
+    if (!file || binary.empty()) {
+        std::cout << "Program cache: ignoring damaged " << path << std::endl;
+        return 0;
+    }
+    file.close();
+
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        // The driver may reject binaries at any time (e.g. after an update that kept its version string)
+        std::cout << "Program cache: binary rejected, recompiling " << path << std::endl;
+        glDeleteProgram(program);
+        std::error_code error;
+        std::filesystem::remove(path, error);
+        return 0;
+    }
+    return program;
+}
+
+void ProgramCache::saveBinary(std::uint64_t key, GLuint program) const {
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, nullptr, &format, binary.data());
+
+    const BinaryHeader header = {BINARY_MAGIC, format, static_cast<std::uint32_t>(length), 0, key};
+    std::ofstream file(pathOf(key), std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(binary.data(), length);
+    if (!file) {
+        std::cout << "Program cache: could not write " << pathOf(key) << std::endl;
+    }
+}
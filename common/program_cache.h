@@ -0,0 +1,55 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "glad.h"
+
+/*
+ * ProgramCache Class
+ * Keeps linked GLSL programs on disk with glGetProgramBinary/glProgramBinary so later launches skip compiling.
+ * A binary is keyed by a hash of the sources and the driver's vendor/renderer/version strings; after a driver
+ * update the key changes, and a binary the driver still rejects is deleted and the program rebuilt from source.
+ * Needs a current GL context. On drivers without any binary format (e.g. macOS) it only compiles.
+ */
+class ProgramCache {
+public:
+    struct Entry {
+        std::string label;
+        bool fromCache;
+        double milliseconds;
+    };
+
+    explicit ProgramCache(std::string directory = "shader_cache");
+
+    // Returns a program for the sources: from disk if the driver accepts the stored binary, otherwise a new
+    // program is created, "attachShaders" compiles and attaches its stages, and it is linked and saved.
+    // The caller checks GL_LINK_STATUS as usual; failed links are never saved
+    GLuint getProgram(const std::string &vertexSource, const std::string &fragmentSource, const std::string &label,
+                      const std::function<void(GLuint)> &attachShaders, bool *fromCache = nullptr);
+
+    bool isEnabled() const { return enabled; }
+
+    // Prints compile vs cached time for every program requested so far
+    void report() const;
+
+    const std::vector<Entry> &getEntries() const { return entries; }
+
+private:
+    std::uint64_t keyOf(const std::string &vertexSource, const std::string &fragmentSource) const;
+
+    std::string pathOf(std::uint64_t key) const;
+
+    GLuint loadBinary(std::uint64_t key) const;
+
+    void saveBinary(std::uint64_t key, GLuint program) const;
+
+    std::string directory;
+    std::string driver; // Vendor, renderer and version, part of every key
+    bool enabled = false;
+    std::vector<Entry> entries;
+};
+
+#endif // PROGRAM_CACHE_H
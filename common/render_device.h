@@ -0,0 +1,182 @@
+#ifndef RENDER_DEVICE_H
+#define RENDER_DEVICE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+/*
+ * Render device abstraction
+ * The objects a frame is drawn with (buffers, textures, pipelines) and command lists recording draws with them,
+ * independent of the graphics API. GLRenderDevice implements it on the application's GL 4.1 context;
+ * VulkanRenderDevice (built with WINDMILL_VULKAN) on a headless Vulkan 1.3 device, which may be Mesa's lavapipe
+ * on machines without a GPU.
+ * Objects are referred to by handles, of which 0 is never valid. Objects must not be created or destroyed while
+ * lists are being recorded. Recording only reads them, so several lists may be recorded at once on different
+ * threads, one thread per list; submit() then runs them in order on the thread that owns the device.
+ * So far only the windowed renderer's skybox pass is drawn through it; the other passes call GL directly, so the
+ * Vulkan device renders vulkan_headless's scene, not the windmill.
+ */
+
+struct BufferHandle {
+    uint32_t id = 0;
+
+    bool valid() const { return id != 0; }
+};
+
+struct TextureHandle {
+    uint32_t id = 0;
+
+    bool valid() const { return id != 0; }
+};
+
+struct PipelineHandle {
+    uint32_t id = 0;
+
+    bool valid() const { return id != 0; }
+};
+
+enum class BufferUsage { Vertex, Index };
+
+enum class TextureFormat { RGBA8, RGBA16F, Depth32F };
+
+enum class TextureType { Texture2D, Cube };
+
+enum class CompareOp { Less, LessEqual, Always };
+
+struct BufferDesc {
+    BufferUsage usage = BufferUsage::Vertex;
+    size_t size = 0;
+    const void *data = nullptr; // Initial contents, may be null
+};
+
+struct TextureDesc {
+    TextureType type = TextureType::Texture2D;
+    TextureFormat format = TextureFormat::RGBA8;
+    int width = 0, height = 0;
+    bool renderTarget = false; // Can be attached to a render pass
+    // Initial texels, tightly packed rows (RGBA16F as half floats). A cube's six faces follow each other
+    // in the order +X, -X, +Y, -Y, +Z, -Z. May be null
+    const void *data = nullptr;
+};
+
+// Vertex attribute of 32-bit floats, read from the bound vertex buffer
+struct VertexAttribute {
+    uint32_t location = 0;
+    int components = 3;
+    uint32_t offset = 0;
+};
+
+struct PipelineDesc {
+    // GLSL sources. GL compiles them with the "features" defines (ShaderVariants::Feature); Vulkan loads
+    // the SPIR-V compiled next to them ("<path>.spv") and has no features
+    std::string vertexShader, fragmentShader;
+    unsigned features = 0;
+
+    uint32_t vertexStride = 0;
+    std::vector<VertexAttribute> attributes;
+    std::vector<std::string> textures; // Sampler names, bound to slots 0, 1, ... in this order
+    uint32_t pushConstantSize = 0;     // Bytes of the shaders' PushConstants block, at most 128
+
+    bool depthTest = true;
+    bool depthWrite = true;
+    CompareOp depthCompare = CompareOp::Less;
+    bool alphaBlend = false;
+    bool cullBackFaces = false;
+
+    // Formats of the attachments it renders into, which Vulkan builds into the pipeline
+    TextureFormat colorFormat = TextureFormat::RGBA8;
+    TextureFormat depthFormat = TextureFormat::Depth32F;
+};
+
+struct RenderPassDesc {
+    // Without attachments a pass draws into whatever GL framebuffer and viewport are current when the list
+    // is submitted, to mix with code that does not use the device (GL only)
+    TextureHandle color, depth;
+    bool clear = false;
+    glm::vec4 clearColor = glm::vec4(0.0f);
+    float clearDepth = 1.0f;
+};
+
+/*
+ * CommandList Class
+ * Records a sequence of passes and draws for RenderDevice::submit(). Recording makes no API calls that need
+ * the device's thread. A list can be recorded again once the device has run it.
+ */
+class CommandList {
+public:
+    virtual ~CommandList() = default;
+
+    // Drops what was recorded before and starts recording
+    virtual void begin() = 0;
+
+    virtual void end() = 0;
+
+    // Also sets the viewport to the attachments' size
+    virtual void beginRenderPass(const RenderPassDesc &pass) = 0;
+
+    virtual void endRenderPass() = 0;
+
+    // In pixels from the bottom left, as in GL
+    virtual void setViewport(int x, int y, int width, int height) = 0;
+
+    virtual void bindPipeline(PipelineHandle pipeline) = 0;
+
+    virtual void bindVertexBuffer(BufferHandle buffer, size_t offset = 0) = 0;
+
+    // 32-bit indices
+    virtual void bindIndexBuffer(BufferHandle buffer) = 0;
+
+    virtual void bindTexture(int slot, TextureHandle texture) = 0;
+
+    // Replaces the bound pipeline's PushConstants block from its start
+    virtual void pushConstants(const void *data, uint32_t size) = 0;
+
+    virtual void draw(uint32_t vertexCount, uint32_t instanceCount = 1, uint32_t firstVertex = 0) = 0;
+
+    virtual void drawIndexed(uint32_t indexCount, uint32_t instanceCount = 1, uint32_t firstIndex = 0) = 0;
+};
+
+/*
+ * RenderDevice Class
+ * Creates the objects and command lists of one graphics API and runs recorded lists.
+ */
+class RenderDevice {
+public:
+    virtual ~RenderDevice() = default;
+
+    // API and adapter, e.g. "Vulkan 1.3 llvmpipe (LLVM 15.0.7, 256 bits)"
+    virtual std::string name() const = 0;
+
+    virtual BufferHandle createBuffer(const BufferDesc &desc) = 0;
+
+    // The caller makes sure no submitted work still reads the range
+    virtual void updateBuffer(BufferHandle buffer, const void *data, size_t size, size_t offset = 0) = 0;
+
+    virtual TextureHandle createTexture(const TextureDesc &desc) = 0;
+
+    virtual PipelineHandle createPipeline(const PipelineDesc &desc) = 0;
+
+    virtual void destroyBuffer(BufferHandle buffer) = 0;
+
+    virtual void destroyTexture(TextureHandle texture) = 0;
+
+    virtual void destroyPipeline(PipelineHandle pipeline) = 0;
+
+    // Lists must be destroyed before the device
+    virtual std::unique_ptr<CommandList> createCommandList() = 0;
+
+    // Runs the lists in the given order. Call on the device's thread, with none of them being recorded
+    virtual void submit(const std::vector<CommandList *> &lists) = 0;
+
+    // Waits for submitted work and returns an RGBA8 texture's texels, top row first
+    virtual std::vector<unsigned char> readTexture(TextureHandle texture) = 0;
+
+    // Maps GL clip space (z in [-1, 1]) to the device's; applied after the projection
+    virtual glm::mat4 clipCorrection() const { return glm::mat4(1.0f); }
+};
+
+#endif // RENDER_DEVICE_H
@@ -0,0 +1,390 @@
+#include "render_graph.h"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+
+namespace {
+    // Frames a pooled object may stay unused before it is deleted
+    constexpr int POOL_GRACE_FRAMES = 8;
+
+    bool isDepthFormat(GLenum format) {
+        return format == GL_DEPTH_COMPONENT16 || format == GL_DEPTH_COMPONENT24 || format == GL_DEPTH_COMPONENT32F ||
+               format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+    }
+
+    bool hasStencil(GLenum format) {
+        return format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+    }
+
+    size_t bytesPerPixel(GLenum format) {
+        switch (format) {
+            case GL_R8: return 1;
+            case GL_RG8: case GL_R16F: case GL_DEPTH_COMPONENT16: return 2;
+            case GL_RGBA16F: case GL_RG32F: case GL_DEPTH32F_STENCIL8: return 8;
+            case GL_RGBA32F: return 16;
+            default: return 4; // RGBA8, RG16F, R32F, 24/32-bit depth
+        }
+    }
+
+    size_t sizeOf(const RenderGraph::TextureDesc &desc) {
+        return static_cast<size_t>(desc.width) * static_cast<size_t>(desc.height) * bytesPerPixel(desc.format) *
+               static_cast<size_t>(std::max(desc.samples, 1));
+    }
+
+    // Client format and type matching an internal format, for glTexImage2D without data
+    void uploadFormat(GLenum internalFormat, GLenum &format, GLenum &type) {
+        type = GL_UNSIGNED_BYTE;
+        switch (internalFormat) {
+            case GL_DEPTH24_STENCIL8: format = GL_DEPTH_STENCIL; type = GL_UNSIGNED_INT_24_8; return;
+            case GL_DEPTH32F_STENCIL8: format = GL_DEPTH_STENCIL; type = GL_FLOAT_32_UNSIGNED_INT_24_8_REV; return;
+            case GL_R8: format = GL_RED; return;
+            case GL_R16F: case GL_R32F: format = GL_RED; type = GL_FLOAT; return;
+            case GL_RG8: format = GL_RG; return;
+            case GL_RG16F: case GL_RG32F: format = GL_RG; type = GL_FLOAT; return;
+            case GL_RGBA16F: case GL_RGBA32F: format = GL_RGBA; type = GL_FLOAT; return;
+            default: break;
+        }
+        if (isDepthFormat(internalFormat)) {
+            format = GL_DEPTH_COMPONENT;
+            type = GL_FLOAT;
+        } else {
+            format = GL_RGBA;
+        }
+    }
+
+    GLuint createObject(const RenderGraph::TextureDesc &desc) {
+        GLuint name;
+        if (desc.renderbuffer || desc.samples > 1) {
+            glGenRenderbuffers(1, &name);
+            glBindRenderbuffer(GL_RENDERBUFFER, name);
+            glRenderbufferStorageMultisample(GL_RENDERBUFFER, desc.samples > 1 ? desc.samples : 0, desc.format,
+                                             desc.width, desc.height);
+            glBindRenderbuffer(GL_RENDERBUFFER, 0);
+            return name;
+        }
+        GLenum format, type;
+        uploadFormat(desc.format, format, type);
+        glGenTextures(1, &name);
+        glBindTexture(GL_TEXTURE_2D, name);
+        glTexImage2D(GL_TEXTURE_2D, 0, static_cast<GLint>(desc.format), desc.width, desc.height, 0, format, type,
+                     nullptr);
+        const GLint filter = isDepthFormat(desc.format) ? GL_NEAREST : GL_LINEAR;
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return name;
+    }
+}
+
+RenderGraph::Resource RenderGraph::Builder::create(const std::string &name, const TextureDesc &desc) {
+    ResourceNode node;
+    node.name = name;
+    node.desc = desc;
+    graph.resources.push_back(node);
+    const Resource resource = static_cast<Resource>(graph.resources.size()) - 1;
+    write(resource);
+    return resource;
+}
+
+void RenderGraph::Builder::read(Resource resource) {
+    std::vector<Resource> &reads = graph.passes[pass].reads;
+    if (std::find(reads.begin(), reads.end(), resource) == reads.end()) reads.push_back(resource);
+}
+
+void RenderGraph::Builder::write(Resource resource) {
+    ResourceNode &node = graph.resources[resource];
+    if (!node.writers.empty() && node.writers.back() != pass) read(resource);
+    graph.passes[pass].writes.push_back(resource);
+    node.writers.push_back(pass);
+}
+
+void RenderGraph::Builder::sideEffect() {
+    graph.passes[pass].sideEffect = true;
+}
+
+GLuint RenderGraph::Context::texture(Resource resource) const {
+    return graph.objectOf(resource);
+}
+
+GLuint RenderGraph::Context::framebuffer(std::initializer_list<Resource> attachments) const {
+    return graph.framebufferFor(std::vector<Resource>(attachments));
+}
+
+RenderGraph::~RenderGraph() {
+    for (const auto &entry: framebuffers) glDeleteFramebuffers(1, &entry.second);
+    for (size_t i = 0; i < pool.size(); i++) releasePool(i);
+}
+
+void RenderGraph::reset() {
+    resources.clear();
+    passes.clear();
+    order.clear();
+    frame++;
+}
+
+RenderGraph::Resource RenderGraph::import(const std::string &name, GLuint texture, const TextureDesc &desc,
+                                          bool attachable) {
+    ResourceNode node;
+    node.name = name;
+    node.desc = desc;
+    node.imported = true;
+    node.attachable = attachable;
+    node.importedName = texture;
+    resources.push_back(node);
+    return static_cast<Resource>(resources.size()) - 1;
+}
+
+void RenderGraph::addPass(const std::string &name, const Setup &setup, const Execute &execute) {
+    PassNode node;
+    node.name = name;
+    node.execute = execute;
+    passes.push_back(node);
+    Builder builder(*this, static_cast<int>(passes.size()) - 1);
+    setup(builder);
+}
+
+void RenderGraph::compile() {
+    // Culling: from the passes with side effects backwards, keep every pass that writes something a kept
+    // pass reads
+    std::vector<bool> needed(resources.size(), false);
+    for (auto &pass: passes) pass.culled = true;
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (auto &pass: passes) {
+            if (!pass.culled) continue;
+            bool live = pass.sideEffect;
+            for (Resource resource: pass.writes) live = live || needed[resource];
+            if (!live) continue;
+            pass.culled = false;
+            for (Resource resource: pass.reads) needed[resource] = true;
+            changed = true;
+        }
+    }
+
+    // Ordering: a pass runs after the writers of everything it reads; ties keep the declaration order
+    std::vector<std::vector<int>> dependents(passes.size());
+    std::vector<int> pending(passes.size(), 0);
+    for (size_t p = 0; p < passes.size(); p++) {
+        if (passes[p].culled) continue;
+        for (Resource resource: passes[p].reads) {
+            // Of several writers, the ones declared before the reader feed it
+            const std::vector<int> &writers = resources[resource].writers;
+            const bool writtenBefore = !writers.empty() && writers.front() < static_cast<int>(p);
+            for (int writer: writers) {
+                if (writer == static_cast<int>(p) || passes[writer].culled) continue;
+                if (writtenBefore && writer > static_cast<int>(p)) continue;
+                dependents[writer].push_back(static_cast<int>(p));
+                pending[p]++;
+            }
+        }
+    }
+    std::vector<bool> done(passes.size(), false);
+    for (size_t step = 0; step < passes.size(); step++) {
+        int next = -1;
+        for (size_t p = 0; p < passes.size() && next < 0; p++) {
+            if (!passes[p].culled && !done[p] && pending[p] == 0) next = static_cast<int>(p);
+        }
+        if (next < 0) break;
+        done[next] = true;
+        order.push_back(next);
+        for (int dependent: dependents[next]) pending[dependent]--;
+    }
+    size_t livePasses = 0;
+    for (const auto &pass: passes) livePasses += pass.culled ? 0 : 1;
+    if (order.size() != livePasses) {
+        std::cout << "ERROR::RENDER_GRAPH::CYCLE, falling back to declaration order" << std::endl;
+        order.clear();
+        for (size_t p = 0; p < passes.size(); p++) {
+            if (!passes[p].culled) order.push_back(static_cast<int>(p));
+        }
+    }
+
+    // Lifetimes of the transients, in execution positions
+    for (size_t position = 0; position < order.size(); position++) {
+        const PassNode &pass = passes[order[position]];
+        for (const auto *list: {&pass.reads, &pass.writes}) {
+            for (Resource resource: *list) {
+                ResourceNode &node = resources[resource];
+                if (node.firstUse < 0) node.firstUse = static_cast<int>(position);
+                node.lastUse = static_cast<int>(position);
+            }
+        }
+    }
+
+    // Allocation: in order of first use, reuse a pooled object of the same format that is free by then
+    std::vector<Resource> transients;
+    for (size_t r = 0; r < resources.size(); r++) {
+        if (!resources[r].imported && resources[r].firstUse >= 0) transients.push_back(static_cast<Resource>(r));
+    }
+    std::stable_sort(transients.begin(), transients.end(), [&](Resource a, Resource b) {
+        return resources[a].firstUse < resources[b].firstUse;
+    });
+    for (auto &entry: pool) entry.busyUntil = -1;
+    std::vector<bool> usedThisFrame(pool.size(), false);
+    for (Resource resource: transients) {
+        ResourceNode &node = resources[resource];
+        int chosen = -1;
+        for (size_t i = 0; i < pool.size() && chosen < 0; i++) {
+            if (!pool[i].name || !(pool[i].desc == node.desc)) continue;
+            const bool free = !usedThisFrame[i] || (aliasing && pool[i].busyUntil < node.firstUse);
+            if (free) chosen = static_cast<int>(i);
+        }
+        if (chosen < 0) {
+            // New object, in a released slot if there is one
+            for (size_t i = 0; i < pool.size() && chosen < 0; i++) {
+                if (!pool[i].name) chosen = static_cast<int>(i);
+            }
+            if (chosen < 0) {
+                pool.emplace_back();
+                usedThisFrame.push_back(false);
+                chosen = static_cast<int>(pool.size()) - 1;
+            }
+            pool[chosen].desc = node.desc;
+            pool[chosen].name = createObject(node.desc);
+        }
+        node.allocation = chosen;
+        usedThisFrame[chosen] = true;
+        pool[chosen].busyUntil = node.lastUse;
+        pool[chosen].lastFrame = frame;
+    }
+
+    // Objects no transient has needed for a while go away, with the framebuffers they were attached to
+    for (size_t i = 0; i < pool.size(); i++) {
+        if (pool[i].name && frame - pool[i].lastFrame > POOL_GRACE_FRAMES) releasePool(i);
+    }
+
+    stats = Stats();
+    stats.passes = static_cast<int>(order.size());
+    stats.culled = static_cast<int>(passes.size() - order.size());
+    stats.transients = static_cast<int>(transients.size());
+    for (Resource resource: transients) stats.unaliasedBytes += sizeOf(resources[resource].desc);
+    for (size_t i = 0; i < pool.size(); i++) {
+        if (!usedThisFrame[i]) continue;
+        stats.allocations++;
+        stats.aliasedBytes += sizeOf(pool[i].desc);
+    }
+
+    previous_layout = layout;
+    layout.clear();
+    for (int p: order) layout += passes[p].name + ";";
+    for (Resource resource: transients) {
+        layout += resources[resource].name + "@" + std::to_string(resources[resource].allocation) + ";";
+    }
+}
+
+void RenderGraph::execute() {
+    for (int p: order) {
+        const PassNode &pass = passes[p];
+        std::vector<Resource> attachments;
+        bool backbuffer = false;
+        for (Resource resource: pass.writes) {
+            const ResourceNode &node = resources[resource];
+            if (!node.attachable) continue;
+            if (node.imported && node.importedName == 0) backbuffer = true;
+            else attachments.push_back(resource);
+        }
+        if (backbuffer || !attachments.empty()) {
+            const TextureDesc &desc = resources[backbuffer ? pass.writes.front() : attachments.front()].desc;
+            glBindFramebuffer(GL_FRAMEBUFFER, backbuffer ? 0 : framebufferFor(attachments));
+            glViewport(0, 0, desc.width, desc.height);
+        }
+        pass.execute(Context(*this));
+    }
+}
+
+void RenderGraph::report() const {
+    std::cout << "Render graph (" << (aliasing ? "aliasing" : "no aliasing") << "):\n";
+    for (size_t position = 0; position < order.size(); position++) {
+        const PassNode &pass = passes[order[position]];
+        std::cout << "  " << position << " " << pass.name << "\n";
+    }
+    for (const auto &pass: passes) {
+        if (pass.culled) std::cout << "  culled " << pass.name << "\n";
+    }
+    for (const auto &node: resources) {
+        if (node.imported || node.firstUse < 0) continue;
+        char line[160];
+        std::snprintf(line, sizeof(line), "  %-16s %4dx%-4d %7.2f MB  passes %d-%d  -> allocation %d\n",
+                      node.name.c_str(), node.desc.width, node.desc.height,
+                      static_cast<double>(sizeOf(node.desc)) / 1.0e6, node.firstUse, node.lastUse, node.allocation);
+        std::cout << line;
+    }
+    char total[160];
+    std::snprintf(total, sizeof(total),
+                  "  peak transient memory: %.2f MB in %d allocations (%.2f MB in %d without aliasing)\n",
+                  static_cast<double>(stats.aliasedBytes) / 1.0e6, stats.allocations,
+                  static_cast<double>(stats.unaliasedBytes) / 1.0e6, stats.transients);
+    std::cout << total;
+}
+
+GLuint RenderGraph::objectOf(Resource resource) const {
+    const ResourceNode &node = resources[resource];
+    if (node.imported) return node.importedName;
+    return node.allocation >= 0 ? pool[node.allocation].name : 0;
+}
+
+bool RenderGraph::isRenderbuffer(Resource resource) const {
+    const TextureDesc &desc = resources[resource].desc;
+    return !resources[resource].imported && (desc.renderbuffer || desc.samples > 1);
+}
+
+GLuint RenderGraph::framebufferFor(const std::vector<Resource> &attachments) {
+    // Texture and renderbuffer names may coincide, so the kind is part of the key
+    std::vector<long long> key;
+    for (Resource resource: attachments) {
+        key.push_back((static_cast<long long>(objectOf(resource)) << 1) | (isRenderbuffer(resource) ? 1 : 0));
+    }
+    auto found = framebuffers.find(key);
+    if (found != framebuffers.end()) return found->second;
+
+    GLuint framebuffer;
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    std::vector<GLenum> drawBuffers;
+    for (Resource resource: attachments) {
+        const GLenum format = resources[resource].desc.format;
+        GLenum attachment;
+        if (isDepthFormat(format)) {
+            attachment = hasStencil(format) ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+        } else {
+            attachment = GL_COLOR_ATTACHMENT0 + static_cast<GLenum>(drawBuffers.size());
+            drawBuffers.push_back(attachment);
+        }
+        if (isRenderbuffer(resource)) {
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, attachment, GL_RENDERBUFFER, objectOf(resource));
+        } else {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, objectOf(resource), 0);
+        }
+    }
+    if (drawBuffers.empty()) {
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+    } else {
+        glDrawBuffers(static_cast<GLsizei>(drawBuffers.size()), drawBuffers.data());
+    }
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cout << "ERROR::RENDER_GRAPH::FRAMEBUFFER_INCOMPLETE" << std::endl;
+    }
+    framebuffers.emplace(key, framebuffer);
+    return framebuffer;
+}
+
+void RenderGraph::releasePool(size_t index) {
+    Allocation &entry = pool[index];
+    if (!entry.name) return;
+    const bool renderbuffer = entry.desc.renderbuffer || entry.desc.samples > 1;
+    const long long key = (static_cast<long long>(entry.name) << 1) | (renderbuffer ? 1 : 0);
+    for (auto it = framebuffers.begin(); it != framebuffers.end();) {
+        if (std::find(it->first.begin(), it->first.end(), key) != it->first.end()) {
+            glDeleteFramebuffers(1, &it->second);
+            it = framebuffers.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    if (renderbuffer) glDeleteRenderbuffers(1, &entry.name);
+    else glDeleteTextures(1, &entry.name);
+    entry.name = 0;
+}
@@ -0,0 +1,175 @@
+#ifndef RENDER_GRAPH_H
+#define RENDER_GRAPH_H
+
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <map>
+#include <string>
+#include <vector>
+#include "glad.h"
+
+/*
+ * RenderGraph Class
+ * Describes a frame as passes that read and write textures, then runs them.
+ * The passes are declared again every frame (reset, import/addPass, compile, execute). compile() culls passes
+ * whose results nobody reads, orders the rest so every texture is written before it is read, and gives
+ * transient textures whose lifetimes do not overlap the same GL texture or renderbuffer when their formats
+ * match. GL objects are pooled across frames, so a steady frame allocates nothing.
+ * Imported textures (histories, shadow maps, the default framebuffer) belong to the caller and are never aliased.
+ */
+class RenderGraph {
+public:
+    using Resource = int;
+
+    struct TextureDesc {
+        int width = 0, height = 0;
+        GLenum format = GL_RGBA8;
+        int samples = 1;           // More than 1 needs a renderbuffer
+        bool renderbuffer = false; // Never sampled, only attached
+
+        bool operator==(const TextureDesc &that) const {
+            return width == that.width && height == that.height && format == that.format &&
+                   samples == that.samples && renderbuffer == that.renderbuffer;
+        }
+    };
+
+    // Declares what one pass uses; handed to the setup callback of addPass()
+    class Builder {
+    public:
+        // New transient texture, first written by this pass
+        Resource create(const std::string &name, const TextureDesc &desc);
+
+        void read(Resource resource);
+
+        // Attaches the resource to the pass's framebuffer. Writing a resource an earlier pass wrote keeps
+        // its contents, so it also counts as reading it
+        void write(Resource resource);
+
+        // Keeps the pass even if nothing reads what it writes (presenting, queries)
+        void sideEffect();
+
+    private:
+        friend class RenderGraph;
+
+        Builder(RenderGraph &graph, int pass) : graph(graph), pass(pass) {
+        }
+
+        RenderGraph &graph;
+        int pass;
+    };
+
+    // Resolves resources to GL objects while a pass executes
+    class Context {
+    public:
+        GLuint texture(Resource resource) const;
+
+        // Framebuffer with the resources attached: colour in the given order, depth formats as depth
+        GLuint framebuffer(std::initializer_list<Resource> attachments) const;
+
+    private:
+        friend class RenderGraph;
+
+        explicit Context(RenderGraph &graph) : graph(graph) {
+        }
+
+        RenderGraph &graph;
+    };
+
+    using Setup = std::function<void(Builder &)>;
+    using Execute = std::function<void(const Context &)>;
+
+    struct Stats {
+        int passes = 0;
+        int culled = 0;
+        int transients = 0;
+        int allocations = 0;       // GL objects backing the transients
+        size_t aliasedBytes = 0;   // Transient memory as allocated
+        size_t unaliasedBytes = 0; // Transient memory if every transient had its own allocation
+    };
+
+    RenderGraph() = default;
+
+    ~RenderGraph();
+
+    RenderGraph(const RenderGraph &) = delete;
+
+    RenderGraph &operator=(const RenderGraph &) = delete;
+
+    // Starts declaring a new frame
+    void reset();
+
+    // A texture owned by the caller. "texture" 0 stands for the default framebuffer; non-attachable
+    // resources (e.g. texture arrays the pass renders into itself) are only used for ordering and culling
+    Resource import(const std::string &name, GLuint texture, const TextureDesc &desc, bool attachable = true);
+
+    void addPass(const std::string &name, const Setup &setup, const Execute &execute);
+
+    // Culls, orders and assigns GL objects to the transients
+    void compile();
+
+    // Runs the compiled passes in order. Each pass starts with the framebuffer of the resources it writes
+    // bound and the viewport covering them; passes writing nothing attachable get no framebuffer
+    void execute();
+
+    // Off: every transient gets its own allocation, to compare memory
+    void setAliasing(bool enabled) { aliasing = enabled; }
+
+    bool isAliasing() const { return aliasing; }
+
+    // Whether the last compile() ordered, culled or allocated differently from the one before
+    bool layoutChanged() const { return layout != previous_layout; }
+
+    // Prints the pass order, culled passes, allocations and transient memory with and without aliasing
+    void report() const;
+
+    const Stats &getStats() const { return stats; }
+
+private:
+    struct ResourceNode {
+        std::string name;
+        TextureDesc desc;
+        bool imported = false;
+        bool attachable = true;
+        GLuint importedName = 0;
+        int allocation = -1;      // Pool entry of a transient
+        std::vector<int> writers; // Passes in declaration order
+        int firstUse = -1, lastUse = -1; // Positions in the execution order
+    };
+
+    struct PassNode {
+        std::string name;
+        Execute execute;
+        std::vector<Resource> reads, writes;
+        bool sideEffect = false;
+        bool culled = false;
+    };
+
+    struct Allocation {
+        TextureDesc desc;
+        GLuint name = 0;
+        int lastFrame = 0; // Last frame it backed a transient
+        int busyUntil = -1; // Execution position of its current transient's last use, this frame
+    };
+
+    GLuint objectOf(Resource resource) const;
+
+    bool isRenderbuffer(Resource resource) const;
+
+    GLuint framebufferFor(const std::vector<Resource> &attachments);
+
+    void releasePool(size_t index);
+
+    std::vector<ResourceNode> resources;
+    std::vector<PassNode> passes;
+    std::vector<int> order; // Live passes in execution order
+
+    std::vector<Allocation> pool;
+    std::map<std::vector<long long>, GLuint> framebuffers; // Keyed by attached objects
+    int frame = 0;
+    bool aliasing = true;
+    std::string layout, previous_layout;
+    Stats stats;
+};
+
+#endif // RENDER_GRAPH_H
@@ -0,0 +1,75 @@
+#include "render_queue.h"
+#include "model.h"
+#include "occlusion_query.h"
+#include "shader_variants.h"
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+
+void RenderQueue::sortFrontToBack(const glm::vec3 &cameraPosition) {
+    // Distance to the closest point of the box: large objects the camera is near (ground, cabin) sort early
+    auto distance2 = [&](const DrawItem &item) {
+        glm::vec3 closest = glm::clamp(cameraPosition, item.worldBounds.min, item.worldBounds.max);
+        glm::vec3 d = closest - cameraPosition;
+        return glm::dot(d, d);
+    };
+    std::stable_sort(items.begin(), items.end(), [&](const DrawItem &a, const DrawItem &b) {
+        return distance2(a) < distance2(b);
+    });
+}
+
+void RenderQueue::draw(ShaderVariants &shaders, unsigned passFeatures, OcclusionQueries *queries, Filter filter) {
+    stats = Stats();
+    // Single-pass stereo draws everything once per eye
+    const GLsizei views = (passFeatures & ShaderVariants::STEREO) ? 2 : 1;
+    const ShaderProgram *bound = nullptr;
+    GLuint boundTexture = 0;
+
+    for (size_t i = 0; i < items.size(); i++) {
+        const DrawItem &item = items[i];
+        if (filter == Filter::Opaque && item.alphaTested) continue;
+        if (filter == Filter::AlphaTested && !item.alphaTested) continue;
+
+        const bool queried = queries && item.occlusionQuery >= 0;
+        if (queried && !queries->beginDraw(item.occlusionQuery)) {
+            stats.skipped++;
+            continue;
+        }
+
+        const bool instanced = item.model && item.instanceCount > 0;
+        unsigned features = ShaderVariants::materialFeatures(item.useTexture, item.unlit, item.alphaTested);
+        if (instanced) features |= ShaderVariants::INSTANCED;
+        const ShaderProgram &program = shaders.get(features | passFeatures);
+        if (&program != bound) {
+            glUseProgram(program.id);
+            bound = &program;
+        }
+
+        if (!instanced) {
+            glm::mat3 normalMat = glm::transpose(glm::inverse(glm::mat3(item.transform)));
+            glUniformMatrix4fv(program.model, 1, GL_FALSE, glm::value_ptr(item.transform));
+            glUniformMatrix3fv(program.normalMat, 1, GL_FALSE, glm::value_ptr(normalMat));
+        }
+        glUniform3fv(program.objectColor, 1, glm::value_ptr(item.objectColor));
+        if ((program.features & ShaderVariants::TEXTURED) && item.texture != boundTexture) {
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, item.texture);
+            boundTexture = item.texture;
+        }
+
+        if (instanced) {
+            item.model->drawInstanced(item.instanceCount * views);
+        } else if (item.model && views > 1) {
+            item.model->drawInstanced(views);
+        } else if (item.model) {
+            item.model->draw(program.id);
+        } else {
+            glBindVertexArray(item.vao);
+            glDrawElementsInstanced(GL_TRIANGLES, item.indexCount, GL_UNSIGNED_INT, nullptr, views);
+        }
+        stats.drawn++;
+
+        if (queried) queries->endDraw(item.occlusionQuery);
+    }
+
+    glBindVertexArray(0);
+}
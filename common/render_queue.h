@@ -0,0 +1,73 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "glad.h"
+
+#include "bounds.h"
+
+class Model;
+class OcclusionQueries;
+class ShaderVariants;
+
+/*
+ * DrawItem struct
+ * One opaque draw of the frame: either a Model or a raw indexed VAO, with its transform and material.
+ * A Model with instanceCount > 0 is drawn instanced from the buffer set with Model::setInstanceBuffer,
+ * and "transform" is ignored.
+ */
+struct DrawItem {
+    const Model *model = nullptr;
+    GLuint vao = 0;
+    GLsizei indexCount = 0;
+    GLsizei instanceCount = 0;
+
+    glm::mat4 transform = glm::mat4(1.0f);
+    AABB worldBounds;
+
+    GLuint texture = 0;
+    bool useTexture = true;
+    bool unlit = false;
+    bool alphaTested = false; // Foliage: needs the alpha-tested depth pre-pass variant
+    glm::vec3 objectColor = glm::vec3(1.0f);
+
+    int occlusionQuery = -1; // Index into OcclusionQueries, or -1
+};
+
+/*
+ * RenderQueue Class
+ * Collects the frame's opaque draws so they can be sorted and drawn more than once (depth pre-pass + shading).
+ * Each item is drawn with the shader permutation matching its material, switching programs only when it changes.
+ */
+class RenderQueue {
+public:
+    enum class Filter { All, Opaque, AlphaTested };
+
+    struct Stats {
+        int drawn = 0;
+        int skipped = 0; // Rejected by occlusion queries
+    };
+
+    void clear() { items.clear(); }
+
+    void add(const DrawItem &item) { items.push_back(item); }
+
+    // Sorts by distance from the camera to the bounds, nearest first, so early-z rejects more
+    void sortFrontToBack(const glm::vec3 &cameraPosition);
+
+    // Draws the items matching "filter". "passFeatures" are added to every item's shader features
+    // (e.g. DEPTH_ONLY). With "queries" set, items with an occlusion query go through beginDraw()/endDraw().
+    // With STEREO every draw is instanced twice; instanced models need an instance divisor of 2 then
+    void draw(ShaderVariants &shaders, unsigned passFeatures, OcclusionQueries *queries, Filter filter = Filter::All);
+
+    const std::vector<DrawItem> &getItems() const { return items; }
+
+    const Stats &getStats() const { return stats; }
+
+private:
+    std::vector<DrawItem> items;
+    Stats stats;
+};
+
+#endif // RENDER_QUEUE_H
@@ -0,0 +1,203 @@
+#include "shader_variants.h"
+#include "program_cache.h"
+#include <glm/gtc/type_ptr.hpp>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace {
+    const char *const FEATURE_NAMES[ShaderVariants::FEATURE_COUNT] = {
+        "TEXTURED", "UNLIT", "INSTANCED", "ALPHA_TEST", "DEPTH_ONLY", "STEREO", "ANALYTIC", "SOFT", "OIT"
+    };
+
+    std::string readSource(const std::string &path) {
+        std::ifstream file(path);
+        if (!file) {
+            std::cout << "ERROR::SHADER::FILE_NOT_READ " << path << std::endl;
+            return "";
+        }
+        std::stringstream stream;
+        stream << file.rdbuf();
+        return stream.str();
+    }
+
+    // #version has to stay the first statement, so the defines go on the line after it
+    std::string withDefines(const std::string &source, unsigned features) {
+        std::string defines;
+        for (int i = 0; i < ShaderVariants::FEATURE_COUNT; i++) {
+            if (features & (1u << i)) defines += std::string("#define ") + FEATURE_NAMES[i] + "\n";
+        }
+        size_t versionLine = source.find("#version");
+        size_t insertAt = versionLine == std::string::npos ? 0 : source.find('\n', versionLine);
+        insertAt = insertAt == std::string::npos ? source.size() : insertAt + 1;
+        return source.substr(0, insertAt) + defines + source.substr(insertAt);
+    }
+
+    GLuint compileStage(GLenum type, const std::string &source, const std::string &label) {
+        GLuint shader = glCreateShader(type);
+        const char *code = source.c_str();
+        glShaderSource(shader, 1, &code, nullptr);
+        glCompileShader(shader);
+        int success;
+        char infoLog[512];
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+        if (!success) {
+            glGetShaderInfoLog(shader, 512, nullptr, infoLog);
+            std::cout << "ERROR::SHADER::" << (type == GL_VERTEX_SHADER ? "VERTEX" : "FRAGMENT")
+                    << "::COMPILATION_FAILED (" << label << ")\n" << infoLog << std::endl;
+        }
+        return shader;
+    }
+}
+
+ShaderVariants::ShaderVariants(const char *vertexPath, const char *fragmentPath, ProgramCache *cache)
+    : vertex_path(vertexPath), fragment_path(fragmentPath), program_cache(cache) {
+    vertex_source = readSource(vertex_path);
+    fragment_source = readSource(fragment_path);
+}
+
+ShaderVariants::~ShaderVariants() {
+    for (const auto &entry: programs) {
+        glDeleteProgram(entry.second.id);
+    }
+}
+
+const ShaderProgram &ShaderVariants::get(unsigned features) {
+    features = normalize(features);
+    auto found = programs.find(features);
+    if (found != programs.end()) return found->second;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    const std::string label = vertex_path + " + " + fragment_path + " [" + featureNames(features) + "]";
+
+    const std::string vertexSource = withDefines(vertex_source, features);
+    const std::string fragmentSource = withDefines(fragment_source, features);
+    // Shaders are flagged for deletion right away and go with the program
+    auto attachShaders = [&](GLuint id) {
+        GLuint vertex = compileStage(GL_VERTEX_SHADER, vertexSource, label);
+        GLuint fragment = compileStage(GL_FRAGMENT_SHADER, fragmentSource, label);
+        glAttachShader(id, vertex);
+        glAttachShader(id, fragment);
+        glDeleteShader(vertex);
+        glDeleteShader(fragment);
+    };
+
+    ShaderProgram program;
+    program.features = features;
+    if (program_cache) {
+        program.id = program_cache->getProgram(vertexSource, fragmentSource, label, attachShaders,
+                                               &program.fromCache);
+    } else {
+        program.id = glCreateProgram();
+        attachShaders(program.id);
+        glLinkProgram(program.id);
+    }
+    int success;
+    char infoLog[512];
+    glGetProgramiv(program.id, GL_LINK_STATUS, &success);
+    if (!success) {
+        glGetProgramInfoLog(program.id, 512, nullptr, infoLog);
+        std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED (" << label << ")\n" << infoLog << std::endl;
+    }
+
+    program.model = glGetUniformLocation(program.id, "model");
+    program.normalMat = glGetUniformLocation(program.id, "normalMat");
+    program.view = glGetUniformLocation(program.id, "view");
+    program.proj = glGetUniformLocation(program.id, "proj");
+    program.viewPos = glGetUniformLocation(program.id, "viewPos");
+    program.lightPos = glGetUniformLocation(program.id, "lightPos");
+    program.lightColor = glGetUniformLocation(program.id, "lightColor");
+    program.ambientColor = glGetUniformLocation(program.id, "ambientColor");
+    program.objectColor = glGetUniformLocation(program.id, "objectColor");
+    program.shininess = glGetUniformLocation(program.id, "shininess");
+    program.alphaCutoff = glGetUniformLocation(program.id, "alphaCutoff");
+    program.clusterGrid = glGetUniformLocation(program.id, "clusterGrid");
+    program.clusterSliceScaleBias = glGetUniformLocation(program.id, "clusterSliceScaleBias");
+    program.clusterViewProjection = glGetUniformLocation(program.id, "clusterViewProjection");
+    program.shadowMatrices = glGetUniformLocation(program.id, "shadowMatrices");
+    program.shadowSplits = glGetUniformLocation(program.id, "shadowSplits");
+    program.shadowCascadeCount = glGetUniformLocation(program.id, "shadowCascadeCount");
+    program.stereoHalfSeparation = glGetUniformLocation(program.id, "stereoHalfSeparation");
+
+    glUseProgram(program.id);
+    glUniform1i(glGetUniformLocation(program.id, "texture_diffuse1"), DIFFUSE_UNIT);
+    glUniform1i(glGetUniformLocation(program.id, "lightData"), LIGHT_BUFFER_UNIT);
+    glUniform1i(glGetUniformLocation(program.id, "clusterRanges"), LIGHT_BUFFER_UNIT + 1);
+    glUniform1i(glGetUniformLocation(program.id, "lightIndices"), LIGHT_BUFFER_UNIT + 2);
+    glUniform1i(glGetUniformLocation(program.id, "shadowMap"), SHADOW_MAP_UNIT);
+    applyFrameUniforms(program);
+
+    program.compileMs = std::chrono::duration<double, std::milli>(
+        std::chrono::high_resolution_clock::now() - start).count();
+    return programs.emplace(features, program).first->second;
+}
+
+void ShaderVariants::setFrameUniforms(const FrameUniforms &uniforms) {
+    frame_uniforms = uniforms;
+    for (const auto &entry: programs) {
+        glUseProgram(entry.second.id);
+        applyFrameUniforms(entry.second);
+    }
+}
+
+void ShaderVariants::applyFrameUniforms(const ShaderProgram &program) const {
+    // Expects the program to be bound
+    glUniformMatrix4fv(program.view, 1, GL_FALSE, glm::value_ptr(frame_uniforms.view));
+    glUniformMatrix4fv(program.proj, 1, GL_FALSE, glm::value_ptr(frame_uniforms.proj));
+    glUniform3fv(program.viewPos, 1, glm::value_ptr(frame_uniforms.viewPos));
+    glUniform3fv(program.lightPos, 1, glm::value_ptr(frame_uniforms.lightPos));
+    glUniform3fv(program.lightColor, 1, glm::value_ptr(frame_uniforms.lightColor));
+    glUniform3fv(program.ambientColor, 1, glm::value_ptr(frame_uniforms.ambientColor));
+    glUniform1f(program.shininess, frame_uniforms.shininess);
+    glUniform1f(program.alphaCutoff, frame_uniforms.alphaCutoff);
+    glUniform3iv(program.clusterGrid, 1, glm::value_ptr(frame_uniforms.clusterGrid));
+    glUniform2fv(program.clusterSliceScaleBias, 1, glm::value_ptr(frame_uniforms.clusterSliceScaleBias));
+    glUniformMatrix4fv(program.clusterViewProjection, 1, GL_FALSE,
+                       glm::value_ptr(frame_uniforms.clusterViewProjection));
+    glUniformMatrix4fv(program.shadowMatrices, ShadowCascades::MAX_CASCADES, GL_FALSE,
+                       glm::value_ptr(frame_uniforms.shadowMatrices[0]));
+    glUniform4fv(program.shadowSplits, 1, glm::value_ptr(frame_uniforms.shadowSplits));
+    glUniform1i(program.shadowCascadeCount, frame_uniforms.shadowCascadeCount);
+    glUniform1f(program.stereoHalfSeparation, frame_uniforms.stereoHalfSeparation);
+}
+
+void ShaderVariants::report() const {
+    std::cout << "Shader variants of " << vertex_path << " + " << fragment_path << ":\n";
+    for (const auto &entry: programs) {
+        char line[160];
+        std::snprintf(line, sizeof(line), "  key 0x%02x  program %3u  %7.2f ms %-8s  %s\n", entry.first,
+                      entry.second.id, entry.second.compileMs, entry.second.fromCache ? "(binary)" : "",
+                      featureNames(entry.first).c_str());
+        std::cout << line;
+    }
+}
+
+unsigned ShaderVariants::normalize(unsigned features) {
+    // Alpha testing reads the texture
+    if (!(features & TEXTURED)) features &= ~ALPHA_TEST;
+    if (features & DEPTH_ONLY) {
+        features &= ~UNLIT;
+        if (!(features & ALPHA_TEST)) features &= ~TEXTURED;
+    }
+    return features;
+}
+
+unsigned ShaderVariants::materialFeatures(bool useTexture, bool unlit, bool alphaTested) {
+    unsigned features = 0;
+    if (useTexture) features |= TEXTURED;
+    if (unlit) features |= UNLIT;
+    if (alphaTested) features |= ALPHA_TEST;
+    return normalize(features);
+}
+
+std::string ShaderVariants::featureNames(unsigned features) {
+    std::string names;
+    for (int i = 0; i < FEATURE_COUNT; i++) {
+        if (!(features & (1u << i))) continue;
+        if (!names.empty()) names += "|";
+        names += FEATURE_NAMES[i];
+    }
+    return names.empty() ? "-" : names;
+}
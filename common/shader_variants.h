@@ -0,0 +1,119 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include <map>
+#include <string>
+#include <glm/glm.hpp>
+#include "glad.h"
+
+#include "shadow_cascades.h"
+
+class ProgramCache;
+
+/*
+ * ShaderProgram struct
+ * One linked permutation of a shader pair and the uniform locations the draw code needs.
+ * Locations of uniforms a permutation compiled out are -1, which GL silently ignores.
+ */
+struct ShaderProgram {
+    GLuint id = 0;
+    unsigned features = 0;
+    double compileMs = 0.0;
+    bool fromCache = false; // Loaded as a program binary
+
+    GLint model, normalMat, view, proj;
+    GLint viewPos, lightPos, lightColor, ambientColor, objectColor, shininess;
+    GLint alphaCutoff;
+    GLint clusterGrid, clusterSliceScaleBias, clusterViewProjection;
+    GLint shadowMatrices, shadowSplits, shadowCascadeCount;
+    GLint stereoHalfSeparation;
+};
+
+/*
+ * ShaderVariants Class
+ * Compiles one vertex/fragment source pair into permutations selected by #define feature sets.
+ * The defines are inserted right after the #version line, so a feature that is off removes its code path
+ * at compile time instead of branching on a uniform per fragment. Programs are compiled on first use and
+ * cached by their feature key. With a ProgramCache, linked permutations are also kept on disk between runs.
+ */
+class ShaderVariants {
+public:
+    enum Feature : unsigned {
+        TEXTURED = 1u << 0,   // Base colour from texture_diffuse1 instead of objectColor
+        UNLIT = 1u << 1,      // Skip lighting
+        INSTANCED = 1u << 2,  // Model matrix from per-instance attributes (locations 3-6)
+        ALPHA_TEST = 1u << 3, // Discard texels below alphaCutoff
+        DEPTH_ONLY = 1u << 4, // No colour output, for the depth pre-pass
+        STEREO = 1u << 5,     // Both eyes side by side from one draw instanced twice, see StereoRig
+        ANALYTIC = 1u << 6,   // Particles computed from their spawn time and seed, see AnalyticParticles
+        SOFT = 1u << 7,       // Particles fade against the scene depth, see OffscreenParticles
+        OIT = 1u << 8         // Particles write weighted blended OIT accumulation and revealage, see WeightedOit
+    };
+    static constexpr int FEATURE_COUNT = 9;
+
+    // Texture units the scene shader samples from
+    enum TextureUnit : GLuint {
+        DIFFUSE_UNIT = 0,
+        LIGHT_BUFFER_UNIT = 1, // Three consecutive units, see LightBuffers
+        SHADOW_MAP_UNIT = 4
+    };
+
+    // Uniforms shared by every permutation, applied to all of them once per frame
+    struct FrameUniforms {
+        glm::mat4 view = glm::mat4(1.0f);
+        glm::mat4 proj = glm::mat4(1.0f);
+        glm::vec3 viewPos = glm::vec3(0.0f);
+        glm::vec3 lightPos = glm::vec3(0.0f);
+        glm::vec3 lightColor = glm::vec3(1.0f);
+        glm::vec3 ambientColor = glm::vec3(0.0f);
+        float shininess = 32.0f;
+        float alphaCutoff = 0.5f;
+        // Clustered lighting, see LightClusters
+        glm::ivec3 clusterGrid = glm::ivec3(1);
+        glm::vec2 clusterSliceScaleBias = glm::vec2(0.0f);
+        glm::mat4 clusterViewProjection = glm::mat4(1.0f); // Projection and view the lights were assigned with
+        // Shadows of the controllable light, see ShadowCascades. No shadows with a count of 0
+        int shadowCascadeCount = 0;
+        glm::mat4 shadowMatrices[ShadowCascades::MAX_CASCADES];
+        glm::vec4 shadowSplits = glm::vec4(0.0f);
+        // Eye offset of the STEREO permutations, half the eye separation
+        float stereoHalfSeparation = 0.0f;
+    };
+
+    ShaderVariants(const char *vertexPath, const char *fragmentPath, ProgramCache *cache = nullptr);
+
+    ~ShaderVariants();
+
+    ShaderVariants(const ShaderVariants &) = delete;
+
+    ShaderVariants &operator=(const ShaderVariants &) = delete;
+
+    // Returns the program for a feature set, compiling it on first use.
+    // The returned reference stays valid for the lifetime of this object
+    const ShaderProgram &get(unsigned features);
+
+    void setFrameUniforms(const FrameUniforms &uniforms);
+
+    // Prints every compiled permutation with its defines and compile time
+    void report() const;
+
+    // Drops features that mean nothing in combination (e.g. lighting in a depth-only pass)
+    static unsigned normalize(unsigned features);
+
+    // Feature set for a material
+    static unsigned materialFeatures(bool useTexture, bool unlit, bool alphaTested);
+
+    // "TEXTURED|UNLIT", or "-" for none
+    static std::string featureNames(unsigned features);
+
+private:
+    void applyFrameUniforms(const ShaderProgram &program) const;
+
+    std::string vertex_path, fragment_path;
+    std::string vertex_source, fragment_source;
+    ProgramCache *program_cache;
+    std::map<unsigned, ShaderProgram> programs;
+    FrameUniforms frame_uniforms;
+};
+
+#endif // SHADER_VARIANTS_H
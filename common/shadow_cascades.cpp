@@ -0,0 +1,175 @@
+#include "shadow_cascades.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace {
+    GLuint createDepthArray(int resolution, int layers, bool comparison) {
+        GLuint texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT32F, resolution, resolution, layers, 0,
+                     GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+        // Sampled with hardware 2x2 PCF; the cached array is only ever blitted from
+        const GLint filter = comparison ? GL_LINEAR : GL_NEAREST;
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+        const float border[4] = {1.0f, 1.0f, 1.0f, 1.0f}; // Outside the map counts as lit
+        glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border);
+        if (comparison) {
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+        }
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        return texture;
+    }
+}
+
+ShadowCascades::ShadowCascades(int resolution, int cascadeCount)
+    : resolution(resolution), cascade_count(std::clamp(cascadeCount, 1, MAX_CASCADES)) {
+    shadow_texture = createDepthArray(resolution, cascade_count, true);
+    static_texture = createDepthArray(resolution, cascade_count, false);
+
+    glGenFramebuffers(1, &shadow_fbo);
+    glGenFramebuffers(1, &static_fbo);
+    for (GLuint framebuffer: {shadow_fbo, static_fbo}) {
+        attachLayer(framebuffer, GL_FRAMEBUFFER, framebuffer == shadow_fbo ? shadow_texture : static_texture, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cout << "ERROR::SHADOW::FRAMEBUFFER_INCOMPLETE" << std::endl;
+        }
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    for (int c = 0; c < MAX_CASCADES; c++) {
+        light_view_proj[c] = cached_view_proj[c] = shadow_matrices[c] = glm::mat4(1.0f);
+        footprint_min[c] = footprint_max[c] = glm::vec2(0.0f);
+    }
+}
+
+ShadowCascades::~ShadowCascades() {
+    glDeleteFramebuffers(1, &shadow_fbo);
+    glDeleteFramebuffers(1, &static_fbo);
+    glDeleteTextures(1, &shadow_texture);
+    glDeleteTextures(1, &static_texture);
+}
+
+void ShadowCascades::update(const glm::mat4 &view, float fovY, float aspect, float zNear, float shadowDistance,
+                            const glm::vec3 &lightDirection, const AABB &sceneBounds) {
+    const glm::vec3 direction = glm::length(lightDirection) > 1e-4f ? glm::normalize(lightDirection)
+                                                                     : glm::vec3(0.0f, -1.0f, 0.0f);
+    const glm::vec3 up = std::abs(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    light_view = glm::lookAt(glm::vec3(0.0f), direction, up);
+
+    // Every cascade spans the whole scene in depth, so casters outside the camera frustum still cast
+    const AABB lightScene = sceneBounds.transformed(light_view);
+    const float lightNear = -lightScene.max.z - 1.0f;
+    const float lightFar = -lightScene.min.z + 1.0f;
+
+    const glm::mat4 inverseView = glm::inverse(view);
+    const float tanY = std::tan(fovY * 0.5f);
+    const float tanX = tanY * aspect;
+    // Maps clip space [-1, 1] to texture space [0, 1]
+    const glm::mat4 bias = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(0.5f)), glm::vec3(0.5f));
+
+    float sliceNear = zNear;
+    for (int c = 0; c < cascade_count; c++) {
+        // Blend of logarithmic and uniform splits
+        const float t = static_cast<float>(c + 1) / static_cast<float>(cascade_count);
+        const float logSplit = zNear * std::pow(shadowDistance / zNear, t);
+        const float uniformSplit = zNear + (shadowDistance - zNear) * t;
+        const float sliceFar = glm::mix(uniformSplit, logSplit, 0.75f);
+        splits[c] = sliceFar;
+
+        // Bounding sphere of the slice. Its radius does not change when the camera turns, so neither does the
+        // cascade's size (rounded so float noise cannot change it either)
+        glm::vec3 corners[8];
+        glm::vec3 center(0.0f);
+        for (int i = 0; i < 8; i++) {
+            const float d = i & 4 ? sliceFar : sliceNear;
+            corners[i] = glm::vec3((i & 1 ? tanX : -tanX) * d, (i & 2 ? tanY : -tanY) * d, -d);
+            center += corners[i] / 8.0f;
+        }
+        float radius = 0.0f;
+        for (const auto &corner: corners) radius = std::max(radius, glm::length(corner - center));
+        radius = std::ceil(radius * 16.0f) / 16.0f;
+
+        // Snap the center to a grid of whole texels, an eighth of the radius wide, and grow the box by that
+        // margin: the cascade only moves when the camera leaves its grid cell
+        const float margin = radius * 0.125f;
+        const float half = radius + margin;
+        const float texel = 2.0f * half / static_cast<float>(resolution);
+        const float step = std::max(std::floor(margin / texel), 1.0f) * texel;
+        const glm::vec3 lightCenter = glm::vec3(light_view * inverseView * glm::vec4(center, 1.0f));
+        const float x = std::floor(lightCenter.x / step) * step;
+        const float y = std::floor(lightCenter.y / step) * step;
+
+        footprint_min[c] = glm::vec2(x - half, y - half);
+        footprint_max[c] = glm::vec2(x + half, y + half);
+        light_view_proj[c] = glm::ortho(x - half, x + half, y - half, y + half, lightNear, lightFar) * light_view;
+        shadow_matrices[c] = bias * light_view_proj[c];
+        sliceNear = sliceFar;
+    }
+}
+
+void ShadowCascades::render(const DrawCasters &drawStatic, const DrawCasters &drawDynamic) {
+    GLint previousFramebuffer = 0;
+    GLint previousViewport[4];
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+    glGetIntegerv(GL_VIEWPORT, previousViewport);
+
+    stats.staticRedraws = 0;
+    glViewport(0, 0, resolution, resolution);
+    // Slope-scaled bias against shadow acne
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(2.0f, 4.0f);
+
+    for (int c = 0; c < cascade_count; c++) {
+        if (!static_valid[c] || cached_view_proj[c] != light_view_proj[c]) {
+            attachLayer(static_fbo, GL_FRAMEBUFFER, static_texture, c);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            drawStatic(c, light_view_proj[c]);
+            cached_view_proj[c] = light_view_proj[c];
+            static_valid[c] = true;
+            stats.staticRedraws++;
+        }
+
+        // Start from the cached static depth, then add what moves
+        attachLayer(static_fbo, GL_READ_FRAMEBUFFER, static_texture, c);
+        attachLayer(shadow_fbo, GL_DRAW_FRAMEBUFFER, shadow_texture, c);
+        glBlitFramebuffer(0, 0, resolution, resolution, 0, 0, resolution, resolution, GL_DEPTH_BUFFER_BIT,
+                          GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, shadow_fbo);
+        drawDynamic(c, light_view_proj[c]);
+    }
+    stats.staticRedrawsTotal += stats.staticRedraws;
+
+    glDisable(GL_POLYGON_OFFSET_FILL);
+    glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+    glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+}
+
+void ShadowCascades::invalidate() {
+    for (bool &valid: static_valid) valid = false;
+}
+
+bool ShadowCascades::intersects(int cascade, const AABB &worldBounds) const {
+    const AABB box = worldBounds.transformed(light_view);
+    return box.max.x >= footprint_min[cascade].x && box.min.x <= footprint_max[cascade].x &&
+           box.max.y >= footprint_min[cascade].y && box.min.y <= footprint_max[cascade].y;
+}
+
+void ShadowCascades::bind(GLuint unit) const {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, shadow_texture);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void ShadowCascades::attachLayer(GLuint framebuffer, GLenum target, GLuint texture, int layer) const {
+    glBindFramebuffer(target, framebuffer);
+    glFramebufferTextureLayer(target, GL_DEPTH_ATTACHMENT, texture, 0, layer);
+}
@@ -0,0 +1,90 @@
+#ifndef SHADOW_CASCADES_H
+#define SHADOW_CASCADES_H
+
+#include <functional>
+#include <glm/glm.hpp>
+#include "glad.h"
+
+#include "bounds.h"
+
+/*
+ * ShadowCascades Class
+ * Cascaded shadow maps for one directional light, stored as layers of a depth texture array.
+ * Each cascade is fitted to a bounding sphere of its slice of the camera frustum and snapped to a coarse grid in
+ * light space, so its matrix stays the same while the camera moves within a grid cell. Static casters are drawn
+ * into a separate cached array and only redrawn when a cascade's matrix changes (light moved or the cascade was
+ * re-snapped); every frame the cached depth is blitted into the sampled array and the dynamic casters are drawn on
+ * top of it.
+ */
+class ShadowCascades {
+public:
+    static constexpr int MAX_CASCADES = 4;
+
+    // Draws the casters of one cascade; the framebuffer, viewport and depth state are already set up
+    using DrawCasters = std::function<void(int cascade, const glm::mat4 &lightViewProj)>;
+
+    struct Stats {
+        int staticRedraws = 0; // Cascades whose static layer was redrawn by the last render()
+        int staticRedrawsTotal = 0;
+    };
+
+    explicit ShadowCascades(int resolution = 1024, int cascadeCount = 3);
+
+    ~ShadowCascades();
+
+    ShadowCascades(const ShadowCascades &) = delete;
+
+    ShadowCascades &operator=(const ShadowCascades &) = delete;
+
+    // Splits [zNear, shadowDistance] of the camera frustum into cascades and fits one light-space box to each.
+    // "lightDirection" points from the light into the scene; "sceneBounds" must contain every caster
+    void update(const glm::mat4 &view, float fovY, float aspect, float zNear, float shadowDistance,
+                const glm::vec3 &lightDirection, const AABB &sceneBounds);
+
+    // Renders the shadow maps: drawStatic for cascades whose cached layer is out of date, drawDynamic for all.
+    // Restores the previous framebuffer and viewport
+    void render(const DrawCasters &drawStatic, const DrawCasters &drawDynamic);
+
+    // Forces the static layers to be redrawn by the next render()
+    void invalidate();
+
+    // Whether a world-space box overlaps the cascade's light-space footprint
+    bool intersects(int cascade, const AABB &worldBounds) const;
+
+    void bind(GLuint unit) const;
+
+    // Depth array sampled by the scene, one layer per cascade
+    GLuint getTexture() const { return shadow_texture; }
+
+    int getCascadeCount() const { return cascade_count; }
+
+    int getResolution() const { return resolution; }
+
+    // World to shadow-map texture space ([0, 1] in x, y and depth), one per cascade
+    const glm::mat4 *getShadowMatrices() const { return shadow_matrices; }
+
+    // View-space far distance of each cascade
+    glm::vec4 getSplits() const { return splits; }
+
+    const Stats &getStats() const { return stats; }
+
+private:
+    void attachLayer(GLuint framebuffer, GLenum target, GLuint texture, int layer) const;
+
+    int resolution;
+    int cascade_count;
+    GLuint shadow_texture = 0; // Sampled array: static + dynamic casters
+    GLuint static_texture = 0; // Cached static casters
+    GLuint shadow_fbo = 0, static_fbo = 0;
+
+    glm::mat4 light_view = glm::mat4(1.0f);
+    glm::mat4 light_view_proj[MAX_CASCADES];
+    glm::mat4 cached_view_proj[MAX_CASCADES]; // Matrix the static layer was drawn with
+    bool static_valid[MAX_CASCADES] = {};
+    glm::vec2 footprint_min[MAX_CASCADES], footprint_max[MAX_CASCADES]; // Light-space xy of each cascade
+    glm::mat4 shadow_matrices[MAX_CASCADES];
+    glm::vec4 splits = glm::vec4(0.0f);
+    Stats stats;
+};
+
+#endif // SHADOW_CASCADES_H
@@ -0,0 +1,523 @@
+#include "software_raster.h"
+#include "model.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SOFTWARE_RASTER_USE_SSE 1
+#endif
+
+namespace {
+    // Triangles are clipped against x and y only when they reach this many times the screen's half size
+    // beyond its centre, keeping edge function arithmetic in a precise range without clipping most of them
+    constexpr float GUARD_BAND = 4.0f;
+    constexpr int CLIP_PLANES = 6;
+    // Vertices are transformed in pieces of this many, so one big model spreads over the pool too
+    constexpr size_t VERTEX_BATCH = 2048;
+
+    // Signed distance to clip plane "plane", inside when >= 0: near, far, then the guard band on x and y
+    float planeDistance(const glm::vec4 &clip, int plane) {
+        switch (plane) {
+            case 0: return clip.z + clip.w;
+            case 1: return clip.w - clip.z;
+            case 2: return GUARD_BAND * clip.w + clip.x;
+            case 3: return GUARD_BAND * clip.w - clip.x;
+            case 4: return GUARD_BAND * clip.w + clip.y;
+            default: return GUARD_BAND * clip.w - clip.y;
+        }
+    }
+
+    int outcode(const glm::vec4 &clip) {
+        int code = 0;
+        for (int plane = 0; plane < CLIP_PLANES; plane++) {
+            if (planeDistance(clip, plane) < 0.0f) code |= 1 << plane;
+        }
+        return code;
+    }
+
+    // std::floor is a library call without SSE4.1; texture coordinates are far inside int range
+    int floorToInt(float x) {
+        const int i = static_cast<int>(x);
+        return i - (x < static_cast<float>(i));
+    }
+
+    glm::vec4 bilinear(const SoftwareTexture &texture, int x0, int y0, int x1, int y1, float fx, float fy) {
+        const unsigned char *row0 = &texture.rgba[static_cast<size_t>(y0) * texture.width * 4];
+        const unsigned char *row1 = &texture.rgba[static_cast<size_t>(y1) * texture.width * 4];
+        const float w00 = (1.0f - fx) * (1.0f - fy), w10 = fx * (1.0f - fy);
+        const float w01 = (1.0f - fx) * fy, w11 = fx * fy;
+        glm::vec4 result;
+        for (int c = 0; c < 4; c++) {
+            result[c] = w00 * row0[x0 * 4 + c] + w10 * row0[x1 * 4 + c] + w01 * row1[x0 * 4 + c] +
+                        w11 * row1[x1 * 4 + c];
+        }
+        return result * (1.0f / 255.0f);
+    }
+
+    unsigned int packColor(const glm::vec4 &color) {
+        const glm::vec4 c = glm::clamp(color, 0.0f, 1.0f) * 255.0f + 0.5f;
+        return static_cast<unsigned int>(c.r) | static_cast<unsigned int>(c.g) << 8 |
+               static_cast<unsigned int>(c.b) << 16 | static_cast<unsigned int>(c.a) << 24;
+    }
+}
+
+glm::vec4 SoftwareTexture::sample(const glm::vec2 &uv) const {
+    if (width <= 0 || height <= 0) return glm::vec4(1.0f);
+    // Wrap first, so the texel arithmetic stays small however far the coordinates repeat
+    const float x = (uv.x - static_cast<float>(floorToInt(uv.x))) * static_cast<float>(width) - 0.5f;
+    const float y = (uv.y - static_cast<float>(floorToInt(uv.y))) * static_cast<float>(height) - 0.5f;
+    // x0 is in [-1, width - 1] here, so one comparison per neighbour wraps it
+    const int x0 = floorToInt(x), y0 = floorToInt(y);
+    return bilinear(*this, x0 < 0 ? width - 1 : x0, y0 < 0 ? height - 1 : y0, x0 + 1 < width ? x0 + 1 : 0,
+                    y0 + 1 < height ? y0 + 1 : 0, x - static_cast<float>(x0), y - static_cast<float>(y0));
+}
+
+glm::vec4 SoftwareTexture::sampleClamped(const glm::vec2 &uv) const {
+    if (width <= 0 || height <= 0) return glm::vec4(1.0f);
+    const float x = glm::clamp(uv.x * static_cast<float>(width) - 0.5f, 0.0f, static_cast<float>(width - 1));
+    const float y = glm::clamp(uv.y * static_cast<float>(height) - 0.5f, 0.0f, static_cast<float>(height - 1));
+    const int x0 = static_cast<int>(x), y0 = static_cast<int>(y);
+    return bilinear(*this, x0, y0, std::min(x0 + 1, width - 1), std::min(y0 + 1, height - 1),
+                    x - static_cast<float>(x0), y - static_cast<float>(y0));
+}
+
+SoftwareRasterizer::SoftwareRasterizer(int width, int height, ThreadPool *pool)
+    : width(std::max(width, 1)), height(std::max(height, 1)), pool(pool) {
+    tiles_x = (this->width + TILE_SIZE - 1) / TILE_SIZE;
+    tiles_y = (this->height + TILE_SIZE - 1) / TILE_SIZE;
+    image.assign(static_cast<size_t>(this->width) * this->height * 4, 0);
+}
+
+void SoftwareRasterizer::beginFrame(const glm::mat4 &view, const glm::mat4 &projection,
+                                    const SoftwareLighting &frameLighting, const glm::vec4 &clearColor) {
+    view_projection = projection * view;
+    // The sky is drawn around the camera, as skybox.vert drops the view's translation
+    inverse_sky_view_projection = glm::inverse(projection * glm::mat4(glm::mat3(view)));
+    lighting = frameLighting;
+    clear_color = clearColor;
+    draws.clear();
+    stats = Stats();
+}
+
+void SoftwareRasterizer::draw(const float *vertices, size_t vertexCount, int stride, bool hasTexCoords,
+                              const unsigned int *indices, size_t indexCount, const glm::mat4 &model,
+                              const SoftwareMaterial &material) {
+    if (vertexCount == 0 || indexCount < 3) return;
+    Draw item;
+    item.vertices = vertices;
+    item.vertexCount = vertexCount;
+    item.stride = stride;
+    item.hasTexCoords = hasTexCoords;
+    item.indices = indices;
+    item.indexCount = indexCount - indexCount % 3;
+    item.model = model;
+    item.normalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+    item.material = material;
+    item.firstVertex = draws.empty() ? 0 : draws.back().firstVertex + draws.back().vertexCount;
+    item.firstTriangle = draws.empty() ? 0 : draws.back().firstTriangle + draws.back().indexCount / 3;
+    draws.push_back(item);
+}
+
+void SoftwareRasterizer::draw(const std::vector<float> &vertices, int stride, const std::vector<unsigned int> &indices,
+                              const glm::mat4 &model, const SoftwareMaterial &material) {
+    draw(vertices.data(), vertices.size() / stride, stride, stride >= 8, indices.data(), indices.size(), model,
+         material);
+}
+
+void SoftwareRasterizer::draw(const Model &model, const glm::mat4 &transform, const SoftwareMaterial &material) {
+    static_assert(sizeof(Vertex) == 8 * sizeof(float), "Vertex must be position, normal and UV, tightly packed");
+    for (const Mesh &mesh: model.meshes) {
+        draw(reinterpret_cast<const float *>(mesh.vertices.data()), mesh.vertices.size(), 8, true,
+             mesh.indices.data(), mesh.indices.size(), transform, material);
+    }
+}
+
+void SoftwareRasterizer::forEach(int count, const std::function<void(int)> &task) {
+    if (pool) {
+        pool->parallelFor(count, task);
+    } else {
+        for (int i = 0; i < count; i++) task(i);
+    }
+}
+
+void SoftwareRasterizer::endFrame() {
+    using Clock = std::chrono::high_resolution_clock;
+    const int tileCount = tiles_x * tiles_y;
+    const size_t vertexCount = draws.empty() ? 0 : draws.back().firstVertex + draws.back().vertexCount;
+    const size_t triangleCount = draws.empty() ? 0 : draws.back().firstTriangle + draws.back().indexCount / 3;
+    stats.draws = static_cast<int>(draws.size());
+    stats.triangles = static_cast<int>(triangleCount);
+
+    // === Vertices ===
+    auto start = Clock::now();
+    transformed.resize(vertexCount);
+    struct VertexBatch {
+        size_t draw, begin, end;
+    };
+    std::vector<VertexBatch> vertexBatches;
+    for (size_t d = 0; d < draws.size(); d++) {
+        for (size_t begin = 0; begin < draws[d].vertexCount; begin += VERTEX_BATCH) {
+            vertexBatches.push_back({d, begin, std::min(begin + VERTEX_BATCH, draws[d].vertexCount)});
+        }
+    }
+    forEach(static_cast<int>(vertexBatches.size()), [&](int i) {
+        transformVertices(vertexBatches[i].draw, vertexBatches[i].begin, vertexBatches[i].end);
+    });
+    auto end = Clock::now();
+    stats.vertexMs = std::chrono::duration<float, std::milli>(end - start).count();
+
+    // === Clipping, Setup & Binning ===
+    // A few contiguous ranges of triangles per thread, each binned on its own so no locks are needed
+    start = end;
+    const int threads = pool ? static_cast<int>(pool->size()) : 1;
+    chunk_count = static_cast<int>(std::max<size_t>(1, std::min<size_t>(threads * 4, triangleCount / 64)));
+    if (chunk_triangles.size() < static_cast<size_t>(chunk_count)) chunk_triangles.resize(chunk_count);
+    bins.resize(std::max(bins.size(), static_cast<size_t>(chunk_count) * tileCount));
+    forEach(chunk_count, [&](int chunk) {
+        chunk_triangles[chunk].clear();
+        for (int tile = 0; tile < tileCount; tile++) bins[static_cast<size_t>(chunk) * tileCount + tile].clear();
+        setupTriangles(chunk, triangleCount * chunk / chunk_count, triangleCount * (chunk + 1) / chunk_count);
+    });
+    for (int chunk = 0; chunk < chunk_count; chunk++) {
+        stats.rasterized += static_cast<int>(chunk_triangles[chunk].size());
+        for (int tile = 0; tile < tileCount; tile++) {
+            stats.binned += static_cast<int>(bins[static_cast<size_t>(chunk) * tileCount + tile].size());
+        }
+    }
+    end = Clock::now();
+    stats.binMs = std::chrono::duration<float, std::milli>(end - start).count();
+
+    // === Tiles ===
+    start = end;
+    forEach(tileCount, [this](int tile) { renderTile(tile); });
+    stats.rasterMs = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+}
+
+void SoftwareRasterizer::transformVertices(size_t draw, size_t begin, size_t end) {
+    const Draw &item = draws[draw];
+    for (size_t i = begin; i < end; i++) {
+        const float *v = item.vertices + i * item.stride;
+        ShadedVertex &out = transformed[item.firstVertex + i];
+        const glm::vec4 world = item.model * glm::vec4(v[0], v[1], v[2], 1.0f);
+        out.clip = view_projection * world;
+        out.worldPos = glm::vec3(world);
+        out.normal = item.normalMatrix * glm::vec3(v[3], v[4], v[5]);
+        out.uv = item.hasTexCoords ? glm::vec2(v[6], v[7]) : glm::vec2(0.0f);
+    }
+}
+
+void SoftwareRasterizer::setupTriangles(int chunk, size_t begin, size_t end) {
+    if (begin >= end) return;
+    // Draw holding triangle "begin"
+    size_t d = 0;
+    while (d + 1 < draws.size() && draws[d + 1].firstTriangle <= begin) d++;
+
+    for (size_t t = begin; t < end; t++) {
+        while (t >= draws[d].firstTriangle + draws[d].indexCount / 3) d++;
+        const Draw &item = draws[d];
+        const unsigned int *index = item.indices + (t - item.firstTriangle) * 3;
+        if (index[0] >= item.vertexCount || index[1] >= item.vertexCount || index[2] >= item.vertexCount) continue;
+        const ShadedVertex *vertices = &transformed[item.firstVertex];
+        const ShadedVertex &a = vertices[index[0]], &b = vertices[index[1]], &c = vertices[index[2]];
+
+        const int codeA = outcode(a.clip), codeB = outcode(b.clip), codeC = outcode(c.clip);
+        // Entirely outside one plane
+        if (codeA & codeB & codeC) continue;
+        if ((codeA | codeB | codeC) == 0) {
+            emitTriangle(chunk, a, b, c, static_cast<int>(d));
+            continue;
+        }
+
+        // Sutherland-Hodgman against the planes the triangle crosses; each plane adds at most one vertex
+        ShadedVertex polygon[3 + CLIP_PLANES], clipped[3 + CLIP_PLANES];
+        int count = 3;
+        polygon[0] = a;
+        polygon[1] = b;
+        polygon[2] = c;
+        const int crossed = codeA | codeB | codeC;
+        for (int plane = 0; plane < CLIP_PLANES && count >= 3; plane++) {
+            if (!(crossed & 1 << plane)) continue;
+            int clippedCount = 0;
+            for (int i = 0; i < count; i++) {
+                const ShadedVertex &from = polygon[i], &to = polygon[(i + 1) % count];
+                const float fromDistance = planeDistance(from.clip, plane);
+                const float toDistance = planeDistance(to.clip, plane);
+                if (fromDistance >= 0.0f) clipped[clippedCount++] = from;
+                if ((fromDistance >= 0.0f) != (toDistance >= 0.0f)) {
+                    const float s = fromDistance / (fromDistance - toDistance);
+                    ShadedVertex &v = clipped[clippedCount++];
+                    v.clip = glm::mix(from.clip, to.clip, s);
+                    v.worldPos = glm::mix(from.worldPos, to.worldPos, s);
+                    v.normal = glm::mix(from.normal, to.normal, s);
+                    v.uv = glm::mix(from.uv, to.uv, s);
+                }
+            }
+            std::copy(clipped, clipped + clippedCount, polygon);
+            count = clippedCount;
+        }
+        for (int i = 1; i + 1 < count; i++) {
+            emitTriangle(chunk, polygon[0], polygon[i], polygon[i + 1], static_cast<int>(d));
+        }
+    }
+}
+
+void SoftwareRasterizer::emitTriangle(int chunk, const ShadedVertex &a, const ShadedVertex &b, const ShadedVertex &c,
+                                      int draw) {
+    Triangle tri;
+    tri.v[0] = a;
+    tri.v[1] = b;
+    tri.v[2] = c;
+    tri.draw = draw;
+
+    glm::vec2 screen[3];
+    for (int k = 0; k < 3; k++) {
+        const glm::vec4 &clip = tri.v[k].clip;
+        if (clip.w <= 0.0f) return;
+        tri.invW[k] = 1.0f / clip.w;
+        const glm::vec3 ndc = glm::vec3(clip) * tri.invW[k];
+        screen[k] = glm::vec2((ndc.x * 0.5f + 0.5f) * static_cast<float>(width),
+                              (ndc.y * 0.5f + 0.5f) * static_cast<float>(height));
+        tri.depth[k] = glm::clamp(ndc.z * 0.5f + 0.5f, 0.0f, 1.0f);
+    }
+
+    float area = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) -
+                 (screen[1].y - screen[0].y) * (screen[2].x - screen[0].x);
+    if (std::fabs(area) < 1e-8f) return;
+    // Both windings are drawn (the scene draws with culling off): make clockwise triangles counter-clockwise
+    if (area < 0.0f) {
+        std::swap(tri.v[1], tri.v[2]);
+        std::swap(tri.invW[1], tri.invW[2]);
+        std::swap(tri.depth[1], tri.depth[2]);
+        std::swap(screen[1], screen[2]);
+        area = -area;
+    }
+
+    // Pixel centres are at (x + 0.5, y + 0.5)
+    const glm::vec2 lo = glm::min(glm::min(screen[0], screen[1]), screen[2]);
+    const glm::vec2 hi = glm::max(glm::max(screen[0], screen[1]), screen[2]);
+    tri.minPixel = glm::ivec2(std::max(0, static_cast<int>(std::ceil(lo.x - 0.5f))),
+                              std::max(0, static_cast<int>(std::ceil(lo.y - 0.5f))));
+    tri.maxPixel = glm::ivec2(std::min(width - 1, static_cast<int>(std::floor(hi.x - 0.5f))),
+                              std::min(height - 1, static_cast<int>(std::floor(hi.y - 0.5f))));
+    if (tri.minPixel.x > tri.maxPixel.x || tri.minPixel.y > tri.maxPixel.y) return;
+
+    // Barycentrics as edge functions divided by the area, relative to vertex 0 for precision: b0 is 1 there
+    const glm::vec2 &p0 = screen[0], &p1 = screen[1], &p2 = screen[2];
+    const float invArea = 1.0f / area;
+    tri.origin = p0;
+    tri.edgeA[0] = (p1.y - p2.y) * invArea;
+    tri.edgeB[0] = (p2.x - p1.x) * invArea;
+    tri.edgeC[0] = 1.0f;
+    tri.edgeA[1] = (p2.y - p0.y) * invArea;
+    tri.edgeB[1] = (p0.x - p2.x) * invArea;
+    tri.edgeC[1] = 0.0f;
+    tri.edgeA[2] = (p0.y - p1.y) * invArea;
+    tri.edgeB[2] = (p1.x - p0.x) * invArea;
+    tri.edgeC[2] = 0.0f;
+
+    std::vector<Triangle> &triangles = chunk_triangles[chunk];
+    const auto index = static_cast<unsigned int>(triangles.size());
+    triangles.push_back(tri);
+    const int tileCount = tiles_x * tiles_y;
+    for (int ty = tri.minPixel.y / TILE_SIZE; ty <= tri.maxPixel.y / TILE_SIZE; ty++) {
+        for (int tx = tri.minPixel.x / TILE_SIZE; tx <= tri.maxPixel.x / TILE_SIZE; tx++) {
+            bins[static_cast<size_t>(chunk) * tileCount + ty * tiles_x + tx].push_back(index);
+        }
+    }
+}
+
+void SoftwareRasterizer::renderTile(int tile) {
+    const int tileX = tile % tiles_x * TILE_SIZE;
+    const int tileY = tile / tiles_x * TILE_SIZE;
+    alignas(16) float tileDepth[TILE_SIZE * TILE_SIZE];
+    unsigned int tileColor[TILE_SIZE * TILE_SIZE];
+    std::fill(tileDepth, tileDepth + TILE_SIZE * TILE_SIZE, 1.0f);
+
+    // Chunks in order, and each chunk's triangles in order: the tile sees the draws as they were submitted
+    const int tileCount = tiles_x * tiles_y;
+    for (int chunk = 0; chunk < chunk_count; chunk++) {
+        const std::vector<Triangle> &triangles = chunk_triangles[chunk];
+        for (const unsigned int index: bins[static_cast<size_t>(chunk) * tileCount + tile]) {
+            rasterizeTriangle(triangles[index], tileX, tileY, tileDepth, tileColor);
+        }
+    }
+
+    // Pixels nothing was drawn to show the sky, then the tile goes into the image (rows flipped to top first)
+    const unsigned int clearColor = packColor(clear_color);
+    const int columns = std::min(TILE_SIZE, width - tileX), rows = std::min(TILE_SIZE, height - tileY);
+    for (int y = 0; y < rows; y++) {
+        unsigned char *out = &image[(static_cast<size_t>(height - 1 - tileY - y) * width + tileX) * 4];
+        for (int x = 0; x < columns; x++) {
+            const int i = y * TILE_SIZE + x;
+            unsigned int color = tileColor[i];
+            if (tileDepth[i] >= 1.0f) {
+                color = skybox ? packColor(glm::vec4(skyColor(static_cast<float>(tileX + x) + 0.5f,
+                                                              static_cast<float>(tileY + y) + 0.5f), 1.0f))
+                               : clearColor;
+            }
+            out[x * 4 + 0] = static_cast<unsigned char>(color);
+            out[x * 4 + 1] = static_cast<unsigned char>(color >> 8);
+            out[x * 4 + 2] = static_cast<unsigned char>(color >> 16);
+            out[x * 4 + 3] = static_cast<unsigned char>(color >> 24);
+        }
+    }
+}
+
+void SoftwareRasterizer::rasterizeTriangle(const Triangle &tri, int tileX, int tileY, float *tileDepth,
+                                           unsigned int *tileColor) {
+    const int y0 = std::max(tri.minPixel.y, tileY);
+    const int y1 = std::min(tri.maxPixel.y, tileY + TILE_SIZE - 1);
+    // Start on a 4-pixel boundary (tiles are a multiple of 4 wide): lanes left of the bounding box are outside
+    // the triangle, and lanes right of the image land in the tile's unused columns
+    const int x0 = std::max(tri.minPixel.x, tileX) & ~3;
+    const int x1 = std::min(tri.maxPixel.x, tileX + TILE_SIZE - 1);
+    const Draw &item = draws[tri.draw];
+
+    // Shades the covered lanes that passed the depth test; "weights" are the perspective-correct barycentrics
+    auto shadeLanes = [&](int x, int y, int mask, const float *depth, const float (*weights)[4]) {
+        float *depthRow = tileDepth + (y - tileY) * TILE_SIZE + (x - tileX);
+        unsigned int *colorRow = tileColor + (y - tileY) * TILE_SIZE + (x - tileX);
+        for (int lane = 0; lane < 4; lane++) {
+            if (!(mask & 1 << lane)) continue;
+            const float w0 = weights[0][lane], w1 = weights[1][lane], w2 = weights[2][lane];
+            const glm::vec3 worldPos = w0 * tri.v[0].worldPos + w1 * tri.v[1].worldPos + w2 * tri.v[2].worldPos;
+            const glm::vec3 normal = w0 * tri.v[0].normal + w1 * tri.v[1].normal + w2 * tri.v[2].normal;
+            const glm::vec2 uv = w0 * tri.v[0].uv + w1 * tri.v[1].uv + w2 * tri.v[2].uv;
+            bool discarded = false;
+            const glm::vec3 color = shade(item, worldPos, normal, uv, discarded);
+            if (discarded) continue;
+            depthRow[lane] = depth[lane];
+            colorRow[lane] = packColor(glm::vec4(color, 1.0f));
+        }
+    };
+
+    alignas(16) float depth[4];
+    alignas(16) float weights[3][4];
+#ifdef SOFTWARE_RASTER_USE_SSE
+    const __m128 laneOffsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 a0 = _mm_set1_ps(tri.edgeA[0]), a1 = _mm_set1_ps(tri.edgeA[1]), a2 = _mm_set1_ps(tri.edgeA[2]);
+    const __m128 step0 = _mm_set1_ps(tri.edgeA[0] * 4.0f), step1 = _mm_set1_ps(tri.edgeA[1] * 4.0f);
+    const __m128 step2 = _mm_set1_ps(tri.edgeA[2] * 4.0f);
+    const __m128 z0 = _mm_set1_ps(tri.depth[0]), z1 = _mm_set1_ps(tri.depth[1]), z2 = _mm_set1_ps(tri.depth[2]);
+    const __m128 iw0 = _mm_set1_ps(tri.invW[0]), iw1 = _mm_set1_ps(tri.invW[1]), iw2 = _mm_set1_ps(tri.invW[2]);
+    for (int y = y0; y <= y1; y++) {
+        const float py = static_cast<float>(y) + 0.5f - tri.origin.y;
+        const __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x0) - tri.origin.x), laneOffsets);
+        __m128 b0 = _mm_add_ps(_mm_mul_ps(a0, px), _mm_set1_ps(tri.edgeB[0] * py + tri.edgeC[0]));
+        __m128 b1 = _mm_add_ps(_mm_mul_ps(a1, px), _mm_set1_ps(tri.edgeB[1] * py + tri.edgeC[1]));
+        __m128 b2 = _mm_add_ps(_mm_mul_ps(a2, px), _mm_set1_ps(tri.edgeB[2] * py + tri.edgeC[2]));
+        const float *depthRow = tileDepth + (y - tileY) * TILE_SIZE - tileX;
+
+        for (int x = x0; x <= x1; x += 4) {
+            __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(b0, zero), _mm_cmpge_ps(b1, zero)),
+                                       _mm_cmpge_ps(b2, zero));
+            if (_mm_movemask_ps(inside)) {
+                const __m128 z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(b0, z0), _mm_mul_ps(b1, z1)), _mm_mul_ps(b2, z2));
+                inside = _mm_and_ps(inside, _mm_cmplt_ps(z, _mm_load_ps(depthRow + x)));
+                if (const int mask = _mm_movemask_ps(inside)) {
+                    // Perspective correction: attributes / w interpolate linearly on screen
+                    const __m128 p0 = _mm_mul_ps(b0, iw0), p1 = _mm_mul_ps(b1, iw1), p2 = _mm_mul_ps(b2, iw2);
+                    const __m128 w = _mm_div_ps(_mm_set1_ps(1.0f), _mm_add_ps(_mm_add_ps(p0, p1), p2));
+                    _mm_store_ps(depth, z);
+                    _mm_store_ps(weights[0], _mm_mul_ps(p0, w));
+                    _mm_store_ps(weights[1], _mm_mul_ps(p1, w));
+                    _mm_store_ps(weights[2], _mm_mul_ps(p2, w));
+                    shadeLanes(x, y, mask, depth, weights);
+                }
+            }
+            b0 = _mm_add_ps(b0, step0);
+            b1 = _mm_add_ps(b1, step1);
+            b2 = _mm_add_ps(b2, step2);
+        }
+    }
+#else
+    for (int y = y0; y <= y1; y++) {
+        const float py = static_cast<float>(y) + 0.5f - tri.origin.y;
+        const float *depthRow = tileDepth + (y - tileY) * TILE_SIZE - tileX;
+        for (int x = x0; x <= x1; x += 4) {
+            int mask = 0;
+            for (int lane = 0; lane < 4; lane++) {
+                const float px = static_cast<float>(x + lane) + 0.5f - tri.origin.x;
+                const float b0 = tri.edgeA[0] * px + tri.edgeB[0] * py + tri.edgeC[0];
+                const float b1 = tri.edgeA[1] * px + tri.edgeB[1] * py + tri.edgeC[1];
+                const float b2 = tri.edgeA[2] * px + tri.edgeB[2] * py + tri.edgeC[2];
+                if (b0 < 0.0f || b1 < 0.0f || b2 < 0.0f) continue;
+                depth[lane] = b0 * tri.depth[0] + b1 * tri.depth[1] + b2 * tri.depth[2];
+                if (depth[lane] >= depthRow[x + lane]) continue;
+                const float p0 = b0 * tri.invW[0], p1 = b1 * tri.invW[1], p2 = b2 * tri.invW[2];
+                const float w = 1.0f / (p0 + p1 + p2);
+                weights[0][lane] = p0 * w;
+                weights[1][lane] = p1 * w;
+                weights[2][lane] = p2 * w;
+                mask |= 1 << lane;
+            }
+            if (mask) shadeLanes(x, y, mask, depth, weights);
+        }
+    }
+#endif
+}
+
+glm::vec3 SoftwareRasterizer::skyColor(float x, float y) const {
+    const glm::vec4 far = inverse_sky_view_projection * glm::vec4(x / static_cast<float>(width) * 2.0f - 1.0f,
+                                                                   y / static_cast<float>(height) * 2.0f - 1.0f,
+                                                                   1.0f, 1.0f);
+    const glm::vec3 d = glm::vec3(far) / far.w;
+
+    // Cube map face selection and face coordinates, as GL defines them
+    const glm::vec3 a = glm::abs(d);
+    int face;
+    float s, t, major;
+    if (a.x >= a.y && a.x >= a.z) {
+        face = d.x > 0.0f ? 0 : 1;
+        s = d.x > 0.0f ? -d.z : d.z;
+        t = -d.y;
+        major = a.x;
+    } else if (a.y >= a.z) {
+        face = d.y > 0.0f ? 2 : 3;
+        s = d.x;
+        t = d.y > 0.0f ? d.z : -d.z;
+        major = a.y;
+    } else {
+        face = d.z > 0.0f ? 4 : 5;
+        s = d.z > 0.0f ? d.x : -d.x;
+        t = -d.y;
+        major = a.z;
+    }
+    if (major <= 0.0f) return glm::vec3(clear_color);
+    return glm::vec3(skybox[face].sampleClamped(glm::vec2(s, t) / major * 0.5f + 0.5f));
+}
+
+// shader.frag's controllable light: ambient plus diffuse tinted by the base colour, specular in the light's colour
+glm::vec3 SoftwareRasterizer::shade(const Draw &draw, const glm::vec3 &worldPos, const glm::vec3 &normal,
+                                    const glm::vec2 &uv, bool &discarded) const {
+    const SoftwareMaterial &material = draw.material;
+    glm::vec3 baseColor = material.objectColor;
+    if (material.texture) {
+        const glm::vec4 texel = material.texture->sample(uv);
+        if (material.alphaTested && texel.a < lighting.alphaCutoff) {
+            discarded = true;
+            return glm::vec3(0.0f);
+        }
+        baseColor = glm::vec3(texel);
+    }
+    if (material.unlit) return baseColor;
+
+    const float length = glm::length(normal);
+    const glm::vec3 norm = length > 0.0f ? normal / length : normal;
+    const glm::vec3 lightDir = glm::normalize(lighting.lightPos - worldPos);
+
+    const float diff = std::max(glm::dot(norm, lightDir), 0.0f);
+    const glm::vec3 diffuse = 1.2f * diff * lighting.lightColor;
+
+    const glm::vec3 viewDir = glm::normalize(lighting.viewPos - worldPos);
+    const glm::vec3 reflectDir = glm::reflect(-lightDir, norm);
+    const float spec = std::pow(std::max(glm::dot(viewDir, reflectDir), 0.0f), lighting.shininess);
+
+    return lighting.ambientColor * baseColor + diffuse * baseColor + spec * lighting.lightColor;
+}
@@ -0,0 +1,179 @@
+#ifndef SOFTWARE_RASTER_H
+#define SOFTWARE_RASTER_H
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+#include <glm/glm.hpp>
+
+class Model;
+class ThreadPool;
+
+/*
+ * SoftwareTexture Struct
+ * 8-bit RGBA image in CPU memory, rows in the order stb_image loads them, which is the order GL receives them:
+ * v = 0 is the first row. Sampled bilinearly like the GL textures, but without mipmaps.
+ */
+struct SoftwareTexture {
+    int width = 0, height = 0;
+    std::vector<unsigned char> rgba;
+
+    // Repeating texture coordinates (GL_REPEAT)
+    glm::vec4 sample(const glm::vec2 &uv) const;
+
+    // Coordinates clamped to the edge texels (GL_CLAMP_TO_EDGE), as cube map faces are sampled
+    glm::vec4 sampleClamped(const glm::vec2 &uv) const;
+};
+
+// Per-draw shading inputs: the feature set ShaderVariants would pick for the draw
+struct SoftwareMaterial {
+    const SoftwareTexture *texture = nullptr; // Base colour; null: objectColor (TEXTURED off)
+    glm::vec3 objectColor = glm::vec3(1.0f);
+    bool unlit = false;       // UNLIT: the base colour as is
+    bool alphaTested = false; // ALPHA_TEST: texels below alphaCutoff are discarded
+};
+
+// Per-frame inputs of shader.frag's controllable light
+struct SoftwareLighting {
+    glm::vec3 viewPos = glm::vec3(0.0f);
+    glm::vec3 lightPos = glm::vec3(0.0f);
+    glm::vec3 lightColor = glm::vec3(1.0f);
+    glm::vec3 ambientColor = glm::vec3(0.0f);
+    float shininess = 32.0f;
+    float alphaCutoff = 0.5f;
+};
+
+/*
+ * SoftwareRasterizer Class
+ * Tile-based CPU renderer for reference images where there is no GPU (build servers, golden-image checks,
+ * offline previews). Draws take the scene's own vertex layouts and model matrices and are shaded with a C++ port
+ * of shader.frag's Phong/unlit model (the controllable light only: no lanterns, no shadow maps).
+ * endFrame() renders everything drawn since beginFrame() in three stages, each spread over the ThreadPool:
+ * vertices are transformed; triangles are clipped, set up and binned into TILE_SIZE tiles (contiguous ranges of
+ * triangles per task, so every tile sees its triangles in submission order); then each tile is rasterized and
+ * shaded into a tile-local colour and depth buffer and copied to the image. Edge functions, depth and
+ * perspective-correct barycentrics are evaluated four pixels at a time with SSE where available.
+ * Conventions follow GL: counter-clockwise and clockwise triangles are both drawn, depth test LESS, pixel
+ * centres at half-integers. Triangles are clipped against the near and far planes and a guard band.
+ * Like OcclusionCuller it never touches OpenGL.
+ */
+class SoftwareRasterizer {
+public:
+    static constexpr int TILE_SIZE = 64;
+
+    struct Stats {
+        int draws = 0;
+        int triangles = 0;     // Submitted
+        int rasterized = 0;    // After clipping and culling of degenerate or off-screen triangles
+        int binned = 0;        // Triangle-tile pairs
+        float vertexMs = 0.0f;
+        float binMs = 0.0f;
+        float rasterMs = 0.0f;
+    };
+
+    // "pool" may be null (single threaded)
+    SoftwareRasterizer(int width, int height, ThreadPool *pool = nullptr);
+
+    void setThreadPool(ThreadPool *threadPool) { pool = threadPool; }
+
+    // Six faces in GL order (+X, -X, +Y, -Y, +Z, -Z) drawn behind the scene, as the skybox pass does; null: the
+    // clear colour. The faces must outlive the frames rendered with them
+    void setSkybox(const SoftwareTexture *faces) { skybox = faces; }
+
+    void beginFrame(const glm::mat4 &view, const glm::mat4 &projection, const SoftwareLighting &lighting,
+                    const glm::vec4 &clearColor);
+
+    // Indexed triangle list of interleaved floats: position, normal and, with "hasTexCoords", UV (Geometry's
+    // layouts). The data is read in endFrame(), so it must stay alive until then
+    void draw(const float *vertices, size_t vertexCount, int stride, bool hasTexCoords, const unsigned int *indices,
+              size_t indexCount, const glm::mat4 &model, const SoftwareMaterial &material);
+
+    // Geometry's vectors: UV when the stride has room for it (8 floats)
+    void draw(const std::vector<float> &vertices, int stride, const std::vector<unsigned int> &indices,
+              const glm::mat4 &model, const SoftwareMaterial &material);
+
+    // Every mesh of a model, which may have been loaded without uploading it
+    void draw(const Model &model, const glm::mat4 &transform, const SoftwareMaterial &material);
+
+    void endFrame();
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+    // RGBA8, top row first (as image files store it)
+    const std::vector<unsigned char> &getImage() const { return image; }
+
+    const Stats &getStats() const { return stats; }
+
+private:
+    struct Draw {
+        const float *vertices;
+        size_t vertexCount;
+        int stride;
+        bool hasTexCoords;
+        const unsigned int *indices;
+        size_t indexCount;
+        glm::mat4 model;
+        glm::mat3 normalMatrix;
+        SoftwareMaterial material;
+        size_t firstVertex;   // Into transformed
+        size_t firstTriangle; // Over all draws
+    };
+
+    struct ShadedVertex {
+        glm::vec4 clip;
+        glm::vec3 worldPos;
+        glm::vec3 normal;
+        glm::vec2 uv;
+    };
+
+    // Set up for the tile loop: barycentric b_i(x, y) = (x - origin.x) * edgeA_i + (y - origin.y) * edgeB_i + C_i
+    struct Triangle {
+        ShadedVertex v[3];
+        float depth[3];   // Window depth, [0, 1]
+        float invW[3];
+        float edgeA[3], edgeB[3], edgeC[3];
+        glm::vec2 origin;
+        glm::ivec2 minPixel, maxPixel;
+        int draw;
+    };
+
+    void transformVertices(size_t draw, size_t begin, size_t end);
+
+    void setupTriangles(int chunk, size_t begin, size_t end);
+
+    void emitTriangle(int chunk, const ShadedVertex &a, const ShadedVertex &b, const ShadedVertex &c, int draw);
+
+    void renderTile(int tile);
+
+    void rasterizeTriangle(const Triangle &tri, int tileX, int tileY, float *tileDepth, unsigned int *tileColor);
+
+    glm::vec3 skyColor(float x, float y) const;
+
+    glm::vec3 shade(const Draw &draw, const glm::vec3 &worldPos, const glm::vec3 &normal, const glm::vec2 &uv,
+                    bool &discarded) const;
+
+    // task(i) for i in [0, count), on the pool when there is one
+    void forEach(int count, const std::function<void(int)> &task);
+
+    int width, height;
+    int tiles_x, tiles_y;
+    ThreadPool *pool;
+
+    glm::mat4 view_projection = glm::mat4(1.0f);
+    glm::mat4 inverse_sky_view_projection = glm::mat4(1.0f);
+    SoftwareLighting lighting;
+    glm::vec4 clear_color = glm::vec4(0.0f);
+    const SoftwareTexture *skybox = nullptr;
+
+    std::vector<Draw> draws;
+    std::vector<ShadedVertex> transformed;
+    // Per binning chunk: its set-up triangles, and per tile the indices of those that touch it
+    std::vector<std::vector<Triangle> > chunk_triangles;
+    std::vector<std::vector<unsigned int> > bins; // chunk * tile count + tile
+    int chunk_count = 0;
+    std::vector<unsigned char> image;
+    Stats stats;
+};
+
+#endif // SOFTWARE_RASTER_H
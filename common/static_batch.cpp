@@ -0,0 +1,197 @@
+#include "static_batch.h"
+#include "model.h"
+#include "shader_variants.h"
+#include <glm/gtc/type_ptr.hpp>
+#include <cmath>
+#include <cstddef>
+#include <map>
+#include <unordered_map>
+#include <utility>
+
+StaticBatcher::StaticBatcher(float chunkSize) : chunk_size(chunkSize) {
+}
+
+StaticBatcher::~StaticBatcher() {
+    for (auto &batch: batches) {
+        glDeleteVertexArrays(1, &batch.vao);
+        glDeleteBuffers(1, &batch.vbo);
+        glDeleteBuffers(1, &batch.ebo);
+    }
+}
+
+StaticBatcher::PendingGeometry &StaticBatcher::pendingFor(const StaticMaterial &material) {
+    for (auto &geometry: pending) {
+        if (geometry.material == material) return geometry;
+    }
+    pending.push_back({material, {}, {}});
+    return pending.back();
+}
+
+void StaticBatcher::add(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices,
+                        const glm::mat4 &model, const StaticMaterial &material) {
+    PendingGeometry &geometry = pendingFor(material);
+    const glm::mat3 normalMat = glm::transpose(glm::inverse(glm::mat3(model)));
+    const auto base = static_cast<unsigned int>(geometry.vertices.size());
+
+    for (const auto &vertex: vertices) {
+        Vertex world = vertex;
+        world.Position = glm::vec3(model * glm::vec4(vertex.Position, 1.0f));
+        glm::vec3 normal = normalMat * vertex.Normal;
+        // Zero normals (no normals in the source) stay zero instead of turning into NaNs
+        world.Normal = glm::dot(normal, normal) > 0.0f ? glm::normalize(normal) : normal;
+        geometry.vertices.push_back(world);
+    }
+    for (unsigned int index: indices) {
+        geometry.indices.push_back(base + index);
+    }
+}
+
+void StaticBatcher::add(const Model &model, const glm::mat4 &transform, const StaticMaterial &material) {
+    for (const auto &mesh: model.meshes) {
+        add(mesh.vertices, mesh.indices, transform, material);
+    }
+}
+
+void StaticBatcher::add(const std::vector<float> &interleaved, const std::vector<GLuint> &indices,
+                        const glm::mat4 &model, const StaticMaterial &material) {
+    std::vector<Vertex> vertices;
+    for (size_t i = 0; i + 7 < interleaved.size(); i += 8) {
+        Vertex vertex{};
+        vertex.Position = glm::vec3(interleaved[i], interleaved[i + 1], interleaved[i + 2]);
+        vertex.Normal = glm::vec3(interleaved[i + 3], interleaved[i + 4], interleaved[i + 5]);
+        vertex.TexCoords = glm::vec2(interleaved[i + 6], interleaved[i + 7]);
+        vertices.push_back(vertex);
+    }
+    add(vertices, std::vector<unsigned int>(indices.begin(), indices.end()), model, material);
+}
+
+void StaticBatcher::build() {
+    for (auto &geometry: pending) {
+        // Bucket triangles by the chunk their centroid falls into
+        std::map<std::pair<int, int>, std::vector<unsigned int>> chunkTriangles;
+        for (size_t t = 0; t + 2 < geometry.indices.size(); t += 3) {
+            glm::vec3 centroid = (geometry.vertices[geometry.indices[t]].Position +
+                                  geometry.vertices[geometry.indices[t + 1]].Position +
+                                  geometry.vertices[geometry.indices[t + 2]].Position) / 3.0f;
+            std::pair<int, int> cell(static_cast<int>(std::floor(centroid.x / chunk_size)),
+                                     static_cast<int>(std::floor(centroid.z / chunk_size)));
+            auto &triangles = chunkTriangles[cell];
+            triangles.insert(triangles.end(), geometry.indices.begin() + t, geometry.indices.begin() + t + 3);
+        }
+
+        // Re-index so each chunk's vertices and indices are contiguous in the merged buffers
+        Batch batch;
+        batch.material = geometry.material;
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> indices;
+        for (const auto &entry: chunkTriangles) {
+            Chunk chunk{};
+            chunk.firstIndex = static_cast<GLuint>(indices.size());
+            std::unordered_map<unsigned int, unsigned int> remap;
+            for (unsigned int index: entry.second) {
+                auto found = remap.find(index);
+                if (found == remap.end()) {
+                    found = remap.emplace(index, static_cast<unsigned int>(vertices.size())).first;
+                    vertices.push_back(geometry.vertices[index]);
+                    chunk.bounds.expand(geometry.vertices[index].Position);
+                }
+                indices.push_back(found->second);
+            }
+            chunk.indexCount = static_cast<GLsizei>(indices.size() - chunk.firstIndex);
+            batch.chunks.push_back(chunk);
+        }
+        if (indices.empty()) continue;
+
+        glGenVertexArrays(1, &batch.vao);
+        glGenBuffers(1, &batch.vbo);
+        glGenBuffers(1, &batch.ebo);
+        glBindVertexArray(batch.vao);
+        glBindBuffer(GL_ARRAY_BUFFER, batch.vbo);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batch.ebo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+
+        // Same attribute layout as Mesh
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), static_cast<void *>(nullptr));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void *>(offsetof(Vertex, Normal)));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                              reinterpret_cast<void *>(offsetof(Vertex, TexCoords)));
+        glBindVertexArray(0);
+
+        batches.push_back(batch);
+    }
+
+    // The world-space copies are on the GPU now
+    pending.clear();
+}
+
+void StaticBatcher::buildCommands(const std::function<bool(const AABB &)> &isVisible, IndirectDrawList &out) const {
+    out.clear();
+    for (size_t b = 0; b < batches.size(); b++) {
+        out.beginGroup(static_cast<int>(b));
+
+        // Chunks are contiguous in the index buffer, so runs of visible chunks become one command
+        GLuint runStart = 0;
+        GLuint runCount = 0;
+        for (const auto &chunk: batches[b].chunks) {
+            if (isVisible && !isVisible(chunk.bounds)) {
+                out.culled++;
+                if (runCount > 0) out.add(runCount, runStart);
+                runCount = 0;
+                continue;
+            }
+            if (runCount == 0) runStart = chunk.firstIndex;
+            runCount += chunk.indexCount;
+        }
+        if (runCount > 0) out.add(runCount, runStart);
+    }
+}
+
+void StaticBatcher::upload(const IndirectDrawList &list) {
+    indirect_buffer.upload(list);
+}
+
+void StaticBatcher::submit(ShaderVariants &shaders, unsigned passFeatures, const IndirectDrawList &list) {
+    stats = Stats();
+    stats.chunksCulled = list.culled;
+
+    // Geometry is already in world space
+    const glm::mat4 identity(1.0f);
+    const glm::mat3 identityNormal(1.0f);
+    const ShaderProgram *bound = nullptr;
+
+    for (const auto &range: list.ranges) {
+        if (range.commandCount == 0) continue;
+        const Batch &batch = batches[range.group];
+        const StaticMaterial &material = batch.material;
+        const ShaderProgram &program = shaders.get(
+            ShaderVariants::materialFeatures(material.useTexture, material.unlit, false) | passFeatures);
+        if (&program != bound) {
+            glUseProgram(program.id);
+            glUniformMatrix4fv(program.model, 1, GL_FALSE, glm::value_ptr(identity));
+            glUniformMatrix3fv(program.normalMat, 1, GL_FALSE, glm::value_ptr(identityNormal));
+            bound = &program;
+        }
+        glUniform3fv(program.objectColor, 1, glm::value_ptr(material.objectColor));
+        if (program.features & ShaderVariants::TEXTURED) {
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, material.texture);
+        }
+
+        glBindVertexArray(batch.vao);
+        stats.drawCalls += indirect_buffer.draw(range);
+        stats.commands += range.commandCount;
+    }
+
+    glBindVertexArray(0);
+}
+
+void StaticBatcher::draw(ShaderVariants &shaders, unsigned passFeatures,
+                         const std::function<bool(const AABB &)> &isVisible) {
+    buildCommands(isVisible, draw_list);
+    upload(draw_list);
+    submit(shaders, passFeatures, draw_list);
+}
@@ -0,0 +1,117 @@
+#ifndef STATIC_BATCH_H
+#define STATIC_BATCH_H
+
+#include <functional>
+#include <vector>
+#include <glm/glm.hpp>
+#include "glad.h"
+
+#include "bounds.h"
+#include "indirect_draw.h"
+#include "mesh.h"
+
+class Model;
+class ShaderVariants;
+
+/*
+ * StaticMaterial struct
+ * Everything the main shader needs to draw a piece of static geometry besides its transform.
+ * Instances with equal materials end up in the same batch.
+ */
+struct StaticMaterial {
+    GLuint texture = 0;
+    bool useTexture = true;
+    bool unlit = false;
+    glm::vec3 objectColor = glm::vec3(1.0f);
+
+    bool operator==(const StaticMaterial &that) const {
+        return texture == that.texture && useTexture == that.useTexture && unlit == that.unlit &&
+               objectColor == that.objectColor;
+    }
+};
+
+/*
+ * StaticBatcher Class
+ * Merges geometry that never moves into a few world-space vertex/index buffers at load time.
+ * Instances are pre-transformed (positions and normals), grouped by material, and their triangles are split
+ * into square chunks on the XZ plane. Each chunk keeps its own bounding box so it can still be culled, while a
+ * whole material renders from one VAO and shader permutation, with identity model/normal matrices.
+ * Culling writes indirect draw commands (buildCommands, no GL calls) which are uploaded once per frame and
+ * can then be submitted by several passes (depth pre-pass, shading).
+ */
+class StaticBatcher {
+public:
+    struct Chunk {
+        AABB bounds;
+        GLuint firstIndex; // Offset into the batch's index buffer, in indices
+        GLsizei indexCount;
+    };
+
+    struct Batch {
+        StaticMaterial material;
+        std::vector<Chunk> chunks;
+        GLuint vao = 0, vbo = 0, ebo = 0;
+    };
+
+    struct Stats {
+        int drawCalls = 0; // API calls; one per range where glMultiDrawElementsIndirect is available
+        int commands = 0;  // Indirect commands, i.e. runs of visible chunks
+        int chunksCulled = 0;
+    };
+
+    explicit StaticBatcher(float chunkSize = 32.0f);
+
+    ~StaticBatcher();
+
+    // Adds one instance of a triangle mesh
+    void add(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices, const glm::mat4 &model,
+             const StaticMaterial &material);
+
+    // Adds one instance of every mesh of a model
+    void add(const Model &model, const glm::mat4 &transform, const StaticMaterial &material);
+
+    // Adds interleaved position/normal/uv float data (stride 8, the layout used in geometry.h)
+    void add(const std::vector<float> &interleaved, const std::vector<GLuint> &indices, const glm::mat4 &model,
+             const StaticMaterial &material);
+
+    // Splits the collected geometry into chunks and uploads it. No instances can be added afterwards
+    void build();
+
+    // Culls the chunks and writes one indirect command per run of visible chunks into "out".
+    // Makes no GL calls, so it may run on another thread as long as isVisible is thread-safe
+    void buildCommands(const std::function<bool(const AABB &)> &isVisible, IndirectDrawList &out) const;
+
+    // Uploads the commands into the indirect buffer; call once per frame before submit()
+    void upload(const IndirectDrawList &list);
+
+    // Draws the uploaded commands, one state change per batch. "passFeatures" are added to each material's
+    // shader features (e.g. DEPTH_ONLY)
+    void submit(ShaderVariants &shaders, unsigned passFeatures, const IndirectDrawList &list);
+
+    // Culls and draws in one go on the calling thread
+    void draw(ShaderVariants &shaders, unsigned passFeatures,
+              const std::function<bool(const AABB &)> &isVisible = nullptr);
+
+    const std::vector<Batch> &getBatches() const { return batches; }
+
+    const Stats &getStats() const { return stats; }
+
+private:
+    // World-space geometry collected for one material before build()
+    struct PendingGeometry {
+        StaticMaterial material;
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> indices;
+    };
+
+    PendingGeometry &pendingFor(const StaticMaterial &material);
+
+    float chunk_size;
+    std::vector<PendingGeometry> pending;
+    std::vector<Batch> batches;
+    IndirectDrawBuffer indirect_buffer;
+    IndirectDrawList draw_list; // Scratch list used by draw()
+    Stats stats;
+};
+
+#endif // STATIC_BATCH_H
@@ -0,0 +1,92 @@
+#include "stereo.h"
+#include "shader_variants.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+namespace {
+    const char *const MODE_NAMES[StereoRig::MODE_COUNT] = {"mono", "two passes", "single pass"};
+
+    // GPU timers report a few frames late, so the first frames after a switch still measure the previous mode
+    constexpr int WARMUP_FRAMES = 10;
+}
+
+StereoRig::StereoRig(float eyeSeparation) : eye_separation(eyeSeparation) {
+}
+
+unsigned StereoRig::shaderFeatures() const {
+    return mode == Mode::SinglePass ? ShaderVariants::STEREO : 0u;
+}
+
+glm::mat4 StereoRig::eyeView(const glm::mat4 &view, int eye) const {
+    // Moving the eye left moves the scene right in view space
+    const float side = eye == 0 ? -1.0f : 1.0f;
+    return glm::translate(glm::mat4(1.0f), glm::vec3(-side * getHalfSeparation(), 0.0f, 0.0f)) * view;
+}
+
+glm::ivec4 StereoRig::passViewport(glm::ivec2 renderSize, int pass) const {
+    if (mode != Mode::TwoPass) return glm::ivec4(0, 0, renderSize.x, renderSize.y);
+    const glm::ivec2 eye = eyeSize(renderSize);
+    return glm::ivec4(pass * eye.x, 0, eye.x, eye.y);
+}
+
+glm::ivec2 StereoRig::eyeSize(glm::ivec2 renderSize) const {
+    if (mode == Mode::Off) return renderSize;
+    return glm::ivec2(glm::max(renderSize.x / 2, 1), renderSize.y);
+}
+
+glm::mat4 StereoRig::cullingView(const glm::mat4 &view, float fovY, float aspect) const {
+    if (mode == Mode::Off) return view;
+    // The eyes' frusta are the camera's shifted sideways by s; pulled back by s / tan(horizontal half-angle),
+    // the camera's frustum touches both at the eyes' planes and contains them beyond
+    const float tanHalfX = std::tan(fovY * 0.5f) * aspect;
+    const float pullBack = getHalfSeparation() / tanHalfX;
+    return glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -pullBack)) * view;
+}
+
+void StereoRig::startBenchmark(int framesPerMode) {
+    mode_before_benchmark = mode;
+    frames_per_mode = framesPerMode;
+    benchmark_frame = 0;
+    for (int i = 0; i < MODE_COUNT; i++) {
+        totals[i] = Sample();
+        counted[i] = 0;
+    }
+    mode = Mode::Off;
+}
+
+void StereoRig::record(const Sample &sample) {
+    last[static_cast<int>(mode)] = sample;
+    if (!isBenchmarking()) return;
+
+    const int current = static_cast<int>(mode);
+    if (benchmark_frame % frames_per_mode >= WARMUP_FRAMES) {
+        totals[current].submitMs += sample.submitMs;
+        totals[current].gpuMs += sample.gpuMs;
+        totals[current].drawCalls += sample.drawCalls;
+        counted[current]++;
+    }
+    benchmark_frame++;
+    if (benchmark_frame % frames_per_mode != 0) return;
+
+    if (current + 1 < MODE_COUNT) {
+        mode = static_cast<Mode>(current + 1);
+    } else {
+        printBenchmark();
+        benchmark_frame = -1;
+        mode = mode_before_benchmark;
+    }
+}
+
+void StereoRig::printBenchmark() const {
+    std::cout << "Stereo benchmark (" << frames_per_mode << " frames per mode, scene pass only):\n";
+    std::cout << "  mode          CPU submit ms   GPU ms   draw calls\n";
+    for (int i = 0; i < MODE_COUNT; i++) {
+        const double n = counted[i] > 0 ? static_cast<double>(counted[i]) : 1.0;
+        char line[128];
+        std::snprintf(line, sizeof(line), "  %-12s %14.3f %8.2f %12.0f\n", MODE_NAMES[i], totals[i].submitMs / n,
+                      totals[i].gpuMs / n, static_cast<double>(totals[i].drawCalls) / n);
+        std::cout << line;
+    }
+}
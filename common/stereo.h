@@ -0,0 +1,90 @@
+#ifndef STEREO_H
+#define STEREO_H
+
+#include <glm/glm.hpp>
+
+/*
+ * StereoRig Class
+ * Parallel-axis stereo camera. Both eyes are rendered side by side into the scene target (half side-by-side, the
+ * frame-packed format stereo displays stretch back to full width), in one of two ways:
+ * TwoPass submits the whole scene once per eye, with that eye's view matrix and half of the viewport.
+ * SinglePass submits it once with the STEREO shader permutations and every draw instanced twice: the instance's
+ * parity picks the eye, which offsets the view and squeezes the result into its half of the target, clipped
+ * with gl_ClipDistance. Draw calls and state changes stay those of mono.
+ * The rig also benchmarks the modes against each other: each runs for a number of frames and the averages of
+ * the CPU submission time, GPU time and draw calls are printed.
+ */
+class StereoRig {
+public:
+    enum class Mode { Off, TwoPass, SinglePass };
+    static constexpr int MODE_COUNT = 3;
+
+    // Measurements of one frame's scene pass
+    struct Sample {
+        double submitMs = 0.0; // CPU time spent issuing the GL calls
+        double gpuMs = 0.0;
+        int drawCalls = 0;
+    };
+
+    explicit StereoRig(float eyeSeparation = 0.065f);
+
+    void setMode(Mode newMode) { mode = newMode; }
+
+    Mode getMode() const { return mode; }
+
+    void setEyeSeparation(float separation) { eye_separation = separation; }
+
+    float getEyeSeparation() const { return eye_separation; }
+
+    // Offset of each eye from the camera, for the STEREO shaders
+    float getHalfSeparation() const { return mode == Mode::Off ? 0.0f : eye_separation * 0.5f; }
+
+    // Times the scene is submitted per frame
+    int passCount() const { return mode == Mode::TwoPass ? 2 : 1; }
+
+    // Eyes each draw covers, i.e. the instance multiplier
+    int viewsPerDraw() const { return mode == Mode::SinglePass ? 2 : 1; }
+
+    // ShaderVariants::STEREO in SinglePass mode, else 0
+    unsigned shaderFeatures() const;
+
+    // View matrix of eye 0 (left) or 1 (right): the camera moved sideways by half the separation
+    glm::mat4 eyeView(const glm::mat4 &view, int eye) const;
+
+    // Viewport (x, y, width, height) of a pass within the render region
+    glm::ivec4 passViewport(glm::ivec2 renderSize, int pass) const;
+
+    // Size of one eye's image within the render region
+    glm::ivec2 eyeSize(glm::ivec2 renderSize) const;
+
+    // The camera moved back along its axis until its frustum contains both eyes' frusta, for culling once
+    // for both eyes
+    glm::mat4 cullingView(const glm::mat4 &view, float fovY, float aspect) const;
+
+    // Runs every mode for "framesPerMode" frames, prints the averages and goes back to the current mode
+    void startBenchmark(int framesPerMode = 240);
+
+    bool isBenchmarking() const { return benchmark_frame >= 0; }
+
+    // Called once per frame with that frame's measurements; switches modes while benchmarking
+    void record(const Sample &sample);
+
+    // Latest measurements taken in a mode
+    const Sample &getLast(Mode of) const { return last[static_cast<int>(of)]; }
+
+private:
+    void printBenchmark() const;
+
+    Mode mode = Mode::Off;
+    float eye_separation;
+    Sample last[MODE_COUNT];
+
+    // Benchmark state; benchmark_frame is -1 when not running
+    int benchmark_frame = -1;
+    int frames_per_mode = 0;
+    Mode mode_before_benchmark = Mode::Off;
+    Sample totals[MODE_COUNT];
+    int counted[MODE_COUNT] = {0, 0, 0};
+};
+
+#endif // STEREO_H
@@ -0,0 +1,103 @@
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(unsigned int threadCount) {
+    if (threadCount == 0) threadCount = 1;
+    // The calling thread is one of the "threadCount" threads
+    for (unsigned int i = 1; i < threadCount; i++) {
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    work_ready.notify_all();
+    background_ready.notify_all();
+    for (auto &worker: workers) {
+        worker.join();
+    }
+    // Queued tasks still run, so no future is left without a result
+    if (background.joinable()) background.join();
+}
+
+std::future<void> ThreadPool::submit(std::function<void()> task) {
+    std::packaged_task<void()> packaged(std::move(task));
+    std::future<void> result = packaged.get_future();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        background_tasks.push_back(std::move(packaged));
+        if (!background.joinable()) background = std::thread(&ThreadPool::backgroundLoop, this);
+    }
+    background_ready.notify_one();
+    return result;
+}
+
+void ThreadPool::backgroundLoop() {
+    while (true) {
+        std::packaged_task<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            background_ready.wait(lock, [this] { return stopping || !background_tasks.empty(); });
+            if (background_tasks.empty()) return;
+            task = std::move(background_tasks.front());
+            background_tasks.pop_front();
+        }
+        task();
+    }
+}
+
+void ThreadPool::parallelFor(int count, const std::function<void(int)> &task) {
+    if (count <= 0) return;
+
+    // Not worth waking the workers for a single task
+    if (workers.empty() || count == 1) {
+        for (int i = 0; i < count; i++) task(i);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = &task;
+        job_count = count;
+        next_index.store(0);
+        active_workers = static_cast<int>(workers.size());
+        generation++;
+    }
+    work_ready.notify_all();
+
+    // The caller works on the job as well
+    runTasks();
+
+    // Wait until every worker has left the job before "task" goes out of scope
+    std::unique_lock<std::mutex> lock(mutex);
+    work_done.wait(lock, [this] { return active_workers == 0; });
+    job = nullptr;
+}
+
+void ThreadPool::runTasks() {
+    for (int i = next_index.fetch_add(1); i < job_count; i = next_index.fetch_add(1)) {
+        (*job)(i);
+    }
+}
+
+void ThreadPool::workerLoop() {
+    unsigned long long seen_generation = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            work_ready.wait(lock, [&] { return stopping || generation != seen_generation; });
+            if (stopping) return;
+            seen_generation = generation;
+        }
+
+        runTasks();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            active_workers--;
+        }
+        work_done.notify_one();
+    }
+}
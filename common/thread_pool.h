@@ -0,0 +1,70 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * ThreadPool Class
+ * A small fixed-size pool of worker threads for data-parallel CPU work (culling, light assignment, ...).
+ * Work is submitted with parallelFor(); the calling thread participates and the call blocks until done.
+ * Single tasks that should overlap the caller's own work go to submit(), which queues them for one long-lived
+ * background thread, so nothing on a per-frame path creates a thread.
+ * No OpenGL calls may be made from a task, as the GL context only lives on the main thread.
+ */
+class ThreadPool {
+public:
+    // threadCount is the total number of threads working on a job, including the caller
+    explicit ThreadPool(unsigned int threadCount = std::thread::hardware_concurrency());
+
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // Number of threads (workers + caller) that can run tasks concurrently
+    unsigned int size() const { return static_cast<unsigned int>(workers.size()) + 1; }
+
+    // Runs task(i) for every i in [0, count) and waits for all of them to finish
+    void parallelFor(int count, const std::function<void(int)> &task);
+
+    // Queues "task" for the background thread (started on first use) and returns at once; tasks run one at a
+    // time in submission order. A task must not call parallelFor(), which only serves one caller at a time
+    std::future<void> submit(std::function<void()> task);
+
+private:
+    void workerLoop();
+
+    void backgroundLoop();
+
+    // Grabs and runs task indices until the current job is exhausted
+    void runTasks();
+
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable work_ready;
+    std::condition_variable work_done;
+
+    // Current job, protected by "mutex" (indices are handed out atomically)
+    const std::function<void(int)> *job = nullptr;
+    int job_count = 0;
+    std::atomic<int> next_index{0};
+    int active_workers = 0;
+    unsigned long long generation = 0;
+    bool stopping = false;
+
+    // submit()'s queue, protected by "mutex"
+    std::thread background;
+    std::deque<std::packaged_task<void()> > background_tasks;
+    std::condition_variable background_ready;
+};
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,931 @@
+#include "vulkan_device.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+namespace {
+    // The push constant size every Vulkan implementation supports, and the abstraction's limit
+    constexpr uint32_t MAX_PUSH_CONSTANTS = 128;
+    constexpr uint32_t MAX_TEXTURES = 8;
+    constexpr uint32_t DESCRIPTOR_SETS_PER_POOL = 256;
+
+    VkFormat formatOf(TextureFormat format) {
+        switch (format) {
+            case TextureFormat::RGBA16F: return VK_FORMAT_R16G16B16A16_SFLOAT;
+            case TextureFormat::Depth32F: return VK_FORMAT_D32_SFLOAT;
+            default: return VK_FORMAT_R8G8B8A8_UNORM;
+        }
+    }
+
+    size_t texelBytes(TextureFormat format) {
+        return format == TextureFormat::RGBA16F ? 8 : 4;
+    }
+
+    VkCompareOp compareOf(CompareOp op) {
+        switch (op) {
+            case CompareOp::LessEqual: return VK_COMPARE_OP_LESS_OR_EQUAL;
+            case CompareOp::Always: return VK_COMPARE_OP_ALWAYS;
+            default: return VK_COMPARE_OP_LESS;
+        }
+    }
+
+    VkFormat attributeFormat(int components) {
+        switch (components) {
+            case 1: return VK_FORMAT_R32_SFLOAT;
+            case 2: return VK_FORMAT_R32G32_SFLOAT;
+            case 4: return VK_FORMAT_R32G32B32A32_SFLOAT;
+            default: return VK_FORMAT_R32G32B32_SFLOAT;
+        }
+    }
+
+    void imageBarrier(VkCommandBuffer commands, VkImage image, VkImageAspectFlags aspect, uint32_t layers,
+                      VkImageLayout from, VkImageLayout to, VkPipelineStageFlags srcStages, VkAccessFlags srcAccess,
+                      VkPipelineStageFlags dstStages, VkAccessFlags dstAccess) {
+        VkImageMemoryBarrier barrier{VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstAccessMask = dstAccess;
+        barrier.oldLayout = from;
+        barrier.newLayout = to;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange = {aspect, 0, 1, 0, layers};
+        vkCmdPipelineBarrier(commands, srcStages, dstStages, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
+
+    // Validation layer messages: warnings and errors are printed, errors counted in the device's counter
+    VKAPI_ATTR VkBool32 VKAPI_CALL onValidationMessage(VkDebugUtilsMessageSeverityFlagBitsEXT severity,
+                                                       VkDebugUtilsMessageTypeFlagsEXT,
+                                                       const VkDebugUtilsMessengerCallbackDataEXT *data,
+                                                       void *errors) {
+        const bool error = (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT) != 0;
+        if (error) static_cast<std::atomic<int> *>(errors)->fetch_add(1);
+        std::cout << (error ? "ERROR::VULKAN_VALIDATION " : "WARNING::VULKAN_VALIDATION ") << data->pMessage
+                << std::endl;
+        return VK_FALSE;
+    }
+}
+
+/*
+ * VulkanCommandList Class
+ * One primary command buffer with its own command pool, and descriptor pools for the texture bindings of its
+ * draws. Both are reset by begin(), so nothing is shared with other lists. The objects it binds are noted, for
+ * submit() to stamp with the submission's serial.
+ */
+class VulkanCommandList : public CommandList {
+public:
+    explicit VulkanCommandList(VulkanRenderDevice &device) : device(device) {
+        VkCommandPoolCreateInfo poolInfo{VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        poolInfo.queueFamilyIndex = device.queue_family;
+        vkCreateCommandPool(device.device, &poolInfo, nullptr, &pool);
+
+        VkCommandBufferAllocateInfo allocateInfo{VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+        allocateInfo.commandPool = pool;
+        allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocateInfo.commandBufferCount = 1;
+        vkAllocateCommandBuffers(device.device, &allocateInfo, &commands);
+    }
+
+    ~VulkanCommandList() override {
+        for (VkDescriptorPool descriptorPool: descriptor_pools) {
+            vkDestroyDescriptorPool(device.device, descriptorPool, nullptr);
+        }
+        vkDestroyCommandPool(device.device, pool, nullptr);
+    }
+
+    VulkanCommandList(const VulkanCommandList &) = delete;
+
+    VulkanCommandList &operator=(const VulkanCommandList &) = delete;
+
+    void begin() override {
+        // The pools are about to be reset, so the submission that last ran this list has to be done
+        device.waitForSubmission(submitted);
+        vkResetCommandPool(device.device, pool, 0);
+        for (VkDescriptorPool descriptorPool: descriptor_pools) {
+            vkResetDescriptorPool(device.device, descriptorPool, 0);
+        }
+        current_descriptor_pool = 0;
+        pipeline = nullptr;
+        std::fill(std::begin(textures), std::end(textures), TextureHandle());
+        textures_dirty = false;
+        used_buffers.clear();
+        used_textures.clear();
+        used_pipelines.clear();
+
+        VkCommandBufferBeginInfo beginInfo{VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(commands, &beginInfo);
+    }
+
+    void end() override {
+        vkEndCommandBuffer(commands);
+    }
+
+    void beginRenderPass(const RenderPassDesc &pass) override {
+        if (!pass.color.valid() && !pass.depth.valid()) {
+            std::cout << "ERROR::VULKAN_DEVICE::PASS_WITHOUT_ATTACHMENTS" << std::endl;
+            return;
+        }
+        pass_color = pass.color;
+
+        VkRenderingInfo renderingInfo{VK_STRUCTURE_TYPE_RENDERING_INFO};
+        VkRenderingAttachmentInfo colorAttachment{VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO};
+        VkRenderingAttachmentInfo depthAttachment{VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO};
+        if (pass.color.valid()) {
+            const VulkanRenderDevice::Texture &texture = device.textures[pass.color.id - 1];
+            used_textures.push_back(pass.color.id);
+            // Earlier passes may still be writing it or sampling it
+            imageBarrier(commands, texture.image, VK_IMAGE_ASPECT_COLOR_BIT, 1,
+                         VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                         VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                         VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+            colorAttachment.imageView = texture.view;
+            colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            colorAttachment.loadOp = pass.clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+            colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+            colorAttachment.clearValue.color = {{pass.clearColor.r, pass.clearColor.g, pass.clearColor.b,
+                                                 pass.clearColor.a}};
+            renderingInfo.colorAttachmentCount = 1;
+            renderingInfo.pColorAttachments = &colorAttachment;
+        }
+        if (pass.depth.valid()) {
+            const VulkanRenderDevice::Texture &texture = device.textures[pass.depth.id - 1];
+            used_textures.push_back(pass.depth.id);
+            // Depth stays in its layout; this only orders the tests after earlier passes' writes
+            imageBarrier(commands, texture.image, VK_IMAGE_ASPECT_DEPTH_BIT, 1,
+                         VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                         VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                         VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                         VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                         VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                         VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
+            depthAttachment.imageView = texture.view;
+            depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+            depthAttachment.loadOp = pass.clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+            depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+            depthAttachment.clearValue.depthStencil = {pass.clearDepth, 0};
+            renderingInfo.pDepthAttachment = &depthAttachment;
+        }
+
+        const TextureDesc &size = device.textures[(pass.color.valid() ? pass.color : pass.depth).id - 1].desc;
+        pass_height = size.height;
+        renderingInfo.renderArea = {{0, 0}, {static_cast<uint32_t>(size.width), static_cast<uint32_t>(size.height)}};
+        renderingInfo.layerCount = 1;
+        vkCmdBeginRendering(commands, &renderingInfo);
+        in_pass = true;
+        setViewport(0, 0, size.width, size.height);
+    }
+
+    void endRenderPass() override {
+        if (!in_pass) return;
+        vkCmdEndRendering(commands);
+        in_pass = false;
+        if (pass_color.valid()) {
+            imageBarrier(commands, device.textures[pass_color.id - 1].image, VK_IMAGE_ASPECT_COLOR_BIT, 1,
+                         VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+        }
+        pass_color = TextureHandle();
+    }
+
+    void setViewport(int x, int y, int width, int height) override {
+        // Negative height flips y, so the origin is at the bottom left as in GL
+        VkViewport viewport;
+        viewport.x = static_cast<float>(x);
+        viewport.y = static_cast<float>(pass_height - y);
+        viewport.width = static_cast<float>(width);
+        viewport.height = -static_cast<float>(height);
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+        vkCmdSetViewport(commands, 0, 1, &viewport);
+
+        VkRect2D scissor;
+        scissor.offset = {std::max(x, 0), std::max(pass_height - y - height, 0)};
+        scissor.extent = {static_cast<uint32_t>(width), static_cast<uint32_t>(height)};
+        vkCmdSetScissor(commands, 0, 1, &scissor);
+    }
+
+    void bindPipeline(PipelineHandle handle) override {
+        pipeline = &device.pipelines[handle.id - 1];
+        used_pipelines.push_back(handle.id);
+        vkCmdBindPipeline(commands, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->pipeline);
+        textures_dirty = pipeline->textureCount > 0;
+    }
+
+    void bindVertexBuffer(BufferHandle buffer, size_t offset) override {
+        const VkDeviceSize bufferOffset = offset;
+        used_buffers.push_back(buffer.id);
+        vkCmdBindVertexBuffers(commands, 0, 1, &device.buffers[buffer.id - 1].buffer, &bufferOffset);
+    }
+
+    void bindIndexBuffer(BufferHandle buffer) override {
+        used_buffers.push_back(buffer.id);
+        vkCmdBindIndexBuffer(commands, device.buffers[buffer.id - 1].buffer, 0, VK_INDEX_TYPE_UINT32);
+    }
+
+    void bindTexture(int slot, TextureHandle texture) override {
+        if (slot < 0 || slot >= static_cast<int>(MAX_TEXTURES)) return;
+        textures[slot] = texture;
+        textures_dirty = true;
+    }
+
+    void pushConstants(const void *data, uint32_t size) override {
+        if (!pipeline || pipeline->pushConstantSize == 0) return;
+        vkCmdPushConstants(commands, pipeline->layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0,
+                           std::min(size, pipeline->pushConstantSize), data);
+    }
+
+    void draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex) override {
+        bindTextures();
+        vkCmdDraw(commands, vertexCount, instanceCount, firstVertex, 0);
+    }
+
+    void drawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex) override {
+        bindTextures();
+        vkCmdDrawIndexed(commands, indexCount, instanceCount, firstIndex, 0, 0);
+    }
+
+    VkCommandBuffer commands = VK_NULL_HANDLE;
+    uint64_t submitted = 0; // Serial of the submission that last ran the list
+    std::vector<uint32_t> used_buffers, used_textures, used_pipelines; // Handle ids, with repeats
+
+private:
+    // Texture bindings are descriptor sets, written only when a draw follows a change
+    void bindTextures() {
+        if (!textures_dirty || !pipeline) return;
+        textures_dirty = false;
+
+        VkDescriptorSet set = allocateSet(pipeline->setLayout);
+        if (set == VK_NULL_HANDLE) return;
+        VkDescriptorImageInfo images[MAX_TEXTURES];
+        VkWriteDescriptorSet writes[MAX_TEXTURES];
+        uint32_t writeCount = 0;
+        for (uint32_t slot = 0; slot < pipeline->textureCount; slot++) {
+            if (!textures[slot].valid()) continue;
+            used_textures.push_back(textures[slot].id);
+            images[writeCount] = {device.sampler, device.textures[textures[slot].id - 1].view,
+                                  VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+            writes[writeCount] = VkWriteDescriptorSet{VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+            writes[writeCount].dstSet = set;
+            writes[writeCount].dstBinding = slot;
+            writes[writeCount].descriptorCount = 1;
+            writes[writeCount].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            writes[writeCount].pImageInfo = &images[writeCount];
+            writeCount++;
+        }
+        vkUpdateDescriptorSets(device.device, writeCount, writes, 0, nullptr);
+        vkCmdBindDescriptorSets(commands, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->layout, 0, 1, &set, 0, nullptr);
+    }
+
+    // Takes a set from the current pool, moving on to a new pool when it is full
+    VkDescriptorSet allocateSet(VkDescriptorSetLayout layout) {
+        for (;;) {
+            if (current_descriptor_pool == descriptor_pools.size()) {
+                VkDescriptorPoolSize poolSize{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                              DESCRIPTOR_SETS_PER_POOL * MAX_TEXTURES};
+                VkDescriptorPoolCreateInfo poolInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+                poolInfo.maxSets = DESCRIPTOR_SETS_PER_POOL;
+                poolInfo.poolSizeCount = 1;
+                poolInfo.pPoolSizes = &poolSize;
+                VkDescriptorPool descriptorPool;
+                if (vkCreateDescriptorPool(device.device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+                    std::cout << "ERROR::VULKAN_DEVICE::DESCRIPTOR_POOL_CREATION_FAILED" << std::endl;
+                    return VK_NULL_HANDLE;
+                }
+                descriptor_pools.push_back(descriptorPool);
+            }
+            VkDescriptorSetAllocateInfo allocateInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+            allocateInfo.descriptorPool = descriptor_pools[current_descriptor_pool];
+            allocateInfo.descriptorSetCount = 1;
+            allocateInfo.pSetLayouts = &layout;
+            VkDescriptorSet set;
+            if (vkAllocateDescriptorSets(device.device, &allocateInfo, &set) == VK_SUCCESS) return set;
+            current_descriptor_pool++;
+        }
+    }
+
+    VulkanRenderDevice &device;
+    VkCommandPool pool = VK_NULL_HANDLE;
+    std::vector<VkDescriptorPool> descriptor_pools;
+    size_t current_descriptor_pool = 0;
+
+    const VulkanRenderDevice::Pipeline *pipeline = nullptr;
+    TextureHandle textures[MAX_TEXTURES];
+    bool textures_dirty = false;
+    TextureHandle pass_color;
+    int pass_height = 0;
+    bool in_pass = false;
+};
+
+VulkanRenderDevice::VulkanRenderDevice(bool preferCpu, bool validation) {
+    if (!createInstance(validation) || !pickDevice(preferCpu)) return;
+
+    const float priority = 1.0f;
+    VkDeviceQueueCreateInfo queueInfo{VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO};
+    queueInfo.queueFamilyIndex = queue_family;
+    queueInfo.queueCount = 1;
+    queueInfo.pQueuePriorities = &priority;
+
+    VkPhysicalDeviceVulkan13Features features13{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES};
+    features13.dynamicRendering = VK_TRUE;
+
+    VkDeviceCreateInfo deviceInfo{VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO};
+    deviceInfo.pNext = &features13;
+    deviceInfo.queueCreateInfoCount = 1;
+    deviceInfo.pQueueCreateInfos = &queueInfo;
+    if (vkCreateDevice(physical_device, &deviceInfo, nullptr, &device) != VK_SUCCESS) {
+        std::cout << "ERROR::VULKAN_DEVICE::DEVICE_CREATION_FAILED" << std::endl;
+        device = VK_NULL_HANDLE;
+        return;
+    }
+    vkGetDeviceQueue(device, queue_family, 0, &queue);
+
+    VkCommandPoolCreateInfo poolInfo{VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolInfo.queueFamilyIndex = queue_family;
+    vkCreateCommandPool(device, &poolInfo, nullptr, &immediate_pool);
+
+    VkFenceCreateInfo fenceInfo{VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+    for (Frame &frame: frames) {
+        vkCreateFence(device, &fenceInfo, nullptr, &frame.fence);
+    }
+
+    VkSamplerCreateInfo samplerInfo{VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.maxLod = 0.0f;
+    vkCreateSampler(device, &samplerInfo, nullptr, &sampler);
+}
+
+VulkanRenderDevice::~VulkanRenderDevice() {
+    if (device != VK_NULL_HANDLE) {
+        vkDeviceWaitIdle(device);
+        for (size_t i = 0; i < buffers.size(); i++) {
+            if (buffers[i].buffer != VK_NULL_HANDLE) destroyBuffer(BufferHandle{static_cast<uint32_t>(i + 1)});
+        }
+        for (size_t i = 0; i < textures.size(); i++) {
+            if (textures[i].image != VK_NULL_HANDLE) destroyTexture(TextureHandle{static_cast<uint32_t>(i + 1)});
+        }
+        for (size_t i = 0; i < pipelines.size(); i++) {
+            if (pipelines[i].pipeline != VK_NULL_HANDLE) {
+                destroyPipeline(PipelineHandle{static_cast<uint32_t>(i + 1)});
+            }
+        }
+        vkDestroySampler(device, sampler, nullptr);
+        for (Frame &frame: frames) {
+            vkDestroyFence(device, frame.fence, nullptr);
+        }
+        vkDestroyCommandPool(device, immediate_pool, nullptr);
+        vkDestroyDevice(device, nullptr);
+    }
+    if (debug_messenger != VK_NULL_HANDLE) {
+        auto destroyMessenger = reinterpret_cast<PFN_vkDestroyDebugUtilsMessengerEXT>(
+            vkGetInstanceProcAddr(instance, "vkDestroyDebugUtilsMessengerEXT"));
+        destroyMessenger(instance, debug_messenger, nullptr);
+    }
+    if (instance != VK_NULL_HANDLE) vkDestroyInstance(instance, nullptr);
+}
+
+bool VulkanRenderDevice::createInstance(bool validation) {
+    VkApplicationInfo applicationInfo{VK_STRUCTURE_TYPE_APPLICATION_INFO};
+    applicationInfo.pApplicationName = "Autumn Windmill";
+    applicationInfo.apiVersion = VK_API_VERSION_1_3;
+
+    std::vector<const char *> layers, extensions;
+    if (validation) {
+        uint32_t count = 0;
+        vkEnumerateInstanceLayerProperties(&count, nullptr);
+        std::vector<VkLayerProperties> available(count);
+        vkEnumerateInstanceLayerProperties(&count, available.data());
+        for (const VkLayerProperties &layer: available) {
+            if (std::strcmp(layer.layerName, "VK_LAYER_KHRONOS_validation") == 0) {
+                layers.push_back("VK_LAYER_KHRONOS_validation");
+                // The layer implements it, whether or not the loader does
+                extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+            }
+        }
+        if (layers.empty()) std::cout << "Vulkan validation layer not installed, running without it" << std::endl;
+    }
+
+    VkDebugUtilsMessengerCreateInfoEXT messengerInfo{VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT};
+    messengerInfo.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT |
+                                    VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+    messengerInfo.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT |
+                                VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT |
+                                VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+    messengerInfo.pfnUserCallback = onValidationMessage;
+    messengerInfo.pUserData = &validation_errors;
+
+    VkInstanceCreateInfo instanceInfo{VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO};
+    // Chained as well, so instance creation and destruction are validated too
+    if (!layers.empty()) instanceInfo.pNext = &messengerInfo;
+    instanceInfo.pApplicationInfo = &applicationInfo;
+    instanceInfo.enabledLayerCount = static_cast<uint32_t>(layers.size());
+    instanceInfo.ppEnabledLayerNames = layers.data();
+    instanceInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+    instanceInfo.ppEnabledExtensionNames = extensions.data();
+    if (vkCreateInstance(&instanceInfo, nullptr, &instance) != VK_SUCCESS) {
+        std::cout << "ERROR::VULKAN_DEVICE::INSTANCE_CREATION_FAILED" << std::endl;
+        instance = VK_NULL_HANDLE;
+        return false;
+    }
+
+    if (!layers.empty()) {
+        auto createMessenger = reinterpret_cast<PFN_vkCreateDebugUtilsMessengerEXT>(
+            vkGetInstanceProcAddr(instance, "vkCreateDebugUtilsMessengerEXT"));
+        if (createMessenger == nullptr ||
+            createMessenger(instance, &messengerInfo, nullptr, &debug_messenger) != VK_SUCCESS) {
+            std::cout << "ERROR::VULKAN_DEVICE::VALIDATION_MESSENGER_NOT_CREATED" << std::endl;
+            debug_messenger = VK_NULL_HANDLE;
+        }
+    }
+    return true;
+}
+
+bool VulkanRenderDevice::pickDevice(bool preferCpu) {
+    uint32_t count = 0;
+    vkEnumeratePhysicalDevices(instance, &count, nullptr);
+    std::vector<VkPhysicalDevice> candidates(count);
+    vkEnumeratePhysicalDevices(instance, &count, candidates.data());
+
+    int bestScore = 0;
+    for (VkPhysicalDevice candidate: candidates) {
+        VkPhysicalDeviceProperties candidateProperties;
+        vkGetPhysicalDeviceProperties(candidate, &candidateProperties);
+        if (candidateProperties.apiVersion < VK_API_VERSION_1_3) continue;
+
+        uint32_t familyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(candidate, &familyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> families(familyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(candidate, &familyCount, families.data());
+        uint32_t graphicsFamily = familyCount;
+        for (uint32_t i = 0; i < familyCount; i++) {
+            if (families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+                graphicsFamily = i;
+                break;
+            }
+        }
+        if (graphicsFamily == familyCount) continue;
+
+        int score;
+        switch (candidateProperties.deviceType) {
+            case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: score = 4; break;
+            case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: score = 3; break;
+            case VK_PHYSICAL_DEVICE_TYPE_CPU: score = preferCpu ? 5 : 1; break;
+            default: score = 2; break;
+        }
+        if (score > bestScore) {
+            bestScore = score;
+            physical_device = candidate;
+            properties = candidateProperties;
+            queue_family = graphicsFamily;
+        }
+    }
+    if (physical_device == VK_NULL_HANDLE) {
+        std::cout << "ERROR::VULKAN_DEVICE::NO_VULKAN_1_3_DEVICE" << std::endl;
+        return false;
+    }
+    vkGetPhysicalDeviceMemoryProperties(physical_device, &memory_properties);
+    return true;
+}
+
+std::string VulkanRenderDevice::name() const {
+    return "Vulkan " + std::to_string(VK_API_VERSION_MAJOR(properties.apiVersion)) + "." +
+           std::to_string(VK_API_VERSION_MINOR(properties.apiVersion)) + " " + properties.deviceName;
+}
+
+uint32_t VulkanRenderDevice::memoryType(uint32_t typeBits, VkMemoryPropertyFlags wanted) const {
+    for (uint32_t i = 0; i < memory_properties.memoryTypeCount; i++) {
+        if ((typeBits & (1u << i)) && (memory_properties.memoryTypes[i].propertyFlags & wanted) == wanted) return i;
+    }
+    return UINT32_MAX;
+}
+
+VulkanRenderDevice::Buffer VulkanRenderDevice::makeBuffer(size_t size, VkBufferUsageFlags usage) {
+    Buffer buffer;
+    buffer.size = size;
+    VkBufferCreateInfo bufferInfo{VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+    bufferInfo.size = std::max<size_t>(size, 4);
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    vkCreateBuffer(device, &bufferInfo, nullptr, &buffer.buffer);
+
+    // Host-visible: the CPU writes vertex data directly, and lavapipe has no other memory anyway
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(device, buffer.buffer, &requirements);
+    VkMemoryAllocateInfo allocateInfo{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+    allocateInfo.allocationSize = requirements.size;
+    allocateInfo.memoryTypeIndex = memoryType(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                                                           VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    vkAllocateMemory(device, &allocateInfo, nullptr, &buffer.memory);
+    vkBindBufferMemory(device, buffer.buffer, buffer.memory, 0);
+    vkMapMemory(device, buffer.memory, 0, VK_WHOLE_SIZE, 0, &buffer.mapped);
+    return buffer;
+}
+
+void VulkanRenderDevice::freeBuffer(Buffer &buffer) {
+    vkUnmapMemory(device, buffer.memory);
+    vkDestroyBuffer(device, buffer.buffer, nullptr);
+    vkFreeMemory(device, buffer.memory, nullptr);
+    buffer = Buffer();
+}
+
+VkShaderModule VulkanRenderDevice::loadModule(const std::string &path) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) {
+        std::cout << "ERROR::VULKAN_DEVICE::SPIRV_NOT_READ " << path << std::endl;
+        return VK_NULL_HANDLE;
+    }
+    const size_t bytes = static_cast<size_t>(file.tellg());
+    std::vector<uint32_t> code((bytes + 3) / 4);
+    file.seekg(0);
+    file.read(reinterpret_cast<char *>(code.data()), static_cast<std::streamsize>(bytes));
+
+    VkShaderModuleCreateInfo moduleInfo{VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO};
+    moduleInfo.codeSize = bytes;
+    moduleInfo.pCode = code.data();
+    VkShaderModule module;
+    if (vkCreateShaderModule(device, &moduleInfo, nullptr, &module) != VK_SUCCESS) {
+        std::cout << "ERROR::VULKAN_DEVICE::SHADER_MODULE_CREATION_FAILED " << path << std::endl;
+        return VK_NULL_HANDLE;
+    }
+    return module;
+}
+
+VkCommandBuffer VulkanRenderDevice::beginImmediate() {
+    VkCommandBufferAllocateInfo allocateInfo{VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+    allocateInfo.commandPool = immediate_pool;
+    allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocateInfo.commandBufferCount = 1;
+    VkCommandBuffer commands;
+    vkAllocateCommandBuffers(device, &allocateInfo, &commands);
+
+    VkCommandBufferBeginInfo beginInfo{VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(commands, &beginInfo);
+    return commands;
+}
+
+void VulkanRenderDevice::endImmediate(VkCommandBuffer commands) {
+    vkEndCommandBuffer(commands);
+    VkSubmitInfo submitInfo{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commands;
+    vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+    vkQueueWaitIdle(queue);
+    vkFreeCommandBuffers(device, immediate_pool, 1, &commands);
+}
+
+void VulkanRenderDevice::waitForSubmission(uint64_t serial) {
+    if (serial == 0) return;
+    std::lock_guard<std::mutex> lock(frame_mutex);
+    // A slot given to a later submission was waited for first, so an older serial is done
+    const Frame &frame = frames[serial % FRAMES_IN_FLIGHT];
+    if (frame.serial == serial) vkWaitForFences(device, 1, &frame.fence, VK_TRUE, UINT64_MAX);
+}
+
+BufferHandle VulkanRenderDevice::createBuffer(const BufferDesc &desc) {
+    Buffer buffer = makeBuffer(desc.size, desc.usage == BufferUsage::Index ? VK_BUFFER_USAGE_INDEX_BUFFER_BIT
+                                                                           : VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+    if (desc.data) std::memcpy(buffer.mapped, desc.data, desc.size);
+    buffers.push_back(buffer);
+    return BufferHandle{static_cast<uint32_t>(buffers.size())};
+}
+
+void VulkanRenderDevice::updateBuffer(BufferHandle buffer, const void *data, size_t size, size_t offset) {
+    Buffer &entry = buffers[buffer.id - 1];
+    waitForSubmission(entry.lastUse);
+    std::memcpy(static_cast<unsigned char *>(entry.mapped) + offset, data, size);
+}
+
+TextureHandle VulkanRenderDevice::createTexture(const TextureDesc &desc) {
+    const bool depth = desc.format == TextureFormat::Depth32F;
+    const bool cube = desc.type == TextureType::Cube;
+    const uint32_t layers = cube ? 6 : 1;
+    const VkImageAspectFlags aspect = depth ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+
+    Texture texture;
+    texture.desc = desc;
+    texture.desc.data = nullptr;
+
+    VkImageCreateInfo imageInfo{VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
+    imageInfo.flags = cube ? VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT : 0;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = formatOf(desc.format);
+    imageInfo.extent = {static_cast<uint32_t>(desc.width), static_cast<uint32_t>(desc.height), 1};
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = layers;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = depth ? VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT
+                            : VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    if (desc.renderTarget && !depth) {
+        imageInfo.usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    }
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    if (vkCreateImage(device, &imageInfo, nullptr, &texture.image) != VK_SUCCESS) {
+        std::cout << "ERROR::VULKAN_DEVICE::IMAGE_CREATION_FAILED" << std::endl;
+        return TextureHandle();
+    }
+
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(device, texture.image, &requirements);
+    VkMemoryAllocateInfo allocateInfo{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+    allocateInfo.allocationSize = requirements.size;
+    allocateInfo.memoryTypeIndex = memoryType(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (allocateInfo.memoryTypeIndex == UINT32_MAX) {
+        allocateInfo.memoryTypeIndex = memoryType(requirements.memoryTypeBits, 0);
+    }
+    vkAllocateMemory(device, &allocateInfo, nullptr, &texture.memory);
+    vkBindImageMemory(device, texture.image, texture.memory, 0);
+
+    VkImageViewCreateInfo viewInfo{VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+    viewInfo.image = texture.image;
+    viewInfo.viewType = cube ? VK_IMAGE_VIEW_TYPE_CUBE : VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = imageInfo.format;
+    viewInfo.subresourceRange = {aspect, 0, 1, 0, layers};
+    vkCreateImageView(device, &viewInfo, nullptr, &texture.view);
+
+    // Into the layout it rests in, with the initial texels if there are any
+    Buffer staging;
+    VkCommandBuffer commands = beginImmediate();
+    if (depth) {
+        imageBarrier(commands, texture.image, aspect, layers, VK_IMAGE_LAYOUT_UNDEFINED,
+                     VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0,
+                     VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                     VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
+    } else if (desc.data) {
+        const size_t bytes = static_cast<size_t>(desc.width) * desc.height * texelBytes(desc.format) * layers;
+        staging = makeBuffer(bytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+        std::memcpy(staging.mapped, desc.data, bytes);
+        imageBarrier(commands, texture.image, aspect, layers, VK_IMAGE_LAYOUT_UNDEFINED,
+                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0,
+                     VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+        // Cube faces are consecutive layers, as they are consecutive in the data
+        VkBufferImageCopy region{};
+        region.imageSubresource = {aspect, 0, 0, layers};
+        region.imageExtent = imageInfo.extent;
+        vkCmdCopyBufferToImage(commands, staging.buffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
+                               &region);
+        imageBarrier(commands, texture.image, aspect, layers, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                     VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                     VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+    } else {
+        imageBarrier(commands, texture.image, aspect, layers, VK_IMAGE_LAYOUT_UNDEFINED,
+                     VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0,
+                     VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+    }
+    endImmediate(commands);
+    if (staging.buffer != VK_NULL_HANDLE) freeBuffer(staging);
+
+    textures.push_back(texture);
+    return TextureHandle{static_cast<uint32_t>(textures.size())};
+}
+
+PipelineHandle VulkanRenderDevice::createPipeline(const PipelineDesc &desc) {
+    if (desc.features != 0) {
+        std::cout << "ERROR::VULKAN_DEVICE::SHADER_FEATURES_UNSUPPORTED " << desc.vertexShader << std::endl;
+    }
+    VkShaderModule vertexModule = loadModule(desc.vertexShader + ".spv");
+    VkShaderModule fragmentModule = loadModule(desc.fragmentShader + ".spv");
+    if (vertexModule == VK_NULL_HANDLE || fragmentModule == VK_NULL_HANDLE) {
+        if (vertexModule != VK_NULL_HANDLE) vkDestroyShaderModule(device, vertexModule, nullptr);
+        if (fragmentModule != VK_NULL_HANDLE) vkDestroyShaderModule(device, fragmentModule, nullptr);
+        return PipelineHandle();
+    }
+
+    Pipeline pipeline;
+    pipeline.textureCount = std::min(static_cast<uint32_t>(desc.textures.size()), MAX_TEXTURES);
+    pipeline.pushConstantSize = std::min(desc.pushConstantSize, MAX_PUSH_CONSTANTS);
+
+    // Textures are bindings 0, 1, ... of set 0; push constants are visible to both stages
+    std::vector<VkDescriptorSetLayoutBinding> bindings(pipeline.textureCount);
+    for (uint32_t slot = 0; slot < pipeline.textureCount; slot++) {
+        bindings[slot] = {slot, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr};
+    }
+    VkDescriptorSetLayoutCreateInfo setInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+    setInfo.bindingCount = pipeline.textureCount;
+    setInfo.pBindings = bindings.data();
+    vkCreateDescriptorSetLayout(device, &setInfo, nullptr, &pipeline.setLayout);
+
+    const VkPushConstantRange pushRange{VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0,
+                                        pipeline.pushConstantSize};
+    VkPipelineLayoutCreateInfo layoutInfo{VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+    layoutInfo.setLayoutCount = 1;
+    layoutInfo.pSetLayouts = &pipeline.setLayout;
+    layoutInfo.pushConstantRangeCount = pipeline.pushConstantSize > 0 ? 1 : 0;
+    layoutInfo.pPushConstantRanges = &pushRange;
+    vkCreatePipelineLayout(device, &layoutInfo, nullptr, &pipeline.layout);
+
+    VkPipelineShaderStageCreateInfo stages[2];
+    stages[0] = VkPipelineShaderStageCreateInfo{VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
+    stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    stages[0].module = vertexModule;
+    stages[0].pName = "main";
+    stages[1] = stages[0];
+    stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    stages[1].module = fragmentModule;
+
+    const VkVertexInputBindingDescription vertexBinding{0, desc.vertexStride, VK_VERTEX_INPUT_RATE_VERTEX};
+    std::vector<VkVertexInputAttributeDescription> attributes;
+    for (const VertexAttribute &attribute: desc.attributes) {
+        attributes.push_back({attribute.location, 0, attributeFormat(attribute.components), attribute.offset});
+    }
+    VkPipelineVertexInputStateCreateInfo vertexInput{VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO};
+    vertexInput.vertexBindingDescriptionCount = attributes.empty() ? 0 : 1;
+    vertexInput.pVertexBindingDescriptions = &vertexBinding;
+    vertexInput.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributes.size());
+    vertexInput.pVertexAttributeDescriptions = attributes.data();
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly{
+        VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO
+    };
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+    VkPipelineViewportStateCreateInfo viewportState{VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO};
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
+
+    VkPipelineRasterizationStateCreateInfo rasterization{
+        VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO
+    };
+    rasterization.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterization.cullMode = desc.cullBackFaces ? VK_CULL_MODE_BACK_BIT : VK_CULL_MODE_NONE;
+    rasterization.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    rasterization.lineWidth = 1.0f;
+
+    VkPipelineMultisampleStateCreateInfo multisample{VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO};
+    multisample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkPipelineDepthStencilStateCreateInfo depthStencil{
+        VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO
+    };
+    depthStencil.depthTestEnable = desc.depthTest ? VK_TRUE : VK_FALSE;
+    depthStencil.depthWriteEnable = desc.depthWrite ? VK_TRUE : VK_FALSE;
+    depthStencil.depthCompareOp = compareOf(desc.depthCompare);
+
+    VkPipelineColorBlendAttachmentState blendAttachment{};
+    blendAttachment.blendEnable = desc.alphaBlend ? VK_TRUE : VK_FALSE;
+    blendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    blendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    blendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+    blendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    blendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    blendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+    blendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                                     VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    VkPipelineColorBlendStateCreateInfo colorBlend{VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO};
+    colorBlend.attachmentCount = 1;
+    colorBlend.pAttachments = &blendAttachment;
+
+    const VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamicState{VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO};
+    dynamicState.dynamicStateCount = 2;
+    dynamicState.pDynamicStates = dynamicStates;
+
+    // Dynamic rendering: the attachment formats replace a render pass
+    const VkFormat colorFormat = formatOf(desc.colorFormat);
+    VkPipelineRenderingCreateInfo rendering{VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO};
+    rendering.colorAttachmentCount = 1;
+    rendering.pColorAttachmentFormats = &colorFormat;
+    rendering.depthAttachmentFormat = formatOf(desc.depthFormat);
+
+    VkGraphicsPipelineCreateInfo pipelineInfo{VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO};
+    pipelineInfo.pNext = &rendering;
+    pipelineInfo.stageCount = 2;
+    pipelineInfo.pStages = stages;
+    pipelineInfo.pVertexInputState = &vertexInput;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &rasterization;
+    pipelineInfo.pMultisampleState = &multisample;
+    pipelineInfo.pDepthStencilState = &depthStencil;
+    pipelineInfo.pColorBlendState = &colorBlend;
+    pipelineInfo.pDynamicState = &dynamicState;
+    pipelineInfo.layout = pipeline.layout;
+    const VkResult result = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr,
+                                                      &pipeline.pipeline);
+    vkDestroyShaderModule(device, vertexModule, nullptr);
+    vkDestroyShaderModule(device, fragmentModule, nullptr);
+    if (result != VK_SUCCESS) {
+        std::cout << "ERROR::VULKAN_DEVICE::PIPELINE_CREATION_FAILED " << desc.vertexShader << std::endl;
+        vkDestroyPipelineLayout(device, pipeline.layout, nullptr);
+        vkDestroyDescriptorSetLayout(device, pipeline.setLayout, nullptr);
+        return PipelineHandle();
+    }
+    pipelines.push_back(pipeline);
+    return PipelineHandle{static_cast<uint32_t>(pipelines.size())};
+}
+
+void VulkanRenderDevice::destroyBuffer(BufferHandle buffer) {
+    Buffer &entry = buffers[buffer.id - 1];
+    waitForSubmission(entry.lastUse);
+    freeBuffer(entry);
+}
+
+void VulkanRenderDevice::destroyTexture(TextureHandle texture) {
+    Texture &entry = textures[texture.id - 1];
+    waitForSubmission(entry.lastUse);
+    vkDestroyImageView(device, entry.view, nullptr);
+    vkDestroyImage(device, entry.image, nullptr);
+    vkFreeMemory(device, entry.memory, nullptr);
+    entry = Texture();
+}
+
+void VulkanRenderDevice::destroyPipeline(PipelineHandle pipeline) {
+    Pipeline &entry = pipelines[pipeline.id - 1];
+    waitForSubmission(entry.lastUse);
+    vkDestroyPipeline(device, entry.pipeline, nullptr);
+    vkDestroyPipelineLayout(device, entry.layout, nullptr);
+    vkDestroyDescriptorSetLayout(device, entry.setLayout, nullptr);
+    entry = Pipeline();
+}
+
+std::unique_ptr<CommandList> VulkanRenderDevice::createCommandList() {
+    return std::make_unique<VulkanCommandList>(*this);
+}
+
+void VulkanRenderDevice::submit(const std::vector<CommandList *> &lists) {
+    const uint64_t serial = ++submission_serial;
+    std::vector<VkCommandBuffer> commandBuffers;
+    commandBuffers.reserve(lists.size());
+    for (CommandList *list: lists) {
+        auto *vulkanList = static_cast<VulkanCommandList *>(list);
+        commandBuffers.push_back(vulkanList->commands);
+        vulkanList->submitted = serial;
+        for (uint32_t id: vulkanList->used_buffers) buffers[id - 1].lastUse = serial;
+        for (uint32_t id: vulkanList->used_textures) textures[id - 1].lastUse = serial;
+        for (uint32_t id: vulkanList->used_pipelines) pipelines[id - 1].lastUse = serial;
+    }
+
+    // The slot's previous submission is FRAMES_IN_FLIGHT back; only that one is waited for
+    std::lock_guard<std::mutex> lock(frame_mutex);
+    Frame &frame = frames[serial % FRAMES_IN_FLIGHT];
+    vkWaitForFences(device, 1, &frame.fence, VK_TRUE, UINT64_MAX);
+    vkResetFences(device, 1, &frame.fence);
+    frame.serial = serial;
+    VkSubmitInfo submitInfo{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+    submitInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+    submitInfo.pCommandBuffers = commandBuffers.data();
+    if (vkQueueSubmit(queue, 1, &submitInfo, frame.fence) != VK_SUCCESS) {
+        std::cout << "ERROR::VULKAN_DEVICE::SUBMIT_FAILED" << std::endl;
+        // An empty batch still signals the fence, so later waits do not hang
+        vkQueueSubmit(queue, 0, nullptr, frame.fence);
+    }
+}
+
+std::vector<unsigned char> VulkanRenderDevice::readTexture(TextureHandle texture) {
+    const Texture &entry = textures[texture.id - 1];
+    const size_t bytes = static_cast<size_t>(entry.desc.width) * entry.desc.height * 4;
+    std::vector<unsigned char> texels(bytes);
+    if (entry.desc.format != TextureFormat::RGBA8 || entry.desc.type != TextureType::Texture2D ||
+        !entry.desc.renderTarget) {
+        std::cout << "ERROR::VULKAN_DEVICE::READ_TEXTURE_FORMAT" << std::endl;
+        return texels;
+    }
+
+    // The copy follows the submissions that drew into the texture on the same queue, and its barrier orders it
+    // after their colour writes; endImmediate() then waits for all of it
+    Buffer staging = makeBuffer(bytes, VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+    VkCommandBuffer commands = beginImmediate();
+    imageBarrier(commands, entry.image, VK_IMAGE_ASPECT_COLOR_BIT, 1, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                 VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                 VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+    VkBufferImageCopy region{};
+    region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.imageExtent = {static_cast<uint32_t>(entry.desc.width), static_cast<uint32_t>(entry.desc.height), 1};
+    vkCmdCopyImageToBuffer(commands, entry.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, staging.buffer, 1, &region);
+    imageBarrier(commands, entry.image, VK_IMAGE_ASPECT_COLOR_BIT, 1, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                 VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                 VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0);
+    VkMemoryBarrier hostRead{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    hostRead.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    hostRead.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(commands, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &hostRead, 0,
+                         nullptr, 0, nullptr);
+    endImmediate(commands);
+
+    // The flipped viewport already put the top row first
+    std::memcpy(texels.data(), staging.mapped, bytes);
+    freeBuffer(staging);
+    return texels;
+}
+
+glm::mat4 VulkanRenderDevice::clipCorrection() const {
+    // z' = (z + w) / 2 maps [-w, w] to [0, w]
+    glm::mat4 correction(1.0f);
+    correction[2][2] = 0.5f;
+    correction[3][2] = 0.5f;
+    return correction;
+}
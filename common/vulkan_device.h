@@ -0,0 +1,154 @@
+#ifndef VULKAN_DEVICE_H
+#define VULKAN_DEVICE_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+#include "render_device.h"
+
+/*
+ * VulkanRenderDevice Class
+ * RenderDevice on a headless Vulkan 1.3 device, without a window or swapchain: frames go into render target
+ * textures and are read back. Any Vulkan 1.3 driver works, including Mesa's lavapipe (a CPU device), so the
+ * backend can be run where there is no GPU.
+ * Every command list owns its command pool and descriptor pools, so lists are recorded on several threads with
+ * no locking; each is one primary command buffer, and submit() hands them to the queue in one batch. Passes
+ * use dynamic rendering, so pipelines need no render pass objects. Colour targets rest in the shader-read
+ * layout between passes; depth targets stay in the attachment layout and cannot be sampled.
+ * The viewport is flipped (negative height) so GL's conventions hold: bottom-left viewport origin,
+ * counter-clockwise front faces; clipCorrection() maps GL's depth range to Vulkan's.
+ * Up to FRAMES_IN_FLIGHT submissions run while the next ones are recorded, each signalling its own fence. Every
+ * submission gets a serial, stamped on its lists and on the buffers, textures and pipelines they use, so starting
+ * to record a list waits only for the submission that last ran it, and updating or destroying an object only for
+ * the last one that used it. Recording frame N + 1 into another set of lists therefore never waits for frame N.
+ * With validation on, the layer's warnings and errors are printed and its errors counted (validationErrors()),
+ * so a run can fail on them.
+ */
+class VulkanRenderDevice : public RenderDevice {
+public:
+    // Submissions that may run at once; submit() waits for the one this many submissions back
+    static constexpr int FRAMES_IN_FLIGHT = 2;
+
+    // "preferCpu" picks a CPU device (lavapipe) even if a GPU is present. "validation" enables the Khronos
+    // validation layer when it is installed; isValidating() tells whether it was
+    explicit VulkanRenderDevice(bool preferCpu = false, bool validation = false);
+
+    ~VulkanRenderDevice() override;
+
+    VulkanRenderDevice(const VulkanRenderDevice &) = delete;
+
+    VulkanRenderDevice &operator=(const VulkanRenderDevice &) = delete;
+
+    // False if no Vulkan 1.3 device could be set up; nothing else may be called then
+    bool isValid() const { return device != VK_NULL_HANDLE; }
+
+    bool isValidating() const { return debug_messenger != VK_NULL_HANDLE; }
+
+    // Errors the validation layer has reported so far, from any thread
+    int validationErrors() const { return validation_errors.load(); }
+
+    std::string name() const override;
+
+    BufferHandle createBuffer(const BufferDesc &desc) override;
+
+    void updateBuffer(BufferHandle buffer, const void *data, size_t size, size_t offset) override;
+
+    TextureHandle createTexture(const TextureDesc &desc) override;
+
+    PipelineHandle createPipeline(const PipelineDesc &desc) override;
+
+    void destroyBuffer(BufferHandle buffer) override;
+
+    void destroyTexture(TextureHandle texture) override;
+
+    void destroyPipeline(PipelineHandle pipeline) override;
+
+    std::unique_ptr<CommandList> createCommandList() override;
+
+    void submit(const std::vector<CommandList *> &lists) override;
+
+    std::vector<unsigned char> readTexture(TextureHandle texture) override;
+
+    glm::mat4 clipCorrection() const override;
+
+private:
+    friend class VulkanCommandList;
+
+    struct Buffer {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        void *mapped = nullptr; // Host-visible memory, mapped for the buffer's lifetime
+        size_t size = 0;
+        uint64_t lastUse = 0; // Serial of the last submission using it; 0 if none
+    };
+
+    struct Texture {
+        VkImage image = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        TextureDesc desc;
+        uint64_t lastUse = 0;
+    };
+
+    struct Pipeline {
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        VkPipelineLayout layout = VK_NULL_HANDLE;
+        VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+        uint32_t textureCount = 0;
+        uint32_t pushConstantSize = 0;
+        uint64_t lastUse = 0;
+    };
+
+    // One submission slot: a fence, created signalled, and the serial of the submission it was last given to
+    struct Frame {
+        VkFence fence = VK_NULL_HANDLE;
+        uint64_t serial = 0;
+    };
+
+    bool createInstance(bool validation);
+
+    bool pickDevice(bool preferCpu);
+
+    uint32_t memoryType(uint32_t typeBits, VkMemoryPropertyFlags properties) const;
+
+    Buffer makeBuffer(size_t size, VkBufferUsageFlags usage);
+
+    void freeBuffer(Buffer &buffer);
+
+    VkShaderModule loadModule(const std::string &path);
+
+    // Commands outside the lists (uploads, layout changes, readback), run synchronously
+    VkCommandBuffer beginImmediate();
+
+    void endImmediate(VkCommandBuffer commands);
+
+    // Waits for the submission with the given serial unless it is known to be done; 0 returns at once.
+    // Callable from any thread
+    void waitForSubmission(uint64_t serial);
+
+    VkInstance instance = VK_NULL_HANDLE;
+    VkDebugUtilsMessengerEXT debug_messenger = VK_NULL_HANDLE;
+    std::atomic<int> validation_errors{0};
+    VkPhysicalDevice physical_device = VK_NULL_HANDLE;
+    VkPhysicalDeviceProperties properties{};
+    VkPhysicalDeviceMemoryProperties memory_properties{};
+    VkDevice device = VK_NULL_HANDLE;
+    VkQueue queue = VK_NULL_HANDLE;
+    uint32_t queue_family = 0;
+
+    VkCommandPool immediate_pool = VK_NULL_HANDLE;
+    Frame frames[FRAMES_IN_FLIGHT];     // Indexed by serial % FRAMES_IN_FLIGHT
+    std::mutex frame_mutex;             // Guards frames: submit() resets fences that lists may be waiting on
+    uint64_t submission_serial = 0;     // Serial of the last submit(); the device's thread only
+    VkSampler sampler = VK_NULL_HANDLE; // Linear, clamped; used for every texture
+
+    std::vector<Buffer> buffers; // Handle id - 1; destroyed entries are null
+    std::vector<Texture> textures;
+    std::vector<Pipeline> pipelines;
+};
+
+#endif // VULKAN_DEVICE_H
@@ -0,0 +1,43 @@
+#include "weighted_oit.h"
+
+WeightedOit::WeightedOit(GLuint resolveProgram) : resolve_program(resolveProgram) {
+    glUseProgram(resolve_program);
+    glUniform1i(glGetUniformLocation(resolve_program, "accumulation"), 0);
+    glUniform1i(glGetUniformLocation(resolve_program, "revealage"), 1);
+    glGenVertexArrays(1, &empty_vao);
+}
+
+WeightedOit::~WeightedOit() {
+    glDeleteVertexArrays(1, &empty_vao);
+}
+
+void WeightedOit::clearTargets() {
+    const GLfloat zero[] = {0.0f, 0.0f, 0.0f, 0.0f};
+    const GLfloat one[] = {1.0f, 0.0f, 0.0f, 0.0f};
+    glClearBufferfv(GL_COLOR, 0, zero);
+    glClearBufferfv(GL_COLOR, 1, one);
+}
+
+void WeightedOit::setBlendState() {
+    glEnable(GL_BLEND);
+    glBlendFunci(0, GL_ONE, GL_ONE);
+    glBlendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+}
+
+void WeightedOit::resolve(GLuint accumulation, GLuint revealage, int width, int height) const {
+    glViewport(0, 0, width, height);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+
+    glUseProgram(resolve_program);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, accumulation);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, revealage);
+    glBindVertexArray(empty_vao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glActiveTexture(GL_TEXTURE0);
+
+    glBindVertexArray(0);
+    glEnable(GL_DEPTH_TEST);
+}
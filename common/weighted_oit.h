@@ -0,0 +1,41 @@
+#ifndef WEIGHTED_OIT_H
+#define WEIGHTED_OIT_H
+
+#include "glad.h"
+
+/*
+ * WeightedOit Class
+ * Weighted blended order-independent transparency (McGuire and Bavoil 2013), so transparent draws need no sorting
+ * at all: each fragment adds its colour, weighted by depth and opacity, to an RGBA16F accumulation target and
+ * multiplies its transparency into an R8 revealage target. Both blends are commutative, so draw order, emitter
+ * order and intersecting billboards make no difference. The resolve turns the pair into a premultiplied colour.
+ * The result is an approximation: where layers of different colours overlap, it shows their weighted average
+ * rather than the exact "over" order.
+ * The targets come from the render graph; only the resolve program is held here.
+ */
+class WeightedOit {
+public:
+    // "resolveProgram" is fullscreen.vert with particle_oit_resolve.frag
+    explicit WeightedOit(GLuint resolveProgram);
+
+    ~WeightedOit();
+
+    WeightedOit(const WeightedOit &) = delete;
+
+    WeightedOit &operator=(const WeightedOit &) = delete;
+
+    // Clears the bound framebuffer's accumulation (draw buffer 0) to 0 and revealage (draw buffer 1) to 1
+    static void clearTargets();
+
+    // Blend state of the accumulating draws, in place of the sorted path's "over"; leaves GL_BLEND enabled
+    static void setBlendState();
+
+    // Writes the resolved, premultiplied colour into the bound framebuffer, over the rendered region
+    void resolve(GLuint accumulation, GLuint revealage, int width, int height) const;
+
+private:
+    GLuint resolve_program;
+    GLuint empty_vao = 0;
+};
+
+#endif // WEIGHTED_OIT_H
@@ -6,6 +6,7 @@
   */
 
 #include "wrapper_glfw.h"
+#include "program_cache.h"
 
 /* Include some standard headers */
 
@@ -16,7 +17,7 @@
 using namespace std;
 
 /* Constructor for wrapper object */
-GLWrapper::GLWrapper(int width, int height, const char *title) {
+GLWrapper::GLWrapper(int width, int height, const char *title, int samples) {
     this->width = width;
     this->height = height;
     this->title = title;
@@ -32,7 +33,7 @@ GLWrapper::GLWrapper(int width, int height, const char *title) {
 
     // Personal modification: BELOW
 
-    glfwWindowHint(GLFW_SAMPLES, 8);
+    glfwWindowHint(GLFW_SAMPLES, samples);
     // glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     // glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
 
@@ -74,7 +75,9 @@ GLWrapper::GLWrapper(int width, int height, const char *title) {
 
     glfwSetInputMode(window, GLFW_STICKY_KEYS, true);
 
-    glEnable(GL_MULTISAMPLE);
+    if (samples > 0) {
+        glEnable(GL_MULTISAMPLE);
+    }
 }
 
 
@@ -221,14 +224,26 @@ GLuint GLWrapper::LoadShader(const char *vertex_path, const char *fragment_path)
     GLint result = GL_FALSE;
     int logLength;
 
-    vertShader = BuildShader(GL_VERTEX_SHADER, vertShaderStr);
-    fragShader = BuildShader(GL_FRAGMENT_SHADER, fragShaderStr);
+    /* Compiling is skipped entirely when the program cache has a binary */
+    auto attachShaders = [&](GLuint program) {
+        vertShader = BuildShader(GL_VERTEX_SHADER, vertShaderStr);
+        fragShader = BuildShader(GL_FRAGMENT_SHADER, fragShaderStr);
+        glAttachShader(program, vertShader);
+        glAttachShader(program, fragShader);
+        glDeleteShader(vertShader);
+        glDeleteShader(fragShader);
+    };
 
     cout << "Linking program" << endl;
-    GLuint program = glCreateProgram();
-    glAttachShader(program, vertShader);
-    glAttachShader(program, fragShader);
-    glLinkProgram(program);
+    GLuint program;
+    if (program_cache) {
+        program = program_cache->getProgram(vertShaderStr, fragShaderStr,
+                                            string(vertex_path) + " + " + fragment_path, attachShaders);
+    } else {
+        program = glCreateProgram();
+        attachShaders(program);
+        glLinkProgram(program);
+    }
 
     glGetProgramiv(program, GL_LINK_STATUS, &result);
     glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
@@ -236,9 +251,6 @@ GLuint GLWrapper::LoadShader(const char *vertex_path, const char *fragment_path)
     glGetProgramInfoLog(program, logLength, NULL, &programError[0]);
     cout << &programError[0] << endl;
 
-    glDeleteShader(vertShader);
-    glDeleteShader(fragShader);
-
     return program;
 }
 
@@ -247,21 +259,32 @@ GLuint GLWrapper::BuildShaderProgram(string vertShaderStr, string fragShaderStr)
     GLuint vertShader, fragShader;
     GLint result = GL_FALSE;
 
-    try {
-        vertShader = BuildShader(GL_VERTEX_SHADER, vertShaderStr);
-        fragShader = BuildShader(GL_FRAGMENT_SHADER, fragShaderStr);
-    } catch (exception &e) {
-        cout << "Exception: " << e.what() << endl;
+    /* Compiling is skipped entirely when the program cache has a binary */
+    auto attachShaders = [&](GLuint program) {
+        try {
+            vertShader = BuildShader(GL_VERTEX_SHADER, vertShaderStr);
+            fragShader = BuildShader(GL_FRAGMENT_SHADER, fragShaderStr);
+        } catch (exception &e) {
+            cout << "Exception: " << e.what() << endl;
 
-        // Personal modification: From exception to runtime_error
-        throw runtime_error("BuildShaderProgram() Build shader failure. Abandoning");
+            // Personal modification: From exception to runtime_error
+            throw runtime_error("BuildShaderProgram() Build shader failure. Abandoning");
+        }
+        glAttachShader(program, vertShader);
+        glAttachShader(program, fragShader);
+        glDeleteShader(vertShader);
+        glDeleteShader(fragShader);
+    };
+
+    GLuint program;
+    if (program_cache) {
+        program = program_cache->getProgram(vertShaderStr, fragShaderStr, "BuildShaderProgram", attachShaders);
+    } else {
+        program = glCreateProgram();
+        attachShaders(program);
+        glLinkProgram(program);
     }
 
-    GLuint program = glCreateProgram();
-    glAttachShader(program, vertShader);
-    glAttachShader(program, fragShader);
-    glLinkProgram(program);
-
     GLint status;
     glGetProgramiv(program, GL_LINK_STATUS, &status);
     if (status == GL_FALSE) {
@@ -276,8 +299,5 @@ GLuint GLWrapper::BuildShaderProgram(string vertShaderStr, string fragShaderStr)
         throw runtime_error("Shader could not be linked.");
     }
 
-    glDeleteShader(vertShader);
-    glDeleteShader(fragShader);
-
     return program;
 }
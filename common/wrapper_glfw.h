@@ -11,6 +11,8 @@ Iain Martin August 2014
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+class ProgramCache;
+
 class GLWrapper {
 private:
     int width;
@@ -23,8 +25,11 @@ private:
     bool running;
     GLFWwindow *window;
 
+    ProgramCache *program_cache = nullptr;
+
 public:
-    GLWrapper(int width, int height, const char *title);
+    /* "samples" > 0 requests a multisampled default framebuffer; 0 leaves anti-aliasing to post passes */
+    GLWrapper(int width, int height, const char *title, int samples = 0);
 
     ~GLWrapper();
 
@@ -44,6 +49,11 @@ public:
     void setErrorCallback(void (*f)(int error, const char *description));
 
     /* Shader load and build support functions */
+    /* With a program cache set, linked programs are reused from disk instead of recompiled */
+    void setProgramCache(ProgramCache *cache) {
+        this->program_cache = cache;
+    }
+
     GLuint LoadShader(const char *vertex_path, const char *fragment_path);
 
     GLuint BuildShader(GLenum eShaderType, const std::string &shaderText);
@@ -0,0 +1,54 @@
+#version 410 core
+
+// FXAA: blends across edges found in the luma of the final image, along the edge direction
+in vec2 uv;
+
+out vec4 color;
+
+uniform sampler2D sceneColor;
+uniform vec2 renderScale; // Rendered region / texture size; the scene occupies the lower-left corner
+uniform vec2 texelSize;   // 1 / texture size
+
+const float EDGE_THRESHOLD = 0.125;     // Minimum local contrast, relative to the brightest neighbour
+const float EDGE_THRESHOLD_MIN = 0.0312; // Dark areas below this are left alone
+const float REDUCE_MUL = 1.0 / 8.0;
+const float REDUCE_MIN = 1.0 / 128.0;
+const float SPAN_MAX = 8.0;               // Longest blend along an edge, in texels
+
+vec3 fetch(vec2 p) {
+    return texture(sceneColor, clamp(p, 0.5 * texelSize, renderScale - 0.5 * texelSize)).rgb;
+}
+
+float luma(vec3 rgb) {
+    return dot(rgb, vec3(0.299, 0.587, 0.114));
+}
+
+void main() {
+    vec2 p = gl_FragCoord.xy * texelSize;
+
+    vec3 rgbM = fetch(p);
+    float lumaM = luma(rgbM);
+    float lumaNW = luma(fetch(p + vec2(-1.0, -1.0) * texelSize));
+    float lumaNE = luma(fetch(p + vec2(1.0, -1.0) * texelSize));
+    float lumaSW = luma(fetch(p + vec2(-1.0, 1.0) * texelSize));
+    float lumaSE = luma(fetch(p + vec2(1.0, 1.0) * texelSize));
+
+    float lumaMin = min(lumaM, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));
+    float lumaMax = max(lumaM, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));
+    if (lumaMax - lumaMin < max(EDGE_THRESHOLD_MIN, lumaMax * EDGE_THRESHOLD)) {
+        color = vec4(rgbM, 1.0);
+        return;
+    }
+
+    // Edge direction from the luma gradient, stretched so that thin edges blend over a longer span
+    vec2 dir = vec2(-((lumaNW + lumaNE) - (lumaSW + lumaSE)), (lumaNW + lumaSW) - (lumaNE + lumaSE));
+    float dirReduce = max((lumaNW + lumaNE + lumaSW + lumaSE) * 0.25 * REDUCE_MUL, REDUCE_MIN);
+    float rcpDirMin = 1.0 / (min(abs(dir.x), abs(dir.y)) + dirReduce);
+    dir = clamp(dir * rcpDirMin, vec2(-SPAN_MAX), vec2(SPAN_MAX)) * texelSize;
+
+    vec3 rgbA = 0.5 * (fetch(p + dir * (1.0 / 3.0 - 0.5)) + fetch(p + dir * (2.0 / 3.0 - 0.5)));
+    vec3 rgbB = rgbA * 0.5 + 0.25 * (fetch(p - dir * 0.5) + fetch(p + dir * 0.5));
+    // The wide blend overshot the local range: it crossed another edge, use the narrow one
+    float lumaB = luma(rgbB);
+    color = vec4(lumaB < lumaMin || lumaB > lumaMax ? rgbA : rgbB, 1.0);
+}
@@ -0,0 +1,17 @@
+#version 450
+
+layout (push_constant) uniform PushConstants {
+    mat4 mvp;
+    vec4 color;
+};
+
+layout (location = 0) in vec3 Normal;
+
+layout (location = 0) out vec4 FragColor;
+
+void main()
+{
+    const vec3 lightDir = normalize(vec3(0.4, 1.0, 0.3));
+    float diffuse = max(dot(normalize(Normal), lightDir), 0.0);
+    FragColor = vec4(color.rgb * (0.25 + 0.75 * diffuse), 1.0);
+}
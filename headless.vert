@@ -0,0 +1,19 @@
+#version 450
+
+// Vulkan GLSL for vulkan_headless, compiled to SPIR-V by the build (WINDMILL_VULKAN)
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+
+layout (push_constant) uniform PushConstants {
+    mat4 mvp;
+    vec4 color;
+};
+
+layout (location = 0) out vec3 Normal;
+
+void main()
+{
+    // The cubes are only scaled and moved, so object-space normals point the right way
+    Normal = aNormal;
+    gl_Position = mvp * vec4(aPos, 1.0);
+}
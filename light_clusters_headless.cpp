@@ -0,0 +1,241 @@
+// Correctness test and benchmark for LightClusters, without a window or GPU. Random lanterns, scattered like the
+// windowed renderer's, are assigned to its 16x12x24 grid from a few cameras, single threaded and on the pool, and
+// every cluster's light list is compared with a brute-force sphere/box test of every light against every cluster.
+// Points seen by the camera, at several window aspects and by each eye in stereo, are then looked up the way
+// shader.frag does, and every light reaching a point must be in its cluster's list. Assignment is finally timed
+// with 16, 256 and 1024 lights.
+//   light_clusters_headless [--runs <count>] [--threads <count>]
+// Exits with 1 when a cluster's lights differ from the brute-force result or a lookup misses a light.
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "light_clusters.h"
+#include "stereo.h"
+#include "thread_pool.h"
+
+namespace {
+    constexpr int TILES_X = 16, TILES_Y = 12, SLICES = 24;
+    constexpr float FOV_Y = glm::radians(45.0f), ASPECT = 800.0f / 600.0f, Z_NEAR = 0.1f, Z_FAR = 100.0f;
+
+    // Lanterns as main.cpp places them: around the windmill at hand height, with a 4-7 radius
+    std::vector<PointLight> randomLights(int count, unsigned int seed) {
+        auto random = [&seed]() {
+            seed = seed * 1664525u + 1013904223u;
+            return static_cast<float>(seed >> 8) / static_cast<float>(1u << 24);
+        };
+        std::vector<PointLight> lights(count);
+        for (PointLight &light: lights) {
+            const float angle = random() * 6.2832f;
+            const float distance = 6.0f + random() * 40.0f;
+            light.position = glm::vec3(std::cos(angle) * distance, 1.0f + random() * 1.5f, std::sin(angle) * distance);
+            light.radius = 4.0f + random() * 3.0f;
+            light.color = glm::vec3(1.0f);
+        }
+        return lights;
+    }
+
+    // Lights touching every cluster, from the cluster layout documented in LightClusters: screen tiles over NDC,
+    // slice depths spaced exponentially from near to far, and each box spanning the tile on both depth faces
+    std::vector<std::vector<std::uint32_t>> bruteForce(const std::vector<PointLight> &lights, const glm::mat4 &view) {
+        std::vector<std::vector<std::uint32_t>> clusters(TILES_X * TILES_Y * SLICES);
+        const float tanY = std::tan(FOV_Y * 0.5f), tanX = tanY * ASPECT;
+        for (int slice = 0; slice < SLICES; slice++) {
+            const float d0 = Z_NEAR * std::pow(Z_FAR / Z_NEAR, static_cast<float>(slice) / SLICES);
+            const float d1 = Z_NEAR * std::pow(Z_FAR / Z_NEAR, static_cast<float>(slice + 1) / SLICES);
+            for (int y = 0; y < TILES_Y; y++) {
+                const float ny0 = -1.0f + 2.0f * static_cast<float>(y) / TILES_Y;
+                const float ny1 = -1.0f + 2.0f * static_cast<float>(y + 1) / TILES_Y;
+                for (int x = 0; x < TILES_X; x++) {
+                    const float nx0 = -1.0f + 2.0f * static_cast<float>(x) / TILES_X;
+                    const float nx1 = -1.0f + 2.0f * static_cast<float>(x + 1) / TILES_X;
+                    const glm::vec3 boxMin(std::min(nx0 * tanX * d0, nx0 * tanX * d1),
+                                           std::min(ny0 * tanY * d0, ny0 * tanY * d1), -d1);
+                    const glm::vec3 boxMax(std::max(nx1 * tanX * d0, nx1 * tanX * d1),
+                                           std::max(ny1 * tanY * d0, ny1 * tanY * d1), -d0);
+                    auto &cluster = clusters[(slice * TILES_Y + y) * TILES_X + x];
+                    for (size_t i = 0; i < lights.size(); i++) {
+                        const glm::vec3 p = glm::vec3(view * glm::vec4(lights[i].position, 1.0f));
+                        const glm::vec3 closest = glm::clamp(p, boxMin, boxMax);
+                        const glm::vec3 d = p - closest;
+                        if (glm::dot(d, d) <= lights[i].radius * lights[i].radius) {
+                            cluster.push_back(static_cast<std::uint32_t>(i));
+                        }
+                    }
+                }
+            }
+        }
+        return clusters;
+    }
+
+    // Number of clusters whose light list differs from the expected one
+    int compare(const LightClusters &clusters, const std::vector<std::vector<std::uint32_t>> &expected) {
+        const auto &ranges = clusters.getClusterRanges();
+        const auto &indices = clusters.getLightIndices();
+        int mismatches = 0;
+        for (int c = 0; c < clusters.clusterCount(); c++) {
+            std::vector<std::uint32_t> assigned(indices.begin() + ranges[c * 2],
+                                                indices.begin() + ranges[c * 2] + ranges[c * 2 + 1]);
+            std::sort(assigned.begin(), assigned.end());
+            if (assigned != expected[c]) mismatches++;
+        }
+        return mismatches;
+    }
+
+    // shader.frag's cluster lookup, ported: the cluster of a world-space point seen through the projection and
+    // view the lights were assigned with
+    int clusterOf(const LightClusters &clusters, const glm::mat4 &clusterViewProjection, const glm::vec3 &point) {
+        const glm::ivec3 grid = clusters.gridSize();
+        const glm::vec4 clip = clusterViewProjection * glm::vec4(point, 1.0f);
+        const glm::vec2 uv = glm::vec2(clip) / clip.w * 0.5f + 0.5f;
+        const glm::ivec2 tile = glm::clamp(glm::ivec2(uv * glm::vec2(grid)), glm::ivec2(0), glm::ivec2(grid) - 1);
+        const glm::vec2 scaleBias = clusters.sliceScaleBias();
+        const int slice = glm::clamp(static_cast<int>(std::log(clip.w) * scaleBias.x + scaleBias.y), 0, grid.z - 1);
+        return (slice * grid.y + tile.y) * grid.x + tile.x;
+    }
+
+    // Points anywhere in what each eye sees, for a camera set up like main.cpp's: clusters assigned once in the
+    // culling view, with the eye's aspect. Returns the number of points whose cluster misses a light reaching them
+    int checkLookups(const std::vector<PointLight> &lights, float aspect, StereoRig::Mode mode, int points,
+                     ThreadPool &pool) {
+        StereoRig rig;
+        rig.setMode(mode);
+        LightClusters clusters(TILES_X, TILES_Y, SLICES, &pool);
+        clusters.setProjection(FOV_Y, aspect, Z_NEAR, Z_FAR);
+        const glm::mat4 projection = glm::perspective(FOV_Y, aspect, Z_NEAR, Z_FAR);
+
+        std::mt19937 random(4321u);
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f), fraction(0.0f, 1.0f);
+        int misses = 0;
+        for (int camera = 0; camera < 8; camera++) {
+            const float angle = fraction(random) * 6.2832f;
+            const glm::vec3 position(std::cos(angle) * 25.0f, 1.5f + fraction(random) * 10.0f, std::sin(angle) * 25.0f);
+            const glm::mat4 view = glm::lookAt(position, glm::vec3(0.0f, 2.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+            const glm::mat4 cullingView = rig.cullingView(view, FOV_Y, aspect);
+            clusters.assign(lights, cullingView);
+            const auto &ranges = clusters.getClusterRanges();
+            const auto &indices = clusters.getLightIndices();
+
+            for (int i = 0; i < points / 8; i++) {
+                // A point in one eye's frustum, by NDC and view depth
+                const int eye = mode == StereoRig::Mode::Off ? 0 : i & 1;
+                const float distance = Z_NEAR + (Z_FAR - Z_NEAR) * fraction(random) * fraction(random);
+                const glm::vec4 eyePosition(unit(random) * distance * std::tan(FOV_Y * 0.5f) * aspect,
+                                            unit(random) * distance * std::tan(FOV_Y * 0.5f), -distance, 1.0f);
+                const glm::vec3 point = glm::vec3(glm::inverse(rig.eyeView(view, eye)) * eyePosition);
+
+                const int cluster = clusterOf(clusters, projection * cullingView, point);
+                const auto first = indices.begin() + ranges[cluster * 2];
+                const auto last = first + ranges[cluster * 2 + 1];
+                for (size_t l = 0; l < lights.size(); l++) {
+                    if (glm::length(point - lights[l].position) < lights[l].radius &&
+                        std::find(first, last, static_cast<std::uint32_t>(l)) == last) {
+                        misses++;
+                        break;
+                    }
+                }
+            }
+        }
+        return misses;
+    }
+}
+
+int main(int argc, char **argv) {
+    int runs = 100;
+    int threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--runs" && i + 1 < argc) runs = std::max(std::atoi(argv[++i]), 1);
+        else if (arg == "--threads" && i + 1 < argc) threads = std::max(std::atoi(argv[++i]), 1);
+        else {
+            std::cout << "Usage: " << argv[0] << " [--runs <count>] [--threads <count>]" << std::endl;
+            return 2;
+        }
+    }
+
+    ThreadPool pool(static_cast<unsigned int>(threads));
+    LightClusters serial(TILES_X, TILES_Y, SLICES);
+    LightClusters pooled(TILES_X, TILES_Y, SLICES, &pool);
+    serial.setProjection(FOV_Y, ASPECT, Z_NEAR, Z_FAR);
+    pooled.setProjection(FOV_Y, ASPECT, Z_NEAR, Z_FAR);
+
+    // The starting camera, one standing among the lanterns, and one looking down on them
+    const glm::vec3 up(0.0f, 1.0f, 0.0f);
+    const std::vector<glm::mat4> views = {
+        glm::lookAt(glm::vec3(0.0f, 6.5f, 20.0f), glm::vec3(0.0f, 6.5f, 0.0f), up),
+        glm::lookAt(glm::vec3(12.0f, 2.0f, 5.0f), glm::vec3(-20.0f, 1.0f, -10.0f), up),
+        glm::lookAt(glm::vec3(0.0f, 40.0f, 30.0f), glm::vec3(0.0f, 0.0f, 0.0f), up),
+    };
+
+    int failures = 0;
+    for (int count: {16, 256, 1024}) {
+        const std::vector<PointLight> lights = randomLights(count, 12345u + static_cast<unsigned int>(count));
+        for (size_t v = 0; v < views.size(); v++) {
+            const auto expected = bruteForce(lights, views[v]);
+            serial.assign(lights, views[v]);
+            pooled.assign(lights, views[v]);
+            const int serialMismatches = compare(serial, expected);
+            const int pooledMismatches = compare(pooled, expected);
+            if (serialMismatches > 0 || pooledMismatches > 0) {
+                std::cout << "FAIL " << count << " lights, view " << v << ": " << serialMismatches
+                        << " cluster(s) differ single threaded, " << pooledMismatches << " on the pool" << std::endl;
+                failures++;
+            }
+        }
+    }
+
+    // Lookups at the aspects of a 4:3 and a 16:9 window, and of one eye of the 16:9 window in stereo
+    const std::vector<PointLight> lookupLights = randomLights(256, 777u);
+    constexpr int LOOKUP_POINTS = 20000;
+    struct LookupCase {
+        const char *name;
+        float aspect;
+        StereoRig::Mode mode;
+    };
+    const LookupCase lookupCases[] = {
+        {"4:3", 4.0f / 3.0f, StereoRig::Mode::Off},
+        {"16:9", 16.0f / 9.0f, StereoRig::Mode::Off},
+        {"16:9 stereo, two passes", 8.0f / 9.0f, StereoRig::Mode::TwoPass},
+        {"16:9 stereo, single pass", 8.0f / 9.0f, StereoRig::Mode::SinglePass},
+    };
+    for (const LookupCase &lookup: lookupCases) {
+        const int misses = checkLookups(lookupLights, lookup.aspect, lookup.mode, LOOKUP_POINTS, pool);
+        if (misses > 0) {
+            std::cout << "FAIL " << lookup.name << ": " << misses << " of " << LOOKUP_POINTS
+                    << " looked-up points miss a light that reaches them" << std::endl;
+            failures++;
+        }
+    }
+
+    // Timings from the starting view
+    std::printf("%6s | %12s %12s | %d threads, %d runs\n", "lights", "1 thread ms", "pool ms", threads, runs);
+    for (int count: {16, 256, 1024}) {
+        const std::vector<PointLight> lights = randomLights(count, 12345u + static_cast<unsigned int>(count));
+        double serialMs = 0.0, pooledMs = 0.0;
+        for (int run = 0; run < runs; run++) {
+            serial.assign(lights, views[0]);
+            serialMs += serial.getStats().assignMs;
+            pooled.assign(lights, views[0]);
+            pooledMs += pooled.getStats().assignMs;
+        }
+        const LightClusters::Stats &stats = pooled.getStats();
+        std::printf("%6d | %12.4f %12.4f | %d in front, %d indices, at most %d per cluster\n", count,
+                    serialMs / runs, pooledMs / runs, stats.lights, stats.indices, stats.maxPerCluster);
+    }
+
+    if (failures > 0) {
+        std::cout << failures << " assignment(s) or lookup(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "All cluster assignments match the brute-force result and every lookup finds its lights"
+            << std::endl;
+    return 0;
+}
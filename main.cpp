@@ -6,16 +6,40 @@
 #include "wrapper_glfw.h"
 #include "glad.h"
 #include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
 #include <iostream>
-#include <fstream>
-#include <sstream>
+#include <future>
 #include <vector>
 
+#include "analytic_particles.h"
+#include "dynamic_resolution.h"
 #include "geometry.h"
+#include "gl_device.h"
+#include "gpu_counter.h"
+#include "gpu_particles.h"
+#include "light_buffers.h"
+#include "light_clusters.h"
 #include "model.h"
+#include "occlusion.h"
+#include "occlusion_query.h"
+#include "offscreen_particles.h"
 #include "particle.h"
+#include "particle_atlas.h"
+#include "post_aa.h"
+#include "program_cache.h"
+#include "render_graph.h"
+#include "render_queue.h"
+#include "shader_variants.h"
+#include "shadow_cascades.h"
+#include "static_batch.h"
+#include "stereo.h"
+#include "thread_pool.h"
+#include "weighted_oit.h"
 
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
@@ -29,68 +53,6 @@
 #define M_PI 3.14159265358979323846f
 #endif
 
-// Function for loading vertex & fragment shaders
-GLuint loadShader(const char *vertexPath, const char *fragmentPath) {
-    std::string vertexCode, fragmentCode;
-    std::ifstream vShaderFile, fShaderFile;
-    vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    try {
-        vShaderFile.open(vertexPath);
-        fShaderFile.open(fragmentPath);
-        std::stringstream vShaderStream, fShaderStream;
-        vShaderStream << vShaderFile.rdbuf();
-        fShaderStream << fShaderFile.rdbuf();
-        vShaderFile.close();
-        fShaderFile.close();
-        vertexCode = vShaderStream.str();
-        fragmentCode = fShaderStream.str();
-    } catch (std::ifstream::failure &e) {
-        std::cout << "ERROR: " << &e << std::endl;
-    }
-    const char *vShaderCode = vertexCode.c_str();
-    const char *fShaderCode = fragmentCode.c_str();
-
-    // Create vertex shader and compile
-    GLuint vertex = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex, 1, &vShaderCode, nullptr);
-    glCompileShader(vertex);
-    int success;
-    char infoLog[512];
-    glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(vertex, 512, nullptr, infoLog);
-        std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
-    }
-
-    // Create fragment shader and compile
-    GLuint fragment = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment, 1, &fShaderCode, nullptr);
-    glCompileShader(fragment);
-    glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(fragment, 512, nullptr, infoLog);
-        std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
-    }
-
-    // Create shader application and link it
-    GLuint shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertex);
-    glAttachShader(shaderProgram, fragment);
-    glLinkProgram(shaderProgram);
-    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-    if (!success) {
-        glGetProgramInfoLog(shaderProgram, 512, nullptr, infoLog);
-        std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
-    }
-
-    // Delete shader objects after compilation is complete
-    glDeleteShader(vertex);
-    glDeleteShader(fragment);
-    return shaderProgram;
-}
-
-
 // Function for loading a cube map texture from 6 individual texture faces
 // Order:
 // +X (right)
@@ -169,6 +131,48 @@ unsigned int loadTexture(char const *path) {
     return textureID;
 }
 
+// Procedural sprite for the blade dust: a soft round dot, white so the emitter's tint gives its colour
+std::vector<unsigned char> makeDustSprite(int size) {
+    std::vector<unsigned char> pixels(static_cast<size_t>(size) * size * 4);
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            const glm::vec2 offset = (glm::vec2(x, y) + 0.5f) / static_cast<float>(size) * 2.0f - 1.0f;
+            const float falloff = glm::clamp(1.0f - glm::length(offset), 0.0f, 1.0f);
+            unsigned char *pixel = &pixels[(static_cast<size_t>(y) * size + x) * 4];
+            pixel[0] = pixel[1] = pixel[2] = 255;
+            pixel[3] = static_cast<unsigned char>(falloff * falloff * 255.0f);
+        }
+    }
+    return pixels;
+}
+
+// Procedural flipbook for the leaves: "columns x rows" frames of a leaf turning over as it falls, in one sheet
+std::vector<unsigned char> makeLeafFlipbook(int frameSize, int columns, int rows) {
+    const int width = frameSize * columns, height = frameSize * rows;
+    std::vector<unsigned char> pixels(static_cast<size_t>(width) * height * 4, 0);
+    const int frames = columns * rows;
+    for (int frame = 0; frame < frames; frame++) {
+        const float angle = glm::two_pi<float>() * static_cast<float>(frame) / static_cast<float>(frames);
+        const float turn = glm::max(std::abs(std::cos(angle)), 0.15f); // The leaf seen edge-on gets thin
+        const glm::vec2 axis(std::cos(angle * 0.5f), std::sin(angle * 0.5f));
+        for (int y = 0; y < frameSize; y++) {
+            for (int x = 0; x < frameSize; x++) {
+                const glm::vec2 point = (glm::vec2(x, y) + 0.5f) / static_cast<float>(frameSize) * 2.0f - 1.0f;
+                const float along = glm::dot(point, axis), across = glm::dot(point, glm::vec2(-axis.y, axis.x));
+                // A pointed ellipse, darker along the midrib
+                const float shape = along * along / 0.8f + across * across / (0.16f * turn * turn * (1.0f - along));
+                if (shape > 1.0f || along > 0.95f) continue;
+                const float shade = glm::mix(0.7f, 1.0f, glm::clamp(std::abs(across) * 8.0f, 0.0f, 1.0f));
+                unsigned char *pixel = &pixels[((static_cast<size_t>((frame / columns) * frameSize + y)) * width +
+                                                (frame % columns) * frameSize + x) * 4];
+                pixel[0] = pixel[1] = pixel[2] = static_cast<unsigned char>(shade * 255.0f);
+                pixel[3] = static_cast<unsigned char>(glm::clamp((1.0f - shape) * 6.0f, 0.0f, 1.0f) * 255.0f);
+            }
+        }
+    }
+    return pixels;
+}
+
 
 int main() {
     // GLFW initialization
@@ -217,34 +221,35 @@ int main() {
     ImGui_ImplOpenGL3_Init("#version 410");
 
     // Shaders
-    GLuint program = loadShader("shader.vert", "shader.frag");
-    glUseProgram(program);
-    GLuint skyboxProgram = loadShader("skybox.vert", "skybox.frag");
-    GLuint particleProgram = loadShader("particle.vert", "particle.frag");
-
-    // Get uniform location
-    GLint modelLoc = glGetUniformLocation(program, "model");
-    GLint viewLoc = glGetUniformLocation(program, "view");
-    GLint projLoc = glGetUniformLocation(program, "proj");
-    GLint normalMatLoc = glGetUniformLocation(program, "normalMat");
-    GLint lightPosLoc = glGetUniformLocation(program, "lightPos");
-    GLint viewPosLoc = glGetUniformLocation(program, "viewPos");
-    GLint lightColorLoc = glGetUniformLocation(program, "lightColor");
-    GLint objectColorLoc = glGetUniformLocation(program, "objectColor");
-    GLint shininessLoc = glGetUniformLocation(program, "shininess");
-    GLint ambientColorLoc = glGetUniformLocation(program, "ambientColor");
-    GLint useTextureLoc = glGetUniformLocation(program, "useTexture");
-    GLint unlitLoc = glGetUniformLocation(program, "u_unlit");
-
+    // Linked programs are kept as driver binaries in shader_cache/ so later launches skip compiling
+    ProgramCache programCache("shader_cache");
+    // The scene shader is compiled into #define permutations (see ShaderVariants::Feature) on demand;
+    // the others have a single variant
+    ShaderVariants sceneShaders("shader.vert", "shader.frag", &programCache);
+    ShaderVariants particleShaders("particle.vert", "particle.frag", &programCache);
+    ShaderVariants boxShaders("bbox.vert", "bbox.frag", &programCache);
+    ShaderVariants upscaleShaders("fullscreen.vert", "upscale.frag", &programCache);
+    ShaderVariants fxaaShaders("fullscreen.vert", "fxaa.frag", &programCache);
+    ShaderVariants taaShaders("fullscreen.vert", "taa.frag", &programCache);
+    ShaderVariants particleDepthShaders("fullscreen.vert", "particle_depth.frag", &programCache);
+    ShaderVariants particleUpsampleShaders("fullscreen.vert", "particle_upsample.frag", &programCache);
+    ShaderVariants particleOitResolveShaders("fullscreen.vert", "particle_oit_resolve.frag", &programCache);
+    GLuint particleProgram = particleShaders.get(0).id;
+    GLuint boxProgram = boxShaders.get(0).id;
+
+    // Draws recorded through the render device abstraction (see render_device.h) run on this context. Only the
+    // skybox is drawn that way so far; every other pass still calls GL directly
+    GLRenderDevice renderDevice(&programCache);
+
+    ShaderVariants::FrameUniforms sceneUniforms;
     // Controllable light
-    glUseProgram(program);
-    glUniform3f(lightColorLoc, 1.0f, 0.5f, 0.1f);
-
+    sceneUniforms.lightColor = glm::vec3(1.0f, 0.5f, 0.1f);
     // Global ambient color
-    glUniform3f(ambientColorLoc, 0.76f, 0.64f, 0.23f);
-
+    sceneUniforms.ambientColor = glm::vec3(0.76f, 0.64f, 0.23f);
     // Shininess
-    glUniform1f(shininessLoc, 32.0f);
+    sceneUniforms.shininess = 32.0f;
+    // Leaves: texels below this alpha are cut out
+    sceneUniforms.alphaCutoff = 0.5f;
 
     // === Load All Models ===
     // Load models using Model class
@@ -254,6 +259,55 @@ int main() {
     Model cabinModel("objects/Cabin/farmhouse_obj.obj");
     Model benchModel("objects/Bench/Bench_HighRes.obj");
 
+    // === Static Transforms ===
+    // Trees, cabin and benches never move, so their model matrices are built once (see Geometry's scene layout)
+    std::vector<glm::mat4> treeA_transforms, treeB_transforms;
+    for (const auto &pos: Geometry::treeA_positions) {
+        treeA_transforms.push_back(Geometry::treeTransform(pos, Geometry::treeA_scale));
+    }
+    for (const auto &pos: Geometry::treeB_positions) {
+        treeB_transforms.push_back(Geometry::treeTransform(pos, Geometry::treeB_scale));
+    }
+    const glm::mat4 cabinTransform = Geometry::cabinTransform();
+    const glm::mat4 bench1Transform = Geometry::bench1Transform();
+    const glm::mat4 bench2Transform = Geometry::bench2Transform();
+    const glm::mat4 chimneyTransform = Geometry::chimneyTransform();
+    const glm::mat4 groundTransform = Geometry::groundTransform();
+
+    // === CPU Occlusion Culling ===
+    // Occluders are simplified stand-ins: the real tower mesh, a box inside the cabin and thin trunk boxes
+    ThreadPool threadPool;
+    OcclusionCuller occlusionCuller(256, 128, &threadPool);
+    bool useOcclusionCulling = true;
+
+    std::vector<glm::vec3> towerOccluderPositions;
+    for (size_t i = 0; i + 2 < Geometry::towerVertices.size(); i += 8) {
+        towerOccluderPositions.emplace_back(Geometry::towerVertices[i], Geometry::towerVertices[i + 1],
+                                            Geometry::towerVertices[i + 2]);
+    }
+    const AABB cabinOccluder = cabinModel.bounds.scaled(glm::vec3(0.8f));
+    // Lower part of the trunk only, foliage is far from solid
+    auto trunkOccluder = [](const AABB &treeBounds) {
+        glm::vec3 c = treeBounds.center();
+        glm::vec3 e = treeBounds.extents();
+        float trunkTop = treeBounds.min.y + (treeBounds.max.y - treeBounds.min.y) * 0.35f;
+        return AABB(glm::vec3(c.x - e.x * 0.05f, treeBounds.min.y, c.z - e.z * 0.05f),
+                    glm::vec3(c.x + e.x * 0.05f, trunkTop, c.z + e.z * 0.05f));
+    };
+    const AABB treeA_trunk = trunkOccluder(treeA_model.bounds);
+    const AABB treeB_trunk = trunkOccluder(treeB_model.bounds);
+
+    // === GPU Occlusion Queries ===
+    // Heavy models get a query each: Tree A instances, then Tree B instances, then the cabin
+    std::vector<AABB> heavyWorldBounds;
+    for (const auto &transform: treeA_transforms) heavyWorldBounds.push_back(treeA_model.bounds.transformed(transform));
+    for (const auto &transform: treeB_transforms) heavyWorldBounds.push_back(treeB_model.bounds.transformed(transform));
+    heavyWorldBounds.push_back(cabinModel.bounds.transformed(cabinTransform));
+    const int cabinQuery = static_cast<int>(heavyWorldBounds.size()) - 1;
+
+    OcclusionQueries occlusionQueries(static_cast<int>(heavyWorldBounds.size()), boxProgram);
+    int occlusionQueryMode = static_cast<int>(OcclusionQueries::Mode::Off);
+
     // === Tower (Quadrangular Frustum) ===
     GLuint towerVAO, towerVBO, towerEBO;
 
@@ -343,71 +397,7 @@ int main() {
     // === Hub (Cylinder, in the center of 4 blades) ===
     std::vector<float> hubVertexData;
     std::vector<GLuint> hubIndices;
-    constexpr int segments = 16;
-    constexpr float radius = 0.3f;
-    constexpr float length = 0.5f;
-
-    // Centers: X = 0.0, Y = 0.0
-    // Front Center (Z = length/2)
-    hubVertexData.insert(hubVertexData.end(), {0.0f, 0.0f, length / 2.0f, 0.0f, 0.0f, 1.0f}); // Index 0
-    // Back Center (Z = -length/2)
-    hubVertexData.insert(hubVertexData.end(), {0.0f, 0.0f, -length / 2.0f, 0.0f, 0.0f, -1.0f}); // Index 1
-
-    // Perimeter vertices
-    for (int i = 0; i < segments; ++i) {
-        float angle = 2.0f * M_PI * static_cast<float>(i) / static_cast<float>(segments);
-        float x = radius * std::cos(angle);
-        float y = radius * std::sin(angle);
-
-        // Front perimeter vertex (Z = length/2)
-        hubVertexData.insert(hubVertexData.end(), {x, y, length / 2.0f, 0.0f, 0.0f, 1.0f});
-        // Back perimeter vertex (Z = -length/2)
-        hubVertexData.insert(hubVertexData.end(), {x, y, -length / 2.0f, 0.0f, 0.0f, -1.0f});
-    }
-
-    // Indices for caps
-    for (int i = 0; i < segments; ++i) {
-        GLuint next_i = (i + 1) % segments;
-        GLuint front_curr = 2 + i * 2;
-        GLuint front_next = 2 + next_i * 2;
-        GLuint back_curr = 3 + i * 2;
-        GLuint back_next = 3 + next_i * 2;
-
-        // Front cap triangle fan (using index 0 as center)
-        hubIndices.insert(hubIndices.end(), {0, front_curr, front_next});
-
-        // Back cap triangle fan (using index 1 as center)
-        hubIndices.insert(hubIndices.end(), {1, back_next, back_curr});
-    }
-
-    // Duplicating perimeter vertices for correct side normals
-    GLuint sideStartIndex = hubVertexData.size() / 6;
-    for (int i = 0; i < segments; ++i) {
-        float angle = 2.0f * M_PI * static_cast<float>(i) / static_cast<float>(segments);
-        float x = radius * std::cos(angle);
-        float y = radius * std::sin(angle);
-
-        // Side normal (perpendicular to Z-axis)
-        float nx = std::cos(angle);
-        float ny = std::sin(angle);
-
-        GLuint next_i = (i + 1) % segments;
-
-        // Side Quad vertices
-        hubVertexData.insert(hubVertexData.end(), {x, y, length / 2.0f, nx, ny, 0.0f}); // front_curr_side
-        hubVertexData.insert(hubVertexData.end(), {x, y, -length / 2.0f, nx, ny, 0.0f}); // back_curr_side
-
-        // Quad indices
-        GLuint curr_f = sideStartIndex + i * 2;
-        GLuint curr_b = sideStartIndex + i * 2 + 1;
-        GLuint next_f = sideStartIndex + next_i * 2;
-        GLuint next_b = sideStartIndex + next_i * 2 + 1;
-
-        // Triangle 1 - front_curr, front_next, back_curr
-        hubIndices.insert(hubIndices.end(), {curr_f, next_f, curr_b});
-        // Triangle 2 - back_curr, front_next, back_next
-        hubIndices.insert(hubIndices.end(), {curr_b, next_f, next_b});
-    }
+    Geometry::buildHub(hubVertexData, hubIndices);
 
     GLuint hubVAO, hubVBO, hubEBO;
     glGenVertexArrays(1, &hubVAO);
@@ -434,74 +424,8 @@ int main() {
     // === Chimney (Cylinder) ===
     std::vector<float> chimneyVertexData;
     std::vector<GLuint> chimneyIndices;
-    constexpr int chimneySegments = 32;
-    constexpr float chimneyRadius = 1.0f;
-    constexpr float chimneyHeight = 1.0f;
-    constexpr int chimneyVertexStride = 8; // 3 for position, 3 for normal, 2 for UV
-
-    // Generate vertices for the side of the cylinder
-    for (int i = 0; i <= chimneySegments; ++i) {
-        float angle = 2.0f * M_PI * static_cast<float>(i) / static_cast<float>(chimneySegments);
-        float x = chimneyRadius * std::cos(angle);
-        float z = chimneyRadius * std::sin(angle);
-        float u = static_cast<float>(i) / static_cast<float>(chimneySegments);
-
-        glm::vec3 normal = glm::normalize(glm::vec3(x, 0.0f, z));
-
-        // Top vertex
-        chimneyVertexData.insert(chimneyVertexData.end(), {
-                                     x, chimneyHeight / 2.0f, z, normal.x, normal.y, normal.z, u, 1.0f
-                                 });
-        // Bottom vertex
-        chimneyVertexData.insert(chimneyVertexData.end(), {
-                                     x, -chimneyHeight / 2.0f, z, normal.x, normal.y, normal.z, u, 0.0f
-                                 });
-    }
-
-    // Indices for the side of the cylinder
-    for (int i = 0; i < chimneySegments; ++i) {
-        GLuint topLeft = i * 2;
-        GLuint bottomLeft = i * 2 + 1;
-        GLuint topRight = (i + 1) * 2;
-        GLuint bottomRight = (i + 1) * 2 + 1;
-
-        chimneyIndices.insert(chimneyIndices.end(), {bottomLeft, topRight, topLeft});
-        chimneyIndices.insert(chimneyIndices.end(), {bottomLeft, bottomRight, topRight});
-    }
-
-    // --- Vertices and indices for caps ---
-    // Top cap
-    GLuint topCenterIndex = chimneyVertexData.size() / chimneyVertexStride;
-    chimneyVertexData.insert(chimneyVertexData.end(), {0.0f, chimneyHeight / 2.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.5f, 0.5f});
-    for (int i = 0; i <= chimneySegments; ++i) {
-        float angle = 2.0f * M_PI * static_cast<float>(i) / static_cast<float>(chimneySegments);
-        float x = chimneyRadius * std::cos(angle);
-        float z = chimneyRadius * std::sin(angle);
-        chimneyVertexData.insert(chimneyVertexData.end(), {
-                                     x, chimneyHeight / 2.0f, z, 0.0f, 1.0f, 0.0f, 0.5f + 0.5f * x, 0.5f + 0.5f * z
-                                 });
-    }
-    for (int i = 0; i < chimneySegments; ++i) {
-        chimneyIndices.insert(chimneyIndices.end(), {topCenterIndex, topCenterIndex + i + 1, topCenterIndex + i + 2});
-    }
-
-    // Bottom cap
-    GLuint bottomCenterIndex = chimneyVertexData.size() / chimneyVertexStride;
-    chimneyVertexData.insert(chimneyVertexData.end(),
-                             {0.0f, -chimneyHeight / 2.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.5f, 0.5f});
-    for (int i = 0; i <= chimneySegments; ++i) {
-        float angle = 2.0f * M_PI * static_cast<float>(i) / static_cast<float>(chimneySegments);
-        float x = chimneyRadius * std::cos(angle);
-        float z = chimneyRadius * std::sin(angle);
-        chimneyVertexData.insert(chimneyVertexData.end(), {
-                                     x, -chimneyHeight / 2.0f, z, 0.0f, -1.0f, 0.0f, 0.5f + 0.5f * x, 0.5f + 0.5f * z
-                                 });
-    }
-    for (int i = 0; i < chimneySegments; ++i) {
-        chimneyIndices.insert(chimneyIndices.end(), {
-                                  bottomCenterIndex, bottomCenterIndex + i + 2, bottomCenterIndex + i + 1
-                              });
-    }
+    Geometry::buildChimney(chimneyVertexData, chimneyIndices);
+    constexpr int chimneyVertexStride = Geometry::chimneyVertexStride;
 
     GLuint chimneyVAO, chimneyVBO, chimneyEBO;
     glGenVertexArrays(1, &chimneyVAO);
@@ -531,14 +455,9 @@ int main() {
     // === End of Chimney ===
 
     // === Skybox ===
-    GLuint skyboxVAO, skyboxVBO;
-    glGenVertexArrays(1, &skyboxVAO);
-    glGenBuffers(1, &skyboxVBO);
-    glBindVertexArray(skyboxVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Geometry::skyboxVertices), &Geometry::skyboxVertices, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), static_cast<void *>(nullptr));
+    const BufferHandle skyboxBuffer = renderDevice.createBuffer({
+        BufferUsage::Vertex, sizeof(Geometry::skyboxVertices), &Geometry::skyboxVertices
+    });
 
     std::vector<std::string> faces{
         "textures/sky_15_2k/sky_15_cubemap_2k/px.png",
@@ -549,9 +468,26 @@ int main() {
         "textures/sky_15_2k/sky_15_cubemap_2k/nz.png"
     };
     unsigned int cubeMapTexture = loadCubeMap(faces);
+    const TextureHandle skyboxTexture = renderDevice.importTexture(cubeMapTexture, TextureType::Cube);
 
-    glUseProgram(skyboxProgram);
-    glUniform1i(glGetUniformLocation(skyboxProgram, "skybox"), 0);
+    // Drawn last: at depth 1 ("z = w" trick) it only passes GL_LEQUAL where no geometry was drawn
+    struct SkyboxConstants {
+        glm::mat4 view;
+        glm::mat4 projection;
+    };
+    PipelineDesc skyboxPipelineDesc;
+    skyboxPipelineDesc.vertexShader = "skybox.vert";
+    skyboxPipelineDesc.fragmentShader = "skybox.frag";
+    skyboxPipelineDesc.vertexStride = 3 * sizeof(float);
+    skyboxPipelineDesc.attributes = {{0, 3, 0}};
+    skyboxPipelineDesc.textures = {"skybox"};
+    skyboxPipelineDesc.pushConstantSize = sizeof(SkyboxConstants);
+    skyboxPipelineDesc.depthWrite = false;
+    skyboxPipelineDesc.depthCompare = CompareOp::LessEqual;
+    const PipelineHandle skyboxPipeline = renderDevice.createPipeline(skyboxPipelineDesc);
+    skyboxPipelineDesc.features = ShaderVariants::STEREO;
+    const PipelineHandle skyboxStereoPipeline = renderDevice.createPipeline(skyboxPipelineDesc);
+    std::unique_ptr<CommandList> skyboxCommands = renderDevice.createCommandList();
     // === End of Skybox ===
 
     // === Load Textures ===
@@ -559,16 +495,282 @@ int main() {
     unsigned int towerTexture = loadTexture("textures/Bricks099_1K-JPG/Bricks099_1K-JPG_Color.jpg");
     unsigned int capTexture = loadTexture("textures/Bricks094_1K-JPG/Bricks094_1K-JPG_Color.jpg");
     unsigned int chimneyTexture = loadTexture("textures/PavingStones135_1K-JPG/PavingStones135_1K-JPG_Color.jpg");
-    unsigned int particleTexture = loadTexture(
+    // Every particle sprite in one atlas, so the emitters share a texture and the particle system draws them all at
+    // once; each emitter picks its frames through its settings
+    ParticleAtlas particleAtlas;
+    const int smokeSheet = particleAtlas.addSheet(
         "textures/Smoke/toppng.com-realistic-smoke-texture-with-soft-particle-edges-png-399x385.png");
-
-    // === Texture Uniforms ===
-    glUseProgram(program);
-    glUniform1i(glGetUniformLocation(program, "texture_diffuse1"), 0);
+    constexpr int DUST_SPRITE_SIZE = 32;
+    const int dustSheet = particleAtlas.addSheet(DUST_SPRITE_SIZE, DUST_SPRITE_SIZE,
+                                                 makeDustSprite(DUST_SPRITE_SIZE).data());
+    constexpr int LEAF_FRAME_SIZE = 32, LEAF_COLUMNS = 4, LEAF_ROWS = 2;
+    const int leafSheet = particleAtlas.addSheet(LEAF_FRAME_SIZE * LEAF_COLUMNS, LEAF_FRAME_SIZE * LEAF_ROWS,
+                                                 makeLeafFlipbook(LEAF_FRAME_SIZE, LEAF_COLUMNS, LEAF_ROWS).data(),
+                                                 LEAF_COLUMNS, LEAF_ROWS);
+    particleAtlas.build();
+    const GLuint particleTexture = particleAtlas.getTexture();
+
+    // === Static Batching ===
+    // Chimney, cabin, benches and ground never move: merge them per material into world-space chunks.
+    // The cabin and benches have no textures of their own and are drawn with the chimney's stone texture
+    StaticBatcher staticBatcher(32.0f);
+    StaticMaterial chimneyMaterial;
+    chimneyMaterial.texture = chimneyTexture;
+    chimneyMaterial.unlit = true;
+    StaticMaterial stoneMaterial;
+    stoneMaterial.texture = chimneyTexture;
+    StaticMaterial groundMaterial;
+    groundMaterial.texture = groundTexture;
+    groundMaterial.objectColor = glm::vec3(0.32f, 0.53f, 0.05f);
+
+    staticBatcher.add(chimneyVertexData, chimneyIndices, chimneyTransform, chimneyMaterial);
+    staticBatcher.add(cabinModel, cabinTransform, stoneMaterial);
+    staticBatcher.add(benchModel, bench1Transform, stoneMaterial);
+    staticBatcher.add(benchModel, bench2Transform, stoneMaterial);
+    staticBatcher.add(groundModel, groundTransform, groundMaterial);
+    staticBatcher.build();
+    bool useStaticBatching = true;
+    // Indirect commands for the visible static chunks, written by a worker thread every frame
+    IndirectDrawList staticDrawList;
+
+    // === Depth Pre-Pass & Draw Ordering ===
+    // Object-space bounds of the procedural meshes, used to sort them by distance
+    const AABB towerBounds = AABB::fromInterleaved(Geometry::towerVertices, 8);
+    const AABB capBounds = AABB::fromInterleaved(Geometry::capVertices, 8);
+    const AABB bladeBounds = AABB::fromInterleaved(Geometry::bladeVertices, 6);
+    const AABB hubBounds = AABB::fromInterleaved(hubVertexData, 6);
+    const AABB chimneyBounds = AABB::fromInterleaved(chimneyVertexData, chimneyVertexStride);
+
+    RenderQueue opaqueQueue;
+    // The models with an occlusion query (trees, cabin), drawn after the rest of the opaque scene so their queries
+    // test against it rather than against the models themselves
+    RenderQueue heavyQueue;
+    // Primitives the heavy models produced in the colour pass: conditional render skips them on the GPU, so this
+    // is where skipped draws show
+    GpuCounter heavyPrimitives(GL_PRIMITIVES_GENERATED);
+    bool useDepthPrepass = true;
+    bool useFrontToBack = true;
+    // Samples that pass the depth test in the main colour pass, i.e. fragments actually shaded
+    GpuCounter shadedSamples(GL_SAMPLES_PASSED);
+
+    // === Instanced Trees ===
+    // Without per-tree occlusion queries, the visible trees of each model are drawn with one instanced draw
+    bool useTreeInstancing = true;
+    GLuint treeInstanceBuffers[2];
+    glGenBuffers(2, treeInstanceBuffers);
+    treeA_model.setInstanceBuffer(treeInstanceBuffers[0]);
+    treeB_model.setInstanceBuffer(treeInstanceBuffers[1]);
+    std::vector<glm::mat4> visibleTreeTransforms;
+
+    // === Clustered Lanterns ===
+    // Point lights are assigned to a 16x12x24 cluster grid on the CPU every frame; shader.frag only loops
+    // over the lights of its fragment's cluster
+    constexpr int MAX_LANTERNS = 1024;
+    // Their frustum follows the camera's projection, set every frame from the window's aspect
+    LightClusters lightClusters(16, 12, 24, &threadPool);
+    float clusterAspect = 0.0f;
+    LightBuffers lightBuffers;
+    std::vector<PointLight> lanterns, frameLights;
+    std::vector<float> lanternPhases;
+    unsigned int lanternSeed = 12345u;
+    auto lanternRandom = [&lanternSeed]() {
+        lanternSeed = lanternSeed * 1664525u + 1013904223u;
+        return static_cast<float>(lanternSeed >> 8) / static_cast<float>(1u << 24);
+    };
+    // Scattered between the windmill and the edge of the ground, at hand height, in warm colours
+    for (int i = 0; i < MAX_LANTERNS; i++) {
+        const float angle = lanternRandom() * 2.0f * M_PI;
+        const float distance = 6.0f + lanternRandom() * 40.0f;
+        PointLight lantern;
+        lantern.position = glm::vec3(std::cos(angle) * distance, 1.0f + lanternRandom() * 1.5f,
+                                     std::sin(angle) * distance);
+        lantern.radius = 4.0f + lanternRandom() * 3.0f;
+        lantern.color = glm::vec3(1.0f, 0.55f + lanternRandom() * 0.2f, 0.2f + lanternRandom() * 0.15f) * 6.0f;
+        lanterns.push_back(lantern);
+        lanternPhases.push_back(lanternRandom() * 6.2832f);
+    }
+    int lanternCount = 128;
+    bool nightMode = false;
+
+    // === Cascaded Shadows ===
+    // Shadows of the controllable light. Everything but the windmill is static and drawn into cached
+    // per-cascade layers; only the windmill is drawn into the maps every frame
+    ShadowCascades shadowCascades(1024, 3);
+    bool useShadows = true;
+    bool cacheStaticShadows = true;
+    AABB shadowSceneBounds;
+    for (const auto &batch: staticBatcher.getBatches()) {
+        for (const auto &chunk: batch.chunks) shadowSceneBounds.expand(chunk.bounds);
+    }
+    for (const auto &bounds: heavyWorldBounds) shadowSceneBounds.expand(bounds);
+    // Space swept by the rotating body and blades
+    shadowSceneBounds.expand(AABB(glm::vec3(-5.0f, 0.0f, -5.0f), glm::vec3(5.0f, 15.0f, 5.0f)));
+    // Trees are not batched; they go into the cached layers one by one, culled to each cascade
+    std::vector<DrawItem> treeCasters;
+    for (size_t i = 0; i < treeA_transforms.size() + treeB_transforms.size(); i++) {
+        const bool isTreeA = i < treeA_transforms.size();
+        DrawItem tree;
+        tree.model = isTreeA ? &treeA_model : &treeB_model;
+        tree.transform = isTreeA ? treeA_transforms[i] : treeB_transforms[i - treeA_transforms.size()];
+        tree.worldBounds = heavyWorldBounds[i];
+        tree.texture = chimneyTexture;
+        tree.alphaTested = true;
+        treeCasters.push_back(tree);
+    }
+    RenderQueue staticCasters, dynamicCasters;
+    ShaderVariants::FrameUniforms shadowUniforms = sceneUniforms;
+    // Shadow maps and the main (pre-pass, colour, skybox and particles) pass are timed separately
+    GpuCounter shadowPassTime(GL_TIME_ELAPSED);
+    GpuCounter mainPassTime(GL_TIME_ELAPSED);
+
+    // === Dynamic Resolution ===
+    // The scene is rendered offscreen at a scale steered by the main pass's GPU time, then upscaled with
+    // sharpening; ImGui is drawn afterwards at native resolution. Off by default, so the scene is drawn at full
+    // resolution unless it is enabled in the overlay; its budget starts at 3/4 of the display's refresh interval
+    DynamicResolution dynamicResolution(upscaleShaders.get(0).id);
+    bool useDynamicResolution = false;
+    const GLFWvidmode *videoMode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+    const int refreshRate = videoMode != nullptr && videoMode->refreshRate > 0 ? videoMode->refreshRate : 60;
+    float sceneBudgetMs = 750.0f / static_cast<float>(refreshRate); // Target for the resolution-dependent passes only
+    float fixedRenderScale = 1.0f;
+    float upscaleSharpness = 0.5f;
+
+    // === Anti-Aliasing ===
+    // FXAA and TAA are post passes over the single-sampled scene; MSAA multisamples the offscreen framebuffer
+    // instead. MSAA, which the window always had, stays the default; FXAA and TAA are chosen in the overlay.
+    // The main + AA pass GPU time last measured in each mode is kept for comparison
+    constexpr int MSAA_SAMPLES = 4;
+    const char *const antiAliasingNames[] = {"Off", "FXAA", "TAA", "MSAA 4x"};
+    PostAntiAliasing postAA(fxaaShaders.get(0).id, taaShaders.get(0).id);
+    int antiAliasingMode = 3;
+    GpuCounter antiAliasingTime(GL_TIME_ELAPSED);
+    double antiAliasingCost[4] = {0.0, 0.0, 0.0, 0.0};
+
+    // === Render Graph ===
+    // The frame's GPU passes are declared to it every frame; transient render targets come from its pool
+    RenderGraph renderGraph;
+
+    // === Stereo ===
+    // Both eyes side by side in the scene target, drawn in two passes or in one with instanced draws.
+    // The mode-dependent state (instance divisors, particle shader) is reapplied when the mode changes
+    const char *const stereoModeNames[] = {"Mono", "Two passes", "Single pass"};
+    StereoRig stereoRig;
+    StereoRig::Mode appliedStereoMode = StereoRig::Mode::Off;
+    double sceneSubmitMs = 0.0;
+    int sceneDrawCalls = 0;
+
+    // Compile the permutations the scene uses up front rather than on first draw
+    for (bool depthOnly: {false, true}) {
+        const unsigned pass = depthOnly ? ShaderVariants::DEPTH_ONLY : 0u;
+        sceneShaders.get(pass | ShaderVariants::TEXTURED);
+        sceneShaders.get(pass);
+        sceneShaders.get(pass | ShaderVariants::TEXTURED | ShaderVariants::UNLIT);
+        sceneShaders.get(pass | ShaderVariants::TEXTURED | ShaderVariants::ALPHA_TEST);
+        sceneShaders.get(pass | ShaderVariants::TEXTURED | ShaderVariants::ALPHA_TEST | ShaderVariants::INSTANCED);
+    }
+    sceneShaders.report();
+    renderDevice.report();
+    particleShaders.report();
+    boxShaders.report();
+    upscaleShaders.report();
+    fxaaShaders.report();
+    taaShaders.report();
+    particleDepthShaders.report();
+    particleUpsampleShaders.report();
+    particleOitResolveShaders.report();
+    programCache.report();
 
     // === Particle System ===
+    // Emitters are updated in parallel on the thread pool; the output does not depend on the thread count
     constexpr int MAX_PARTICLES = 5000;
-    ParticleSystem particleSystem(MAX_PARTICLES, particleProgram, particleTexture);
+    ParticleSystem particleSystem(particleProgram, particleTexture, &threadPool);
+    ParticleEmitter::Settings chimneySmoke;
+    chimneySmoke.position = glm::vec3(-10.0f, 15.0f, -30.0f); // Correct chimney top
+    // A clear, consistent upward speed: 8 units up over the 2s lifetime, with very slight randomness
+    chimneySmoke.velocity = glm::vec3(0.0f, 4.0f, 0.0f);
+    chimneySmoke.velocityJitter = glm::vec3(0.3f);
+    chimneySmoke.minSize = 1.4f; // Size of the smoke, slightly varied
+    chimneySmoke.maxSize = 2.0f;
+    chimneySmoke.tint = glm::vec4(0.85f, 0.85f, 0.85f, 1.0f); // A semi-transparent gray over the sprite's own shading
+    chimneySmoke.atlasFrame = smokeSheet < 0 ? 0 : particleAtlas.getSheet(smokeSheet).firstFrame;
+    chimneySmoke.lifetime = 2.0f;
+    chimneySmoke.rate = 60.0f; // Particles per second, whatever the frame rate
+    chimneySmoke.capacity = MAX_PARTICLES;
+    const int chimneyEmitter = particleSystem.addEmitter(chimneySmoke);
+
+    // Dust blown off the blades, following the hub as the body turns
+    ParticleEmitter::Settings bladeDust;
+    bladeDust.velocity = glm::vec3(0.0f, -0.5f, 0.0f);
+    bladeDust.velocityJitter = glm::vec3(1.5f, 0.8f, 1.5f);
+    bladeDust.minSize = 0.3f;
+    bladeDust.maxSize = 0.6f;
+    bladeDust.tint = glm::vec4(0.55f, 0.45f, 0.35f, 0.8f);
+    bladeDust.atlasFrame = particleAtlas.getSheet(dustSheet).firstFrame;
+    bladeDust.lifetime = 1.5f;
+    bladeDust.rate = 30.0f;
+    bladeDust.capacity = 500;
+    bladeDust.enabled = false;
+    const int bladeDustEmitter = particleSystem.addEmitter(bladeDust);
+
+    // Leaves drifting down from every tree's canopy
+    ParticleEmitter::Settings leaves;
+    leaves.velocity = glm::vec3(0.4f, -1.2f, 0.1f);
+    leaves.velocityJitter = glm::vec3(0.6f, 0.3f, 0.6f);
+    leaves.minSize = 0.2f;
+    leaves.maxSize = 0.35f;
+    leaves.tint = glm::vec4(0.75f, 0.5f, 0.15f, 1.0f);
+    // Turning over twice a second while it falls
+    leaves.atlasFrame = particleAtlas.getSheet(leafSheet).firstFrame;
+    leaves.frameCount = particleAtlas.getSheet(leafSheet).frameCount;
+    leaves.lifetime = 4.0f;
+    leaves.rate = 6.0f;
+    leaves.capacity = 100;
+    leaves.enabled = false;
+    std::vector<int> leafEmitters;
+    for (const glm::vec3 &position: Geometry::treeA_positions) {
+        leaves.position = position + glm::vec3(0.0f, 4.0f * Geometry::treeA_scale, 0.0f);
+        leafEmitters.push_back(particleSystem.addEmitter(leaves));
+    }
+    for (const glm::vec3 &position: Geometry::treeB_positions) {
+        leaves.position = position + glm::vec3(0.0f, 4.0f * Geometry::treeB_scale, 0.0f);
+        leafEmitters.push_back(particleSystem.addEmitter(leaves));
+    }
+    bool extraEmitters = false;
+    int particleOverflow = 0; // ParticleEmitter::OverflowPolicy of every emitter
+    // Emitters off-screen stop drawing (or simulating), distant ones emit fewer, larger particles
+    ParticleSystem::LodSettings particleLod;
+    bool showEmitterLods = false;
+
+    // Smoke simulated on the GPU with transform feedback, for counts the CPU path could not upload every frame
+    int gpuParticleCount = 200000;
+    ParticleEmitter::Settings gpuSmoke = chimneySmoke;
+    gpuSmoke.velocityJitter = glm::vec3(0.8f, 0.6f, 0.8f);
+    gpuSmoke.minSize = 0.2f;
+    gpuSmoke.maxSize = 0.5f;
+    gpuSmoke.lifetime = 3.0f;
+    gpuSmoke.capacity = gpuParticleCount;
+    GpuParticles gpuParticles(gpuSmoke, particleProgram, particleTexture, &programCache);
+    // The chimney smoke again, computed in particle.vert from a ring of spawn times: no simulation, no per-frame
+    // upload beyond the new particles' slots
+    AnalyticParticles analyticSmoke(chimneySmoke, particleShaders.get(ShaderVariants::ANALYTIC).id, particleTexture);
+    int particleSimulation = 0; // 0: CPU emitters, 1: GPU transform feedback, 2: analytic
+    // Permutation features of the particle renderers' shaders (STEREO, SOFT), reapplied when they change; none
+    // applied yet, so the first frame also hands the atlas to the permutations in use
+    unsigned appliedParticleFeatures = ~0u;
+
+    // Particles drawn into half- or quarter-resolution targets and upsampled over the scene, to cut the fill rate
+    // of overlapping billboards; the samples counter measures their overdraw either way
+    OffscreenParticles offscreenParticles(particleDepthShaders.get(0).id, particleUpsampleShaders.get(0).id);
+    offscreenParticles.setDepthRange(0.1f, 100.0f);
+    int particleResolution = 0; // 0: full, 1: half, 2: quarter
+    bool softParticles = true;
+    float softParticleDistance = 1.5f;
+    // Sorted blending is exact but needs the CPU emitters sorted every frame; weighted blended OIT needs no order
+    // at all. It draws through the offscreen passes, at full resolution when the particle resolution is full
+    WeightedOit weightedOit(particleOitResolveShaders.get(0).id);
+    int particleBlending = 0; // 0: sorted, 1: weighted OIT
+    GpuCounter particleSamples(GL_SAMPLES_PASSED);
+    GpuCounter particlePassTime(GL_TIME_ELAPSED);
 
     // Display control tip in console
     std::cout << "Controls:\n";
@@ -661,6 +863,185 @@ int main() {
             // Blade Speed (I/K)
             ImGui::SliderFloat("Blade (I/K)", &bladeRotationSpeed, 0.0f, 1000.0f);
 
+            ImGui::Separator();
+            ImGui::Text("Performance");
+            ImGui::Checkbox("CPU occlusion culling", &useOcclusionCulling);
+            if (useOcclusionCulling) {
+                const OcclusionCuller::Stats &occlusionStats = occlusionCuller.getStats();
+                ImGui::Text("Occluder tris: %d, raster: %.3f ms", occlusionStats.occluderTriangles,
+                            occlusionStats.rasterMs);
+                ImGui::Text("Culled objects: %d / %d", occlusionStats.culled, occlusionStats.tested);
+            }
+            if (ImGui::Combo("GPU occlusion queries", &occlusionQueryMode, "Off\0Conditional render\0Last frame\0")) {
+                occlusionQueries.setMode(static_cast<OcclusionQueries::Mode>(occlusionQueryMode));
+            }
+            if (occlusionQueries.getMode() != OcclusionQueries::Mode::Off) {
+                ImGui::Text("Occluded heavy models: %d / %d", occlusionQueries.occludedCount(),
+                            occlusionQueries.objectCount());
+            }
+            ImGui::Text("Heavy model triangles drawn: %.2f M", static_cast<double>(heavyPrimitives.value()) / 1.0e6);
+            ImGui::Checkbox("Static batching", &useStaticBatching);
+            if (useStaticBatching) {
+                ImGui::Text("Static draw calls: %d (%d commands), chunks culled: %d",
+                            staticBatcher.getStats().drawCalls, staticBatcher.getStats().commands,
+                            staticBatcher.getStats().chunksCulled);
+            }
+            ImGui::Checkbox("Depth pre-pass", &useDepthPrepass);
+            ImGui::Checkbox("Front-to-back order", &useFrontToBack);
+            ImGui::Checkbox("Instanced trees (queries off)", &useTreeInstancing);
+            ImGui::SliderInt("Lanterns", &lanternCount, 0, MAX_LANTERNS);
+            ImGui::Checkbox("Night", &nightMode);
+            const LightClusters::Stats &clusterStats = lightClusters.getStats();
+            ImGui::Text("Light assign: %.3f ms, %d lights, %d refs, max %d/cluster", clusterStats.assignMs,
+                        clusterStats.lights, clusterStats.indices, clusterStats.maxPerCluster);
+            ImGui::Checkbox("Shadows", &useShadows);
+            if (useShadows) {
+                ImGui::Checkbox("Cache static shadow casters", &cacheStaticShadows);
+                ImGui::Text("Shadow pass: %.2f ms GPU, static layers redrawn: %d (%d total)",
+                            shadowPassTime.milliseconds(), shadowCascades.getStats().staticRedraws,
+                            shadowCascades.getStats().staticRedrawsTotal);
+            }
+            ImGui::Text("Main pass: %.2f ms GPU", mainPassTime.milliseconds());
+            int stereoMode = static_cast<int>(stereoRig.getMode());
+            if (ImGui::Combo("Stereo", &stereoMode, "Off\0Two passes\0Single pass (instanced)\0")) {
+                stereoRig.setMode(static_cast<StereoRig::Mode>(stereoMode));
+            }
+            if (stereoRig.getMode() != StereoRig::Mode::Off) {
+                float eyeSeparation = stereoRig.getEyeSeparation();
+                if (ImGui::SliderFloat("Eye separation", &eyeSeparation, 0.0f, 0.5f)) {
+                    stereoRig.setEyeSeparation(eyeSeparation);
+                }
+                ImGui::Text("GPU occlusion queries and TAA are off in stereo");
+            }
+            for (int mode = 0; mode < StereoRig::MODE_COUNT; mode++) {
+                const StereoRig::Sample &sample = stereoRig.getLast(static_cast<StereoRig::Mode>(mode));
+                ImGui::Text("%s: submit %.3f ms CPU, %.2f ms GPU, %d draws", stereoModeNames[mode], sample.submitMs,
+                            sample.gpuMs, sample.drawCalls);
+            }
+            if (stereoRig.isBenchmarking()) {
+                ImGui::Text("Stereo benchmark running...");
+            } else if (ImGui::Button("Run stereo benchmark")) {
+                stereoRig.startBenchmark();
+            }
+            ImGui::Combo("Particle simulation", &particleSimulation,
+                         "CPU emitters\0GPU (transform feedback)\0Analytic (vertex shader)\0");
+            if (particleSimulation == 2) {
+                ImGui::Text("Analytic smoke: %d alive of %d slots, %d bytes uploaded",
+                            analyticSmoke.getStats().alive, analyticSmoke.getCapacity(),
+                            analyticSmoke.getStats().uploadedBytes);
+            }
+            if (ImGui::Combo("Particle resolution", &particleResolution, "Full\0Half\0Quarter\0")) {
+                offscreenParticles.setFactor(1 << particleResolution);
+            }
+            ImGui::Combo("Particle blending", &particleBlending, "Sorted (back to front)\0Weighted OIT (unsorted)\0");
+            const bool particlePasses = offscreenParticles.isEnabled() || particleBlending == 1;
+            if (particlePasses) {
+                ImGui::Checkbox("Soft particles", &softParticles);
+                if (softParticles) ImGui::SliderFloat("Soft distance", &softParticleDistance, 0.1f, 5.0f);
+            }
+            {
+                // Samples are per MSAA sample, so with MSAA 4x a fully covered pixel layer counts 4
+                const glm::ivec2 shadedSize = dynamicResolution.getRenderSize() / offscreenParticles.getFactor();
+                const double pixels = static_cast<double>(shadedSize.x) * static_cast<double>(shadedSize.y);
+                ImGui::Text("Particle overdraw: %llu samples (%.2f per pixel), offscreen passes %.2f ms",
+                            static_cast<unsigned long long>(particleSamples.value()),
+                            pixels > 0.0 ? static_cast<double>(particleSamples.value()) / pixels : 0.0,
+                            particlePasses ? particlePassTime.milliseconds() : 0.0);
+            }
+            if (particleSimulation == 1) {
+                ImGui::SliderInt("GPU particles", &gpuParticleCount, 10000, 1000000);
+                // Reallocating restarts the emitter, so only once the slider is let go
+                if (ImGui::IsItemDeactivatedAfterEdit()) gpuParticles.setCapacity(gpuParticleCount);
+            }
+            if (ImGui::Checkbox("Blade dust and leaves", &extraEmitters)) {
+                particleSystem.getEmitter(bladeDustEmitter).setEnabled(extraEmitters);
+                for (const int emitter: leafEmitters) particleSystem.getEmitter(emitter).setEnabled(extraEmitters);
+            }
+            if (ImGui::Combo("Particle overflow", &particleOverflow, "Drop\0Steal oldest\0Grow\0")) {
+                for (int i = 0; i < particleSystem.getEmitterCount(); i++) {
+                    particleSystem.getEmitter(i).setOverflowPolicy(
+                        static_cast<ParticleEmitter::OverflowPolicy>(particleOverflow));
+                }
+            }
+            if (ImGui::Button("Smoke burst (2000)")) particleSystem.getEmitter(chimneyEmitter).burst(2000);
+            ImGui::Checkbox("Particle LOD", &particleLod.enabled);
+            if (particleLod.enabled) {
+                ImGui::Checkbox("Off-screen emitters dormant", &particleLod.dormantOffscreen);
+                ImGui::SliderFloat("Full detail height (px)", &particleLod.fullDetailPixels, 20.0f, 600.0f);
+                ImGui::SliderFloat("Minimum detail", &particleLod.minDetail, 0.05f, 1.0f);
+            }
+            const ParticleSystem::Stats &particleStats = particleSystem.getStats();
+            ImGui::Text("Particles: %d drawn, %d simulated, from %d emitters, update %.3f ms, merge %.3f ms",
+                        particleStats.alive, particleStats.simulated, particleStats.emitters, particleStats.updateMs,
+                        particleStats.mergeMs);
+            ImGui::Text("Emitter LOD: %d full, %d reduced, %d hidden, %d dormant", particleStats.lodCounts[0],
+                        particleStats.lodCounts[1], particleStats.lodCounts[2], particleStats.lodCounts[3]);
+            ImGui::Checkbox("Show emitter LODs", &showEmitterLods);
+            if (showEmitterLods) {
+                static const char *const LOD_NAMES[] = {"full", "reduced", "hidden", "dormant"};
+                for (int i = 0; i < particleSystem.getEmitterCount(); i++) {
+                    const ParticleEmitter &emitter = particleSystem.getEmitter(i);
+                    const char *name =
+                            i == chimneyEmitter ? "Chimney" : i == bladeDustEmitter ? "Blade dust" : "Leaves";
+                    ImGui::Text("%2d %-10s %-7s %3.0f%% detail, %4d alive", i, name,
+                                LOD_NAMES[static_cast<int>(emitter.getLod())], emitter.getDetail() * 100.0f,
+                                emitter.getPool().size());
+                }
+            }
+            ImGui::Text("Per second: %.0f spawned, %.0f dropped, %.0f recycled (chimney pool %d)",
+                        particleStats.spawned, particleStats.dropped, particleStats.recycled,
+                        particleSystem.getEmitter(chimneyEmitter).getStats().capacity);
+            int particleKernelLevel = static_cast<int>(ParticleKernels::getLevel());
+            if (ImGui::Combo("Particle kernels", &particleKernelLevel, "Scalar\0SSE2\0AVX2\0")) {
+                // Clamped to what the CPU supports
+                ParticleKernels::setLevel(static_cast<ParticleKernels::Level>(particleKernelLevel));
+            }
+            if (ImGui::Button("Run particle benchmark (5k/100k/1M)")) {
+                // CPU only and synchronous: the window stalls for a few seconds, the results go to the console
+                ParticlePool::runBenchmark();
+            }
+            ImGui::Checkbox("Dynamic resolution", &useDynamicResolution);
+            if (useDynamicResolution) {
+                ImGui::SliderFloat("Main pass budget (ms)", &sceneBudgetMs, 1.0f, 33.0f);
+            } else {
+                ImGui::SliderFloat("Render scale", &fixedRenderScale, 0.5f, 1.0f);
+            }
+            ImGui::SliderFloat("Sharpening", &upscaleSharpness, 0.0f, 1.0f);
+            if (ImGui::Combo("Anti-aliasing", &antiAliasingMode, "Off\0FXAA\0TAA\0MSAA 4x\0")) {
+                postAA.setMode(antiAliasingMode == 1 ? PostAntiAliasing::Mode::FXAA
+                               : antiAliasingMode == 2 ? PostAntiAliasing::Mode::TAA
+                               : PostAntiAliasing::Mode::Off);
+            }
+            ImGui::Text("AA pass: %.2f ms GPU, TAA history: %.1f MB", antiAliasingTime.milliseconds(),
+                        static_cast<double>(postAA.memoryBytes()) / 1.0e6);
+            ImGui::Text("Main + AA, last measured:");
+            for (int mode = 0; mode < 4; mode++) {
+                ImGui::SameLine();
+                ImGui::Text("%s %.2f ms", antiAliasingNames[mode], antiAliasingCost[mode]);
+            }
+            const glm::ivec2 renderSize = dynamicResolution.getRenderSize();
+            char scaleOverlay[64];
+            std::snprintf(scaleOverlay, sizeof(scaleOverlay), "%.0f%% (%dx%d)",
+                          dynamicResolution.getScale() * 100.0f, renderSize.x, renderSize.y);
+            ImGui::PlotLines("Scale history", dynamicResolution.getHistory().data(),
+                             static_cast<int>(dynamicResolution.getHistory().size()),
+                             dynamicResolution.getHistoryOffset(), scaleOverlay, 0.0f, 1.0f, ImVec2(0.0f, 50.0f));
+            const RenderGraph::Stats &graphStats = renderGraph.getStats();
+            ImGui::Text("Render graph: %d passes (%d culled), %d transients in %d allocations", graphStats.passes,
+                        graphStats.culled, graphStats.transients, graphStats.allocations);
+            ImGui::Text("Transient targets: %.1f MB (%.1f MB without aliasing)",
+                        static_cast<double>(graphStats.aliasedBytes) / 1.0e6,
+                        static_cast<double>(graphStats.unaliasedBytes) / 1.0e6);
+            bool aliasTargets = renderGraph.isAliasing();
+            if (ImGui::Checkbox("Alias transient targets", &aliasTargets)) {
+                renderGraph.setAliasing(aliasTargets);
+            }
+            if (useDepthPrepass || occlusionQueries.getMode() != OcclusionQueries::Mode::Conditional) {
+                ImGui::Text("Shaded samples: %.2f M", static_cast<double>(shadedSamples.value()) / 1.0e6);
+            } else {
+                ImGui::Text("Shaded samples: n/a with conditional queries");
+            }
+
             ImGui::End();
         }
         // End of GUI panel
@@ -728,279 +1109,744 @@ int main() {
         mainBodyAngle = std::fmod(mainBodyAngle, 360.0f);
         bladeAngle = std::fmod(bladeAngle, 360.0f);
 
+        // === Camera ===
+        // 45 degrees vertically over the aspect of what one eye sees: the whole window, or half of it side by
+        // side in stereo. Everything that works with the camera's frustum (culling, shadows, clusters) uses it
+        int framebufferWidth, framebufferHeight;
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        const glm::ivec2 eyeWindowSize = glm::max(stereoRig.eyeSize(glm::ivec2(framebufferWidth, framebufferHeight)),
+                                                  glm::ivec2(1));
+        const float cameraFovY = glm::radians(45.0f);
+        const float cameraAspect = static_cast<float>(eyeWindowSize.x) / static_cast<float>(eyeWindowSize.y);
+        const glm::mat4 cameraProjection = glm::perspective(cameraFovY, cameraAspect, 0.1f, 100.0f);
+        if (cameraAspect != clusterAspect) {
+            lightClusters.setProjection(cameraFovY, cameraAspect, 0.1f, 100.0f);
+            clusterAspect = cameraAspect;
+        }
+        // === Camera end ===
+
         // === Update Particles ===
-        int newParticles = 1; // Spawn 1 new particle per frame
-        particleSystem.update(deltaTime, newParticles, cameraPos);
+        // Order independent, the emitters skip their depth sort; either blending draws through the offscreen passes
+        const bool orderIndependent = particleBlending == 1;
+        const bool particlePasses = offscreenParticles.isEnabled() || orderIndependent;
+        particleSystem.setOrderIndependent(orderIndependent);
+        // Chosen for the camera that will draw this frame: both eyes' frustum in stereo
+        particleSystem.setLodSettings(particleLod);
+        particleSystem.setCamera(stereoRig.cullingView(glm::lookAt(cameraPos, lookAtPos, up), cameraFovY, cameraAspect),
+                                 cameraProjection, dynamicResolution.getRenderSize().y);
+        particleSystem.getEmitter(bladeDustEmitter).setPosition(
+            glm::vec3(Geometry::hubTransform(mainBodyAngle) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)));
+        if (particleSimulation == 1) {
+            gpuParticles.simulate(deltaTime);
+        } else if (particleSimulation == 2) {
+            analyticSmoke.update(deltaTime);
+        } else {
+            particleSystem.update(deltaTime, cameraPos);
+        }
 
-        // Rendering
-        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        // === Stereo Mode ===
+        if (stereoRig.getMode() != appliedStereoMode) {
+            appliedStereoMode = stereoRig.getMode();
+            // Single pass draws every instance once per eye, so instance data advances every second instance
+            const GLuint views = static_cast<GLuint>(stereoRig.viewsPerDraw());
+            treeA_model.setInstanceBuffer(treeInstanceBuffers[0], views);
+            treeB_model.setInstanceBuffer(treeInstanceBuffers[1], views);
+            postAA.resetHistory();
+        }
+        // Soft particles read the reduced depth, so they only exist on the offscreen path; OIT writes the
+        // accumulation and revealage targets instead of blending over the target
+        const unsigned particleFeatures = stereoRig.shaderFeatures() |
+                (particlePasses && softParticles ? ShaderVariants::SOFT : 0u) |
+                (orderIndependent ? ShaderVariants::OIT : 0u);
+        if (particleFeatures != appliedParticleFeatures) {
+            appliedParticleFeatures = particleFeatures;
+            particleAtlas.applyTo(particleShaders.get(particleFeatures).id);
+            particleAtlas.applyTo(particleShaders.get(particleFeatures | ShaderVariants::ANALYTIC).id);
+            particleSystem.setShader(particleShaders.get(particleFeatures).id);
+            gpuParticles.setShader(particleShaders.get(particleFeatures).id);
+            analyticSmoke.setShader(particleShaders.get(particleFeatures | ShaderVariants::ANALYTIC).id);
+            gpuParticles.setOrderIndependent(orderIndependent);
+            analyticSmoke.setOrderIndependent(orderIndependent);
+        }
+        // The query boxes are drawn for one eye only
+        if (stereoRig.getMode() != StereoRig::Mode::Off && occlusionQueries.getMode() != OcclusionQueries::Mode::Off) {
+            occlusionQueryMode = static_cast<int>(OcclusionQueries::Mode::Off);
+            occlusionQueries.setMode(OcclusionQueries::Mode::Off);
+        }
+        // === Stereo Mode end ===
 
-        glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+        // Rendering: the scene goes into the offscreen framebuffer at this frame's render scale
+        if (stereoRig.isBenchmarking()) {
+            // Keep the pixel count fixed while the stereo modes are compared
+        } else if (useDynamicResolution) {
+            dynamicResolution.update(mainPassTime.milliseconds(), sceneBudgetMs);
+        } else {
+            dynamicResolution.setScale(fixedRenderScale);
+        }
+        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+        dynamicResolution.beginFrame(framebufferWidth, framebufferHeight);
+
+        // With TAA every frame is rendered with a different sub-pixel offset (mono only: the history is
+        // reprojected with a single camera)
+        const bool temporalAA =
+                postAA.getMode() == PostAntiAliasing::Mode::TAA && stereoRig.getMode() == StereoRig::Mode::Off;
+        glm::mat4 projection = temporalAA
+                               ? postAA.jitterProjection(cameraProjection, dynamicResolution.getRenderSize())
+                               : cameraProjection;
         glm::mat4 view = glm::lookAt(cameraPos, lookAtPos, up);
-        glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-        glUniform3fv(viewPosLoc, 1, glm::value_ptr(cameraPos));
-        glUniform3fv(lightPosLoc, 1, glm::value_ptr(lightPos));
-
-        // === Draw Skybox ===
-        // Draw skybox as first object
-        glDepthFunc(GL_LEQUAL);
-        // Change depth function so depth test passes when values are equal to depth buffer's content
-        glUseProgram(skyboxProgram);
-        // Remove translation from the view matrix
-        glm::mat4 skyboxView = glm::mat4(glm::mat3(view));
-        glUniformMatrix4fv(glGetUniformLocation(skyboxProgram, "view"), 1, GL_FALSE, glm::value_ptr(skyboxView));
-        glUniformMatrix4fv(glGetUniformLocation(skyboxProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
-        // skybox cube
-        glBindVertexArray(skyboxVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubeMapTexture);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-        glDepthFunc(GL_LESS); // Set depth function back to default
-
-        glUseProgram(program);
-
-        glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-        glUniform3fv(viewPosLoc, 1, glm::value_ptr(cameraPos));
-        glUniform3fv(lightPosLoc, 1, glm::value_ptr(lightPos));
-        // === Draw Skybox end ===
-
-        // === Draw Windmill Main Body ===
-        // Main body Part 1 - Tower (Quadrangular Frustum)
-
-        glm::mat4 model = glm::mat4(1.0f);
-        // Rotate the tower (tetrahedron) and cube together around the Y-axis
-        model = glm::rotate(model, glm::radians(mainBodyAngle), glm::vec3(0.0f, 1.0f, 0.0f));
-
-        glm::mat3 normalMat = glm::transpose(glm::inverse(glm::mat3(model)));
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-        glUniformMatrix3fv(normalMatLoc, 1, GL_FALSE, glm::value_ptr(normalMat));
-        glUniform3f(objectColorLoc, 0.5f, 0.5f, 0.5f);
-
-        glUniform1i(useTextureLoc, 1); // Use texture
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, towerTexture);
-
-        glBindVertexArray(towerVAO);
-        glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(Geometry::towerIndices.size()), GL_UNSIGNED_INT, nullptr);
-
-        // Main body Part 2 - Cap (Cube)
-
-        // T_center * R_body
-        glm::mat4 baseTransform = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 10.0f, 0.0f));
-        baseTransform = glm::rotate(baseTransform, glm::radians(mainBodyAngle), glm::vec3(0.0f, 1.0f, 0.0f));
-        // T_center * R_body * S_cap
-        glm::mat4 capModel = glm::scale(baseTransform, glm::vec3(1.5f, 1.0f, 1.5f));
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(capModel));
-        glUniform3f(objectColorLoc, 0.42f, 0.48f, 0.85f);
-
-        glUniform1i(useTextureLoc, 1); // Use texture
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, capTexture);
-
-        glBindVertexArray(capVAO);
-        glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(Geometry::capIndices.size()), GL_UNSIGNED_INT, nullptr);
-        // === Draw Windmill Main Body end ===
-
-        // === Draw Blades ===
-        // Use color, not texture
-        glUniform1i(useTextureLoc, 0);
-
-        glUniform3f(objectColorLoc, 0.35f, 0.3f, 0.85f);
-        for (int i = 0; i < 4; ++i) {
-            glm::mat4 bladeModel = capModel;
-            // Translate to the center of the block's side, leaving a slight gap
-            bladeModel = glm::translate(bladeModel, glm::vec3(0.0f, 0.0f, 1.05f));
-            // Rotate the blade around the Z-axis
-            bladeModel = glm::rotate(bladeModel, glm::radians(bladeAngle + static_cast<float>(i) * 90.0f),
-                                     glm::vec3(0.0f, 0.0f, 1.0f));
-            normalMat = glm::transpose(glm::inverse(glm::mat3(bladeModel)));
-            glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(bladeModel));
-            glUniformMatrix3fv(normalMatLoc, 1, GL_FALSE, glm::value_ptr(normalMat));
-            glBindVertexArray(bladeVAO);
-            glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(Geometry::bladeIndices.size()), GL_UNSIGNED_INT, nullptr);
+        // Culling is done once for both eyes
+        const glm::mat4 cullingView = stereoRig.cullingView(view, cameraFovY, cameraAspect);
+        sceneUniforms.proj = projection;
+        sceneUniforms.view = view;
+        sceneUniforms.viewPos = cameraPos;
+        sceneUniforms.lightPos = lightPos;
+        // At night the sky light fades and the lanterns carry the scene
+        const float dayLight = nightMode ? 0.15f : 1.0f;
+        sceneUniforms.lightColor = glm::vec3(1.0f, 0.5f, 0.1f) * dayLight;
+        sceneUniforms.ambientColor = glm::vec3(0.76f, 0.64f, 0.23f) * dayLight;
+        sceneUniforms.stereoHalfSeparation = stereoRig.getHalfSeparation();
+        sceneUniforms.clusterGrid = lightClusters.gridSize();
+        sceneUniforms.clusterSliceScaleBias = lightClusters.sliceScaleBias();
+        // Lights are assigned once for both eyes, in the culling camera's frustum that contains them
+        sceneUniforms.clusterViewProjection = cameraProjection * cullingView;
+        if (useShadows) {
+            // Directional approximation of the controllable light, aimed at the foot of the windmill
+            shadowCascades.update(view, cameraFovY, cameraAspect, 0.1f, 60.0f, -lightPos,
+                                  shadowSceneBounds);
+            for (int c = 0; c < shadowCascades.getCascadeCount(); c++) {
+                sceneUniforms.shadowMatrices[c] = shadowCascades.getShadowMatrices()[c];
+            }
+            sceneUniforms.shadowSplits = shadowCascades.getSplits();
         }
-        // === Draw Blades end ===
-
-        // === Draw Hub ===
-        glm::mat4 hubModel = baseTransform;
-        hubModel = glm::translate(hubModel, glm::vec3(0.0f, 0.0f, 1.5f));
-
-        normalMat = glm::transpose(glm::inverse(glm::mat3(hubModel)));
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(hubModel));
-        glUniformMatrix3fv(normalMatLoc, 1, GL_FALSE, glm::value_ptr(normalMat));
-
-        // Hub cylinder color
-        glUniform3f(objectColorLoc, 0.1f, 0.1f, 0.05f);
-
-        glBindVertexArray(hubVAO);
-        glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(hubIndices.size()), GL_UNSIGNED_INT, nullptr);
-        // === Draw Hub end ===
-
-        // === Draw Chimney ===
-
-        // Set u_unlit to true (1) to disable lighting
-        glUniform1i(unlitLoc, 1);
-
-        // Use texture
-        glUniform1i(useTextureLoc, 1);
-
-        // Bind chimney texture
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, chimneyTexture);
-
-        // Create model matrix to position and scale the chimney
-        model = glm::mat4(1.0f);
-        // Move it back-left of the windmill and move it up so its base is on the ground plane
-        model = glm::translate(model, glm::vec3(-10.0f, 7.5f, -30.0f));
-        // Scaling
-        model = glm::scale(model, glm::vec3(0.8f, 15.0f, 0.8f));
-
-        normalMat = glm::transpose(glm::inverse(glm::mat3(model)));
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-        glUniformMatrix3fv(normalMatLoc, 1, GL_FALSE, glm::value_ptr(normalMat));
-
-        // Draw the chimney
-        glBindVertexArray(chimneyVAO);
-        glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(chimneyIndices.size()), GL_UNSIGNED_INT, nullptr);
-
-        // Set u_unlit back to false (0) for other objects
-        glUniform1i(unlitLoc, 0);
-        // === Draw Chimney end ===
-
-        // === Draw Trees ===
-        glUniform1i(unlitLoc, 0); // Ensure lighting is enabled
-        glUniform1i(useTextureLoc, 1); // Ensure textures are enabled
-
-        // --- Draw all instances of Tree A ---
-        for (const auto &pos: Geometry::treeA_positions) {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, pos);
-            model = glm::scale(model, glm::vec3(2.0f)); // Set scale
-
-            normalMat = glm::transpose(glm::inverse(glm::mat3(model)));
-            glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-            glUniformMatrix3fv(normalMatLoc, 1, GL_FALSE, glm::value_ptr(normalMat));
-
-            treeA_model.draw(program);
+        sceneUniforms.shadowCascadeCount = useShadows ? shadowCascades.getCascadeCount() : 0;
+        sceneShaders.setFrameUniforms(sceneUniforms);
+        lightBuffers.bind(ShaderVariants::LIGHT_BUFFER_UNIT);
+        shadowCascades.bind(ShaderVariants::SHADOW_MAP_UNIT);
+
+        // === Rasterize Occluders ===
+        if (useOcclusionCulling) {
+            const glm::mat4 towerTransform = Geometry::towerTransform(mainBodyAngle);
+            occlusionCuller.beginFrame(projection * cullingView);
+            occlusionCuller.addOccluder(towerOccluderPositions, Geometry::towerIndices, towerTransform);
+            occlusionCuller.addOccluder(cabinOccluder, cabinTransform);
+            for (const auto &transform: treeA_transforms) occlusionCuller.addOccluder(treeA_trunk, transform);
+            for (const auto &transform: treeB_transforms) occlusionCuller.addOccluder(treeB_trunk, transform);
+            occlusionCuller.rasterize();
         }
-
-        // --- Draw all instances of Tree B ---
-        for (const auto &pos: Geometry::treeB_positions) {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, pos);
-            model = glm::scale(model, glm::vec3(1.5f)); // Set scale
-
-            normalMat = glm::transpose(glm::inverse(glm::mat3(model)));
-            glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-            glUniformMatrix3fv(normalMatLoc, 1, GL_FALSE, glm::value_ptr(normalMat));
-
-            treeB_model.draw(program);
+        // Objects hidden behind the occluders are skipped before any GL call is made
+        auto isOccluded = [&](const AABB &localBounds, const glm::mat4 &transform) {
+            return useOcclusionCulling && !occlusionCuller.isVisible(localBounds.transformed(transform));
+        };
+        // === Rasterize Occluders end ===
+
+        // === Assign Clustered Lights ===
+        frameLights.assign(lanterns.begin(), lanterns.begin() + lanternCount);
+        for (int i = 0; i < lanternCount; i++) {
+            // Candle flicker
+            frameLights[i].color *= 0.85f + 0.15f * std::sin(currentTime * 7.0f + lanternPhases[i]);
+        }
+        lightClusters.assign(frameLights, cullingView);
+        lightBuffers.upload(frameLights, lightClusters);
+        // === Assign Clustered Lights end ===
+
+        // Cull the static chunks into indirect draw commands on the pool's background thread while the windmill is
+        // drawn
+        std::future<void> staticCommandsReady;
+        if (useStaticBatching) {
+            staticDrawList.instanceCount = static_cast<GLuint>(stereoRig.viewsPerDraw());
+            staticCommandsReady = threadPool.submit([&]() {
+                staticBatcher.buildCommands([&](const AABB &bounds) {
+                    return !useOcclusionCulling || occlusionCuller.isVisible(bounds);
+                }, staticDrawList);
+            });
         }
-        // === Draw Trees end ===
-
-        // === Draw Cabin ===
-        glUniform1i(unlitLoc, 0); // Ensure lighting is enabled
-        glUniform1i(useTextureLoc, 1); // Ensure textures are enabled
-
-        model = glm::mat4(1.0f);
-        // Positioning
-        model = glm::translate(model, glm::vec3(10.0f, 0.0f, -30.0f));
-
-        // Rotation (clockwise, around the Y-axis)
-        model = glm::rotate(model, glm::radians(-180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-
-        // Scaling
-        model = glm::scale(model, glm::vec3(0.4f));
-
-        normalMat = glm::transpose(glm::inverse(glm::mat3(model)));
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-        glUniformMatrix3fv(normalMatLoc, 1, GL_FALSE, glm::value_ptr(normalMat));
-
-        cabinModel.draw(program);
-        // === Draw Cabin end ===
-
-        // === Draw Benches ===
-        glUniform1i(unlitLoc, 0); // Ensure lighting is enabled
-        glUniform1i(useTextureLoc, 1); // Ensure textures are enabled
-
-        /*
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, pos);
-        model = glm::scale(model, glm::vec3(2.0f)); // Set scale
-
-        normalMat = glm::transpose(glm::inverse(glm::mat3(model)));
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-        glUniformMatrix3fv(normalMatLoc, 1, GL_FALSE, glm::value_ptr(normalMat));
-
-        treeA_model.draw(program);
-        */
-
-        // --- Bench 1 ---
-        model = glm::mat4(1.0f);
-        // Positioning
-        model = glm::translate(model, glm::vec3(6.0f, 0.0f, -12.0f));
-        // Scaling
-        model = glm::scale(model, glm::vec3(0.02f));
-
-        normalMat = glm::transpose(glm::inverse(glm::mat3(model)));
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-        glUniformMatrix3fv(normalMatLoc, 1, GL_FALSE, glm::value_ptr(normalMat));
-
-        benchModel.draw(program);
-
-        // --- Bench 2 ---
-        model = glm::mat4(1.0f);
-        // Positioning
-        model = glm::translate(model, glm::vec3(10.0f, 0.0f, -8.0f));
-        // Rotation (clockwise, around the Y-axis)
-        model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        // Scaling
-        model = glm::scale(model, glm::vec3(0.02f));
-
-        normalMat = glm::transpose(glm::inverse(glm::mat3(model)));
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-        glUniformMatrix3fv(normalMatLoc, 1, GL_FALSE, glm::value_ptr(normalMat));
-
-        benchModel.draw(program);
-
-        // === Draw Benches end ===
-
-
-        // === Draw Ground ===
-
-        // Use texture
-        glUniform1i(useTextureLoc, 1);
 
-        model = glm::mat4(1.0f); // Reset model matrix
-        // Move the ground plane up slightly to meet the base of the objects
-        model = glm::translate(model, glm::vec3(0.0f, 0.5f, 0.0f));
+        // Collect last frame's query results without waiting on the GPU
+        occlusionQueries.beginFrame();
+
+        // === Build Opaque Draw List ===
+        opaqueQueue.clear();
+        heavyQueue.clear();
+
+        // Windmill main body: the tower (quadrangular frustum) and cap (cube) rotate together around the Y-axis
+        const glm::mat4 towerModel = Geometry::towerTransform(mainBodyAngle);
+        const glm::mat4 capModel = Geometry::capTransform(mainBodyAngle);
+
+        DrawItem tower;
+        tower.vao = towerVAO;
+        tower.indexCount = static_cast<GLsizei>(Geometry::towerIndices.size());
+        tower.transform = towerModel;
+        tower.worldBounds = towerBounds.transformed(towerModel);
+        tower.texture = towerTexture;
+        tower.objectColor = glm::vec3(0.5f, 0.5f, 0.5f);
+        opaqueQueue.add(tower);
+
+        DrawItem cap;
+        cap.vao = capVAO;
+        cap.indexCount = static_cast<GLsizei>(Geometry::capIndices.size());
+        cap.transform = capModel;
+        cap.worldBounds = capBounds.transformed(capModel);
+        cap.texture = capTexture;
+        cap.objectColor = glm::vec3(0.42f, 0.48f, 0.85f);
+        opaqueQueue.add(cap);
+
+        // Blades use color, not texture
+        for (int i = 0; i < 4; ++i) {
+            const glm::mat4 bladeModel = Geometry::bladeTransform(mainBodyAngle, bladeAngle, i);
+            DrawItem blade;
+            blade.vao = bladeVAO;
+            blade.indexCount = static_cast<GLsizei>(Geometry::bladeIndices.size());
+            blade.transform = bladeModel;
+            blade.worldBounds = bladeBounds.transformed(bladeModel);
+            blade.useTexture = false;
+            blade.objectColor = glm::vec3(0.35f, 0.3f, 0.85f);
+            opaqueQueue.add(blade);
+        }
 
-        normalMat = glm::transpose(glm::inverse(glm::mat3(model)));
+        // Hub cylinder, in the center of the 4 blades
+        const glm::mat4 hubModel = Geometry::hubTransform(mainBodyAngle);
+        DrawItem hub;
+        hub.vao = hubVAO;
+        hub.indexCount = static_cast<GLsizei>(hubIndices.size());
+        hub.transform = hubModel;
+        hub.worldBounds = hubBounds.transformed(hubModel);
+        hub.useTexture = false;
+        hub.objectColor = glm::vec3(0.1f, 0.1f, 0.05f);
+        opaqueQueue.add(hub);
+
+        // Everything so far is the windmill, the only shadow caster that moves
+        dynamicCasters.clear();
+        for (const DrawItem &item: opaqueQueue.getItems()) dynamicCasters.add(item);
+
+        // Static scenery goes through the batcher instead when batching is on
+        if (!useStaticBatching) {
+            // Chimney is unlit
+            DrawItem chimney;
+            chimney.vao = chimneyVAO;
+            chimney.indexCount = static_cast<GLsizei>(chimneyIndices.size());
+            chimney.transform = chimneyTransform;
+            chimney.worldBounds = chimneyBounds.transformed(chimneyTransform);
+            chimney.texture = chimneyTexture;
+            chimney.unlit = true;
+            opaqueQueue.add(chimney);
+
+            // Cabin and benches have no textures of their own and are drawn with the chimney's stone texture
+            if (!isOccluded(cabinModel.bounds, cabinTransform)) {
+                DrawItem cabin;
+                cabin.model = &cabinModel;
+                cabin.transform = cabinTransform;
+                cabin.worldBounds = heavyWorldBounds[cabinQuery];
+                cabin.texture = chimneyTexture;
+                // With conditional render the cabin is the main occluder of the trees, so it has to be in the depth
+                // buffer before the queries and cannot be skipped by its own
+                if (occlusionQueries.getMode() == OcclusionQueries::Mode::Conditional) {
+                    opaqueQueue.add(cabin);
+                } else {
+                    cabin.occlusionQuery = cabinQuery;
+                    heavyQueue.add(cabin);
+                }
+            }
 
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-        glUniformMatrix3fv(normalMatLoc, 1, GL_FALSE, glm::value_ptr(normalMat));
+            for (const glm::mat4 &transform: {bench1Transform, bench2Transform}) {
+                if (isOccluded(benchModel.bounds, transform)) continue;
+                DrawItem bench;
+                bench.model = &benchModel;
+                bench.transform = transform;
+                bench.worldBounds = benchModel.bounds.transformed(transform);
+                bench.texture = chimneyTexture;
+                opaqueQueue.add(bench);
+            }
 
-        // Ground color
-        glUniform3f(objectColorLoc, 0.32f, 0.53f, 0.05f);
+            DrawItem ground;
+            ground.model = &groundModel;
+            ground.transform = groundTransform;
+            ground.worldBounds = groundModel.bounds.transformed(groundTransform);
+            ground.texture = groundTexture;
+            ground.objectColor = glm::vec3(0.32f, 0.53f, 0.05f);
+            opaqueQueue.add(ground);
+        }
 
-        // Bind ground texture
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, groundTexture);
+        // Trees: foliage takes the alpha-tested path. Like the cabin, they use the stone texture
+        if (useTreeInstancing && occlusionQueries.getMode() == OcclusionQueries::Mode::Off) {
+            // One instanced item per tree model, holding the instances that survived CPU culling
+            for (int t = 0; t < 2; t++) {
+                const Model &treeModel = t == 0 ? treeA_model : treeB_model;
+                const std::vector<glm::mat4> &transforms = t == 0 ? treeA_transforms : treeB_transforms;
+                const size_t queryBase = t == 0 ? 0 : treeA_transforms.size();
+                DrawItem trees;
+                trees.model = &treeModel;
+                trees.texture = chimneyTexture;
+                trees.alphaTested = true;
+                visibleTreeTransforms.clear();
+                for (size_t i = 0; i < transforms.size(); i++) {
+                    if (isOccluded(treeModel.bounds, transforms[i])) continue;
+                    visibleTreeTransforms.push_back(transforms[i]);
+                    trees.worldBounds.expand(heavyWorldBounds[queryBase + i]);
+                }
+                if (visibleTreeTransforms.empty()) continue;
+                glBindBuffer(GL_ARRAY_BUFFER, treeInstanceBuffers[t]);
+                glBufferData(GL_ARRAY_BUFFER, visibleTreeTransforms.size() * sizeof(glm::mat4),
+                             visibleTreeTransforms.data(), GL_STREAM_DRAW);
+                trees.instanceCount = static_cast<GLsizei>(visibleTreeTransforms.size());
+                opaqueQueue.add(trees);
+            }
+        } else {
+            for (size_t i = 0; i < treeA_transforms.size() + treeB_transforms.size(); i++) {
+                const bool isTreeA = i < treeA_transforms.size();
+                const Model &treeModel = isTreeA ? treeA_model : treeB_model;
+                const glm::mat4 &transform = isTreeA
+                                                 ? treeA_transforms[i]
+                                                 : treeB_transforms[i - treeA_transforms.size()];
+                if (isOccluded(treeModel.bounds, transform)) continue;
+                DrawItem tree;
+                tree.model = &treeModel;
+                tree.transform = transform;
+                tree.worldBounds = heavyWorldBounds[i];
+                tree.texture = chimneyTexture;
+                tree.alphaTested = true;
+                tree.occlusionQuery = static_cast<int>(i);
+                heavyQueue.add(tree);
+            }
+        }
 
-        // Draw the ground using the Model class
-        groundModel.draw(program);
-        // === Draw Ground end ===
+        // Nearest first, so early-z rejects what is hidden behind them
+        if (useFrontToBack) {
+            opaqueQueue.sortFrontToBack(cameraPos);
+            heavyQueue.sortFrontToBack(cameraPos);
+        }
+        // === Build Opaque Draw List end ===
 
-        // === Draw Particles ===
-        particleSystem.render(view, projection);
-        // === Draw Particles end ===
+        if (useStaticBatching) {
+            staticCommandsReady.get();
+        }
 
-        glBindVertexArray(0); // Swap buffer display
+        // Draws the selected particle simulation with one pass's view (both eyes in single-pass stereo)
+        auto drawParticles = [&](const glm::mat4 &passView) {
+            if (particleSimulation == 1) {
+                gpuParticles.render(passView, projection, stereoRig.viewsPerDraw(), stereoRig.getHalfSeparation());
+            } else if (particleSimulation == 2) {
+                analyticSmoke.render(passView, projection, stereoRig.viewsPerDraw(), stereoRig.getHalfSeparation());
+            } else {
+                particleSystem.render(passView, projection, stereoRig.viewsPerDraw(), stereoRig.getHalfSeparation());
+            }
+        };
+
+        // === Frame Graph ===
+        // The GPU work from here on is declared as passes. The graph drops the ones nothing reads (the shadow
+        // maps with shadows off) and lets transient targets with disjoint lifetimes share memory
+        renderGraph.reset();
+        const glm::ivec2 nativeSize = dynamicResolution.getNativeSize();
+        const int sceneSamples = antiAliasingMode == 3 ? MSAA_SAMPLES : 1;
+        RenderGraph::TextureDesc sceneTarget;
+        sceneTarget.width = nativeSize.x;
+        sceneTarget.height = nativeSize.y;
+        const RenderGraph::Resource backbuffer = renderGraph.import("backbuffer", 0, sceneTarget);
+        RenderGraph::TextureDesc shadowTarget;
+        shadowTarget.width = shadowTarget.height = shadowCascades.getResolution();
+        shadowTarget.format = GL_DEPTH_COMPONENT32F;
+        // Rendered layer by layer by ShadowCascades itself, so the graph only orders and culls it
+        const RenderGraph::Resource shadowMap =
+                renderGraph.import("shadowMap", shadowCascades.getTexture(), shadowTarget, false);
+
+        // === Shadow Pass ===
+        renderGraph.addPass(
+                "shadows",
+                [&](RenderGraph::Builder &pass) { pass.write(shadowMap); },
+                [&](const RenderGraph::Context &) {
+                    shadowPassTime.begin();
+                    if (!cacheStaticShadows) shadowCascades.invalidate();
+                    auto useLightMatrix = [&](const glm::mat4 &lightViewProj) {
+                        shadowUniforms.view = glm::mat4(1.0f);
+                        shadowUniforms.proj = lightViewProj;
+                        sceneShaders.setFrameUniforms(shadowUniforms);
+                    };
+                    shadowCascades.render(
+                        [&](int cascade, const glm::mat4 &lightViewProj) {
+                            useLightMatrix(lightViewProj);
+                            auto inCascade = [&](const AABB &bounds) {
+                                return shadowCascades.intersects(cascade, bounds);
+                            };
+                            staticBatcher.draw(sceneShaders, ShaderVariants::DEPTH_ONLY, inCascade);
+                            staticCasters.clear();
+                            for (const DrawItem &tree: treeCasters) {
+                                if (inCascade(tree.worldBounds)) staticCasters.add(tree);
+                            }
+                            staticCasters.draw(sceneShaders, ShaderVariants::DEPTH_ONLY, nullptr);
+                        },
+                        [&](int, const glm::mat4 &lightViewProj) {
+                            useLightMatrix(lightViewProj);
+                            dynamicCasters.draw(sceneShaders, ShaderVariants::DEPTH_ONLY, nullptr);
+                        });
+                    sceneShaders.setFrameUniforms(sceneUniforms);
+                    shadowPassTime.end();
+                });
+        // === Shadow Pass end ===
+
+        // === Main Pass ===
+        RenderGraph::Resource sceneColor = -1, sceneDepth = -1;
+        renderGraph.addPass(
+                "scene",
+                [&](RenderGraph::Builder &pass) {
+                    if (useShadows) pass.read(shadowMap);
+                    RenderGraph::TextureDesc color = sceneTarget;
+                    color.samples = sceneSamples;
+                    RenderGraph::TextureDesc depth = color;
+                    depth.format = GL_DEPTH_COMPONENT24;
+                    // Only TAA and the reduced-resolution particles sample the scene depth
+                    depth.renderbuffer = !temporalAA && !particlePasses;
+                    sceneColor = pass.create(sceneSamples > 1 ? "sceneColorMS" : "sceneColor", color);
+                    sceneDepth = pass.create(sceneSamples > 1 ? "sceneDepthMS" : "sceneDepth", depth);
+                    // Its occlusion queries decide next frame's draws
+                    pass.sideEffect();
+                },
+                [&](const RenderGraph::Context &) {
+                    if (useStaticBatching) {
+                        staticBatcher.upload(staticDrawList);
+                    }
+
+                    // The heavy models are drawn after everything else in both passes. Last-frame results are known
+                    // up front; conditional render needs this frame's queries, which are issued just before the heavy
+                    // models, against the depth of the rest of the scene, so a model never occludes its own query
+                    const bool conditionalQueries = occlusionQueries.getMode() == OcclusionQueries::Mode::Conditional;
+
+                    mainPassTime.begin();
+                    const auto submitStart = std::chrono::high_resolution_clock::now();
+                    sceneDrawCalls = 0;
+                    dynamicResolution.beginScene();
+                    const unsigned stereoFeatures = stereoRig.shaderFeatures();
+                    if (stereoFeatures) glEnable(GL_CLIP_DISTANCE0);
+                    for (int eye = 0; eye < stereoRig.passCount(); eye++) {
+                        // Two-pass stereo: the whole submission again, with the other eye's camera and viewport
+                        if (stereoRig.getMode() == StereoRig::Mode::TwoPass) {
+                            const glm::ivec4 viewport = stereoRig.passViewport(dynamicResolution.getRenderSize(), eye);
+                            glViewport(viewport.x, viewport.y, viewport.z, viewport.w);
+                            sceneUniforms.view = stereoRig.eyeView(view, eye);
+                            sceneShaders.setFrameUniforms(sceneUniforms);
+                        }
+                        const glm::mat4 passView = sceneUniforms.view;
+
+                        // === Depth Pre-Pass ===
+                        if (useDepthPrepass) {
+                            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+                            // DEPTH_ONLY permutations; opaque ones have no discard so early-z stays on
+                            opaqueQueue.draw(sceneShaders, ShaderVariants::DEPTH_ONLY | stereoFeatures, nullptr,
+                                             RenderQueue::Filter::Opaque);
+                            sceneDrawCalls += opaqueQueue.getStats().drawn;
+                            if (useStaticBatching) {
+                                staticBatcher.submit(sceneShaders, ShaderVariants::DEPTH_ONLY | stereoFeatures,
+                                                     staticDrawList);
+                                sceneDrawCalls += staticBatcher.getStats().drawCalls;
+                            }
+
+                            // Leaves: the ALPHA_TEST permutation discards where the texture is transparent
+                            opaqueQueue.draw(sceneShaders, ShaderVariants::DEPTH_ONLY | stereoFeatures, nullptr,
+                                             RenderQueue::Filter::AlphaTested);
+                            sceneDrawCalls += opaqueQueue.getStats().drawn;
+
+                            // Everything but the heavy models is in the depth buffer; query them against it, then
+                            // add the ones that pass to the pre-pass
+                            if (conditionalQueries) {
+                                occlusionQueries.issueQueries(heavyWorldBounds, projection * view, cameraPos);
+                                glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+                            }
+                            heavyQueue.draw(sceneShaders, ShaderVariants::DEPTH_ONLY | stereoFeatures,
+                                            &occlusionQueries, RenderQueue::Filter::Opaque);
+                            sceneDrawCalls += heavyQueue.getStats().drawn;
+                            heavyQueue.draw(sceneShaders, ShaderVariants::DEPTH_ONLY | stereoFeatures,
+                                            &occlusionQueries, RenderQueue::Filter::AlphaTested);
+                            sceneDrawCalls += heavyQueue.getStats().drawn;
+
+                            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+                        }
+                        // === Depth Pre-Pass end ===
+
+                        // === Draw Opaque Scene ===
+                        // Occlusion queries of any kind cannot overlap the samples counter, so conditional queries
+                        // issued in the middle of the colour pass (no pre-pass) leave it unmeasured. Two-pass stereo
+                        // would count twice per frame, so it is not measured either
+                        const bool countSamples =
+                                stereoRig.passCount() == 1 && (useDepthPrepass || !conditionalQueries);
+                        if (countSamples) shadedSamples.begin();
+                        // After a pre-pass only the nearest surface passes the depth test, so each pixel is shaded
+                        // once
+                        glDepthFunc(useDepthPrepass ? GL_LEQUAL : GL_LESS);
+
+                        opaqueQueue.draw(sceneShaders, stereoFeatures, nullptr, RenderQueue::Filter::Opaque);
+                        sceneDrawCalls += opaqueQueue.getStats().drawn;
+                        if (useStaticBatching) {
+                            staticBatcher.submit(sceneShaders, stereoFeatures, staticDrawList);
+                            sceneDrawCalls += staticBatcher.getStats().drawCalls;
+                        }
+                        opaqueQueue.draw(sceneShaders, stereoFeatures, nullptr, RenderQueue::Filter::AlphaTested);
+                        sceneDrawCalls += opaqueQueue.getStats().drawn;
+
+                        // Without a pre-pass, the rest of the opaque scene is the occluders for the conditional
+                        // queries
+                        if (!useDepthPrepass && conditionalQueries) {
+                            occlusionQueries.issueQueries(heavyWorldBounds, projection * view, cameraPos);
+                        }
+
+                        if (stereoRig.passCount() == 1) heavyPrimitives.begin();
+                        heavyQueue.draw(sceneShaders, stereoFeatures, &occlusionQueries, RenderQueue::Filter::Opaque);
+                        sceneDrawCalls += heavyQueue.getStats().drawn;
+                        heavyQueue.draw(sceneShaders, stereoFeatures, &occlusionQueries,
+                                        RenderQueue::Filter::AlphaTested);
+                        sceneDrawCalls += heavyQueue.getStats().drawn;
+                        if (stereoRig.passCount() == 1) heavyPrimitives.end();
+                        // === Draw Opaque Scene end ===
+
+                        // === Draw Skybox ===
+                        // Into the framebuffer and eye viewport the graph and stereo set up (a pass without
+                        // attachments); translation is removed from the view matrix
+                        const SkyboxConstants skyboxConstants{glm::mat4(glm::mat3(passView)), projection};
+                        skyboxCommands->begin();
+                        skyboxCommands->beginRenderPass(RenderPassDesc());
+                        skyboxCommands->bindPipeline(stereoFeatures ? skyboxStereoPipeline : skyboxPipeline);
+                        skyboxCommands->bindVertexBuffer(skyboxBuffer);
+                        skyboxCommands->bindTexture(0, skyboxTexture);
+                        skyboxCommands->pushConstants(&skyboxConstants, sizeof(skyboxConstants));
+                        skyboxCommands->draw(36, static_cast<uint32_t>(stereoRig.viewsPerDraw()));
+                        skyboxCommands->endRenderPass();
+                        skyboxCommands->end();
+                        renderDevice.submit({skyboxCommands.get()});
+                        sceneDrawCalls++;
+                        if (countSamples) shadedSamples.end();
+                        // === Draw Skybox end ===
+
+                        // === Occlusion Queries (last frame) ===
+                        // Issued against the complete opaque scene; the results decide next frame's submissions
+                        if (occlusionQueries.getMode() == OcclusionQueries::Mode::Latent) {
+                            occlusionQueries.issueQueries(heavyWorldBounds, projection * view, cameraPos);
+                        }
+
+                        // === Draw Particles ===
+                        // At full resolution only; otherwise the reduced-resolution passes below draw them
+                        if (!particlePasses) {
+                            if (stereoRig.passCount() == 1) particleSamples.begin();
+                            drawParticles(passView);
+                            if (stereoRig.passCount() == 1) particleSamples.end();
+                            sceneDrawCalls++;
+                        }
+                        // === Draw Particles end ===
+                    }
+                    if (stereoFeatures) glDisable(GL_CLIP_DISTANCE0);
+                    sceneUniforms.view = view;
+                    sceneSubmitMs = std::chrono::duration<double, std::milli>(
+                            std::chrono::high_resolution_clock::now() - submitStart).count();
+                    mainPassTime.end();
+                });
+        // === Main Pass end ===
+
+        // === Reduced-Resolution Particles ===
+        // The scene depth is reduced to the particle resolution, the particles are drawn against it into a
+        // transparent target, and a depth-aware upsample blends them over the scene colour. Order independent,
+        // they are drawn into accumulation and revealage targets instead, which a resolve turns into that target
+        const glm::ivec2 renderSize = dynamicResolution.getRenderSize();
+        const glm::ivec2 lowSize = offscreenParticles.reducedSize(nativeSize);
+        RenderGraph::Resource particleSceneDepth = sceneDepth, lowDepth = -1, lowDistance = -1, lowColor = -1;
+        RenderGraph::Resource lowAccumulation = -1, lowRevealage = -1;
+        if (particlePasses) {
+            RenderGraph::TextureDesc lowTarget = sceneTarget;
+            lowTarget.width = lowSize.x;
+            lowTarget.height = lowSize.y;
+            RenderGraph::TextureDesc lowDepthTarget = lowTarget;
+            lowDepthTarget.format = GL_DEPTH_COMPONENT24;
+            RenderGraph::TextureDesc lowDistanceTarget = lowTarget;
+            lowDistanceTarget.format = GL_R32F;
+
+            // The multisampled depth is a renderbuffer; the passes below sample one depth per pixel
+            if (sceneSamples > 1) {
+                const RenderGraph::Resource multisampledDepth = sceneDepth;
+                renderGraph.addPass(
+                        "particleDepthResolve",
+                        [&](RenderGraph::Builder &pass) {
+                            pass.read(multisampledDepth);
+                            RenderGraph::TextureDesc resolved = sceneTarget;
+                            resolved.format = GL_DEPTH_COMPONENT24;
+                            particleSceneDepth = pass.create("sceneDepthResolved", resolved);
+                        },
+                        [&, multisampledDepth](const RenderGraph::Context &graph) {
+                            const GLuint target = graph.framebuffer({particleSceneDepth});
+                            glBindFramebuffer(GL_READ_FRAMEBUFFER, graph.framebuffer({multisampledDepth}));
+                            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target);
+                            glBlitFramebuffer(0, 0, renderSize.x, renderSize.y, 0, 0, renderSize.x, renderSize.y,
+                                              GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+                        });
+            }
 
+            renderGraph.addPass(
+                    "particleDepth",
+                    [&](RenderGraph::Builder &pass) {
+                        pass.read(particleSceneDepth);
+                        lowDistance = pass.create("particleDistance", lowDistanceTarget);
+                        lowDepth = pass.create("particleDepth", lowDepthTarget);
+                    },
+                    [&](const RenderGraph::Context &graph) {
+                        particlePassTime.begin();
+                        offscreenParticles.downsampleDepth(graph.texture(particleSceneDepth), renderSize);
+                    });
+            renderGraph.addPass(
+                    "particles",
+                    [&](RenderGraph::Builder &pass) {
+                        if (orderIndependent) {
+                            RenderGraph::TextureDesc accumulationTarget = lowTarget;
+                            accumulationTarget.format = GL_RGBA16F;
+                            RenderGraph::TextureDesc revealageTarget = lowTarget;
+                            revealageTarget.format = GL_R8;
+                            lowAccumulation = pass.create("particleAccumulation", accumulationTarget);
+                            lowRevealage = pass.create("particleRevealage", revealageTarget);
+                        } else {
+                            lowColor = pass.create("particleColor", lowTarget);
+                        }
+                        pass.write(lowDepth);
+                        pass.read(lowDistance);
+                    },
+                    [&](const RenderGraph::Context &graph) {
+                        if (orderIndependent) {
+                            WeightedOit::clearTargets();
+                        } else {
+                            const GLfloat transparent[] = {0.0f, 0.0f, 0.0f, 0.0f};
+                            glClearBufferfv(GL_COLOR, 0, transparent);
+                        }
+                        if (particleFeatures & ShaderVariants::SOFT) {
+                            const unsigned analytic = particleSimulation == 2 ? ShaderVariants::ANALYTIC : 0u;
+                            offscreenParticles.prepareSoftParticles(
+                                    particleShaders.get(particleFeatures | analytic).id, graph.texture(lowDistance),
+                                    lowSize, softParticleDistance);
+                        }
+                        const unsigned stereoFeatures = stereoRig.shaderFeatures();
+                        if (stereoFeatures) glEnable(GL_CLIP_DISTANCE0);
+                        particleSamples.begin();
+                        for (int eye = 0; eye < stereoRig.passCount(); eye++) {
+                            const glm::ivec2 lowRenderSize = offscreenParticles.reducedSize(renderSize);
+                            if (stereoRig.getMode() == StereoRig::Mode::TwoPass) {
+                                const glm::ivec4 viewport = stereoRig.passViewport(lowRenderSize, eye);
+                                glViewport(viewport.x, viewport.y, viewport.z, viewport.w);
+                            } else {
+                                glViewport(0, 0, lowRenderSize.x, lowRenderSize.y);
+                            }
+                            drawParticles(stereoRig.getMode() == StereoRig::Mode::TwoPass
+                                                  ? stereoRig.eyeView(view, eye) : view);
+                            sceneDrawCalls++;
+                        }
+                        particleSamples.end();
+                        if (stereoFeatures) glDisable(GL_CLIP_DISTANCE0);
+                    });
+            if (orderIndependent) {
+                renderGraph.addPass(
+                        "particleResolve",
+                        [&](RenderGraph::Builder &pass) {
+                            pass.read(lowAccumulation);
+                            pass.read(lowRevealage);
+                            lowColor = pass.create("particleColor", lowTarget);
+                        },
+                        [&](const RenderGraph::Context &graph) {
+                            const glm::ivec2 lowRenderSize = offscreenParticles.reducedSize(renderSize);
+                            weightedOit.resolve(graph.texture(lowAccumulation), graph.texture(lowRevealage),
+                                                lowRenderSize.x, lowRenderSize.y);
+                        });
+            }
+            renderGraph.addPass(
+                    "particleComposite",
+                    [&](RenderGraph::Builder &pass) {
+                        pass.read(lowColor);
+                        pass.read(lowDistance);
+                        pass.read(particleSceneDepth);
+                        pass.write(sceneColor);
+                    },
+                    [&](const RenderGraph::Context &graph) {
+                        offscreenParticles.composite(graph.texture(lowColor), graph.texture(lowDistance),
+                                                     graph.texture(particleSceneDepth), renderSize);
+                        particlePassTime.end();
+                    });
+        }
+        // === Reduced-Resolution Particles end ===
+
+        // === Anti-Aliasing ===
+        // MSAA resolves into a single-sampled target; FXAA and TAA read the scene and write a new image.
+        // At most one of them runs per frame, timed by the same counter
+        if (sceneSamples > 1) {
+            const RenderGraph::Resource multisampled = sceneColor;
+            renderGraph.addPass(
+                    "resolve",
+                    [&](RenderGraph::Builder &pass) {
+                        pass.read(multisampled);
+                        sceneColor = pass.create("sceneColor", sceneTarget);
+                    },
+                    [&, multisampled](const RenderGraph::Context &graph) {
+                        antiAliasingTime.begin();
+                        const glm::ivec2 size = dynamicResolution.getRenderSize();
+                        glBindFramebuffer(GL_READ_FRAMEBUFFER, graph.framebuffer({multisampled}));
+                        glBlitFramebuffer(0, 0, size.x, size.y, 0, 0, size.x, size.y, GL_COLOR_BUFFER_BIT,
+                                          GL_NEAREST);
+                        antiAliasingTime.end();
+                    });
+        }
+        RenderGraph::Resource antiAliased = sceneColor;
+        if (postAA.getMode() == PostAntiAliasing::Mode::FXAA || temporalAA) {
+            const bool temporal = temporalAA;
+            const RenderGraph::Resource input = sceneColor, inputDepth = sceneDepth;
+            RenderGraph::Resource history = -1, historyTarget = -1;
+            if (temporal) {
+                // The history outlives the frame, so it is imported rather than transient
+                postAA.prepareHistory(nativeSize);
+                RenderGraph::TextureDesc historyDesc = sceneTarget;
+                historyDesc.format = GL_RGBA16F;
+                history = renderGraph.import("taaHistory", postAA.getHistory(), historyDesc);
+                historyTarget = renderGraph.import("taaOutput", postAA.getHistoryTarget(), historyDesc);
+            }
+            renderGraph.addPass(
+                    temporal ? "taa" : "fxaa",
+                    [&](RenderGraph::Builder &pass) {
+                        pass.read(input);
+                        if (temporal) {
+                            pass.read(inputDepth);
+                            pass.read(history);
+                            pass.write(historyTarget);
+                            antiAliased = historyTarget;
+                        } else {
+                            antiAliased = pass.create("fxaaOutput", sceneTarget);
+                        }
+                    },
+                    [&, temporal, input, inputDepth](const RenderGraph::Context &graph) {
+                        antiAliasingTime.begin();
+                        postAA.apply(graph.texture(input), temporal ? graph.texture(inputDepth) : 0,
+                                     dynamicResolution.getRenderSize(), nativeSize, cameraProjection * view);
+                        antiAliasingTime.end();
+                    });
+        }
+        // === Anti-Aliasing end ===
+
+        // Back to native resolution: upscale the scene into the window
+        const RenderGraph::Resource presented = antiAliased;
+        renderGraph.addPass(
+                "present",
+                [&](RenderGraph::Builder &pass) {
+                    pass.read(presented);
+                    pass.write(backbuffer);
+                    pass.sideEffect();
+                },
+                [&, presented](const RenderGraph::Context &graph) {
+                    glBindVertexArray(0);
+                    // Nothing is upscaled at full scale, so the image goes through unsharpened
+                    dynamicResolution.present(graph.texture(presented),
+                                              dynamicResolution.getScale() < 1.0f ? upscaleSharpness : 0.0f);
+                });
+
+        renderGraph.compile();
+        if (renderGraph.layoutChanged()) renderGraph.report();
+        renderGraph.execute();
+        // === Frame Graph end ===
+        StereoRig::Sample stereoSample;
+        stereoSample.submitMs = sceneSubmitMs;
+        stereoSample.gpuMs = mainPassTime.milliseconds();
+        stereoSample.drawCalls = sceneDrawCalls;
+        stereoRig.record(stereoSample);
+        antiAliasingCost[antiAliasingMode] =
+                mainPassTime.milliseconds() + (antiAliasingMode != 0 ? antiAliasingTime.milliseconds() : 0.0);
+
+        // ImGui on top of the upscaled scene
         ImGui::Render();
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
@@ -1020,8 +1866,9 @@ int main() {
     glDeleteVertexArrays(1, &hubVAO);
     glDeleteBuffers(1, &hubVBO);
     glDeleteBuffers(1, &hubEBO);
-    glDeleteVertexArrays(1, &skyboxVAO);
-    glDeleteBuffers(1, &skyboxVBO);
+    // The device's objects go with it, the cube map texture is the application's
+    skyboxCommands.reset();
+    glDeleteTextures(1, &cubeMapTexture);
     glDeleteVertexArrays(1, &chimneyVAO);
     glDeleteBuffers(1, &chimneyVBO);
     glDeleteBuffers(1, &chimneyEBO);
@@ -1030,11 +1877,8 @@ int main() {
     glDeleteTextures(1, &towerTexture);
     glDeleteTextures(1, &capTexture);
     glDeleteTextures(1, &chimneyTexture);
-    glDeleteTextures(1, &particleTexture);
 
-    glDeleteProgram(program);
-    glDeleteProgram(skyboxProgram);
-    glDeleteProgram(particleProgram);
+    glDeleteBuffers(2, treeInstanceBuffers);
 
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
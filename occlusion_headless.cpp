@@ -0,0 +1,200 @@
+// Benchmark scene and regression test for OcclusionCuller, without a window or GPU. The scene's occluder set (the
+// tower mesh, the box inside the cabin and the tree trunks, as main.cpp builds them) is rasterized from a few fixed
+// cameras, every tree, the cabin and both benches are tested against it, and the results are compared with the
+// ones known for those views. Raster and test times are then measured single threaded and on the pool.
+//   occlusion_headless [--runs <count>] [--threads <count>]
+// Exits with 1 when a visibility result differs. Run from the build directory, where the objects are copied.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "bounds.h"
+#include "geometry.h"
+#include "occlusion.h"
+#include "thread_pool.h"
+
+namespace {
+    // Box around an OBJ file's vertex positions: the Model bounds main.cpp uses, without Assimp
+    AABB objBounds(const std::string &path) {
+        AABB box;
+        std::ifstream file(path);
+        if (!file) {
+            std::cout << "ERROR::OCCLUSION_HEADLESS::FILE_NOT_READ " << path << std::endl;
+            return box;
+        }
+        std::string line;
+        while (std::getline(file, line)) {
+            if (line.size() < 2 || line[0] != 'v' || line[1] != ' ') continue;
+            std::istringstream stream(line.substr(2));
+            glm::vec3 position;
+            if (stream >> position.x >> position.y >> position.z) box.expand(position);
+        }
+        return box;
+    }
+
+    // Lower part of the trunk only, as in main.cpp: foliage is far from solid
+    AABB trunkOccluder(const AABB &treeBounds) {
+        glm::vec3 c = treeBounds.center();
+        glm::vec3 e = treeBounds.extents();
+        float trunkTop = treeBounds.min.y + (treeBounds.max.y - treeBounds.min.y) * 0.35f;
+        return {glm::vec3(c.x - e.x * 0.05f, treeBounds.min.y, c.z - e.z * 0.05f),
+                glm::vec3(c.x + e.x * 0.05f, trunkTop, c.z + e.z * 0.05f)};
+    }
+
+    struct Scene {
+        std::vector<glm::vec3> towerPositions;
+        AABB cabinOccluder, treeA_trunk, treeB_trunk;
+        std::vector<glm::mat4> treeA_transforms, treeB_transforms;
+        std::vector<std::string> names;  // Tested objects: trees A, trees B, cabin, benches
+        std::vector<AABB> objectBounds;  // World space
+    };
+
+    bool loadScene(Scene &scene) {
+        const AABB treeA = objBounds("objects/Tree_A/Tree.obj");
+        const AABB treeB = objBounds("objects/Tree_B/Tree.obj");
+        const AABB cabin = objBounds("objects/Cabin/farmhouse_obj.obj");
+        const AABB bench = objBounds("objects/Bench/Bench_HighRes.obj");
+        if (treeA.isEmpty() || treeB.isEmpty() || cabin.isEmpty() || bench.isEmpty()) return false;
+
+        for (size_t i = 0; i + 2 < Geometry::towerVertices.size(); i += 8) {
+            scene.towerPositions.emplace_back(Geometry::towerVertices[i], Geometry::towerVertices[i + 1],
+                                              Geometry::towerVertices[i + 2]);
+        }
+        scene.cabinOccluder = cabin.scaled(glm::vec3(0.8f));
+        scene.treeA_trunk = trunkOccluder(treeA);
+        scene.treeB_trunk = trunkOccluder(treeB);
+
+        for (size_t i = 0; i < Geometry::treeA_positions.size(); i++) {
+            scene.treeA_transforms.push_back(Geometry::treeTransform(Geometry::treeA_positions[i],
+                                                                     Geometry::treeA_scale));
+            scene.names.push_back("treeA" + std::to_string(i));
+            scene.objectBounds.push_back(treeA.transformed(scene.treeA_transforms.back()));
+        }
+        for (size_t i = 0; i < Geometry::treeB_positions.size(); i++) {
+            scene.treeB_transforms.push_back(Geometry::treeTransform(Geometry::treeB_positions[i],
+                                                                     Geometry::treeB_scale));
+            scene.names.push_back("treeB" + std::to_string(i));
+            scene.objectBounds.push_back(treeB.transformed(scene.treeB_transforms.back()));
+        }
+        scene.names.push_back("cabin");
+        scene.objectBounds.push_back(cabin.transformed(Geometry::cabinTransform()));
+        scene.names.push_back("bench1");
+        scene.objectBounds.push_back(bench.transformed(Geometry::bench1Transform()));
+        scene.names.push_back("bench2");
+        scene.objectBounds.push_back(bench.transformed(Geometry::bench2Transform()));
+        return true;
+    }
+
+    void addOccluders(OcclusionCuller &culler, const Scene &scene, const glm::mat4 &viewProjection) {
+        culler.beginFrame(viewProjection);
+        culler.addOccluder(scene.towerPositions, Geometry::towerIndices, Geometry::towerTransform(0.0f));
+        culler.addOccluder(scene.cabinOccluder, Geometry::cabinTransform());
+        for (const auto &transform: scene.treeA_transforms) culler.addOccluder(scene.treeA_trunk, transform);
+        for (const auto &transform: scene.treeB_transforms) culler.addOccluder(scene.treeB_trunk, transform);
+    }
+
+    struct View {
+        const char *name;
+        glm::vec3 position, target;
+        // Objects known to be culled from this view (hidden or off-screen); all others must be visible
+        std::vector<std::string> culled;
+    };
+
+    double elapsedMs(std::chrono::high_resolution_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+}
+
+int main(int argc, char **argv) {
+    int runs = 200;
+    int maxThreads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--runs" && i + 1 < argc) runs = std::max(std::atoi(argv[++i]), 1);
+        else if (arg == "--threads" && i + 1 < argc) maxThreads = std::max(std::atoi(argv[++i]), 1);
+        else {
+            std::cout << "Usage: " << argv[0] << " [--runs <count>] [--threads <count>]" << std::endl;
+            return 2;
+        }
+    }
+
+    Scene scene;
+    if (!loadScene(scene)) return 1;
+
+    // The windowed renderer's projection and starting camera, then views with a known answer: from behind the
+    // cabin, which hides both benches, from just in front of the tower, and from high above, where nothing is hidden.
+    // Expected results were checked by casting rays from the camera to each box's surface against the occluders.
+    const glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+    const std::vector<View> views = {
+        {"start", glm::vec3(0.0f, 6.5f, 20.0f), glm::vec3(0.0f, 6.5f, 0.0f), {"treeA7", "treeB3", "treeB6"}},
+        {"cabin", glm::vec3(10.0f, 3.0f, -70.0f), glm::vec3(10.0f, 3.0f, 0.0f),
+         {"treeA1", "treeB0", "treeB2", "treeB7", "bench1", "bench2"}},
+        {"tower", glm::vec3(0.0f, 5.0f, 12.0f), glm::vec3(0.0f, 5.0f, -20.0f),
+         {"treeA7", "treeB1", "treeB3", "treeB6"}},
+        {"above", glm::vec3(0.0f, 90.0f, -20.0f), glm::vec3(0.0f, 0.0f, -21.0f), {}},
+    };
+
+    ThreadPool pool(static_cast<unsigned int>(maxThreads));
+    OcclusionCuller culler(256, 128, &pool);
+    int failures = 0;
+    for (const View &view: views) {
+        const glm::mat4 viewProjection =
+                projection * glm::lookAt(view.position, view.target, glm::vec3(0.0f, 1.0f, 0.0f));
+        addOccluders(culler, scene, viewProjection);
+        culler.rasterize();
+        std::string culledList;
+        for (size_t i = 0; i < scene.objectBounds.size(); i++) {
+            const bool visible = culler.isVisible(scene.objectBounds[i]);
+            const bool expectCulled =
+                    std::find(view.culled.begin(), view.culled.end(), scene.names[i]) != view.culled.end();
+            if (!visible) culledList += " " + scene.names[i];
+            if (visible == expectCulled) {
+                std::cout << "FAIL " << view.name << ": " << scene.names[i] << " is "
+                        << (visible ? "visible" : "culled") << ", expected "
+                        << (expectCulled ? "culled" : "visible") << std::endl;
+                failures++;
+            }
+        }
+        std::cout << view.name << ": culled" << (culledList.empty() ? " nothing" : culledList) << std::endl;
+    }
+
+    // Timings from the starting view: rasterizing the occluders, then testing every object
+    const glm::mat4 startViewProjection =
+            projection * glm::lookAt(views[0].position, views[0].target, glm::vec3(0.0f, 1.0f, 0.0f));
+    std::printf("%7s | %10s %10s | %zu objects, %d runs\n", "threads", "raster ms", "test ms",
+                scene.objectBounds.size(), runs);
+    for (int threads = 1;; threads = std::min(threads * 2, maxThreads)) {
+        ThreadPool timedPool(static_cast<unsigned int>(threads));
+        OcclusionCuller timed(256, 128, threads > 1 ? &timedPool : nullptr);
+        double rasterMs = 0.0, testMs = 0.0;
+        int visibleCount = 0;
+        for (int run = 0; run < runs; run++) {
+            auto start = std::chrono::high_resolution_clock::now();
+            addOccluders(timed, scene, startViewProjection);
+            timed.rasterize();
+            rasterMs += elapsedMs(start);
+            start = std::chrono::high_resolution_clock::now();
+            for (const AABB &bounds: scene.objectBounds) visibleCount += timed.isVisible(bounds) ? 1 : 0;
+            testMs += elapsedMs(start);
+        }
+        std::printf("%7d | %10.4f %10.4f | %d triangles, %d visible\n", threads, rasterMs / runs, testMs / runs,
+                    timed.getStats().occluderTriangles, visibleCount / runs);
+        if (threads == maxThreads) break;
+    }
+
+    if (failures > 0) {
+        std::cout << failures << " visibility result(s) differ" << std::endl;
+        return 1;
+    }
+    std::cout << "All visibility results match" << std::endl;
+    return 0;
+}
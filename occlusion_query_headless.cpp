@@ -0,0 +1,275 @@
+// GL test for OcclusionQueries in the order main.cpp's main pass uses them. A box stands in for the cabin, with a
+// "heavy model" (a finely tessellated quad) hidden behind it and a second one beside it. The occluder goes into the
+// depth buffer first, the queries are issued against it, and the heavy models' pre-pass and colour draws follow
+// inside their queries. GL_PRIMITIVES_GENERATED around each heavy draw must then be zero for the hidden model and the
+// full triangle count for the visible one, with and without a pre-pass and with last-frame results. The order the
+// pass had before (heavy models in the pre-pass ahead of the queries) is rendered too, to show that it pays for them.
+// Needs an OpenGL 4.1 context from EGL's surfaceless platform (see HeadlessGL); llvmpipe is enough.
+//   occlusion_query_headless [--grid <cells per side>]
+// Exits with 1 when a check fails. Run from the build directory, where the shaders are copied.
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "headless_gl.h"
+#include "occlusion_query.h"
+#include "shader_variants.h"
+
+namespace {
+    constexpr int TARGET_SIZE = 256;
+    enum Object { HIDDEN = 0, BESIDE = 1, OBJECT_COUNT = 2 };
+
+    int failures = 0;
+
+    void check(bool condition, const std::string &what) {
+        if (condition) return;
+        if (failures < 20) std::cout << "FAIL " << what << std::endl;
+        failures++;
+    }
+
+    struct Mesh {
+        GLuint vao = 0, vbo = 0, ebo = 0;
+        GLsizei indexCount = 0;
+
+        void upload(const std::vector<glm::vec3> &positions, const std::vector<GLuint> &indices) {
+            glGenVertexArrays(1, &vao);
+            glGenBuffers(1, &vbo);
+            glGenBuffers(1, &ebo);
+            glBindVertexArray(vao);
+            glBindBuffer(GL_ARRAY_BUFFER, vbo);
+            glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(positions.size() * sizeof(glm::vec3)),
+                         positions.data(), GL_STATIC_DRAW);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(indices.size() * sizeof(GLuint)),
+                         indices.data(), GL_STATIC_DRAW);
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), static_cast<void *>(nullptr));
+            glBindVertexArray(0);
+            indexCount = static_cast<GLsizei>(indices.size());
+        }
+
+        void release() {
+            glDeleteVertexArrays(1, &vao);
+            glDeleteBuffers(1, &vbo);
+            glDeleteBuffers(1, &ebo);
+        }
+    };
+
+    // Unit cube, the occluder
+    Mesh makeCube() {
+        std::vector<glm::vec3> positions;
+        for (int i = 0; i < 8; i++) positions.emplace_back(i & 1, (i >> 1) & 1, (i >> 2) & 1);
+        const std::vector<GLuint> indices = {
+            0, 1, 3, 0, 3, 2, 4, 6, 7, 4, 7, 5, 0, 4, 5, 0, 5, 1,
+            2, 3, 7, 2, 7, 6, 0, 2, 6, 0, 6, 4, 1, 5, 7, 1, 7, 3,
+        };
+        Mesh mesh;
+        mesh.upload(positions, indices);
+        return mesh;
+    }
+
+    // Quad across the middle of the unit cube, split into grid x grid cells: expensive to draw, cheap to bound
+    Mesh makeHeavyMesh(int grid) {
+        std::vector<glm::vec3> positions;
+        std::vector<GLuint> indices;
+        for (int y = 0; y <= grid; y++) {
+            for (int x = 0; x <= grid; x++) {
+                positions.emplace_back(static_cast<float>(x) / grid, static_cast<float>(y) / grid, 0.5f);
+            }
+        }
+        for (int y = 0; y < grid; y++) {
+            for (int x = 0; x < grid; x++) {
+                const GLuint corner = y * (grid + 1) + x;
+                const GLuint above = corner + grid + 1;
+                for (GLuint index: {corner, corner + 1, above + 1, corner, above + 1, above}) indices.push_back(index);
+            }
+        }
+        Mesh mesh;
+        mesh.upload(positions, indices);
+        return mesh;
+    }
+
+    struct Scene {
+        GLuint program = 0;
+        GLint mvpLocation = -1;
+        Mesh cube, heavy;
+        glm::mat4 viewProjection;
+        glm::vec3 cameraPosition = glm::vec3(0.0f);
+        glm::mat4 occluderTransform;
+        glm::mat4 heavyTransforms[OBJECT_COUNT];
+        std::vector<AABB> heavyBounds;
+        GLuint primitiveQueries[2][OBJECT_COUNT]; // Per pass (pre-pass, colour) and heavy model
+    };
+
+    void drawMesh(const Scene &scene, const Mesh &mesh, const glm::mat4 &transform) {
+        glUseProgram(scene.program);
+        glUniformMatrix4fv(scene.mvpLocation, 1, GL_FALSE, glm::value_ptr(scene.viewProjection * transform));
+        glBindVertexArray(mesh.vao);
+        glDrawElements(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_INT, nullptr);
+    }
+
+    // The heavy models as RenderQueue draws them with queries, each inside a primitives query of its own
+    void drawHeavyModels(const Scene &scene, OcclusionQueries &queries, int pass) {
+        for (int object = 0; object < OBJECT_COUNT; object++) {
+            glBeginQuery(GL_PRIMITIVES_GENERATED, scene.primitiveQueries[pass][object]);
+            if (queries.beginDraw(object)) {
+                drawMesh(scene, scene.heavy, scene.heavyTransforms[object]);
+                queries.endDraw(object);
+            }
+            glEndQuery(GL_PRIMITIVES_GENERATED);
+        }
+    }
+
+    // One frame of the main pass; returns the primitives each heavy model generated over both passes.
+    // heavyFirst draws the heavy models in the pre-pass before the queries are issued, as the pass used to
+    std::vector<GLuint64> renderFrame(Scene &scene, OcclusionQueries &queries, bool depthPrepass, bool heavyFirst) {
+        queries.beginFrame();
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        const bool conditional = queries.getMode() == OcclusionQueries::Mode::Conditional;
+
+        if (depthPrepass) {
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+            drawMesh(scene, scene.cube, scene.occluderTransform);
+            if (heavyFirst) drawHeavyModels(scene, queries, 0);
+            if (conditional) {
+                queries.issueQueries(scene.heavyBounds, scene.viewProjection, scene.cameraPosition);
+                glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+            }
+            if (!heavyFirst) drawHeavyModels(scene, queries, 0);
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        }
+
+        glDepthFunc(depthPrepass ? GL_LEQUAL : GL_LESS);
+        drawMesh(scene, scene.cube, scene.occluderTransform);
+        if (!depthPrepass && conditional) {
+            queries.issueQueries(scene.heavyBounds, scene.viewProjection, scene.cameraPosition);
+        }
+        drawHeavyModels(scene, queries, 1);
+        if (queries.getMode() == OcclusionQueries::Mode::Latent) {
+            queries.issueQueries(scene.heavyBounds, scene.viewProjection, scene.cameraPosition);
+        }
+        glDepthFunc(GL_LESS);
+
+        std::vector<GLuint64> primitives(OBJECT_COUNT, 0);
+        for (int pass = depthPrepass ? 0 : 1; pass < 2; pass++) {
+            for (int object = 0; object < OBJECT_COUNT; object++) {
+                GLuint64 count = 0;
+                glGetQueryObjectui64v(scene.primitiveQueries[pass][object], GL_QUERY_RESULT, &count);
+                primitives[object] += count;
+            }
+        }
+        // Every query result is available by the next frame's beginFrame()
+        glFinish();
+        return primitives;
+    }
+}
+
+int main(int argc, char **argv) {
+    int grid = 128;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--grid" && i + 1 < argc) grid = std::max(std::atoi(argv[++i]), 1);
+        else {
+            std::cout << "Usage: " << argv[0] << " [--grid <cells per side>]" << std::endl;
+            return 2;
+        }
+    }
+
+    HeadlessGL gl;
+    if (!gl.valid()) return 1;
+
+    GLuint framebuffer, colorTarget, depthTarget;
+    glGenFramebuffers(1, &framebuffer);
+    glGenRenderbuffers(1, &colorTarget);
+    glGenRenderbuffers(1, &depthTarget);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorTarget);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, TARGET_SIZE, TARGET_SIZE);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthTarget);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, TARGET_SIZE, TARGET_SIZE);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorTarget);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthTarget);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cout << "ERROR::OCCLUSION_QUERY_HEADLESS::FRAMEBUFFER_INCOMPLETE" << std::endl;
+        return 1;
+    }
+    glViewport(0, 0, TARGET_SIZE, TARGET_SIZE);
+    glEnable(GL_DEPTH_TEST);
+
+    ShaderVariants boxShaders("bbox.vert", "bbox.frag");
+    Scene scene;
+    scene.program = boxShaders.get(0).id;
+    if (scene.program == 0) return 1;
+    scene.mvpLocation = glGetUniformLocation(scene.program, "mvp");
+    scene.cube = makeCube();
+    scene.heavy = makeHeavyMesh(grid);
+    glGenQueries(2 * OBJECT_COUNT, &scene.primitiveQueries[0][0]);
+
+    // Camera at the origin looking down -z. The occluder spans x in [-1, 1] from z = -4 to -6, so it covers
+    // |x| < 3 at z = -12, where the heavy models stand: one straight behind it and one beside it
+    scene.viewProjection = glm::perspective(glm::radians(60.0f), 1.0f, 0.1f, 100.0f) *
+                           glm::lookAt(scene.cameraPosition, glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    scene.occluderTransform = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(-1.0f, -2.0f, -6.0f)),
+                                         glm::vec3(2.0f, 4.0f, 2.0f));
+    scene.heavyTransforms[HIDDEN] = glm::translate(glm::mat4(1.0f), glm::vec3(-0.5f, -0.5f, -12.5f));
+    scene.heavyTransforms[BESIDE] = glm::translate(glm::mat4(1.0f), glm::vec3(4.0f, -0.5f, -12.5f));
+    const AABB unitCube(glm::vec3(0.0f), glm::vec3(1.0f));
+    for (const glm::mat4 &transform: scene.heavyTransforms) {
+        scene.heavyBounds.push_back(unitCube.transformed(transform));
+    }
+
+    const GLuint64 triangles = static_cast<GLuint64>(grid) * grid * 2;
+    OcclusionQueries queries(OBJECT_COUNT, scene.program);
+
+    queries.setMode(OcclusionQueries::Mode::Conditional);
+    for (bool depthPrepass: {true, false}) {
+        const std::string name = depthPrepass ? "conditional render with pre-pass" : "conditional render";
+        const std::vector<GLuint64> primitives = renderFrame(scene, queries, depthPrepass, false);
+        const GLuint64 passes = depthPrepass ? 2 : 1;
+        check(primitives[HIDDEN] == 0, name + ": hidden model drew " + std::to_string(primitives[HIDDEN]) +
+                                       " triangles");
+        check(primitives[BESIDE] == passes * triangles, name + ": visible model drew " +
+                                                         std::to_string(primitives[BESIDE]) + " triangles, expected " +
+                                                         std::to_string(passes * triangles));
+        std::cout << name << ": hidden " << primitives[HIDDEN] << ", visible " << primitives[BESIDE]
+                  << " triangles" << std::endl;
+    }
+
+    // The previous order: the hidden model is already in the pre-pass when its query is issued
+    const std::vector<GLuint64> heavyFirst = renderFrame(scene, queries, true, true);
+    check(heavyFirst[HIDDEN] == triangles, "heavy models before the queries: hidden model drew " +
+                                           std::to_string(heavyFirst[HIDDEN]) + " triangles, expected the pre-pass");
+    std::cout << "heavy models before the queries: hidden " << heavyFirst[HIDDEN] << ", visible "
+              << heavyFirst[BESIDE] << " triangles" << std::endl;
+
+    // Last-frame results: the first frame has none and draws everything, the second skips the hidden model
+    queries.setMode(OcclusionQueries::Mode::Latent);
+    renderFrame(scene, queries, true, false);
+    const std::vector<GLuint64> latent = renderFrame(scene, queries, true, false);
+    check(latent[HIDDEN] == 0, "last frame: hidden model drew " + std::to_string(latent[HIDDEN]) + " triangles");
+    check(latent[BESIDE] == 2 * triangles, "last frame: visible model drew " + std::to_string(latent[BESIDE]) +
+                                           " triangles");
+    check(queries.occludedCount() == 1, "last frame: " + std::to_string(queries.occludedCount()) +
+                                        " models reported occluded, expected 1");
+    std::cout << "last frame: hidden " << latent[HIDDEN] << ", visible " << latent[BESIDE] << " triangles"
+              << std::endl;
+
+    glDeleteQueries(2 * OBJECT_COUNT, &scene.primitiveQueries[0][0]);
+    scene.cube.release();
+    scene.heavy.release();
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteRenderbuffers(1, &colorTarget);
+    glDeleteRenderbuffers(1, &depthTarget);
+
+    if (failures > 0) {
+        std::cout << failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "Heavy models behind the occluder skipped with " << triangles << " triangles each" << std::endl;
+    return 0;
+}
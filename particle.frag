@@ -1,23 +1,58 @@
 #version 410 core
 
 in vec2 TexCoords;
-in vec4 FragColor; // Contains the alpha for fading, passed from C++
+in vec4 FragColor; // The emitter's tint, its alpha multiplied by the fade over the lifetime
 
+// OIT is inserted by ShaderVariants: instead of blending over what is behind, which needs the particles sorted,
+// each fragment adds its depth-weighted premultiplied colour to one target and multiplies its transparency into
+// another (weighted blended order-independent transparency). WeightedOit resolves the two into a colour
+#ifdef OIT
+layout (location = 0) out vec4 accumulation; // RGBA16F, blended ONE, ONE
+layout (location = 1) out float revealage;   // R8, cleared to 1, blended ZERO, ONE_MINUS_SRC_COLOR
+vec4 color;
+#else
 out vec4 color;
+#endif
 
 uniform sampler2D particleTexture;
 
+// SOFT is inserted by ShaderVariants: particles fade out where they approach the scene behind them instead of
+// cutting a hard line into it
+#ifdef SOFT
+uniform sampler2D sceneDistance; // Linear depth of the target being drawn into, read at gl_FragCoord
+uniform vec2 depthTexelSize;     // 1 / sceneDistance size
+uniform vec2 nearFar;
+uniform float softDistance;      // World units over which a particle fades in front of the scene
+
+float linearDepth(float depth) {
+    float z = depth * 2.0 - 1.0;
+    return 2.0 * nearFar.x * nearFar.y / (nearFar.y + nearFar.x - z * (nearFar.y - nearFar.x));
+}
+#endif
+
 void main()
 {
-    // Sample the smoke texture to get its shape (alpha)
+    // Sample the particle's atlas frame to get its shape and colour
     vec4 texColor = texture(particleTexture, TexCoords);
 
-    // Force the smoke color to be a semi-transparent gray
-    // The final alpha is a product of the texture's alpha and the particle's lifetime alpha
-    color = vec4(0.6, 0.6, 0.6, texColor.a * FragColor.a);
+    // Tinted per emitter; the final alpha is a product of the frame's alpha and the particle's lifetime alpha
+    color = texColor * FragColor;
+#ifdef SOFT
+    float behind = texture(sceneDistance, gl_FragCoord.xy * depthTexelSize).r - linearDepth(gl_FragCoord.z);
+    color.a *= clamp(behind / softDistance, 0.0, 1.0);
+#endif
 
     // Discard fragments that are almost fully transparent to avoid rendering artifacts
     if (color.a < 0.01) {
         discard;
     }
+
+#ifdef OIT
+    // Nearer and more opaque fragments dominate the average colour (McGuire and Bavoil, equation 9); the clamp
+    // keeps the sum within half-float range
+    float weight = clamp(pow(min(1.0, color.a * 10.0) + 0.01, 3.0) * 1e8 * pow(1.0 - gl_FragCoord.z * 0.9, 3.0),
+                         1e-2, 3e3);
+    accumulation = vec4(color.rgb * color.a, color.a) * weight;
+    revealage = color.a;
+#endif
 }
\ No newline at end of file
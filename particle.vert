@@ -1,15 +1,56 @@
 #version 410 core
 
+// STEREO is inserted by ShaderVariants for single-pass stereo, ANALYTIC for AnalyticParticles
+
 // Per-vertex attribute (for the quad)
 layout (location = 0) in vec3 aPos;
 
+#ifdef ANALYTIC
+// Instanced attributes: when the particle was born and its seed. Everything else follows from its age
+layout (location = 1) in float spawnTime;
+layout (location = 2) in uint particleSeed;
+
+uniform float time;
+uniform vec3 emitterPosition;
+uniform vec3 baseVelocity;
+uniform vec3 velocityJitter; // Per particle, uniform in [-jitter, jitter)
+uniform vec2 sizeRange;
+uniform float lifetime;
+uniform vec4 tint;
+uniform vec2 flipbook; // .x = first atlas frame, .y = frame count, played once over the lifetime
+
+// Integer hash (lowbias32), as in particle_sim.vert
+uint hash(uint x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+float random01(inout uint state)
+{
+    state = hash(state);
+    return float(state >> 8) * (1.0 / 16777216.0);
+}
+#else
 // Instanced attributes (one per particle)
 layout (location = 1) in vec4 particlePosAndSize; // .xyz = position, .w = size
-layout (location = 2) in vec4 particleColor;
+layout (location = 2) in vec4 particleTint;          // RGBA8, normalized
+layout (location = 3) in vec2 particleAlphaAndFrame; // .x = lifetime fade, .y = atlas frame
+#endif
+
+// Texture coordinate rectangle of every atlas frame (ParticleAtlas::MAX_FRAMES): .xy = offset, .zw = scale
+uniform vec4 atlasFrames[128];
 
 // Uniforms
 uniform mat4 view;
 uniform mat4 projection;
+#ifdef STEREO
+uniform float stereoHalfSeparation; // Half the distance between the eyes
+#endif
 
 // Outputs to fragment shader
 out vec2 TexCoords;
@@ -21,19 +62,45 @@ void main()
     vec3 cameraRight_worldspace = vec3(view[0][0], view[1][0], view[2][0]);
     vec3 cameraUp_worldspace = vec3(view[0][1], view[1][1], view[2][1]);
 
+#ifdef ANALYTIC
+    // Constant velocity and a linear fade; slots not alive collapse to a zero-sized quad
+    float age = time - spawnTime;
+    bool alive = age >= 0.0 && age < lifetime;
+    uint state = particleSeed;
+    vec3 jitter = vec3(random01(state), random01(state), random01(state)) * 2.0 - 1.0;
+    vec3 particleCenter_worldspace = emitterPosition + (baseVelocity + jitter * velocityJitter) * age;
+    float particleSize = alive ? mix(sizeRange.x, sizeRange.y, random01(state)) : 0.0;
+    float lifeFraction = clamp(age / lifetime, 0.0, 1.0);
+    vec4 particleColor = vec4(tint.rgb, alive ? tint.a * (1.0 - lifeFraction) : 0.0);
+    int frame = int(flipbook.x) + min(int(lifeFraction * flipbook.y), int(flipbook.y) - 1);
+#else
     vec3 particleCenter_worldspace = particlePosAndSize.xyz;
     float particleSize = particlePosAndSize.w;
+    vec4 particleColor = vec4(particleTint.rgb, particleTint.a * particleAlphaAndFrame.x);
+    int frame = int(particleAlphaAndFrame.y);
+#endif
 
     // Calculate the vertex position for the billboarded quad
     vec3 vertexPosition_worldspace = particleCenter_worldspace
     + cameraRight_worldspace * aPos.x * particleSize
     + cameraUp_worldspace * aPos.y * particleSize;
 
+#ifdef STEREO
+    // Even instances draw the left eye into the left half of the target, odd ones the right eye
+    float side = (gl_InstanceID & 1) == 0 ? -1.0 : 1.0;
+    vec4 viewPosition = view * vec4(vertexPosition_worldspace, 1.0);
+    viewPosition.x -= side * stereoHalfSeparation;
+    gl_Position = projection * viewPosition;
+    gl_Position.x = gl_Position.x * 0.5 + side * 0.5 * gl_Position.w;
+    gl_ClipDistance[0] = side * gl_Position.x;
+#else
     // Standard MVP transformation
     gl_Position = projection * view * vec4(vertexPosition_worldspace, 1.0);
+#endif
 
-    // Set texture coordinates for the quad
-    TexCoords = aPos.xy + vec2(0.5, 0.5);
+    // Set texture coordinates for the quad, within the particle's frame of the atlas
+    vec4 frameRect = atlasFrames[clamp(frame, 0, 127)];
+    TexCoords = frameRect.xy + (aPos.xy + vec2(0.5, 0.5)) * frameRect.zw;
     // Pass the particle's color to the fragment shader
     FragColor = particleColor;
 }
\ No newline at end of file
@@ -0,0 +1,27 @@
+#version 410 core
+
+// Scene depth for the reduced-resolution particle targets: the nearest depth of each factor x factor block, so a
+// low-resolution texel only hides particles that are behind everything it covers. Written twice: as the depth
+// buffer the particles are tested against, and as linear view distance for sampling while that buffer is bound
+in vec2 uv;
+
+out float linearDepth;
+
+uniform sampler2D sceneDepth;
+uniform int factor;        // 2 or 4
+uniform ivec2 renderSize;  // Rendered region of sceneDepth, in pixels
+uniform vec2 nearFar;
+
+void main() {
+    ivec2 origin = ivec2(gl_FragCoord.xy) * factor;
+    float nearest = 1.0;
+    for (int y = 0; y < factor; y++) {
+        for (int x = 0; x < factor; x++) {
+            ivec2 pixel = min(origin + ivec2(x, y), renderSize - 1);
+            nearest = min(nearest, texelFetch(sceneDepth, pixel, 0).r);
+        }
+    }
+    gl_FragDepth = nearest;
+    float z = nearest * 2.0 - 1.0;
+    linearDepth = 2.0 * nearFar.x * nearFar.y / (nearFar.y + nearFar.x - z * (nearFar.y - nearFar.x));
+}
@@ -0,0 +1,409 @@
+// GL test for the particle draw paths, on a surfaceless context (see HeadlessGL). Every permutation of the particle
+// shader and the full-screen particle passes must link. One smoke emitter is then run by each simulation (the CPU
+// ParticleSystem, GpuParticles' transform feedback and AnalyticParticles) and drawn each way main.cpp can draw it:
+// straight into the scene, at half and quarter resolution through OffscreenParticles' depth downsample and
+// depth-aware upsample (also with SOFT), and order independent through WeightedOit's accumulation and resolve.
+// The scene is a clear colour with a near wall over its left half, written straight into the depth buffer:
+// - nothing may show through the wall, and the right half must show the plume;
+// - the reduced-resolution and OIT images must stay close to the direct one (the tint is uniform, so OIT only
+//   approximates the order of identical colours);
+// - each transform feedback step must capture every particle slot, and no GL error may be raised.
+//   particle_modes_headless [--steps <count>]
+// Exits with 1 when a check fails. Run from the build directory, where the shaders are copied.
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "analytic_particles.h"
+#include "gpu_particles.h"
+#include "headless_gl.h"
+#include "offscreen_particles.h"
+#include "particle.h"
+#include "shader_variants.h"
+#include "weighted_oit.h"
+
+namespace {
+    constexpr int SIZE = 128;
+    constexpr float Z_NEAR = 0.1f, Z_FAR = 100.0f;
+    // Columns compared on each side of the wall's edge at SIZE / 2; the upsample may blend the texels next to it
+    constexpr int WALL_END = 56, OPEN_START = 72;
+    const glm::vec4 BACKGROUND(0.1f, 0.2f, 0.3f, 1.0f);
+
+    int failures = 0;
+
+    void check(bool condition, const std::string &what) {
+        if (condition) return;
+        if (failures < 20) std::cout << "FAIL " << what << std::endl;
+        failures++;
+    }
+
+    void checkErrors(const std::string &what) {
+        for (GLenum error = glGetError(); error != GL_NO_ERROR; error = glGetError()) {
+            check(false, what + ": GL error 0x" + std::to_string(error));
+        }
+    }
+
+    GLuint makeTexture(GLenum internalFormat, int width, int height) {
+        GLenum format = GL_RGBA, type = GL_UNSIGNED_BYTE;
+        if (internalFormat == GL_DEPTH_COMPONENT24) format = GL_DEPTH_COMPONENT, type = GL_UNSIGNED_INT;
+        else if (internalFormat == GL_R32F || internalFormat == GL_R8) format = GL_RED;
+        if (internalFormat == GL_R32F || internalFormat == GL_RGBA16F) type = GL_FLOAT;
+        GLuint texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, static_cast<GLint>(internalFormat), width, height, 0, format, type, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        return texture;
+    }
+
+    // Framebuffer drawing into every colour attachment in order
+    GLuint makeFramebuffer(const std::vector<GLuint> &colors, GLuint depth) {
+        GLuint framebuffer;
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        std::vector<GLenum> drawBuffers;
+        for (size_t i = 0; i < colors.size(); i++) {
+            const GLenum attachment = GL_COLOR_ATTACHMENT0 + static_cast<GLenum>(i);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, colors[i], 0);
+            drawBuffers.push_back(attachment);
+        }
+        if (depth) glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+        glDrawBuffers(static_cast<GLsizei>(drawBuffers.size()), drawBuffers.data());
+        check(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE, "framebuffer incomplete");
+        return framebuffer;
+    }
+
+    bool linked(GLuint program) {
+        GLint status = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &status);
+        return program != 0 && status == GL_TRUE;
+    }
+
+    // Soft round sprite; the test has no ParticleAtlas, so frame 0 is the whole texture
+    GLuint makeSpriteTexture() {
+        constexpr int sprite = 32;
+        std::vector<unsigned char> rgba(sprite * sprite * 4);
+        for (int y = 0; y < sprite; y++) {
+            for (int x = 0; x < sprite; x++) {
+                const float distance = glm::length(glm::vec2(x + 0.5f, y + 0.5f) / (sprite * 0.5f) - 1.0f);
+                unsigned char *texel = &rgba[(y * sprite + x) * 4];
+                texel[0] = texel[1] = texel[2] = 255;
+                texel[3] = static_cast<unsigned char>(255.0f * glm::clamp(1.0f - distance, 0.0f, 1.0f));
+            }
+        }
+        GLuint texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, sprite, sprite, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        return texture;
+    }
+
+    ShaderVariants *particleShaders = nullptr;
+
+    // A permutation of the particle shader with frame 0 set up, as ParticleAtlas::applyTo() would
+    GLuint particleProgram(unsigned features) {
+        const GLuint program = particleShaders->get(features).id;
+        glUseProgram(program);
+        const GLfloat wholeTexture[] = {0.0f, 0.0f, 1.0f, 1.0f};
+        glUniform4fv(glGetUniformLocation(program, "atlasFrames"), 1, wholeTexture);
+        glUniform1i(glGetUniformLocation(program, "particleTexture"), 0);
+        return program;
+    }
+
+    enum class Simulation { Cpu, Gpu, Analytic };
+    const char *const SIMULATION_NAMES[] = {"CPU", "GPU", "analytic"};
+
+    struct Emitters {
+        ParticleSystem *cpu;
+        GpuParticles *gpu;
+        AnalyticParticles *analytic;
+
+        void setShader(Simulation simulation, unsigned features, bool orderIndependent) const {
+            if (simulation == Simulation::Cpu) {
+                cpu->setShader(particleProgram(features));
+                cpu->setOrderIndependent(orderIndependent);
+            } else if (simulation == Simulation::Gpu) {
+                gpu->setShader(particleProgram(features));
+                gpu->setOrderIndependent(orderIndependent);
+            } else {
+                analytic->setShader(particleProgram(features | ShaderVariants::ANALYTIC));
+                analytic->setOrderIndependent(orderIndependent);
+            }
+        }
+
+        void render(Simulation simulation, const glm::mat4 &view, const glm::mat4 &projection) const {
+            if (simulation == Simulation::Cpu) cpu->render(view, projection);
+            else if (simulation == Simulation::Gpu) gpu->render(view, projection);
+            else analytic->render(view, projection);
+        }
+    };
+
+    struct Targets {
+        GLuint sceneColor, sceneDepth, scene, sceneColorOnly;
+        // Reduced resolution, allocated at SIZE so every factor fits; only the rendered corner is used
+        GLuint lowDistance, lowDepth, lowColor, lowAccumulation, lowRevealage;
+        GLuint depthDownsample, particles, particlesOit, resolved;
+    };
+
+    Targets makeTargets() {
+        Targets t{};
+        t.sceneColor = makeTexture(GL_RGBA8, SIZE, SIZE);
+        t.sceneDepth = makeTexture(GL_DEPTH_COMPONENT24, SIZE, SIZE);
+        t.scene = makeFramebuffer({t.sceneColor}, t.sceneDepth);
+        t.sceneColorOnly = makeFramebuffer({t.sceneColor}, 0);
+        t.lowDistance = makeTexture(GL_R32F, SIZE, SIZE);
+        t.lowDepth = makeTexture(GL_DEPTH_COMPONENT24, SIZE, SIZE);
+        t.lowColor = makeTexture(GL_RGBA8, SIZE, SIZE);
+        t.lowAccumulation = makeTexture(GL_RGBA16F, SIZE, SIZE);
+        t.lowRevealage = makeTexture(GL_R8, SIZE, SIZE);
+        t.depthDownsample = makeFramebuffer({t.lowDistance}, t.lowDepth);
+        t.particles = makeFramebuffer({t.lowColor}, t.lowDepth);
+        t.particlesOit = makeFramebuffer({t.lowAccumulation, t.lowRevealage}, t.lowDepth);
+        t.resolved = makeFramebuffer({t.lowColor}, 0);
+        return t;
+    }
+
+    // Background colour, depth 1 and a wall at depth 0.5 (about Z_NEAR x 2 away) over the left half
+    void clearScene(const Targets &t) {
+        glBindFramebuffer(GL_FRAMEBUFFER, t.scene);
+        glViewport(0, 0, SIZE, SIZE);
+        glClearColor(BACKGROUND.r, BACKGROUND.g, BACKGROUND.b, BACKGROUND.a);
+        glClearDepth(1.0);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glEnable(GL_SCISSOR_TEST);
+        glScissor(0, 0, SIZE / 2, SIZE);
+        glClearDepth(0.5);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        glDisable(GL_SCISSOR_TEST);
+        glClearDepth(1.0);
+    }
+
+    using Image = std::vector<unsigned char>;
+
+    Image readScene(const Targets &t) {
+        Image image(SIZE * SIZE * 4);
+        glBindFramebuffer(GL_FRAMEBUFFER, t.scene);
+        glReadPixels(0, 0, SIZE, SIZE, GL_RGBA, GL_UNSIGNED_BYTE, image.data());
+        return image;
+    }
+
+    // Pixels of columns [begin, end) that differ from the background
+    int changedPixels(const Image &image, int begin, int end) {
+        const glm::ivec4 background(glm::round(BACKGROUND * 255.0f));
+        int changed = 0;
+        for (int y = 0; y < SIZE; y++) {
+            for (int x = begin; x < end; x++) {
+                const unsigned char *p = &image[(y * SIZE + x) * 4];
+                if (std::abs(p[0] - background.r) > 1 || std::abs(p[1] - background.g) > 1 ||
+                    std::abs(p[2] - background.b) > 1) {
+                    changed++;
+                }
+            }
+        }
+        return changed;
+    }
+
+    // Mean absolute difference per channel over the open half
+    double meanDifference(const Image &a, const Image &b) {
+        double sum = 0.0;
+        for (int y = 0; y < SIZE; y++) {
+            for (int x = OPEN_START; x < SIZE; x++) {
+                for (int c = 0; c < 3; c++) sum += std::abs(a[(y * SIZE + x) * 4 + c] - b[(y * SIZE + x) * 4 + c]);
+            }
+        }
+        return sum / ((SIZE - OPEN_START) * SIZE * 3);
+    }
+
+    struct Mode {
+        const char *name;
+        int factor;         // 1: straight into the scene
+        float softDistance; // 0: no SOFT permutation
+        bool orderIndependent;
+        double tolerance;   // Of meanDifference() from the direct image; negative: must differ by at least that much
+    };
+
+    Image renderMode(const Targets &t, const Emitters &emitters, OffscreenParticles &offscreen,
+                     const WeightedOit &oit, Simulation simulation, const Mode &mode, const glm::mat4 &view,
+                     const glm::mat4 &projection) {
+        clearScene(t);
+        glEnable(GL_DEPTH_TEST);
+        glDepthFunc(GL_LESS);
+        const unsigned features = (mode.softDistance > 0.0f ? ShaderVariants::SOFT : 0u) |
+                                  (mode.orderIndependent ? ShaderVariants::OIT : 0u);
+        emitters.setShader(simulation, features, mode.orderIndependent);
+
+        if (mode.factor == 1 && !mode.orderIndependent) {
+            emitters.render(simulation, view, projection);
+            return readScene(t);
+        }
+
+        const glm::ivec2 renderSize(SIZE);
+        offscreen.setFactor(mode.factor);
+        const glm::ivec2 lowSize = offscreen.reducedSize(renderSize);
+        glBindFramebuffer(GL_FRAMEBUFFER, t.depthDownsample);
+        offscreen.downsampleDepth(t.sceneDepth, renderSize);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, mode.orderIndependent ? t.particlesOit : t.particles);
+        if (mode.orderIndependent) {
+            WeightedOit::clearTargets();
+        } else {
+            const GLfloat transparent[] = {0.0f, 0.0f, 0.0f, 0.0f};
+            glClearBufferfv(GL_COLOR, 0, transparent);
+        }
+        if (mode.softDistance > 0.0f) {
+            const unsigned analytic = simulation == Simulation::Analytic ? ShaderVariants::ANALYTIC : 0u;
+            offscreen.prepareSoftParticles(particleShaders->get(features | analytic).id, t.lowDistance,
+                                           glm::ivec2(SIZE), mode.softDistance);
+        }
+        glViewport(0, 0, lowSize.x, lowSize.y);
+        emitters.render(simulation, view, projection);
+
+        if (mode.orderIndependent) {
+            glBindFramebuffer(GL_FRAMEBUFFER, t.resolved);
+            oit.resolve(t.lowAccumulation, t.lowRevealage, lowSize.x, lowSize.y);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, t.sceneColorOnly);
+        offscreen.composite(t.lowColor, t.lowDistance, t.sceneDepth, renderSize);
+        return readScene(t);
+    }
+}
+
+int main(int argc, char **argv) {
+    int steps = 60;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--steps" && i + 1 < argc) steps = std::max(std::atoi(argv[++i]), 1);
+        else {
+            std::cout << "Usage: " << argv[0] << " [--steps <count>]" << std::endl;
+            return 2;
+        }
+    }
+
+    HeadlessGL gl;
+    if (!gl.valid()) return 1;
+
+    // Every permutation the particle draws can ask for, and the full-screen passes
+    ShaderVariants shaders("particle.vert", "particle.frag");
+    particleShaders = &shaders;
+    const unsigned particleFeatures[] = {ShaderVariants::STEREO, ShaderVariants::ANALYTIC, ShaderVariants::SOFT,
+                                         ShaderVariants::OIT};
+    for (unsigned combination = 0; combination < 16; combination++) {
+        unsigned features = 0;
+        for (int bit = 0; bit < 4; bit++) {
+            if (combination & (1u << bit)) features |= particleFeatures[bit];
+        }
+        check(linked(shaders.get(features).id), "particle shader [" + ShaderVariants::featureNames(features) +
+                                                "] did not link");
+    }
+    ShaderVariants depthShaders("fullscreen.vert", "particle_depth.frag");
+    ShaderVariants upsampleShaders("fullscreen.vert", "particle_upsample.frag");
+    ShaderVariants resolveShaders("fullscreen.vert", "particle_oit_resolve.frag");
+    check(linked(depthShaders.get(0).id), "particle_depth.frag did not link");
+    check(linked(upsampleShaders.get(0).id), "particle_upsample.frag did not link");
+    check(linked(resolveShaders.get(0).id), "particle_oit_resolve.frag did not link");
+    checkErrors("shaders");
+    if (failures > 0) {
+        std::cout << failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+
+    const GLuint texture = makeSpriteTexture();
+    ParticleEmitter::Settings smoke;
+    smoke.position = glm::vec3(0.0f, -1.5f, 0.0f);
+    smoke.velocity = glm::vec3(0.0f, 1.0f, 0.0f);
+    smoke.velocityJitter = glm::vec3(1.0f, 0.2f, 0.5f);
+    smoke.minSize = 0.2f;
+    smoke.maxSize = 0.4f;
+    smoke.tint = glm::vec4(1.0f, 1.0f, 1.0f, 0.6f);
+    smoke.lifetime = 2.5f;
+    smoke.rate = 400.0f;
+    smoke.capacity = 1000;
+
+    ParticleSystem cpuParticles(particleProgram(0), texture);
+    cpuParticles.addEmitter(smoke);
+    GpuParticles gpuParticles(smoke, particleProgram(0), texture);
+    AnalyticParticles analyticParticles(smoke, particleProgram(ShaderVariants::ANALYTIC), texture);
+    const Emitters emitters{&cpuParticles, &gpuParticles, &analyticParticles};
+    OffscreenParticles offscreen(depthShaders.get(0).id, upsampleShaders.get(0).id);
+    offscreen.setDepthRange(Z_NEAR, Z_FAR);
+    const WeightedOit oit(resolveShaders.get(0).id);
+    const Targets targets = makeTargets();
+    checkErrors("setup");
+
+    // The plume rises through the middle of the view, half of it behind the wall
+    const glm::vec3 cameraPosition(0.0f, 0.0f, 5.0f);
+    const glm::mat4 view = glm::lookAt(cameraPosition, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    const glm::mat4 projection = glm::perspective(glm::radians(60.0f), 1.0f, Z_NEAR, Z_FAR);
+
+    GLuint capturedQuery;
+    glGenQueries(1, &capturedQuery);
+    const float deltaTime = 1.0f / 30.0f;
+    for (int step = 0; step < steps; step++) {
+        cpuParticles.update(deltaTime, cameraPosition);
+        analyticParticles.update(deltaTime);
+        glBeginQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN, capturedQuery);
+        gpuParticles.simulate(deltaTime);
+        glEndQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN);
+        GLuint captured = 0;
+        glGetQueryObjectuiv(capturedQuery, GL_QUERY_RESULT, &captured);
+        check(captured == static_cast<GLuint>(smoke.capacity),
+              "transform feedback step " + std::to_string(step) + " captured " + std::to_string(captured) +
+              " particles, expected " + std::to_string(smoke.capacity));
+    }
+    glDeleteQueries(1, &capturedQuery);
+    checkErrors("simulation");
+
+    // The open half's background is at the far plane, so soft particles only fade there when the soft distance
+    // is about as long
+    const Mode modes[] = {
+        {"direct", 1, 0.0f, false, 0.0},
+        {"half resolution", 2, 0.0f, false, 1.5},
+        {"half resolution, soft", 2, 0.5f, false, 1.5},
+        {"half resolution, soft over 1000 units", 2, 1000.0f, false, -5.0},
+        {"quarter resolution", 4, 0.0f, false, 3.0},
+        {"order independent", 1, 0.0f, true, 0.25},
+        {"order independent, half resolution", 2, 0.0f, true, 1.5},
+    };
+    for (int s = 0; s < 3; s++) {
+        const Simulation simulation = static_cast<Simulation>(s);
+        Image direct;
+        for (const Mode &mode: modes) {
+            const std::string name = std::string(SIMULATION_NAMES[s]) + ", " + mode.name;
+            const Image image = renderMode(targets, emitters, offscreen, oit, simulation, mode, view, projection);
+            checkErrors(name);
+            if (direct.empty()) direct = image;
+            const int hidden = changedPixels(image, 0, WALL_END);
+            const int shown = changedPixels(image, OPEN_START, SIZE);
+            const double difference = meanDifference(image, direct);
+            check(hidden == 0, name + ": " + std::to_string(hidden) + " pixels show through the wall");
+            check(shown > SIZE * 4, name + ": only " + std::to_string(shown) + " pixels show particles");
+            if (mode.tolerance >= 0.0) {
+                check(difference <= mode.tolerance, name + ": differs from the direct image by " +
+                                                    std::to_string(difference) + " on average");
+            } else {
+                check(difference >= -mode.tolerance, name + ": not faded, differs from the direct image by " +
+                                                     std::to_string(difference) + " on average");
+            }
+            std::cout << name << ": " << shown << " pixels with particles, " << difference
+                      << " from the direct image" << std::endl;
+        }
+    }
+
+    if (failures > 0) {
+        std::cout << failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "Particle shaders linked and every simulation drawn " << std::size(modes) << " ways" << std::endl;
+    return 0;
+}
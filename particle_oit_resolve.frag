@@ -0,0 +1,21 @@
+#version 410 core
+
+// Resolves weighted blended OIT: the weighted average colour of every layer, covering as much of the pixel as
+// the layers' combined transparency leaves. Written premultiplied, like the sorted particle target, so the same
+// composite blends either over the scene
+in vec2 uv;
+
+out vec4 color;
+
+uniform sampler2D accumulation; // Sum of weighted premultiplied colour (.rgb) and weighted alpha (.a)
+uniform sampler2D revealage;    // Product of (1 - alpha) over the layers
+
+void main() {
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    float reveal = texelFetch(revealage, texel, 0).r;
+    vec4 sum = texelFetch(accumulation, texel, 0);
+    // A half float that overflowed would turn the average into NaN; saturated, it still gives the right hue
+    if (isinf(max(max(abs(sum.r), abs(sum.g)), abs(sum.b)))) sum.rgb = vec3(sum.a);
+    vec3 average = sum.rgb / max(sum.a, 1e-5);
+    color = vec4(average * (1.0 - reveal), 1.0 - reveal);
+}
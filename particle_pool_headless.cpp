@@ -0,0 +1,155 @@
+// Correctness test and benchmark for ParticlePool, without a window or GPU. A pool is run for a number of frames
+// next to a plain array-of-structs model of the same particles, at every SIMD level this CPU has, and after each
+// frame the live particles, their positions, their fade and their back-to-front order are checked; a full pool
+// and removeOldest() are checked as well. --benchmark then runs ParticlePool::runBenchmark() (5k/100k/1M
+// particles against the previous pool, and the kernels alone), which takes a minute or more.
+//   particle_pool_headless [--frames <count>] [--benchmark]
+// Exits with 1 when a check fails.
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "particle_pool.h"
+#include "particle_simd.h"
+
+namespace {
+    constexpr int CAPACITY = 4099; // Not a multiple of the SIMD width, so the kernels' scalar tails run too
+    constexpr float DELTA_TIME = 1.0f / 60.0f;
+    const glm::vec3 CAMERA_POSITION(0.0f, 6.5f, 20.0f);
+
+    // What the pool must hold for one particle, kept with the same float operations the kernels do. The
+    // particle's id is stored as its size, which the pool carries through unchanged
+    struct ModelParticle {
+        glm::vec3 position, speed;
+        float life, lifetime;
+    };
+
+    int failures = 0;
+
+    // Squared distance at the precision of the sort keys, which drop the lowest bit
+    uint32_t distanceBits(const glm::vec3 &position) {
+        const glm::vec3 d = position - CAMERA_POSITION;
+        const float distance2 = d.x * d.x + d.y * d.y + d.z * d.z;
+        uint32_t bits;
+        std::memcpy(&bits, &distance2, sizeof(bits));
+        return bits | 1u;
+    }
+
+    void check(bool condition, const std::string &what) {
+        if (condition) return;
+        if (failures < 20) std::cout << "FAIL " << what << std::endl;
+        failures++;
+    }
+
+    // The pool's live particles must be exactly the model's, in back-to-front order
+    void compare(const std::vector<ParticleInstanceData> &instances, int count,
+                 const std::map<int, ModelParticle> &model, const std::string &where) {
+        check(count == static_cast<int>(model.size()), where + ": " + std::to_string(count) + " live particles, " +
+              std::to_string(model.size()) + " expected");
+        uint32_t previousDistance = 0xFFFFFFFFu;
+        for (int i = 0; i < count; i++) {
+            const ParticleInstanceData &instance = instances[i];
+            const auto found = model.find(static_cast<int>(instance.posAndSize.w));
+            if (found == model.end()) {
+                check(false, where + ": unknown or dead particle " + std::to_string(instance.posAndSize.w));
+                continue;
+            }
+            const ModelParticle &p = found->second;
+            check(glm::vec3(instance.posAndSize) == p.position, where + ": particle moved differently");
+            check(instance.alpha == p.life * (1.0f / p.lifetime), where + ": wrong fade");
+
+            const uint32_t distance = distanceBits(glm::vec3(instance.posAndSize));
+            check(distance <= previousDistance, where + ": not back to front at " + std::to_string(i));
+            previousDistance = distance;
+        }
+    }
+
+    void runFrames(int frames) {
+        std::mt19937 random(1234u);
+        std::uniform_real_distribution<float> jitter(-0.3f, 0.3f), lifetime(0.2f, 2.0f), spread(-4.0f, 4.0f);
+        const std::string level = ParticleKernels::levelName(ParticleKernels::getLevel());
+
+        ParticlePool pool(CAPACITY);
+        std::map<int, ModelParticle> model;
+        std::vector<ParticleInstanceData> instances(CAPACITY);
+        int nextId = 1;
+        for (int frame = 0; frame < frames; frame++) {
+            // Spawn bursts of different sizes, around emitters on both sides of the camera's axis
+            const int spawns = frame % 7 == 0 ? 600 : 40;
+            for (int i = 0; i < spawns; i++) {
+                const float x = spread(random) * 3.0f, y = 2.0f + spread(random), z = -30.0f + spread(random) * 5.0f;
+                const glm::vec3 position(x, y, z);
+                const glm::vec3 speed(jitter(random), 4.0f + jitter(random), jitter(random));
+                const float life = lifetime(random);
+                const bool spawned = pool.spawn(position, speed, static_cast<float>(nextId), life);
+                check(spawned == (static_cast<int>(model.size()) < CAPACITY), level + ": spawn into a pool of " +
+                      std::to_string(model.size()) + " returned " + (spawned ? "true" : "false"));
+                if (spawned) model[nextId] = {position, speed, life, life};
+                nextId++;
+            }
+
+            pool.update(DELTA_TIME, CAMERA_POSITION);
+            for (auto it = model.begin(); it != model.end();) {
+                ModelParticle &p = it->second;
+                p.life -= DELTA_TIME;
+                p.position.x += p.speed.x * DELTA_TIME;
+                p.position.y += p.speed.y * DELTA_TIME;
+                p.position.z += p.speed.z * DELTA_TIME;
+                it = p.life > 0.0f ? std::next(it) : model.erase(it);
+            }
+
+            pool.sortByDepth();
+            const uint32_t *keys = pool.sortKeys();
+            check(std::is_sorted(keys, keys + pool.size()), level + ": sort keys not ascending");
+            const int count = pool.packInstances(instances.data());
+            compare(instances, count, model, level + " frame " + std::to_string(frame));
+        }
+
+        // The oldest particles are the ones with the least life left
+        std::vector<float> lives;
+        for (const auto &entry: model) lives.push_back(entry.second.life);
+        std::sort(lives.begin(), lives.end());
+        const int removed = static_cast<int>(model.size()) / 3;
+        pool.removeOldest(removed);
+        for (auto it = model.begin(); it != model.end();) {
+            it = it->second.life <= lives[removed - 1] ? model.erase(it) : std::next(it);
+        }
+        pool.sortByDepth();
+        compare(instances, pool.packInstances(instances.data()), model, level + " after removeOldest");
+    }
+}
+
+int main(int argc, char **argv) {
+    int frames = 240;
+    bool benchmark = false;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--frames" && i + 1 < argc) frames = std::max(std::atoi(argv[++i]), 1);
+        else if (arg == "--benchmark") benchmark = true;
+        else {
+            std::cout << "Usage: " << argv[0] << " [--frames <count>] [--benchmark]" << std::endl;
+            return 2;
+        }
+    }
+
+    const ParticleKernels::Level bestLevel = ParticleKernels::bestLevel();
+    for (int level = 0; level <= static_cast<int>(bestLevel); level++) {
+        ParticleKernels::setLevel(static_cast<ParticleKernels::Level>(level));
+        runFrames(frames);
+    }
+    ParticleKernels::setLevel(bestLevel);
+
+    if (failures > 0) {
+        std::cout << failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "Particle pool matches the model for " << frames << " frames at every SIMD level" << std::endl;
+    if (benchmark) ParticlePool::runBenchmark();
+    return 0;
+}
@@ -0,0 +1,76 @@
+#version 410 core
+
+// GPU particle simulation: one particle per vertex, drawn as points with GL_RASTERIZER_DISCARD while transform
+// feedback captures the outputs into the other buffer of a ping-pong pair. Nothing is rasterized.
+
+// Particle state, as captured last step
+layout (location = 0) in vec4 posAndSize;     // .xyz = position, .w = size
+layout (location = 1) in vec4 velocityAndAge; // .xyz = velocity, .w = age in seconds (< 0: not born yet)
+
+// Emitter
+uniform vec3 emitterPosition;
+uniform vec3 baseVelocity;
+uniform vec3 velocityJitter; // Per particle, uniform in [-jitter, jitter)
+uniform vec2 sizeRange;
+uniform float lifetime;
+uniform vec2 flipbook; // .x = first atlas frame, .y = frame count, played once over the lifetime
+
+uniform float deltaTime;
+uniform uint frameSeed; // Changes every step, so a slot respawns with new random values
+
+// Captured, interleaved: the next step's input, and the fade and atlas frame the particle shader draws with
+out vec4 outPosAndSize;
+out vec4 outVelocityAndAge;
+out vec2 outAlphaAndFrame;
+
+// Integer hash (lowbias32): the slot index and step seed give every respawn its own stream
+uint hash(uint x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+float random01(inout uint state)
+{
+    state = hash(state);
+    return float(state >> 8) * (1.0 / 16777216.0);
+}
+
+void main()
+{
+    vec3 position = posAndSize.xyz;
+    float size = posAndSize.w;
+    vec3 velocity = velocityAndAge.xyz;
+    float age = velocityAndAge.w + deltaTime;
+
+    // Every slot is reused as soon as its particle dies, so the emission rate is slot count / lifetime and
+    // independent of the frame rate. A slot is (re)born when its age crosses 0 or the lifetime
+    bool born = velocityAndAge.w < 0.0 && age >= 0.0;
+    if (age >= lifetime) {
+        age = mod(age, lifetime);
+        born = true;
+    }
+
+    if (born) {
+        uint state = hash(uint(gl_VertexID) ^ hash(frameSeed));
+        vec3 jitter = vec3(random01(state), random01(state), random01(state)) * 2.0 - 1.0;
+        velocity = baseVelocity + jitter * velocityJitter;
+        size = mix(sizeRange.x, sizeRange.y, random01(state));
+        // Born "age" seconds before the end of this step
+        position = emitterPosition + velocity * age;
+    } else if (age >= 0.0) {
+        // Simple, constant velocity motion
+        position += velocity * deltaTime;
+    }
+
+    outPosAndSize = vec4(position, size);
+    outVelocityAndAge = vec4(velocity, age);
+    // Fade out over the lifetime; slots not born yet keep size 0 and draw nothing
+    float lifeFraction = clamp(age / lifetime, 0.0, 1.0);
+    outAlphaAndFrame = vec2(age >= 0.0 ? 1.0 - lifeFraction : 0.0,
+                            flipbook.x + min(floor(lifeFraction * flipbook.y), flipbook.y - 1.0));
+}
@@ -0,0 +1,43 @@
+#version 410 core
+
+// Blends the reduced-resolution particles over the full-resolution scene. Each pixel mixes the four nearest
+// low-resolution texels with bilinear weights scaled down by how far their depth is from the pixel's own, so
+// particles neither bleed over the edges of nearer geometry nor leave a blocky halo around them
+in vec2 uv;
+
+out vec4 color;
+
+uniform sampler2D particleColor; // Premultiplied colour, alpha = coverage
+uniform sampler2D lowDepth;      // Linear distance of each block's nearest depth, see particle_depth.frag
+uniform sampler2D sceneDepth;
+uniform int factor;
+uniform ivec2 lowRenderSize;     // Rendered region of the low-resolution targets
+uniform vec2 nearFar;
+
+float linearDepth(float depth) {
+    float z = depth * 2.0 - 1.0;
+    return 2.0 * nearFar.x * nearFar.y / (nearFar.y + nearFar.x - z * (nearFar.y - nearFar.x));
+}
+
+void main() {
+    float pixelDepth = linearDepth(texelFetch(sceneDepth, ivec2(gl_FragCoord.xy), 0).r);
+
+    vec2 p = gl_FragCoord.xy / float(factor) - 0.5;
+    ivec2 base = ivec2(floor(p));
+    vec2 f = p - floor(p);
+
+    vec4 sum = vec4(0.0);
+    float weightSum = 0.0;
+    for (int y = 0; y < 2; y++) {
+        for (int x = 0; x < 2; x++) {
+            ivec2 texel = clamp(base + ivec2(x, y), ivec2(0), lowRenderSize - 1);
+            float bilinear = (x == 0 ? 1.0 - f.x : f.x) * (y == 0 ? 1.0 - f.y : f.y);
+            // Relative depth difference, so the falloff is the same near and far
+            float difference = abs(texelFetch(lowDepth, texel, 0).r - pixelDepth) / pixelDepth;
+            float weight = (bilinear + 1e-3) / (difference + 1e-2);
+            sum += texelFetch(particleColor, texel, 0) * weight;
+            weightSum += weight;
+        }
+    }
+    color = sum / weightSum;
+}
@@ -1,8 +1,11 @@
 #version 410 core
 
+// Feature defines (TEXTURED, UNLIT, INSTANCED, ALPHA_TEST, DEPTH_ONLY, STEREO) are inserted by ShaderVariants
+
+in vec2 TexCoords;
+#ifndef DEPTH_ONLY
 in vec3 fragNormal;
 in vec3 fragPos;
-in vec2 TexCoords;
 
 out vec4 color;
 
@@ -11,25 +14,103 @@ uniform vec3 viewPos;
 uniform vec3 lightColor;
 uniform vec3 ambientColor;
 uniform vec3 objectColor;
-uniform bool useTexture; // Use texture color or object color
 uniform float shininess;
 
+#ifndef UNLIT
+// Clustered point lights (lanterns), see LightClusters / LightBuffers
+uniform mat4 view;
+uniform samplerBuffer lightData;      // Two texels per light: position + radius, color
+uniform usamplerBuffer clusterRanges; // One texel per cluster: offset, count into lightIndices
+uniform usamplerBuffer lightIndices;
+uniform ivec3 clusterGrid;            // Tiles x, tiles y, depth slices
+uniform vec2 clusterSliceScaleBias;   // slice = log(view depth) * scale + bias
+uniform mat4 clusterViewProjection;  // Camera the clusters were built for: unjittered, covering both eyes in stereo
+
+// Sum of the point lights whose cluster list contains this fragment's cluster
+vec3 clusteredLights(vec3 norm, vec3 viewDir, vec3 baseColor) {
+    // The cluster comes from the fragment's position seen by the clusters' camera, not from gl_FragCoord, so it
+    // does not depend on the viewport, the render scale or which eye is drawn
+    vec4 clusterClip = clusterViewProjection * vec4(fragPos, 1.0);
+    float depth = clusterClip.w;
+    vec2 clusterUv = clusterClip.xy / clusterClip.w * 0.5 + 0.5;
+    ivec2 tile = clamp(ivec2(clusterUv * vec2(clusterGrid.xy)), ivec2(0), clusterGrid.xy - 1);
+    int slice = clamp(int(log(depth) * clusterSliceScaleBias.x + clusterSliceScaleBias.y), 0, clusterGrid.z - 1);
+    uvec2 range = texelFetch(clusterRanges, (slice * clusterGrid.y + tile.y) * clusterGrid.x + tile.x).xy;
+
+    vec3 result = vec3(0.0);
+    for (uint i = 0u; i < range.y; i++) {
+        int light = int(texelFetch(lightIndices, int(range.x + i)).r);
+        vec4 positionRadius = texelFetch(lightData, light * 2);
+        vec3 color = texelFetch(lightData, light * 2 + 1).rgb;
+
+        vec3 toLight = positionRadius.xyz - fragPos;
+        float dist = length(toLight);
+        // Inverse square falloff, windowed to reach exactly zero at the light's radius
+        float window = clamp(1.0 - pow(dist / positionRadius.w, 4.0), 0.0, 1.0);
+        float attenuation = window * window / (1.0 + dist * dist);
+
+        vec3 dir = toLight / max(dist, 1e-4);
+        float diff = max(dot(norm, dir), 0.0);
+        float spec = pow(max(dot(viewDir, reflect(-dir, norm)), 0.0), shininess);
+        result += attenuation * color * (diff * baseColor + spec);
+    }
+    return result;
+}
+
+// Cascaded shadow map of the controllable light, see ShadowCascades
+uniform sampler2DArrayShadow shadowMap;
+uniform mat4 shadowMatrices[4];  // World to shadow-map texture space, per cascade
+uniform vec4 shadowSplits;       // View-space far distance of each cascade
+uniform int shadowCascadeCount;  // 0: shadows off
+
+// Fraction of the controllable light that reaches the fragment
+float shadowFactor() {
+    float depth = -(view * vec4(fragPos, 1.0)).z;
+    int cascade = 0;
+    while (cascade < shadowCascadeCount && depth > shadowSplits[cascade])
+        cascade++;
+    if (cascade >= shadowCascadeCount)
+        return 1.0;
+
+    vec4 p = shadowMatrices[cascade] * vec4(fragPos, 1.0);
+    vec2 texel = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+    // Four bilinear comparisons half a texel apart: a smooth 3x3 texel filter
+    float lit = 0.0;
+    for (int i = 0; i < 4; i++) {
+        vec2 offset = (vec2(i & 1, i >> 1) - 0.5) * texel;
+        lit += texture(shadowMap, vec4(p.xy + offset, float(cascade), p.z));
+    }
+    return lit * 0.25;
+}
+#endif
+#endif
+
 uniform sampler2D texture_diffuse1;
-uniform bool u_unlit; // A switch to disable lighting
+#ifdef ALPHA_TEST
+uniform float alphaCutoff;
+#endif
 
 void main() {
-    vec3 baseColor;
-    if(useTexture)
-        baseColor = texture(texture_diffuse1, TexCoords).rgb; // Use texture color
-    else
-        baseColor = objectColor; // Use uniform color
-
-    // If u_unlit is true, skip all lighting calculations
-    if(u_unlit) {
-        color = vec4(baseColor, 1.0);
-        return;
-    }
+#ifdef TEXTURED
+    vec4 texel = texture(texture_diffuse1, TexCoords);
+#endif
+#ifdef ALPHA_TEST
+    // Only alpha-tested variants contain a discard, so early-z stays enabled for everything else
+    if (texel.a < alphaCutoff)
+        discard;
+#endif
 
+#ifndef DEPTH_ONLY
+#ifdef TEXTURED
+    vec3 baseColor = texel.rgb; // Use texture color
+#else
+    vec3 baseColor = objectColor; // Use uniform color
+#endif
+
+#ifdef UNLIT
+    // Lighting disabled
+    color = vec4(baseColor, 1.0);
+#else
     vec3 norm = normalize(fragNormal);
     vec3 lightDir = normalize(lightPos - fragPos);
 
@@ -55,7 +136,15 @@ void main() {
     // Specular light directly uses the light source's color (green), making the highlight very prominent
     vec3 specular_light = specular;
 
+    // The controllable light does not reach fragments in shadow; ambient and lanterns still do
+    float shadow = shadowFactor();
+    diffuse_light *= shadow;
+    specular_light *= shadow;
+
     // Composition
     vec3 result = ambient_light + diffuse_light + specular_light;
+    result += clusteredLights(norm, viewDir, baseColor);
     color = vec4(result, 1.0);
-}
\ No newline at end of file
+#endif
+#endif
+}
@@ -1,21 +1,57 @@
 #version 410 core
 
+// Feature defines (TEXTURED, UNLIT, INSTANCED, ALPHA_TEST, DEPTH_ONLY, STEREO) are inserted by ShaderVariants
+
 layout(location = 0) in vec3 position;
 layout(location = 1) in vec3 normal;
 layout(location = 2) in vec2 aTexCoords;
+#ifdef INSTANCED
+layout(location = 3) in mat4 instanceModel; // Per-instance model matrix, occupies locations 3-6
+#endif
 
+#ifndef DEPTH_ONLY
 out vec3 fragNormal;
 out vec3 fragPos;
+#endif
 out vec2 TexCoords;
 
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 proj;
 uniform mat3 normalMat;
+#ifdef STEREO
+uniform float stereoHalfSeparation; // Half the distance between the eyes, along the view's x axis
+#endif
+
+// Every permutation must produce bit-identical depth so the depth pre-pass can be tested with GL_LEQUAL
+invariant gl_Position;
 
 void main() {
-    gl_Position = proj * view * model * vec4(position, 1.0);
-    fragPos = vec3(model * vec4(position, 1.0));
+#ifdef INSTANCED
+    mat4 modelMat = instanceModel;
+#else
+    mat4 modelMat = model;
+#endif
+#ifdef STEREO
+    // Single-pass stereo: each draw is instanced twice (instanced models advance their attributes every
+    // second instance). Even instances are the left eye, odd ones the right; each eye is squeezed into its
+    // half of the target and clipped there
+    float side = (gl_InstanceID & 1) == 0 ? -1.0 : 1.0;
+    vec4 viewPosition = view * modelMat * vec4(position, 1.0);
+    viewPosition.x -= side * stereoHalfSeparation;
+    gl_Position = proj * viewPosition;
+    gl_Position.x = gl_Position.x * 0.5 + side * 0.5 * gl_Position.w;
+    gl_ClipDistance[0] = side * gl_Position.x;
+#else
+    gl_Position = proj * view * modelMat * vec4(position, 1.0);
+#endif
+#ifndef DEPTH_ONLY
+    fragPos = vec3(modelMat * vec4(position, 1.0));
+#ifdef INSTANCED
+    fragNormal = transpose(inverse(mat3(modelMat))) * normal;
+#else
     fragNormal = normalMat * normal;
+#endif
+#endif
     TexCoords = aTexCoords;
-}
\ No newline at end of file
+}
@@ -1,10 +1,15 @@
 #version 410 core
+
+// STEREO is inserted by ShaderVariants for single-pass stereo
 layout (location = 0) in vec3 aPos;
 
 out vec3 TexCoords;
 
-uniform mat4 projection;
-uniform mat4 view;
+// Filled by GLRenderDevice from the command list's push constants
+layout (std140) uniform PushConstants {
+    mat4 view;
+    mat4 projection;
+};
 
 void main()
 {
@@ -14,4 +19,10 @@ void main()
     vec4 pos = projection * viewNoTranslation * vec4(aPos, 1.0);
     // Use the "z = w" trick to ensure the skybox is always at the far depth plane
     gl_Position = pos.xyww;
+#ifdef STEREO
+    // The sky is the same for both eyes; even instances draw it into the left half, odd ones the right
+    float side = (gl_InstanceID & 1) == 0 ? -1.0 : 1.0;
+    gl_Position.x = gl_Position.x * 0.5 + side * 0.5 * gl_Position.w;
+    gl_ClipDistance[0] = side * gl_Position.x;
+#endif
 }
@@ -0,0 +1,262 @@
+// Renders the windmill scene on the CPU with SoftwareRasterizer, without a window or GPU, and writes a PNG: a
+// reference image for golden-image checks and offline previews. The frame is rendered with 1, 2, 4, ... threads up
+// to --threads to show how it scales; every thread count must produce the same image.
+//   software_headless [--width <pixels>] [--height <pixels>] [--frames <count>] [--threads <count>]
+//                     [--body <degrees>] [--blades <degrees>] [--output <file.png>]
+//                     [--compare <reference.png>] [--tolerance <difference>] [--max-mismatches <pixels>]
+// With --compare, the image is checked against a reference: a pixel matches when no channel differs by more than
+// --tolerance (0 by default) from the reference pixel or one of its neighbours, and up to --max-mismatches pixels
+// (0 by default) may fail that, for slivers that only one build covers. Exits with 1 when more pixels mismatch or
+// when the thread counts disagree.
+// Run from the build directory, where the objects and textures are copied.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "geometry.h"
+#include "model.h"
+#include "png_writer.h"
+#include "software_raster.h"
+#include "thread_pool.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+namespace {
+    // Loads an image as RGBA, as the GL renderer's loadTexture() does (without mipmaps)
+    bool loadTexture(const std::string &path, SoftwareTexture &texture) {
+        int width, height, channels;
+        unsigned char *data = stbi_load(path.c_str(), &width, &height, &channels, 4);
+        if (!data) {
+            std::cout << "Texture failed to load at path: " << path << std::endl;
+            return false;
+        }
+        texture.width = width;
+        texture.height = height;
+        texture.rgba.assign(data, data + static_cast<size_t>(width) * height * 4);
+        stbi_image_free(data);
+        return true;
+    }
+
+    // Largest channel difference between two RGBA pixels
+    int pixelDifference(const unsigned char *a, const unsigned char *b) {
+        int difference = 0;
+        for (int channel = 0; channel < 4; channel++) {
+            difference = std::max(difference, std::abs(a[channel] - b[channel]));
+        }
+        return difference;
+    }
+
+    // Counts the pixels that match neither the reference pixel nor one of its neighbours to within "tolerance", so
+    // edges that move by a pixel between builds (SSE or scalar, other compilers) are not mismatches, and finds the
+    // largest difference from the reference pixel. Returns false if the reference cannot be read or has another size
+    bool compareImages(const std::string &referencePath, const std::vector<unsigned char> &image, int width,
+                       int height, int tolerance, int &mismatches, int &largestDifference) {
+        int referenceWidth, referenceHeight, channels;
+        unsigned char *reference = stbi_load(referencePath.c_str(), &referenceWidth, &referenceHeight, &channels, 4);
+        if (!reference) {
+            std::cout << "ERROR::SOFTWARE_HEADLESS::REFERENCE_NOT_READ " << referencePath << std::endl;
+            return false;
+        }
+        const bool sameSize = referenceWidth == width && referenceHeight == height;
+        if (!sameSize) {
+            std::cout << "ERROR::SOFTWARE_HEADLESS::REFERENCE_SIZE " << referenceWidth << "x" << referenceHeight
+                    << " instead of " << width << "x" << height << std::endl;
+        }
+        mismatches = 0;
+        largestDifference = 0;
+        for (int y = 0; sameSize && y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                const size_t offset = (static_cast<size_t>(y) * width + x) * 4;
+                const unsigned char *pixel = &image[offset];
+                largestDifference = std::max(largestDifference, pixelDifference(pixel, &reference[offset]));
+                bool matched = false;
+                for (int ny = std::max(y - 1, 0); !matched && ny <= std::min(y + 1, height - 1); ny++) {
+                    for (int nx = std::max(x - 1, 0); !matched && nx <= std::min(x + 1, width - 1); nx++) {
+                        const size_t neighbour = (static_cast<size_t>(ny) * width + nx) * 4;
+                        matched = pixelDifference(pixel, &reference[neighbour]) <= tolerance;
+                    }
+                }
+                if (!matched) mismatches++;
+            }
+        }
+        stbi_image_free(reference);
+        return sameSize;
+    }
+}
+
+int main(int argc, char **argv) {
+    int width = 1280, height = 960, frames = 5;
+    int maxThreads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    float bodyAngle = 0.0f, bladeAngle = 0.0f;
+    std::string output = "software_headless.png", reference;
+    int tolerance = 0, maxMismatches = 0;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--width" && i + 1 < argc) width = std::max(std::atoi(argv[++i]), 16);
+        else if (arg == "--height" && i + 1 < argc) height = std::max(std::atoi(argv[++i]), 16);
+        else if (arg == "--frames" && i + 1 < argc) frames = std::max(std::atoi(argv[++i]), 1);
+        else if (arg == "--threads" && i + 1 < argc) maxThreads = std::max(std::atoi(argv[++i]), 1);
+        else if (arg == "--body" && i + 1 < argc) bodyAngle = static_cast<float>(std::atof(argv[++i]));
+        else if (arg == "--blades" && i + 1 < argc) bladeAngle = static_cast<float>(std::atof(argv[++i]));
+        else if (arg == "--output" && i + 1 < argc) output = argv[++i];
+        else if (arg == "--compare" && i + 1 < argc) reference = argv[++i];
+        else if (arg == "--tolerance" && i + 1 < argc) tolerance = std::max(std::atoi(argv[++i]), 0);
+        else if (arg == "--max-mismatches" && i + 1 < argc) maxMismatches = std::max(std::atoi(argv[++i]), 0);
+        else {
+            std::cout << "Usage: " << argv[0] << " [--width <pixels>] [--height <pixels>] [--frames <count>]"
+                    << " [--threads <count>] [--body <degrees>] [--blades <degrees>] [--output <file.png>]"
+                    << " [--compare <reference.png>] [--tolerance <difference>] [--max-mismatches <pixels>]"
+                    << std::endl;
+            return 1;
+        }
+    }
+
+    // === Assets ===
+    // The models stay on the CPU: there is no GL context
+    Model groundModel("objects/Ground/plane.obj", false);
+    Model treeA_model("objects/Tree_A/Tree.obj", false);
+    Model treeB_model("objects/Tree_B/Tree.obj", false);
+    Model cabinModel("objects/Cabin/farmhouse_obj.obj", false);
+    Model benchModel("objects/Bench/Bench_HighRes.obj", false);
+
+    SoftwareTexture groundTexture, towerTexture, capTexture, chimneyTexture;
+    bool loaded = loadTexture("textures/Grass004_1K-JPG/Grass004_1K-JPG_Color.jpg", groundTexture);
+    loaded &= loadTexture("textures/Bricks099_1K-JPG/Bricks099_1K-JPG_Color.jpg", towerTexture);
+    loaded &= loadTexture("textures/Bricks094_1K-JPG/Bricks094_1K-JPG_Color.jpg", capTexture);
+    loaded &= loadTexture("textures/PavingStones135_1K-JPG/PavingStones135_1K-JPG_Color.jpg", chimneyTexture);
+    SoftwareTexture skyboxFaces[6];
+    const char *const faceNames[6] = {"px", "nx", "py", "ny", "pz", "nz"};
+    for (int face = 0; face < 6; face++) {
+        loaded &= loadTexture(std::string("textures/sky_15_2k/sky_15_cubemap_2k/") + faceNames[face] + ".png",
+                              skyboxFaces[face]);
+    }
+    if (!loaded) return 1;
+
+    std::vector<float> hubVertexData, chimneyVertexData;
+    std::vector<GLuint> hubIndices, chimneyIndices;
+    Geometry::buildHub(hubVertexData, hubIndices);
+    Geometry::buildChimney(chimneyVertexData, chimneyIndices);
+
+    // === Materials ===
+    // As the GL renderer draws them: the cabin, benches and trees use the chimney's stone texture
+    SoftwareMaterial towerMaterial, capMaterial, bladeMaterial, hubMaterial;
+    towerMaterial.texture = &towerTexture;
+    capMaterial.texture = &capTexture;
+    bladeMaterial.objectColor = glm::vec3(0.35f, 0.3f, 0.85f);
+    hubMaterial.objectColor = glm::vec3(0.1f, 0.1f, 0.05f);
+    SoftwareMaterial chimneyMaterial, stoneMaterial, groundMaterial, treeMaterial;
+    chimneyMaterial.texture = &chimneyTexture;
+    chimneyMaterial.unlit = true;
+    stoneMaterial.texture = &chimneyTexture;
+    groundMaterial.texture = &groundTexture;
+    treeMaterial.texture = &chimneyTexture;
+    treeMaterial.alphaTested = true;
+
+    // === Camera & Light ===
+    // The windowed renderer's starting view, by day
+    const glm::vec3 cameraPos(0.0f, 6.5f, 20.0f);
+    const glm::mat4 view = glm::lookAt(cameraPos, glm::vec3(0.0f, 6.5f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    const glm::mat4 projection = glm::perspective(glm::radians(45.0f), static_cast<float>(width) / height, 0.1f,
+                                                  100.0f);
+    SoftwareLighting lighting;
+    lighting.viewPos = cameraPos;
+    lighting.lightPos = glm::vec3(0.0f, 10.0f, 5.0f);
+    lighting.lightColor = glm::vec3(1.0f, 0.5f, 0.1f);
+    lighting.ambientColor = glm::vec3(0.76f, 0.64f, 0.23f);
+    lighting.shininess = 32.0f;
+    lighting.alphaCutoff = 0.5f;
+
+    SoftwareRasterizer rasterizer(width, height);
+    rasterizer.setSkybox(skyboxFaces);
+    auto renderFrame = [&]() {
+        rasterizer.beginFrame(view, projection, lighting, glm::vec4(0.1f, 0.1f, 0.1f, 1.0f));
+        rasterizer.draw(Geometry::towerVertices, 8, Geometry::towerIndices, Geometry::towerTransform(bodyAngle),
+                        towerMaterial);
+        rasterizer.draw(Geometry::capVertices, 8, Geometry::capIndices, Geometry::capTransform(bodyAngle),
+                        capMaterial);
+        for (int i = 0; i < 4; i++) {
+            rasterizer.draw(Geometry::bladeVertices, 6, Geometry::bladeIndices,
+                            Geometry::bladeTransform(bodyAngle, bladeAngle, i), bladeMaterial);
+        }
+        rasterizer.draw(hubVertexData, 6, hubIndices, Geometry::hubTransform(bodyAngle), hubMaterial);
+        rasterizer.draw(chimneyVertexData, Geometry::chimneyVertexStride, chimneyIndices,
+                        Geometry::chimneyTransform(), chimneyMaterial);
+        rasterizer.draw(cabinModel, Geometry::cabinTransform(), stoneMaterial);
+        rasterizer.draw(benchModel, Geometry::bench1Transform(), stoneMaterial);
+        rasterizer.draw(benchModel, Geometry::bench2Transform(), stoneMaterial);
+        rasterizer.draw(groundModel, Geometry::groundTransform(), groundMaterial);
+        for (const glm::vec3 &position: Geometry::treeA_positions) {
+            rasterizer.draw(treeA_model, Geometry::treeTransform(position, Geometry::treeA_scale), treeMaterial);
+        }
+        for (const glm::vec3 &position: Geometry::treeB_positions) {
+            rasterizer.draw(treeB_model, Geometry::treeTransform(position, Geometry::treeB_scale), treeMaterial);
+        }
+        rasterizer.endFrame();
+    };
+
+    // === Scaling ===
+    std::vector<int> threadCounts;
+    for (int threads = 1; threads < maxThreads; threads *= 2) threadCounts.push_back(threads);
+    threadCounts.push_back(maxThreads);
+
+    using Clock = std::chrono::high_resolution_clock;
+    double singleThreadMs = 0.0;
+    std::vector<unsigned char> singleThreadImage;
+    bool threadsAgree = true;
+    for (const int threads: threadCounts) {
+        ThreadPool threadPool(static_cast<unsigned int>(threads));
+        rasterizer.setThreadPool(&threadPool);
+        renderFrame(); // Warm-up: first-touch allocations of the bins
+        double totalMs = 0.0;
+        for (int frame = 0; frame < frames; frame++) {
+            const auto start = Clock::now();
+            renderFrame();
+            totalMs += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        }
+        const double frameMs = totalMs / frames;
+        if (threads == 1) {
+            singleThreadMs = frameMs;
+            singleThreadImage = rasterizer.getImage();
+        } else if (rasterizer.getImage() != singleThreadImage) {
+            std::cout << "ERROR::SOFTWARE_HEADLESS::THREADS_DIFFER " << threads << " threads" << std::endl;
+            threadsAgree = false;
+        }
+        const SoftwareRasterizer::Stats &stats = rasterizer.getStats();
+        std::printf("%2d threads: %8.2f ms per frame (x%.2f); vertices %.2f ms, binning %.2f ms, tiles %.2f ms\n",
+                    threads, frameMs, singleThreadMs / frameMs, stats.vertexMs, stats.binMs, stats.rasterMs);
+        rasterizer.setThreadPool(nullptr);
+    }
+    const SoftwareRasterizer::Stats &stats = rasterizer.getStats();
+    std::printf("%d draws, %d triangles, %d rasterized after clipping, %d triangle-tile pairs\n", stats.draws,
+                stats.triangles, stats.rasterized, stats.binned);
+
+    // === Output ===
+    if (!writePNG(output, rasterizer.getImage().data(), width, height)) {
+        std::cout << "ERROR::SOFTWARE_HEADLESS::IMAGE_NOT_WRITTEN" << std::endl;
+        return 1;
+    }
+    std::cout << "Wrote " << output << " (" << width << "x" << height << ")" << std::endl;
+    if (!threadsAgree) return 1;
+
+    // === Comparison ===
+    if (!reference.empty()) {
+        int mismatches = 0, largestDifference = 0;
+        if (!compareImages(reference, rasterizer.getImage(), width, height, tolerance, mismatches,
+                           largestDifference)) {
+            return 1;
+        }
+        std::cout << "Compared with " << reference << ": " << mismatches << " pixels differ by more than "
+                << tolerance << " from their neighbourhood, " << maxMismatches << " allowed (largest difference "
+                << largestDifference << ")" << std::endl;
+        if (mismatches > maxMismatches) return 1;
+    }
+    return 0;
+}
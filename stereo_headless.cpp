@@ -0,0 +1,159 @@
+// Test for StereoRig's CPU side, without a window or GPU. Random points are projected both ways the rig renders
+// stereo: two passes with eyeView() and passViewport(), and one pass with shader.vert's STEREO path (ported below),
+// which must put every point on the same pixel of the side-by-side target and clip it to its eye's half. Points in
+// either eye's frustum must also be inside cullingView()'s frustum, and the benchmark must step through every mode
+// and back. The GPU and submission timings of the modes need a GL context; they stay in the overlay's benchmark.
+//   stereo_headless [--points <count>]
+// Exits with 1 when a check fails.
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "stereo.h"
+
+namespace {
+    constexpr float FOV_Y = glm::radians(45.0f), ASPECT = 800.0f / 600.0f, Z_NEAR = 0.1f, Z_FAR = 100.0f;
+    const glm::ivec2 RENDER_SIZE(1280, 720);
+    const glm::vec3 LOOK_AT(0.0f, 6.5f, 0.0f), UP(0.0f, 1.0f, 0.0f);
+    // GL's minimum sub-pixel precision: a smaller difference cannot change which pixels are covered
+    constexpr float PIXEL_TOLERANCE = 1.0f / 16.0f;
+
+    int failures = 0;
+
+    void check(bool condition, const std::string &what) {
+        if (condition) return;
+        if (failures < 20) std::cout << "FAIL " << what << std::endl;
+        failures++;
+    }
+
+    // Pixel of a point in the whole render target, from the single-pass STEREO vertex shader. "kept" is false when
+    // gl_ClipDistance[0] clips it away from its eye's half
+    glm::vec2 singlePassPixel(const StereoRig &rig, const glm::mat4 &projection, const glm::mat4 &view,
+                              const glm::vec3 &point, int eye, bool &kept) {
+        const float side = eye == 0 ? -1.0f : 1.0f;
+        glm::vec4 viewPosition = view * glm::vec4(point, 1.0f);
+        viewPosition.x -= side * rig.getHalfSeparation();
+        glm::vec4 clip = projection * viewPosition;
+        clip.x = clip.x * 0.5f + side * 0.5f * clip.w;
+        kept = side * clip.x >= 0.0f;
+        return (glm::vec2(clip) / clip.w * 0.5f + 0.5f) * glm::vec2(RENDER_SIZE);
+    }
+
+    // Pixel of a point in the whole render target when its eye is rendered as a pass of its own
+    glm::vec2 twoPassPixel(const StereoRig &rig, const glm::mat4 &projection, const glm::mat4 &view,
+                           const glm::vec3 &point, int eye) {
+        const glm::vec4 clip = projection * rig.eyeView(view, eye) * glm::vec4(point, 1.0f);
+        const glm::ivec4 viewport = rig.passViewport(RENDER_SIZE, eye);
+        return glm::vec2(viewport.x, viewport.y) +
+               (glm::vec2(clip) / clip.w * 0.5f + 0.5f) * glm::vec2(viewport.z, viewport.w);
+    }
+
+    void checkModes() {
+        StereoRig rig;
+        check(rig.passCount() == 1 && rig.viewsPerDraw() == 1 && rig.shaderFeatures() == 0u &&
+              rig.getHalfSeparation() == 0.0f && rig.eyeSize(RENDER_SIZE) == RENDER_SIZE, "mono settings");
+        rig.setMode(StereoRig::Mode::TwoPass);
+        check(rig.passCount() == 2 && rig.viewsPerDraw() == 1 && rig.shaderFeatures() == 0u, "two-pass settings");
+        rig.setMode(StereoRig::Mode::SinglePass);
+        check(rig.passCount() == 1 && rig.viewsPerDraw() == 2 && rig.shaderFeatures() != 0u, "single-pass settings");
+        check(rig.eyeSize(RENDER_SIZE) == glm::ivec2(RENDER_SIZE.x / 2, RENDER_SIZE.y), "eye size");
+    }
+
+    void checkProjections(int points) {
+        std::mt19937 random(1234u);
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f), depth(0.0f, 1.0f), angle(0.0f, 6.2832f);
+        const glm::mat4 projection = glm::perspective(FOV_Y, ASPECT, Z_NEAR, Z_FAR);
+
+        StereoRig singlePass, twoPass;
+        singlePass.setMode(StereoRig::Mode::SinglePass);
+        twoPass.setMode(StereoRig::Mode::TwoPass);
+        for (int i = 0; i < points; i++) {
+            // Cameras around the windmill, like the windowed renderer's
+            const float a = angle(random);
+            const glm::vec3 cameraPosition(std::cos(a) * 20.0f, 2.0f + depth(random) * 10.0f, std::sin(a) * 20.0f);
+            const glm::mat4 view = glm::lookAt(cameraPosition, LOOK_AT, UP);
+            const int eye = i & 1;
+
+            // A point inside this eye's frustum, placed by NDC and view depth (exponentially, like the detail is)
+            const float distance = Z_NEAR * std::pow(Z_FAR / Z_NEAR, depth(random) * 0.999f);
+            const glm::vec2 ndc(unit(random), unit(random));
+            const glm::vec4 eyeViewPosition(ndc.x * distance * std::tan(FOV_Y * 0.5f) * ASPECT,
+                                            ndc.y * distance * std::tan(FOV_Y * 0.5f), -distance, 1.0f);
+            const glm::vec3 point = glm::vec3(glm::inverse(twoPass.eyeView(view, eye)) * eyeViewPosition);
+
+            bool kept = false;
+            const glm::vec2 single = singlePassPixel(singlePass, projection, view, point, eye, kept);
+            const glm::vec2 twoPasses = twoPassPixel(twoPass, projection, view, point, eye);
+            const float error = glm::length(single - twoPasses);
+            check(kept, "single pass clips away a point inside eye " + std::to_string(eye) + "'s frustum");
+            check(error < PIXEL_TOLERANCE, "single and two passes differ by " + std::to_string(error) + " px for eye " +
+                  std::to_string(eye));
+
+            // The same point seen by the other eye is clipped away once it leaves that eye's half
+            const int otherEye = 1 - eye;
+            const glm::vec4 otherClip = projection * twoPass.eyeView(view, otherEye) * glm::vec4(point, 1.0f);
+            bool otherKept = false;
+            singlePassPixel(singlePass, projection, view, point, otherEye, otherKept);
+            if (otherEye == 0 ? otherClip.x > otherClip.w : otherClip.x < -otherClip.w) {
+                check(!otherKept, "eye " + std::to_string(otherEye) + " bleeds into the other half");
+            }
+
+            // Culling once for both eyes: the point must be inside the culling frustum's sides and past its near
+            // plane (cullingView() moves the camera back, so its far plane is short of the eyes' by the pull-back)
+            const glm::mat4 cullingView = singlePass.cullingView(view, FOV_Y, ASPECT);
+            const glm::vec4 cullClip = projection * cullingView * glm::vec4(point, 1.0f);
+            const float slack = cullClip.w * 1.0e-4f;
+            check(std::abs(cullClip.x) <= cullClip.w + slack && std::abs(cullClip.y) <= cullClip.w + slack &&
+                  cullClip.z >= -cullClip.w - slack, "point in eye " + std::to_string(eye) +
+                  "'s frustum is outside the culling frustum");
+        }
+    }
+
+    void checkBenchmark() {
+        constexpr int FRAMES_PER_MODE = 12;
+        StereoRig rig;
+        rig.setMode(StereoRig::Mode::SinglePass);
+        rig.startBenchmark(FRAMES_PER_MODE);
+        int frame = 0;
+        for (; rig.isBenchmarking() && frame < StereoRig::MODE_COUNT * FRAMES_PER_MODE * 2; frame++) {
+            const auto expected = static_cast<StereoRig::Mode>(frame / FRAMES_PER_MODE);
+            check(rig.getMode() == expected, "benchmark frame " + std::to_string(frame) + " in the wrong mode");
+            StereoRig::Sample sample;
+            sample.submitMs = frame;
+            sample.drawCalls = frame;
+            const StereoRig::Mode measured = rig.getMode();
+            rig.record(sample);
+            check(rig.getLast(measured).drawCalls == frame, "benchmark sample not recorded");
+        }
+        check(frame == StereoRig::MODE_COUNT * FRAMES_PER_MODE, "benchmark ran " + std::to_string(frame) + " frames");
+        check(rig.getMode() == StereoRig::Mode::SinglePass, "benchmark did not restore the mode");
+    }
+}
+
+int main(int argc, char **argv) {
+    int points = 100000;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--points" && i + 1 < argc) points = std::max(std::atoi(argv[++i]), 2);
+        else {
+            std::cout << "Usage: " << argv[0] << " [--points <count>]" << std::endl;
+            return 2;
+        }
+    }
+
+    checkModes();
+    checkProjections(points);
+    checkBenchmark();
+
+    if (failures > 0) {
+        std::cout << failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "Stereo projections, culling view and benchmark checked over " << points << " points" << std::endl;
+    return 0;
+}
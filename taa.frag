@@ -0,0 +1,47 @@
+#version 410 core
+
+// Temporal AA: blends the jittered frame into the history, reprojected with the camera motion
+in vec2 uv;
+
+out vec4 color;
+
+uniform sampler2D currentColor;
+uniform sampler2D currentDepth;
+uniform sampler2D history;
+uniform vec2 renderScale;    // This frame's rendered region / texture size
+uniform vec2 historyScale;   // The same for the frame the history was rendered at
+uniform vec2 texelSize;      // 1 / texture size
+uniform mat4 reprojection;   // This frame's unjittered NDC to the previous frame's clip space
+uniform vec2 jitter;         // This frame's projection jitter, in NDC
+uniform float historyWeight; // 0 starts a new history
+
+void main() {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    ivec2 renderSize = ivec2(renderScale / texelSize + 0.5);
+
+    // Colour range of the 3x3 neighbourhood: a history colour outside it belongs to something else
+    vec3 current = texelFetch(currentColor, pixel, 0).rgb;
+    vec3 lowest = current;
+    vec3 highest = current;
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            vec3 neighbour = texelFetch(currentColor, clamp(pixel + ivec2(x, y), ivec2(0), renderSize - 1), 0).rgb;
+            lowest = min(lowest, neighbour);
+            highest = max(highest, neighbour);
+        }
+    }
+
+    // Where the surface seen through this pixel was on screen last frame (camera motion only)
+    vec2 screen = (vec2(pixel) + 0.5) / vec2(renderSize);
+    float depth = texelFetch(currentDepth, pixel, 0).r;
+    vec4 previous = reprojection * vec4(screen * 2.0 - 1.0 - jitter, depth * 2.0 - 1.0, 1.0);
+    vec2 previousScreen = previous.xy / previous.w * 0.5 + 0.5;
+
+    float weight = historyWeight;
+    if (any(lessThan(previousScreen, vec2(0.0))) || any(greaterThan(previousScreen, vec2(1.0))))
+        weight = 0.0; // Off screen last frame
+    vec2 historyUV = clamp(previousScreen * historyScale, 0.5 * texelSize, historyScale - 0.5 * texelSize);
+    vec3 past = clamp(texture(history, historyUV).rgb, lowest, highest);
+
+    color = vec4(mix(current, past, weight), 1.0);
+}
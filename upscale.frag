@@ -0,0 +1,32 @@
+#version 410 core
+
+// Bilinear upscale of the dynamic-resolution scene with contrast-adaptive sharpening
+in vec2 uv;
+
+out vec4 color;
+
+uniform sampler2D sceneColor;
+uniform vec2 renderScale; // Rendered region / texture size; the scene occupies the lower-left corner
+uniform vec2 texelSize;   // 1 / texture size
+uniform float sharpness;  // 0: plain bilinear, 1: strongest
+
+void main() {
+    // Never filter across the edge of the rendered region
+    vec2 lo = 0.5 * texelSize;
+    vec2 hi = renderScale - 0.5 * texelSize;
+    vec2 p = clamp(uv * renderScale, lo, hi);
+
+    vec3 c = texture(sceneColor, p).rgb;
+    vec3 n = texture(sceneColor, clamp(p + vec2(0.0, texelSize.y), lo, hi)).rgb;
+    vec3 s = texture(sceneColor, clamp(p - vec2(0.0, texelSize.y), lo, hi)).rgb;
+    vec3 e = texture(sceneColor, clamp(p + vec2(texelSize.x, 0.0), lo, hi)).rgb;
+    vec3 w = texture(sceneColor, clamp(p - vec2(texelSize.x, 0.0), lo, hi)).rgb;
+
+    // Sharpen less where the neighbourhood already has a lot of contrast, so edges do not ring
+    vec3 lowest = min(c, min(min(n, s), min(e, w)));
+    vec3 highest = max(c, max(max(n, s), max(e, w)));
+    vec3 amount = sqrt(clamp(min(lowest, 1.0 - highest) / max(highest, 1e-4), 0.0, 1.0));
+    vec3 weight = amount * (-0.2 * sharpness);
+
+    color = vec4(clamp((c + (n + s + e + w) * weight) / (1.0 + 4.0 * weight), 0.0, 1.0), 1.0);
+}
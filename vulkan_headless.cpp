@@ -0,0 +1,242 @@
+// Renders a field of cubes with the Vulkan render device, without a window, and writes vulkan_headless.ppm.
+// The draws are recorded into one command list per ThreadPool thread, in parallel, and for comparison into a
+// single list on one thread; both must give the same image, and the cubes must cover part of it. Each frame in
+// flight has its own lists, so recording a frame does not wait for the previous one to finish. Runs on any
+// Vulkan 1.3 driver, Mesa's lavapipe included:
+//   vulkan_headless [--cpu] [--validation] [--size <pixels>] [--grid <cubes per side>] [--frames <count>]
+// Exits with 1 when a check fails, or with --validation when the layer is missing or reports an error.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "thread_pool.h"
+#include "vulkan_device.h"
+
+namespace {
+    const glm::vec4 CLEAR_COLOR(0.55f, 0.7f, 0.85f, 1.0f);
+
+    struct CubeConstants {
+        glm::mat4 mvp;
+        glm::vec4 color;
+    };
+
+    // Unit cube around the origin, position and normal per vertex, wound counter-clockwise seen from outside
+    void buildCube(std::vector<float> &vertices, std::vector<uint32_t> &indices) {
+        for (int axis = 0; axis < 3; axis++) {
+            for (int sign = -1; sign <= 1; sign += 2) {
+                glm::vec3 normal(0.0f), u(0.0f), v(0.0f);
+                normal[axis] = static_cast<float>(sign);
+                u[(axis + 1) % 3] = 1.0f;
+                v[(axis + 2) % 3] = 1.0f;
+                if (sign < 0) std::swap(u, v);
+
+                const auto first = static_cast<uint32_t>(vertices.size() / 6);
+                const glm::vec2 corners[4] = {{-0.5f, -0.5f}, {0.5f, -0.5f}, {0.5f, 0.5f}, {-0.5f, 0.5f}};
+                for (const glm::vec2 &corner: corners) {
+                    const glm::vec3 position = normal * 0.5f + corner.x * u + corner.y * v;
+                    vertices.insert(vertices.end(), {position.x, position.y, position.z, normal.x, normal.y, normal.z});
+                }
+                indices.insert(indices.end(), {first, first + 1, first + 2, first, first + 2, first + 3});
+            }
+        }
+    }
+
+    bool writePPM(const char *path, const std::vector<unsigned char> &rgba, int width, int height) {
+        std::ofstream file(path, std::ios::binary);
+        if (!file) return false;
+        file << "P6\n" << width << " " << height << "\n255\n";
+        for (size_t i = 0; i < rgba.size(); i += 4) {
+            file.write(reinterpret_cast<const char *>(&rgba[i]), 3);
+        }
+        return static_cast<bool>(file);
+    }
+}
+
+int main(int argc, char **argv) {
+    bool preferCpu = false, validation = false;
+    int size = 768, grid = 48, frames = 20;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--cpu") preferCpu = true;
+        else if (arg == "--validation") validation = true;
+        else if (arg == "--size" && i + 1 < argc) size = std::max(std::atoi(argv[++i]), 16);
+        else if (arg == "--grid" && i + 1 < argc) grid = std::max(std::atoi(argv[++i]), 1);
+        else if (arg == "--frames" && i + 1 < argc) frames = std::max(std::atoi(argv[++i]), 1);
+        else {
+            std::cout << "Usage: " << argv[0] << " [--cpu] [--validation] [--size <pixels>] [--grid <cubes>]"
+                    << " [--frames <count>]" << std::endl;
+            return 1;
+        }
+    }
+
+    VulkanRenderDevice device(preferCpu, validation);
+    if (!device.isValid()) return 1;
+    if (validation && !device.isValidating()) {
+        std::cout << "ERROR::VULKAN_HEADLESS::VALIDATION_UNAVAILABLE" << std::endl;
+        return 1;
+    }
+    std::cout << "Device: " << device.name() << (validation ? ", validation on" : "") << std::endl;
+
+    // === Resources ===
+    std::vector<float> cubeVertices;
+    std::vector<uint32_t> cubeIndices;
+    buildCube(cubeVertices, cubeIndices);
+    const BufferHandle vertexBuffer = device.createBuffer({BufferUsage::Vertex, cubeVertices.size() * sizeof(float),
+                                                           cubeVertices.data()});
+    const BufferHandle indexBuffer = device.createBuffer({BufferUsage::Index, cubeIndices.size() * sizeof(uint32_t),
+                                                          cubeIndices.data()});
+
+    TextureDesc colorDesc;
+    colorDesc.width = size;
+    colorDesc.height = size;
+    colorDesc.renderTarget = true;
+    const TextureHandle colorTarget = device.createTexture(colorDesc);
+    TextureDesc depthDesc = colorDesc;
+    depthDesc.format = TextureFormat::Depth32F;
+    const TextureHandle depthTarget = device.createTexture(depthDesc);
+
+    PipelineDesc pipelineDesc;
+    pipelineDesc.vertexShader = "headless.vert";
+    pipelineDesc.fragmentShader = "headless.frag";
+    pipelineDesc.vertexStride = 6 * sizeof(float);
+    pipelineDesc.attributes = {{0, 3, 0}, {1, 3, 3 * sizeof(float)}};
+    pipelineDesc.pushConstantSize = sizeof(CubeConstants);
+    pipelineDesc.cullBackFaces = true;
+    const PipelineHandle pipeline = device.createPipeline(pipelineDesc);
+    if (!pipeline.valid()) return 1;
+
+    // === Scene ===
+    // A ground slab, then a grid of cubes of rolling heights in autumn colours
+    const float spacing = 1.2f;
+    const float extent = static_cast<float>(grid) * spacing;
+    std::vector<glm::mat4> models;
+    std::vector<glm::vec4> colors;
+    models.push_back(glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -0.05f, 0.0f)),
+                                glm::vec3(extent, 0.1f, extent)));
+    colors.emplace_back(0.35f, 0.45f, 0.2f, 1.0f);
+    for (int z = 0; z < grid; z++) {
+        for (int x = 0; x < grid; x++) {
+            const float height = 0.5f + 1.5f * (0.5f + 0.5f * std::sin(x * 0.4f) * std::cos(z * 0.3f));
+            const glm::vec3 position((x - (grid - 1) * 0.5f) * spacing, height * 0.5f,
+                                     (z - (grid - 1) * 0.5f) * spacing);
+            models.push_back(glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(0.8f, height, 0.8f)));
+            const float t = static_cast<float>((x * 7 + z * 13) % 17) / 16.0f;
+            colors.push_back(glm::mix(glm::vec4(0.85f, 0.35f, 0.1f, 1.0f), glm::vec4(0.95f, 0.75f, 0.2f, 1.0f), t));
+        }
+    }
+    const auto drawCount = static_cast<int>(models.size());
+
+    const glm::mat4 view = glm::lookAt(glm::vec3(0.75f, 0.55f, 0.75f) * extent, glm::vec3(0.0f),
+                                       glm::vec3(0.0f, 1.0f, 0.0f));
+    const glm::mat4 projection = glm::perspective(glm::radians(45.0f), 1.0f, 0.1f, extent * 4.0f);
+    const glm::mat4 viewProjection = device.clipCorrection() * projection * view;
+
+    // Each list draws a contiguous range into the same targets; the first one clears them
+    auto record = [&](CommandList &list, int first, int last, bool clear) {
+        list.begin();
+        RenderPassDesc pass;
+        pass.color = colorTarget;
+        pass.depth = depthTarget;
+        pass.clear = clear;
+        pass.clearColor = CLEAR_COLOR;
+        list.beginRenderPass(pass);
+        list.bindPipeline(pipeline);
+        list.bindVertexBuffer(vertexBuffer);
+        list.bindIndexBuffer(indexBuffer);
+        for (int i = first; i < last; i++) {
+            const CubeConstants constants{viewProjection * models[i], colors[i]};
+            list.pushConstants(&constants, sizeof(constants));
+            list.drawIndexed(static_cast<uint32_t>(cubeIndices.size()));
+        }
+        list.endRenderPass();
+        list.end();
+    };
+
+    // === Recording ===
+    // Per frame in flight: one list for the single-threaded recording, then one per thread
+    ThreadPool threadPool;
+    const int listCount = static_cast<int>(threadPool.size());
+    std::vector<std::vector<std::unique_ptr<CommandList> > > frameLists(VulkanRenderDevice::FRAMES_IN_FLIGHT);
+    for (auto &lists: frameLists) {
+        for (int i = 0; i <= listCount; i++) {
+            lists.push_back(device.createCommandList());
+        }
+    }
+
+    using Clock = std::chrono::high_resolution_clock;
+    double serialMs = 0.0, parallelMs = 0.0;
+    std::vector<unsigned char> serialPixels;
+    for (int frame = 0; frame < frames; frame++) {
+        const auto &lists = frameLists[frame % VulkanRenderDevice::FRAMES_IN_FLIGHT];
+        auto start = Clock::now();
+        record(*lists[0], 0, drawCount, true);
+        serialMs += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        device.submit({lists[0].get()});
+        if (frame == frames - 1) serialPixels = device.readTexture(colorTarget);
+
+        start = Clock::now();
+        threadPool.parallelFor(listCount, [&](int i) {
+            record(*lists[i + 1], drawCount * i / listCount, drawCount * (i + 1) / listCount, i == 0);
+        });
+        parallelMs += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        std::vector<CommandList *> parallelBatch;
+        for (int i = 1; i <= listCount; i++) {
+            parallelBatch.push_back(lists[i].get());
+        }
+        device.submit(parallelBatch);
+    }
+
+    std::printf("Recorded %d draws per frame, average of %d frames: %.3f ms on 1 thread, %.3f ms on %d threads\n",
+                drawCount, frames, serialMs / frames, parallelMs / frames, listCount);
+
+    // === Readback ===
+    const std::vector<unsigned char> pixels = device.readTexture(colorTarget);
+    if (!writePPM("vulkan_headless.ppm", pixels, size, size)) {
+        std::cout << "ERROR::VULKAN_HEADLESS::IMAGE_NOT_WRITTEN" << std::endl;
+        return 1;
+    }
+    std::cout << "Wrote vulkan_headless.ppm (" << size << "x" << size << ")" << std::endl;
+
+    // === Checks ===
+    // The lists draw the same cubes in the same order, so the images match exactly. Pixels that are not the clear
+    // colour show the pipeline, viewport and depth setup put the scene on screen
+    int failures = 0;
+    if (pixels.size() != static_cast<size_t>(size) * size * 4 || pixels != serialPixels) {
+        std::cout << "FAIL recording on " << listCount << " threads gives a different image than on 1" << std::endl;
+        failures++;
+    }
+    size_t covered = 0;
+    for (size_t i = 0; i + 3 < pixels.size(); i += 4) {
+        for (int c = 0; c < 3; c++) {
+            if (std::abs(pixels[i + c] - static_cast<int>(std::lround(CLEAR_COLOR[c] * 255.0f))) > 1) {
+                covered++;
+                break;
+            }
+        }
+    }
+    const double coverage = pixels.empty() ? 0.0 : 100.0 * static_cast<double>(covered) / (pixels.size() / 4);
+    std::printf("Scene covers %.1f%% of the image\n", coverage);
+    if (coverage < 10.0 || coverage > 99.9) {
+        std::cout << "FAIL the scene covers " << coverage << "% of the image" << std::endl;
+        failures++;
+    }
+    if (device.validationErrors() > 0) {
+        std::cout << "FAIL the validation layer reported " << device.validationErrors() << " error(s)" << std::endl;
+        failures++;
+    }
+
+    // Lists go before the device
+    frameLists.clear();
+    return failures > 0 ? 1 : 0;
+}